@@ -1,6 +1,8 @@
 #pragma once
 
 #include "iostream"
+#include <cstdint>
+#include <vector>
 
 #ifndef NDEBUG
 #define ASSERT(condition, message)                                             \
@@ -29,3 +31,47 @@ inline size_t AlignUp(size_t originalSize, size_t alignment)
 	}
 	return alignedSize;
 }
+
+
+namespace Plume
+{
+
+// Non-owning view over a contiguous range of elements, e.g. a vector or a block of a memory-mapped file
+template <typename T>
+struct ArrayView
+{
+	const T* pData = nullptr;
+	size_t count = 0;
+
+	ArrayView() = default;
+	ArrayView(const T* pFirst, size_t numElements) : pData(pFirst), count(numElements) {}
+	ArrayView(const std::vector<T>& vec) : pData(vec.data()), count(vec.size()) {}
+
+	const T* data() const { return pData; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	const T* begin() const { return pData; }
+	const T* end() const { return pData + count; }
+
+	const T& operator[](size_t i) const { return pData[i]; }
+};
+
+
+constexpr uint64_t FNV1A_64_OFFSET_BASIS = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV1A_64_PRIME = 0x100000001b3ull;
+
+// 64-bit FNV-1a, chainable through the seed parameter
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = FNV1A_64_OFFSET_BASIS)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= FNV1A_64_PRIME;
+	}
+	return hash;
+}
+
+} // namespace Plume
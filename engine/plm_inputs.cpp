@@ -1,9 +1,12 @@
 #include "plm_inputs.h"
+#include "plm_tracer.h"
 #include "imgui_impl_sdl3.h"
 
 
 void Plume::InputManager::PollEvents()
 {
+	PLM_TRACE_ZONE("PollEvents");
+
 	float curFrameTime = static_cast<float>(SDL_GetTicks() / 1000.0f);
 	_deltaTime = curFrameTime - _lastFrameTime;
 	_lastFrameTime = curFrameTime;
@@ -57,6 +60,11 @@ void Plume::InputManager::PollEvents()
 
 				break;
 			}
+			else if (sym == SDLK_F3)
+			{
+				keyEvent.type = EventType::eWriteTrace;
+				break;
+			}
 			else if (sym == SDLK_ESCAPE)
 			{
 				keyEvent.type = EventType::eQuit;
@@ -24,7 +24,8 @@ public:
 		eMovementStop,
 		eZoom,
 		eDebugWindow,
-		eDefocusMode
+		eDefocusMode,
+		eWriteTrace
 	};
 
 	struct Event
@@ -1,9 +1,58 @@
 #include "plm_inputs.h"
 #include "plm_render.h"
+#include "plm_tracer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+
+namespace
+{
+
+constexpr uint32_t DEFAULT_HEADLESS_FRAME_COUNT = 100;
+
+
+struct LaunchOptions
+{
+	bool isHeadless = false;
+	uint32_t numHeadlessFrames = DEFAULT_HEADLESS_FRAME_COUNT;
+};
+
+
+// --headless renders offscreen without a window, --frames <count> sets the number of frames it renders
+LaunchOptions ParseLaunchOptions(int argc, char* argv[])
+{
+	LaunchOptions options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			options.isHeadless = true;
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			options.numHeadlessFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else
+		{
+			std::cout << "Ignoring unknown argument " << argv[i] << std::endl;
+		}
+	}
+
+	return options;
+}
+
+} // anonymous namespace
 
 
 void main(int argc, char* argv[])
 {
+	PLM_TRACE_THREAD_NAME("Main");
+
+	const LaunchOptions options = ParseLaunchOptions(argc, argv);
+
 	Plume::InputManager inputSystem;
 
 	Plume::Scene scene;
@@ -16,17 +65,29 @@ void main(int argc, char* argv[])
 	initData.pCam = inputSystem.GetPCamera();
 	initData.pLightManager = &lightManager;
 	initData.pScene = &scene;
+	initData.isHeadless = options.isHeadless;
 
 	Plume::RenderManager renderer;
 	renderer.Init(initData);
 
-	while (!inputSystem.ShouldQuit())
+	if (options.isHeadless)
+	{
+		renderer.RenderFrames(options.numHeadlessFrames);
+	}
+	else
 	{
-		inputSystem.PollEvents();
+		while (!inputSystem.ShouldQuit())
+		{
+			PLM_TRACE_ZONE("Frame");
 
-		renderer.ProcessInputEvents(inputSystem.GetEventQueue());
-		renderer.RenderFrame();
+			inputSystem.PollEvents();
+
+			renderer.ProcessInputEvents(inputSystem.GetEventQueue());
+			renderer.RenderFrame();
+		}
 	}
 
 	renderer.Terminate();
+
+	PLM_TRACE_WRITE(Plume::Tracer::TRACE_PATH);
 }
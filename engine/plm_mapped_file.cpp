@@ -0,0 +1,166 @@
+#include "plm_mapped_file.h"
+
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+bool Plume::MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void* pView = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!pView)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	_fileHandle = file;
+	_mappingHandle = mapping;
+	_pData = static_cast<const uint8_t*>(pView);
+	_size = static_cast<size_t>(fileSize.QuadPart);
+
+	return true;
+}
+
+
+void Plume::MappedFile::Close()
+{
+	if (_pData)
+	{
+		UnmapViewOfFile(_pData);
+	}
+	if (_mappingHandle)
+	{
+		CloseHandle(_mappingHandle);
+	}
+	if (_fileHandle)
+	{
+		CloseHandle(_fileHandle);
+	}
+
+	_pData = nullptr;
+	_size = 0;
+	_mappingHandle = nullptr;
+	_fileHandle = nullptr;
+}
+
+#else
+
+bool Plume::MappedFile::Open(const std::string& filePath)
+{
+	Close();
+
+	int fd = open(filePath.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat = {};
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* pView = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	if (pView == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	_fileDescriptor = fd;
+	_pData = static_cast<const uint8_t*>(pView);
+	_size = static_cast<size_t>(fileStat.st_size);
+
+	return true;
+}
+
+
+void Plume::MappedFile::Close()
+{
+	if (_pData)
+	{
+		munmap(const_cast<uint8_t*>(_pData), _size);
+	}
+	if (_fileDescriptor >= 0)
+	{
+		close(_fileDescriptor);
+	}
+
+	_pData = nullptr;
+	_size = 0;
+	_fileDescriptor = -1;
+}
+
+#endif
+
+
+bool Plume::WriteFileAtomically(const std::string& filePath, ArrayView<uint8_t> data)
+{
+	const std::string tempPath = filePath + ".tmp";
+	std::error_code errorCode;
+
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		file.close();
+
+		if (!file.good())
+		{
+			std::filesystem::remove(tempPath, errorCode);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, filePath, errorCode);
+	if (errorCode)
+	{
+		std::filesystem::remove(tempPath, errorCode);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "plm_common.h"
+
+#include <string>
+
+
+namespace Plume
+{
+
+// Read-only memory mapping of a whole file. The mapping stays valid until Close() or destruction.
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+
+	bool Open(const std::string& filePath);
+	void Close();
+
+	bool IsOpen() const { return _pData != nullptr; }
+
+	const uint8_t* GetData() const { return _pData; }
+	size_t GetSize() const { return _size; }
+
+private:
+	const uint8_t* _pData = nullptr;
+	size_t _size = 0;
+
+#ifdef _WIN32
+	void* _fileHandle = nullptr;
+	void* _mappingHandle = nullptr;
+#else
+	int _fileDescriptor = -1;
+#endif
+};
+
+
+// Writes data to a temporary file next to filePath and renames it over filePath, so that an interrupted write never
+// leaves a truncated file behind. The temporary file is removed again if anything fails.
+bool WriteFileAtomically(const std::string& filePath, ArrayView<uint8_t> data);
+
+} // namespace Plume
@@ -0,0 +1,419 @@
+#include "plm_mesh_cache.h"
+#include "plm_mapped_file.h"
+#include "plm_scene.h"
+
+#include <cstring>
+#include <memory>
+
+
+namespace
+{
+
+constexpr size_t PAYLOAD_ALIGNMENT = 16;
+
+struct CacheHeader
+{
+	uint32_t magic = Plume::MeshCache::MAGIC;
+	uint32_t version = Plume::MeshCache::VERSION;
+	uint32_t vertexStride = sizeof(Vertex);
+	uint32_t indexStride = sizeof(uint32_t);
+	uint32_t meshletStride = sizeof(Plume::Meshlet);
+	uint32_t padding = 0;
+	uint64_t sourceHash = 0;
+};
+
+struct CachedMeshRecord
+{
+	int32_t matIndex = -1;
+	float emittance[3] = {};
+	uint64_t vertexCount = 0;
+	uint64_t indexCount = 0;
+	uint64_t vertexOffset = 0;
+	uint64_t indexOffset = 0;
+	uint32_t numLods = 0;
+	uint32_t padding = 0;
+	uint64_t meshletCount = 0;
+	uint64_t meshletVertexCount = 0;
+	uint64_t meshletTriangleCount = 0;
+	uint64_t meshletOffset = 0;
+	uint64_t meshletVertexOffset = 0;
+	uint64_t meshletTriangleOffset = 0;
+};
+
+// LOD records of all meshes follow the mesh records, in mesh order
+struct CachedLodRecord
+{
+	float error = 0.0f;
+	uint32_t padding = 0;
+	uint64_t indexCount = 0;
+	uint64_t indexOffset = 0;
+};
+
+
+class BlobWriter
+{
+public:
+	template <typename T>
+	void Write(const T& value)
+	{
+		WriteBytes(&value, sizeof(T));
+	}
+
+	void WriteBytes(const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		_blob.insert(_blob.end(), bytes, bytes + size);
+	}
+
+	void WriteString(const std::string& str)
+	{
+		Write(static_cast<uint32_t>(str.size()));
+		WriteBytes(str.data(), str.size());
+	}
+
+	void WriteStringTable(const std::vector<std::string>& table)
+	{
+		Write(static_cast<uint32_t>(table.size()));
+		for (const auto& str : table)
+		{
+			WriteString(str);
+		}
+	}
+
+	void Align(size_t alignment)
+	{
+		_blob.resize(AlignUp(_blob.size(), alignment), 0);
+	}
+
+	size_t GetSize() const { return _blob.size(); }
+	const std::vector<uint8_t>& GetBlob() const { return _blob; }
+
+	// Patches a value written earlier, once its contents are known
+	template <typename T>
+	void Overwrite(size_t offset, const T& value)
+	{
+		memcpy(_blob.data() + offset, &value, sizeof(T));
+	}
+
+private:
+	std::vector<uint8_t> _blob;
+};
+
+
+class BlobReader
+{
+public:
+	BlobReader(const uint8_t* pData, size_t size) : _pData(pData), _size(size) {}
+
+	template <typename T>
+	bool Read(T& value)
+	{
+		if (_size - _offset < sizeof(T))
+		{
+			return false;
+		}
+		memcpy(&value, _pData + _offset, sizeof(T));
+		_offset += sizeof(T);
+		return true;
+	}
+
+	bool ReadString(std::string& str)
+	{
+		uint32_t length = 0;
+		if (!Read(length) || _size - _offset < length)
+		{
+			return false;
+		}
+		str.assign(reinterpret_cast<const char*>(_pData + _offset), length);
+		_offset += length;
+		return true;
+	}
+
+	bool ReadStringTable(std::vector<std::string>& table)
+	{
+		uint32_t count = 0;
+		if (!Read(count))
+		{
+			return false;
+		}
+		table.resize(count);
+		for (auto& str : table)
+		{
+			if (!ReadString(str))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Checks that [offset, offset + size) lies within the blob
+	bool ContainsRange(uint64_t offset, uint64_t size) const
+	{
+		return offset <= _size && size <= _size - offset;
+	}
+
+private:
+	const uint8_t* _pData = nullptr;
+	size_t _size = 0;
+	size_t _offset = 0;
+};
+
+} // anonymous namespace
+
+
+std::string Plume::MeshCache::GetCachePath(const std::string& sourcePath)
+{
+	return sourcePath + ".plmcache";
+}
+
+
+bool Plume::MeshCache::HashSourceFiles(const std::vector<std::string>& filePaths, uint64_t importSettingsHash, uint64_t& resHash)
+{
+	uint64_t hash = HashBytes(&importSettingsHash, sizeof(importSettingsHash));
+
+	for (const auto& filePath : filePaths)
+	{
+		MappedFile file;
+		if (!file.Open(filePath))
+		{
+			return false;
+		}
+
+		hash = HashBytes(filePath.data(), filePath.size(), hash);
+		hash = HashBytes(file.GetData(), file.GetSize(), hash);
+	}
+
+	resHash = hash;
+	return true;
+}
+
+
+bool Plume::MeshCache::Load(const std::string& sourcePath, uint64_t importSettingsHash, std::vector<Mesh>& meshes, MaterialTables& materials)
+{
+	auto pCacheFile = std::make_shared<MappedFile>();
+	if (!pCacheFile->Open(GetCachePath(sourcePath)))
+	{
+		return false;
+	}
+
+	BlobReader reader(pCacheFile->GetData(), pCacheFile->GetSize());
+
+	CacheHeader header = {};
+	if (!reader.Read(header) || header.magic != MAGIC || header.version != VERSION ||
+		header.vertexStride != sizeof(Vertex) || header.indexStride != sizeof(uint32_t) || header.meshletStride != sizeof(Meshlet))
+	{
+		return false;
+	}
+
+	std::vector<std::string> dependencies;
+	if (!reader.ReadStringTable(dependencies))
+	{
+		return false;
+	}
+
+	uint64_t sourceHash = 0;
+	if (!HashSourceFiles(dependencies, importSettingsHash, sourceHash) || sourceHash != header.sourceHash)
+	{
+		std::cout << "Mesh cache for " << sourcePath << " is out of date" << std::endl;
+		return false;
+	}
+
+	MaterialTables cachedMaterials;
+	if (!reader.ReadStringTable(cachedMaterials.matNames) || !reader.ReadStringTable(cachedMaterials.diffuseTexNames) ||
+		!reader.ReadStringTable(cachedMaterials.metallicTexNames) || !reader.ReadStringTable(cachedMaterials.roughnessTexNames) ||
+		!reader.ReadStringTable(cachedMaterials.normalMapNames))
+	{
+		return false;
+	}
+
+	uint32_t numMeshes = 0;
+	if (!reader.Read(numMeshes))
+	{
+		return false;
+	}
+
+	std::vector<CachedMeshRecord> records(numMeshes);
+	for (auto& record : records)
+	{
+		if (!reader.Read(record))
+		{
+			return false;
+		}
+	}
+
+	const uint8_t* pData = pCacheFile->GetData();
+
+	std::vector<Mesh> cachedMeshes(numMeshes);
+	for (size_t i = 0; i < cachedMeshes.size(); ++i)
+	{
+		Mesh& mesh = cachedMeshes[i];
+		const CachedMeshRecord& record = records[i];
+
+		if (!reader.ContainsRange(record.vertexOffset, record.vertexCount * sizeof(Vertex)) ||
+			!reader.ContainsRange(record.indexOffset, record.indexCount * sizeof(uint32_t)) ||
+			record.vertexOffset % PAYLOAD_ALIGNMENT != 0 || record.indexOffset % PAYLOAD_ALIGNMENT != 0)
+		{
+			return false;
+		}
+
+		if (!reader.ContainsRange(record.meshletOffset, record.meshletCount * sizeof(Meshlet)) ||
+			!reader.ContainsRange(record.meshletVertexOffset, record.meshletVertexCount * sizeof(uint32_t)) ||
+			!reader.ContainsRange(record.meshletTriangleOffset, record.meshletTriangleCount * sizeof(uint32_t)) ||
+			record.meshletOffset % PAYLOAD_ALIGNMENT != 0 || record.meshletVertexOffset % PAYLOAD_ALIGNMENT != 0 ||
+			record.meshletTriangleOffset % PAYLOAD_ALIGNMENT != 0)
+		{
+			return false;
+		}
+
+		mesh.matIndex = record.matIndex;
+		mesh.emittance = glm::vec3(record.emittance[0], record.emittance[1], record.emittance[2]);
+
+		mesh.pCacheFile = pCacheFile;
+		mesh.cachedVertices = ArrayView<Vertex>(reinterpret_cast<const Vertex*>(pData + record.vertexOffset), record.vertexCount);
+		mesh.cachedIndices = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(pData + record.indexOffset), record.indexCount);
+
+		mesh.cachedMeshlets = ArrayView<Meshlet>(reinterpret_cast<const Meshlet*>(pData + record.meshletOffset), record.meshletCount);
+		mesh.cachedMeshletVertices = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(pData + record.meshletVertexOffset),
+			record.meshletVertexCount);
+		mesh.cachedMeshletTriangles = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(pData + record.meshletTriangleOffset),
+			record.meshletTriangleCount);
+
+		mesh.lods.resize(record.numLods);
+		for (auto& lod : mesh.lods)
+		{
+			CachedLodRecord lodRecord = {};
+			if (!reader.Read(lodRecord))
+			{
+				return false;
+			}
+
+			if (!reader.ContainsRange(lodRecord.indexOffset, lodRecord.indexCount * sizeof(uint32_t)) ||
+				lodRecord.indexOffset % PAYLOAD_ALIGNMENT != 0)
+			{
+				return false;
+			}
+
+			lod.error = lodRecord.error;
+			lod.cachedIndices = ArrayView<uint32_t>(reinterpret_cast<const uint32_t*>(pData + lodRecord.indexOffset),
+				lodRecord.indexCount);
+		}
+	}
+
+	meshes = std::move(cachedMeshes);
+	materials = std::move(cachedMaterials);
+
+	return true;
+}
+
+
+bool Plume::MeshCache::Store(const std::string& sourcePath, uint64_t importSettingsHash, const std::vector<std::string>& dependencies,
+	const std::vector<Mesh>& meshes, const MaterialTables& materials)
+{
+	CacheHeader header = {};
+	if (!HashSourceFiles(dependencies, importSettingsHash, header.sourceHash))
+	{
+		return false;
+	}
+
+	BlobWriter writer;
+	writer.Write(header);
+
+	writer.WriteStringTable(dependencies);
+
+	writer.WriteStringTable(materials.matNames);
+	writer.WriteStringTable(materials.diffuseTexNames);
+	writer.WriteStringTable(materials.metallicTexNames);
+	writer.WriteStringTable(materials.roughnessTexNames);
+	writer.WriteStringTable(materials.normalMapNames);
+
+	writer.Write(static_cast<uint32_t>(meshes.size()));
+
+	// Records are patched with payload offsets once the payload has been laid out
+	const size_t firstRecordOffset = writer.GetSize();
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		writer.Write(CachedMeshRecord{});
+	}
+
+	const size_t firstLodRecordOffset = writer.GetSize();
+	size_t numLodRecords = 0;
+	for (const auto& mesh : meshes)
+	{
+		for (size_t i = 0; i < mesh.lods.size(); ++i)
+		{
+			writer.Write(CachedLodRecord{});
+		}
+	}
+
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		const Mesh& mesh = meshes[i];
+		ArrayView<Vertex> vertices = mesh.GetVertices();
+		ArrayView<uint32_t> indices = mesh.GetIndices();
+
+		CachedMeshRecord record = {};
+		record.matIndex = mesh.matIndex;
+		record.emittance[0] = mesh.emittance.x;
+		record.emittance[1] = mesh.emittance.y;
+		record.emittance[2] = mesh.emittance.z;
+		record.vertexCount = vertices.size();
+		record.indexCount = indices.size();
+		record.numLods = static_cast<uint32_t>(mesh.lods.size());
+
+		writer.Align(PAYLOAD_ALIGNMENT);
+		record.vertexOffset = writer.GetSize();
+		writer.WriteBytes(vertices.data(), vertices.size() * sizeof(Vertex));
+
+		writer.Align(PAYLOAD_ALIGNMENT);
+		record.indexOffset = writer.GetSize();
+		writer.WriteBytes(indices.data(), indices.size() * sizeof(uint32_t));
+
+		ArrayView<Meshlet> meshlets = mesh.GetMeshlets();
+		ArrayView<uint32_t> meshletVertices = mesh.GetMeshletVertices();
+		ArrayView<uint32_t> meshletTriangles = mesh.GetMeshletTriangles();
+
+		record.meshletCount = meshlets.size();
+		record.meshletVertexCount = meshletVertices.size();
+		record.meshletTriangleCount = meshletTriangles.size();
+
+		writer.Align(PAYLOAD_ALIGNMENT);
+		record.meshletOffset = writer.GetSize();
+		writer.WriteBytes(meshlets.data(), meshlets.size() * sizeof(Meshlet));
+
+		writer.Align(PAYLOAD_ALIGNMENT);
+		record.meshletVertexOffset = writer.GetSize();
+		writer.WriteBytes(meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+
+		writer.Align(PAYLOAD_ALIGNMENT);
+		record.meshletTriangleOffset = writer.GetSize();
+		writer.WriteBytes(meshletTriangles.data(), meshletTriangles.size() * sizeof(uint32_t));
+
+		writer.Overwrite(firstRecordOffset + i * sizeof(CachedMeshRecord), record);
+
+		for (size_t lodId = 0; lodId < mesh.lods.size(); ++lodId)
+		{
+			ArrayView<uint32_t> lodIndices = mesh.GetLodIndices(lodId);
+
+			CachedLodRecord lodRecord = {};
+			lodRecord.error = mesh.lods[lodId].error;
+			lodRecord.indexCount = lodIndices.size();
+
+			writer.Align(PAYLOAD_ALIGNMENT);
+			lodRecord.indexOffset = writer.GetSize();
+			writer.WriteBytes(lodIndices.data(), lodIndices.size() * sizeof(uint32_t));
+
+			writer.Overwrite(firstLodRecordOffset + numLodRecords * sizeof(CachedLodRecord), lodRecord);
+			++numLodRecords;
+		}
+	}
+
+	const std::string cachePath = GetCachePath(sourcePath);
+	if (!Plume::WriteFileAtomically(cachePath, writer.GetBlob()))
+	{
+		std::cout << "Failed to write mesh cache " << cachePath << std::endl;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "plm_common.h"
+
+#include <string>
+#include <vector>
+
+
+namespace Plume
+{
+
+struct Mesh;
+struct MaterialTables;
+
+// Baked binary copy of an imported model, stored next to the source file. Vertex and index data are kept
+// in the exact in-memory layout of Plume::Mesh, so a cache hit only maps the file and hands out views into it.
+namespace MeshCache
+{
+
+constexpr uint32_t MAGIC = 0x434d4c50; // "PLMC"
+constexpr uint32_t VERSION = 4;
+
+std::string GetCachePath(const std::string& sourcePath);
+
+// Hash of every file the importer read for this model together with the import settings
+bool HashSourceFiles(const std::vector<std::string>& filePaths, uint64_t importSettingsHash, uint64_t& resHash);
+
+// Fills meshes (with model-local material indices) and material tables on success. Returns false on a missing,
+// outdated or corrupted cache.
+bool Load(const std::string& sourcePath, uint64_t importSettingsHash, std::vector<Mesh>& meshes, MaterialTables& materials);
+
+// Mesh material indices are expected to be model-local
+bool Store(const std::string& sourcePath, uint64_t importSettingsHash, const std::vector<std::string>& dependencies,
+	const std::vector<Mesh>& meshes, const MaterialTables& materials);
+
+} // namespace MeshCache
+
+} // namespace Plume
@@ -0,0 +1,414 @@
+#include "plm_mesh_optimizer.h"
+#include "plm_scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+
+namespace
+{
+
+struct VertexHasher
+{
+	size_t operator()(const Vertex& vertex) const
+	{
+		return static_cast<size_t>(Plume::HashBytes(&vertex, sizeof(Vertex)));
+	}
+};
+
+struct VertexBitwiseEqual
+{
+	bool operator()(const Vertex& lhs, const Vertex& rhs) const
+	{
+		return memcmp(&lhs, &rhs, sizeof(Vertex)) == 0;
+	}
+};
+
+
+// Forsyth's vertex cache optimization parameters
+constexpr int32_t FORSYTH_CACHE_SIZE = 32;
+constexpr float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+constexpr float FORSYTH_LAST_TRI_SCORE = 0.75f;
+constexpr float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+constexpr float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+float ForsythVertexScore(int32_t cachePosition, uint32_t numRemainingTris)
+{
+	if (numRemainingTris == 0)
+	{
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// the vertices of the last triangle get a fixed score so that strips are not preferred over fans
+			score = FORSYTH_LAST_TRI_SCORE;
+		}
+		else
+		{
+			const float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	// boost vertices with few remaining triangles to get rid of lone triangles early
+	score += FORSYTH_VALENCE_BOOST_SCALE * std::pow(static_cast<float>(numRemainingTris), -FORSYTH_VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+} // anonymous namespace
+
+
+Plume::MeshOptimizer::Stats Plume::MeshOptimizer::ComputeStats(const std::vector<uint32_t>& indices, size_t vertexCount,
+	size_t cacheSize /* = STATS_CACHE_SIZE */)
+{
+	Stats stats = {};
+	stats.vertexCount = vertexCount;
+	stats.indexCount = indices.size();
+
+	// ACMR is per triangle, so meshes without a whole triangle keep zero stats
+	if (indices.size() < 3 || vertexCount == 0)
+	{
+		return stats;
+	}
+
+	// FIFO cache: a vertex is cached if fewer than cacheSize misses happened since it was last transformed
+	std::vector<size_t> cacheTimestamps(vertexCount, 0);
+	size_t timestamp = cacheSize + 1;
+	size_t numMisses = 0;
+
+	for (uint32_t index : indices)
+	{
+		if (timestamp - cacheTimestamps[index] > cacheSize)
+		{
+			cacheTimestamps[index] = timestamp++;
+			++numMisses;
+		}
+	}
+
+	stats.acmr = static_cast<float>(numMisses) / (indices.size() / 3);
+	stats.atvr = static_cast<float>(numMisses) / vertexCount;
+
+	return stats;
+}
+
+
+void Plume::MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	std::unordered_map<Vertex, uint32_t, VertexHasher, VertexBitwiseEqual> uniqueVertices;
+	uniqueVertices.reserve(vertices.size());
+
+	std::vector<Vertex> weldedVertices;
+	weldedVertices.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		const Vertex& vertex = vertices[index];
+
+		auto [it, isNew] = uniqueVertices.try_emplace(vertex, static_cast<uint32_t>(weldedVertices.size()));
+		if (isNew)
+		{
+			weldedVertices.push_back(vertex);
+		}
+
+		index = it->second;
+	}
+
+	vertices = std::move(weldedVertices);
+}
+
+
+void Plume::MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	const size_t numTris = indices.size() / 3;
+	if (numTris == 0)
+	{
+		return;
+	}
+
+	// vertex -> triangle adjacency
+	std::vector<uint32_t> numRemainingTris(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		++numRemainingTris[index];
+	}
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + numRemainingTris[v];
+	}
+
+	std::vector<uint32_t> adjacentTris(indices.size());
+	{
+		std::vector<uint32_t> fillCounts(vertexCount, 0);
+		for (size_t tri = 0; tri < numTris; ++tri)
+		{
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const uint32_t v = indices[tri * 3 + k];
+				adjacentTris[adjacencyOffsets[v] + fillCounts[v]++] = static_cast<uint32_t>(tri);
+			}
+		}
+	}
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		vertexScores[v] = ForsythVertexScore(-1, numRemainingTris[v]);
+	}
+
+	std::vector<float> triScores(numTris);
+	std::vector<bool> isTriEmitted(numTris, false);
+	for (size_t tri = 0; tri < numTris; ++tri)
+	{
+		triScores[tri] = vertexScores[indices[tri * 3]] + vertexScores[indices[tri * 3 + 1]] + vertexScores[indices[tri * 3 + 2]];
+	}
+
+	std::vector<uint32_t> optimizedIndices;
+	optimizedIndices.reserve(indices.size());
+
+	// the cache holds up to 3 extra entries so that the vertices pushed out by the newest triangle can be rescored
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+	size_t scanCursor = 0;
+	int64_t bestTri = -1;
+
+	for (size_t numEmitted = 0; numEmitted < numTris; ++numEmitted)
+	{
+		if (bestTri < 0)
+		{
+			// nothing useful in the cache, continue with the next triangle in source order
+			while (isTriEmitted[scanCursor])
+			{
+				++scanCursor;
+			}
+			bestTri = static_cast<int64_t>(scanCursor);
+		}
+
+		const size_t tri = static_cast<size_t>(bestTri);
+		isTriEmitted[tri] = true;
+
+		newCache.clear();
+		for (size_t k = 0; k < 3; ++k)
+		{
+			const uint32_t v = indices[tri * 3 + k];
+			optimizedIndices.push_back(v);
+			newCache.push_back(v);
+
+			// remove the triangle from the vertex adjacency
+			uint32_t* pFirst = adjacentTris.data() + adjacencyOffsets[v];
+			uint32_t* pLast = pFirst + numRemainingTris[v] - 1;
+			*std::find(pFirst, pLast + 1, static_cast<uint32_t>(tri)) = *pLast;
+			--numRemainingTris[v];
+		}
+
+		for (uint32_t v : cache)
+		{
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+			{
+				newCache.push_back(v);
+			}
+		}
+		std::swap(cache, newCache);
+
+		// newCache now holds the previous cache contents, those that fell out need their position reset
+		for (uint32_t v : newCache)
+		{
+			cachePositions[v] = -1;
+		}
+
+		if (cache.size() > FORSYTH_CACHE_SIZE + 3)
+		{
+			cache.resize(FORSYTH_CACHE_SIZE + 3);
+		}
+
+		for (size_t i = 0; i < cache.size(); ++i)
+		{
+			const uint32_t v = cache[i];
+			cachePositions[v] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+		}
+
+		// rescore the vertices that moved and all triangles touching them
+		for (uint32_t v : cache)
+		{
+			const float newScore = ForsythVertexScore(cachePositions[v], numRemainingTris[v]);
+			const float scoreDelta = newScore - vertexScores[v];
+			vertexScores[v] = newScore;
+
+			for (uint32_t i = 0; i < numRemainingTris[v]; ++i)
+			{
+				triScores[adjacentTris[adjacencyOffsets[v] + i]] += scoreDelta;
+			}
+		}
+
+		// only triangles touching the cache changed, so the best candidate is among them
+		bestTri = -1;
+		float bestScore = -1.0f;
+
+		for (uint32_t v : cache)
+		{
+			for (uint32_t i = 0; i < numRemainingTris[v]; ++i)
+			{
+				const uint32_t adjTri = adjacentTris[adjacencyOffsets[v] + i];
+				if (triScores[adjTri] > bestScore)
+				{
+					bestScore = triScores[adjTri];
+					bestTri = adjTri;
+				}
+			}
+		}
+
+		if (cache.size() > FORSYTH_CACHE_SIZE)
+		{
+			cache.resize(FORSYTH_CACHE_SIZE);
+		}
+	}
+
+	indices = std::move(optimizedIndices);
+}
+
+
+void Plume::MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices,
+	size_t cacheSize /* = STATS_CACHE_SIZE */)
+{
+	const size_t numTris = indices.size() / 3;
+	if (numTris == 0)
+	{
+		return;
+	}
+
+	// a triangle that misses the cache on all three vertices starts a new cluster, reordering clusters then
+	// costs nothing in terms of cache efficiency
+	std::vector<size_t> clusterStarts;
+
+	std::vector<size_t> cacheTimestamps(vertices.size(), 0);
+	size_t timestamp = cacheSize + 1;
+
+	for (size_t tri = 0; tri < numTris; ++tri)
+	{
+		size_t numMisses = 0;
+		for (size_t k = 0; k < 3; ++k)
+		{
+			const uint32_t v = indices[tri * 3 + k];
+			if (timestamp - cacheTimestamps[v] > cacheSize)
+			{
+				cacheTimestamps[v] = timestamp++;
+				++numMisses;
+			}
+		}
+
+		if (tri == 0 || numMisses == 3)
+		{
+			clusterStarts.push_back(tri);
+		}
+	}
+
+	glm::vec3 meshCentroid{ 0.0f };
+	for (const auto& vertex : vertices)
+	{
+		meshCentroid += vertex.position;
+	}
+	meshCentroid /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+	// clusters facing away from the mesh center are likely to occlude the rest of the mesh, so they go first
+	std::vector<float> clusterSortKeys(clusterStarts.size());
+
+	for (size_t cluster = 0; cluster < clusterStarts.size(); ++cluster)
+	{
+		const size_t firstTri = clusterStarts[cluster];
+		const size_t lastTri = cluster + 1 < clusterStarts.size() ? clusterStarts[cluster + 1] : numTris;
+
+		glm::vec3 clusterCentroid{ 0.0f };
+		glm::vec3 clusterNormal{ 0.0f };
+		float clusterArea = 0.0f;
+
+		for (size_t tri = firstTri; tri < lastTri; ++tri)
+		{
+			const glm::vec3& p0 = vertices[indices[tri * 3]].position;
+			const glm::vec3& p1 = vertices[indices[tri * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[tri * 3 + 2]].position;
+
+			// the length of the cross product is twice the area, which is used as the weight
+			const glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+			const float area = glm::length(areaNormal);
+
+			clusterCentroid += (p0 + p1 + p2) * (area / 3.0f);
+			clusterNormal += areaNormal;
+			clusterArea += area;
+		}
+
+		if (clusterArea > 0.0f)
+		{
+			clusterCentroid /= clusterArea;
+		}
+
+		const float normalLength = glm::length(clusterNormal);
+		clusterSortKeys[cluster] = normalLength > 0.0f ? glm::dot(clusterCentroid - meshCentroid, clusterNormal / normalLength) : 0.0f;
+	}
+
+	std::vector<size_t> clusterOrder(clusterStarts.size());
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&clusterSortKeys](size_t lhs, size_t rhs) {
+		return clusterSortKeys[lhs] > clusterSortKeys[rhs];
+	});
+
+	std::vector<uint32_t> sortedIndices;
+	sortedIndices.reserve(indices.size());
+
+	for (size_t cluster : clusterOrder)
+	{
+		const size_t firstTri = clusterStarts[cluster];
+		const size_t lastTri = cluster + 1 < clusterStarts.size() ? clusterStarts[cluster + 1] : numTris;
+
+		sortedIndices.insert(sortedIndices.end(), indices.begin() + firstTri * 3, indices.begin() + lastTri * 3);
+	}
+
+	indices = std::move(sortedIndices);
+}
+
+
+void Plume::MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+	constexpr uint32_t UNASSIGNED = ~0u;
+
+	std::vector<uint32_t> remap(vertices.size(), UNASSIGNED);
+
+	std::vector<Vertex> orderedVertices;
+	orderedVertices.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == UNASSIGNED)
+		{
+			remap[index] = static_cast<uint32_t>(orderedVertices.size());
+			orderedVertices.push_back(vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	vertices = std::move(orderedVertices);
+}
+
+
+void Plume::MeshOptimizer::Optimize(Mesh& mesh)
+{
+	ASSERT(!mesh.pCacheFile, "Meshes served from the mesh cache are already optimized");
+
+	WeldVertices(mesh.vertices, mesh.indices);
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	OptimizeOverdraw(mesh.indices, mesh.vertices);
+	OptimizeVertexFetch(mesh.vertices, mesh.indices);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "plm_common.h"
+#include "../render/shaders/host_device_common.h"
+
+#include <vector>
+
+
+namespace Plume
+{
+
+struct Mesh;
+
+// Import-time index and vertex reordering passes. All of them operate on meshes owning their data,
+// i.e. before they are baked into the mesh cache.
+namespace MeshOptimizer
+{
+
+// Size of the FIFO cache used to measure ACMR, matches the post-transform cache of common hardware
+constexpr size_t STATS_CACHE_SIZE = 16;
+
+struct Stats
+{
+	size_t vertexCount = 0;
+	size_t indexCount = 0;
+	// average cache miss ratio: transformed vertices per triangle
+	float acmr = 0.0f;
+	// average transform to vertex ratio: transformed vertices per unique vertex
+	float atvr = 0.0f;
+};
+
+Stats ComputeStats(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize = STATS_CACHE_SIZE);
+
+// Merges bitwise identical vertices and drops unreferenced ones
+void WeldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Reorders triangles for post-transform cache locality (Forsyth's linear-speed algorithm)
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// Splits the cache-optimized index stream into clusters at hard cache boundaries and sorts the clusters so that
+// outward-facing ones are drawn first (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t cacheSize = STATS_CACHE_SIZE);
+
+// Reorders vertices in the order of first use by the index buffer
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Runs all of the passes above in order
+void Optimize(Mesh& mesh);
+
+} // namespace MeshOptimizer
+
+} // namespace Plume
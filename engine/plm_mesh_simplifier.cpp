@@ -0,0 +1,393 @@
+#include "plm_mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+
+
+namespace
+{
+
+struct PositionHasher
+{
+	size_t operator()(const glm::vec3& position) const
+	{
+		return static_cast<size_t>(Plume::HashBytes(&position, sizeof(glm::vec3)));
+	}
+};
+
+struct PositionBitwiseEqual
+{
+	bool operator()(const glm::vec3& lhs, const glm::vec3& rhs) const
+	{
+		return memcmp(&lhs, &rhs, sizeof(glm::vec3)) == 0;
+	}
+};
+
+
+// Sum of squared distances to a set of planes, stored as the upper triangle of a symmetric 4x4 matrix
+struct Quadric
+{
+	double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+	double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+	double a22 = 0.0, a23 = 0.0;
+	double a33 = 0.0;
+
+	// total weight of the planes, used to turn the sum into an average
+	double weight = 0.0;
+
+	static Quadric FromPlane(const glm::dvec3& normal, double distance, double planeWeight)
+	{
+		Quadric quadric;
+		quadric.a00 = normal.x * normal.x * planeWeight;
+		quadric.a01 = normal.x * normal.y * planeWeight;
+		quadric.a02 = normal.x * normal.z * planeWeight;
+		quadric.a03 = normal.x * distance * planeWeight;
+		quadric.a11 = normal.y * normal.y * planeWeight;
+		quadric.a12 = normal.y * normal.z * planeWeight;
+		quadric.a13 = normal.y * distance * planeWeight;
+		quadric.a22 = normal.z * normal.z * planeWeight;
+		quadric.a23 = normal.z * distance * planeWeight;
+		quadric.a33 = distance * distance * planeWeight;
+		quadric.weight = planeWeight;
+
+		return quadric;
+	}
+
+	void Add(const Quadric& other)
+	{
+		a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+		a11 += other.a11; a12 += other.a12; a13 += other.a13;
+		a22 += other.a22; a23 += other.a23;
+		a33 += other.a33;
+		weight += other.weight;
+	}
+
+	double Evaluate(const glm::dvec3& p) const
+	{
+		const double error = a00 * p.x * p.x + 2.0 * a01 * p.x * p.y + 2.0 * a02 * p.x * p.z + 2.0 * a03 * p.x +
+			a11 * p.y * p.y + 2.0 * a12 * p.y * p.z + 2.0 * a13 * p.y +
+			a22 * p.z * p.z + 2.0 * a23 * p.z +
+			a33;
+
+		return std::max(error, 0.0);
+	}
+};
+
+
+struct Collapse
+{
+	uint32_t from = 0;
+	uint32_t to = 0;
+	// weighted mean squared distance, relative to the mesh extent
+	double cost = 0.0;
+};
+
+
+uint64_t MakeEdgeKey(uint32_t from, uint32_t to)
+{
+	return (static_cast<uint64_t>(from) << 32) | to;
+}
+
+} // anonymous namespace
+
+
+float Plume::MeshSimplifier::GetMeshExtent(ArrayView<Vertex> vertices)
+{
+	if (vertices.empty())
+	{
+		return 0.0f;
+	}
+
+	glm::vec3 minPos = vertices[0].position;
+	glm::vec3 maxPos = vertices[0].position;
+	for (const Vertex& vertex : vertices)
+	{
+		minPos = glm::min(minPos, vertex.position);
+		maxPos = glm::max(maxPos, vertex.position);
+	}
+
+	const glm::vec3 size = maxPos - minPos;
+
+	return std::max(size.x, std::max(size.y, size.z));
+}
+
+
+float Plume::MeshSimplifier::Simplify(ArrayView<Vertex> vertices, ArrayView<uint32_t> indices, size_t targetIndexCount, float maxError,
+	std::vector<uint32_t>& resIndices)
+{
+	resIndices.assign(indices.begin(), indices.end());
+
+	const size_t vertexCount = vertices.size();
+	if (resIndices.size() <= targetIndexCount || vertexCount == 0)
+	{
+		return 0.0f;
+	}
+
+	// positions are normalized to the unit cube so that errors do not depend on the mesh scale
+	float extent = GetMeshExtent(vertices);
+	extent = extent > 0.0f ? extent : 1.0f;
+
+	glm::vec3 minPos = vertices[0].position;
+	for (const Vertex& vertex : vertices)
+	{
+		minPos = glm::min(minPos, vertex.position);
+	}
+
+	std::vector<glm::dvec3> positions(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
+	{
+		positions[i] = glm::dvec3(vertices[i].position - minPos) / static_cast<double>(extent);
+	}
+
+	// Vertices sharing a position but differing in other attributes (seams) are wedges of the same position.
+	// Topology is analyzed on positions, each of them is represented by its first vertex.
+	std::vector<uint32_t> positionIds(vertexCount);
+	std::vector<uint32_t> numWedges(vertexCount, 0);
+	{
+		std::unordered_map<glm::vec3, uint32_t, PositionHasher, PositionBitwiseEqual> firstVertices;
+		firstVertices.reserve(vertexCount);
+
+		for (uint32_t i = 0; i < vertexCount; ++i)
+		{
+			positionIds[i] = firstVertices.emplace(vertices[i].position, i).first->second;
+			++numWedges[positionIds[i]];
+		}
+	}
+
+	// border edges only exist in one direction
+	std::vector<bool> isLocked(vertexCount, false);
+	{
+		std::unordered_map<uint64_t, uint32_t> directedEdges;
+		directedEdges.reserve(resIndices.size());
+
+		for (size_t i = 0; i < resIndices.size(); i += 3)
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const uint32_t from = positionIds[resIndices[i + j]];
+				const uint32_t to = positionIds[resIndices[i + (j + 1) % 3]];
+				++directedEdges[MakeEdgeKey(from, to)];
+			}
+		}
+
+		for (const auto& [edgeKey, count] : directedEdges)
+		{
+			const uint32_t from = static_cast<uint32_t>(edgeKey >> 32);
+			const uint32_t to = static_cast<uint32_t>(edgeKey & 0xFFFFFFFF);
+			if (from != to && directedEdges.find(MakeEdgeKey(to, from)) == directedEdges.end())
+			{
+				isLocked[from] = true;
+				isLocked[to] = true;
+			}
+		}
+
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			if (numWedges[i] > 1)
+			{
+				isLocked[i] = true;
+			}
+		}
+	}
+
+	// area-weighted plane quadrics of the adjacent triangles
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < resIndices.size(); i += 3)
+	{
+		const uint32_t id0 = positionIds[resIndices[i + 0]];
+		const uint32_t id1 = positionIds[resIndices[i + 1]];
+		const uint32_t id2 = positionIds[resIndices[i + 2]];
+
+		const glm::dvec3 normal = glm::cross(positions[id1] - positions[id0], positions[id2] - positions[id0]);
+		const double normalLength = glm::length(normal);
+		if (normalLength <= 0.0)
+		{
+			continue;
+		}
+
+		const glm::dvec3 unitNormal = normal / normalLength;
+		const Quadric quadric = Quadric::FromPlane(unitNormal, -glm::dot(unitNormal, positions[id0]), 0.5 * normalLength);
+
+		quadrics[id0].Add(quadric);
+		quadrics[id1].Add(quadric);
+		quadrics[id2].Add(quadric);
+	}
+
+	auto getCollapseCost = [&](uint32_t from, uint32_t to) {
+		Quadric quadric = quadrics[from];
+		quadric.Add(quadrics[to]);
+
+		return quadric.Evaluate(positions[to]) / std::max(quadric.weight, 1e-12);
+	};
+
+	const double maxCost = static_cast<double>(maxError) * maxError;
+	double resCost = 0.0;
+
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> adjacencyOffsets;
+	std::vector<uint32_t> adjacentTriangles;
+	std::vector<uint32_t> collapseTargets(vertexCount);
+	std::vector<bool> isTouched(vertexCount);
+
+	while (resIndices.size() > targetIndexCount)
+	{
+		const size_t numTriangles = resIndices.size() / 3;
+
+		// triangles around each position
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (uint32_t index : resIndices)
+		{
+			++adjacencyOffsets[positionIds[index] + 1];
+		}
+		std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+		adjacentTriangles.resize(resIndices.size());
+		{
+			std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < resIndices.size(); ++i)
+			{
+				adjacentTriangles[fillOffsets[positionIds[resIndices[i]]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		// Every interior edge is seen twice, once per direction, so only the occurrence with from < to is evaluated.
+		// Only single-wedge positions are collapsed, which keeps the mapping between positions and vertices trivial.
+		collapses.clear();
+		for (size_t i = 0; i < resIndices.size(); i += 3)
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				const uint32_t v0 = positionIds[resIndices[i + j]];
+				const uint32_t v1 = positionIds[resIndices[i + (j + 1) % 3]];
+				if (v0 >= v1)
+				{
+					continue;
+				}
+
+				const bool canCollapse01 = !isLocked[v0] && numWedges[v1] == 1;
+				const bool canCollapse10 = !isLocked[v1] && numWedges[v0] == 1;
+
+				const double cost01 = canCollapse01 ? getCollapseCost(v0, v1) : 0.0;
+				const double cost10 = canCollapse10 ? getCollapseCost(v1, v0) : 0.0;
+
+				if (canCollapse01 && (!canCollapse10 || cost01 <= cost10))
+				{
+					collapses.push_back({ v0, v1, cost01 });
+				}
+				else if (canCollapse10)
+				{
+					collapses.push_back({ v1, v0, cost10 });
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+		std::iota(collapseTargets.begin(), collapseTargets.end(), 0);
+		std::fill(isTouched.begin(), isTouched.end(), false);
+
+		// an interior collapse removes two triangles
+		const size_t numTrianglesToRemove = (resIndices.size() - targetIndexCount + 2) / 3;
+		size_t numRemovedTriangles = 0;
+		size_t numAppliedCollapses = 0;
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.cost > maxCost || numRemovedTriangles >= numTrianglesToRemove)
+			{
+				break;
+			}
+
+			if (isTouched[collapse.from] || isTouched[collapse.to])
+			{
+				continue;
+			}
+
+			bool isFlipped = false;
+			for (uint32_t k = adjacencyOffsets[collapse.from]; k < adjacencyOffsets[collapse.from + 1] && !isFlipped; ++k)
+			{
+				const size_t triOffset = size_t(adjacentTriangles[k]) * 3;
+
+				uint32_t triIds[3] = {};
+				for (size_t j = 0; j < 3; ++j)
+				{
+					triIds[j] = positionIds[resIndices[triOffset + j]];
+				}
+
+				// triangles containing the collapsed edge disappear
+				if (triIds[0] == collapse.to || triIds[1] == collapse.to || triIds[2] == collapse.to)
+				{
+					continue;
+				}
+
+				const glm::dvec3 normalBefore = glm::cross(positions[triIds[1]] - positions[triIds[0]], positions[triIds[2]] - positions[triIds[0]]);
+
+				for (uint32_t& id : triIds)
+				{
+					id = (id == collapse.from) ? collapse.to : id;
+				}
+
+				const glm::dvec3 normalAfter = glm::cross(positions[triIds[1]] - positions[triIds[0]], positions[triIds[2]] - positions[triIds[0]]);
+
+				// rotating a triangle by more than ~75 degrees or collapsing it into a sliver is treated as a flip as well
+				isFlipped = glm::dot(normalBefore, normalAfter) <= 0.25 * glm::length(normalBefore) * glm::length(normalAfter);
+			}
+
+			if (isFlipped)
+			{
+				continue;
+			}
+
+			// triangles around the collapsed vertex change, so none of their vertices may move again in this pass
+			for (uint32_t k = adjacencyOffsets[collapse.from]; k < adjacencyOffsets[collapse.from + 1]; ++k)
+			{
+				const size_t triOffset = size_t(adjacentTriangles[k]) * 3;
+				for (size_t j = 0; j < 3; ++j)
+				{
+					isTouched[positionIds[resIndices[triOffset + j]]] = true;
+				}
+			}
+
+			collapseTargets[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+
+			resCost = std::max(resCost, collapse.cost);
+			numRemovedTriangles += 2;
+			++numAppliedCollapses;
+		}
+
+		if (numAppliedCollapses == 0)
+		{
+			break;
+		}
+
+		// collapsed positions have a single wedge, so their vertex is the position's representative
+		size_t numWrittenIndices = 0;
+		for (size_t i = 0; i < numTriangles; ++i)
+		{
+			const uint32_t i0 = collapseTargets[resIndices[i * 3 + 0]];
+			const uint32_t i1 = collapseTargets[resIndices[i * 3 + 1]];
+			const uint32_t i2 = collapseTargets[resIndices[i * 3 + 2]];
+
+			const uint32_t id0 = positionIds[i0];
+			const uint32_t id1 = positionIds[i1];
+			const uint32_t id2 = positionIds[i2];
+
+			if (id0 == id1 || id1 == id2 || id0 == id2)
+			{
+				continue;
+			}
+
+			resIndices[numWrittenIndices++] = i0;
+			resIndices[numWrittenIndices++] = i1;
+			resIndices[numWrittenIndices++] = i2;
+		}
+
+		resIndices.resize(numWrittenIndices);
+	}
+
+	return static_cast<float>(std::sqrt(resCost));
+}
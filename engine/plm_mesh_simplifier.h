@@ -0,0 +1,28 @@
+#pragma once
+
+#include "plm_common.h"
+#include "../render/shaders/host_device_common.h"
+
+#include <vector>
+
+
+namespace Plume
+{
+
+// Import-time mesh simplification for LOD generation (Garland and Heckbert, "Surface Simplification Using Quadric Error
+// Metrics"). Simplified meshes keep using the vertices of the source mesh, only a new index buffer is produced.
+namespace MeshSimplifier
+{
+
+// Largest dimension of the mesh bounding box. Simplification errors are relative to it.
+float GetMeshExtent(ArrayView<Vertex> vertices);
+
+// Collapses edges in order of their quadric error until at most targetIndexCount indices are left or the next
+// collapse would exceed maxError. Vertices on borders and attribute seams are locked, collapses that would flip
+// a triangle are rejected. Returns the error of the result relative to the mesh extent.
+float Simplify(ArrayView<Vertex> vertices, ArrayView<uint32_t> indices, size_t targetIndexCount, float maxError,
+	std::vector<uint32_t>& resIndices);
+
+} // namespace MeshSimplifier
+
+} // namespace Plume
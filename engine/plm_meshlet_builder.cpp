@@ -0,0 +1,255 @@
+#include "plm_meshlet_builder.h"
+#include "plm_scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace
+{
+
+constexpr uint8_t NOT_IN_MESHLET = std::numeric_limits<uint8_t>::max();
+constexpr uint32_t INVALID_TRIANGLE = std::numeric_limits<uint32_t>::max();
+
+static_assert(Plume::MeshletBuilder::MAX_VERTICES < NOT_IN_MESHLET, "Meshlet-local vertex ids have to fit into 8 bits");
+
+
+// Bounding sphere around the vertex bounds and the normal cone of all non-degenerate triangles
+void ComputeMeshletBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& meshletVertices,
+	const std::vector<uint32_t>& meshletTriangleIndices, Plume::Meshlet& meshlet)
+{
+	glm::vec3 minPos = vertices[meshletVertices.front()].position;
+	glm::vec3 maxPos = minPos;
+	for (uint32_t vertexId : meshletVertices)
+	{
+		minPos = glm::min(minPos, vertices[vertexId].position);
+		maxPos = glm::max(maxPos, vertices[vertexId].position);
+	}
+
+	meshlet.center = 0.5f * (minPos + maxPos);
+	meshlet.radius = 0.0f;
+	for (uint32_t vertexId : meshletVertices)
+	{
+		meshlet.radius = std::max(meshlet.radius, glm::length(vertices[vertexId].position - meshlet.center));
+	}
+
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshletTriangleIndices.size() / 3);
+
+	glm::vec3 normalSum{ 0.0f };
+	for (size_t i = 0; i < meshletTriangleIndices.size(); i += 3)
+	{
+		const glm::vec3& p0 = vertices[meshletTriangleIndices[i]].position;
+		const glm::vec3& p1 = vertices[meshletTriangleIndices[i + 1]].position;
+		const glm::vec3& p2 = vertices[meshletTriangleIndices[i + 2]].position;
+
+		const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		const float length = glm::length(normal);
+		if (length <= std::numeric_limits<float>::min())
+		{
+			continue;
+		}
+
+		normals.push_back(normal / length);
+		normalSum += normals.back();
+	}
+
+	// the default cutoff never culls
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+
+	const float normalSumLength = glm::length(normalSum);
+	if (normals.empty() || normalSumLength <= std::numeric_limits<float>::min())
+	{
+		return;
+	}
+
+	const glm::vec3 axis = normalSum / normalSumLength;
+
+	float minDot = 1.0f;
+	for (const auto& normal : normals)
+	{
+		minDot = std::min(minDot, glm::dot(axis, normal));
+	}
+
+	// normals spread over more than a hemisphere, some triangle faces every viewer
+	if (minDot <= 0.0f)
+	{
+		return;
+	}
+
+	// all triangles face away once the view direction is within 90 degrees minus the cone spread of the axis
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+} // anonymous namespace
+
+
+void Plume::MeshletBuilder::Build(Mesh& mesh)
+{
+	mesh.meshlets.clear();
+	mesh.meshletVertices.clear();
+	mesh.meshletTriangles.clear();
+
+	const std::vector<Vertex>& vertices = mesh.vertices;
+	const std::vector<uint32_t>& indices = mesh.indices;
+
+	const size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0)
+	{
+		return;
+	}
+
+	// vertex -> adjacent triangles
+	std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1, 0);
+	for (uint32_t index : indices)
+	{
+		++adjacencyOffsets[index + 1];
+	}
+	for (size_t i = 1; i < adjacencyOffsets.size(); ++i)
+	{
+		adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+	}
+
+	std::vector<uint32_t> adjacentTriangles(indices.size());
+	{
+		std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			adjacentTriangles[fillOffsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	std::vector<bool> isTriangleUsed(numTriangles, false);
+	std::vector<uint8_t> localVertexIds(vertices.size(), NOT_IN_MESHLET);
+
+	std::vector<uint32_t> curVertices;
+	std::vector<uint32_t> curTriangleIndices;
+	curVertices.reserve(MAX_VERTICES);
+	curTriangleIndices.reserve(MAX_TRIANGLES * 3);
+
+	std::vector<uint32_t> resIndices;
+	resIndices.reserve(indices.size());
+
+	auto countNewVertices = [&](uint32_t triangleId) {
+		const uint32_t* pTriangle = &indices[triangleId * 3];
+
+		uint32_t numNew = 0;
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			// repeated vertices of degenerate triangles only count once
+			const bool isRepeated = (i > 0 && pTriangle[i] == pTriangle[0]) || (i > 1 && pTriangle[i] == pTriangle[1]);
+			if (!isRepeated && localVertexIds[pTriangle[i]] == NOT_IN_MESHLET)
+			{
+				++numNew;
+			}
+		}
+
+		return numNew;
+	};
+
+	auto flushMeshlet = [&]() {
+		if (curTriangleIndices.empty())
+		{
+			return;
+		}
+
+		Meshlet meshlet;
+		meshlet.vertexOffset = static_cast<uint32_t>(mesh.meshletVertices.size());
+		meshlet.vertexCount = static_cast<uint32_t>(curVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(mesh.meshletTriangles.size());
+		meshlet.triangleCount = static_cast<uint32_t>(curTriangleIndices.size() / 3);
+
+		ComputeMeshletBounds(vertices, curVertices, curTriangleIndices, meshlet);
+
+		for (size_t i = 0; i < curTriangleIndices.size(); i += 3)
+		{
+			const uint32_t packedTriangle = localVertexIds[curTriangleIndices[i]] |
+				(localVertexIds[curTriangleIndices[i + 1]] << 8) | (localVertexIds[curTriangleIndices[i + 2]] << 16);
+			mesh.meshletTriangles.push_back(packedTriangle);
+		}
+
+		mesh.meshletVertices.insert(mesh.meshletVertices.end(), curVertices.begin(), curVertices.end());
+		resIndices.insert(resIndices.end(), curTriangleIndices.begin(), curTriangleIndices.end());
+		mesh.meshlets.push_back(meshlet);
+
+		for (uint32_t vertexId : curVertices)
+		{
+			localVertexIds[vertexId] = NOT_IN_MESHLET;
+		}
+
+		curVertices.clear();
+		curTriangleIndices.clear();
+	};
+
+	size_t scanCursor = 0;
+
+	for (size_t numUsedTriangles = 0; numUsedTriangles < numTriangles; ++numUsedTriangles)
+	{
+		// prefer the adjacent triangle adding the fewest vertices to keep meshlets compact
+		uint32_t bestTriangle = INVALID_TRIANGLE;
+		uint32_t bestNumNew = 4;
+
+		for (size_t i = 0; i < curVertices.size() && bestNumNew > 0; ++i)
+		{
+			const uint32_t vertexId = curVertices[i];
+			for (uint32_t j = adjacencyOffsets[vertexId]; j < adjacencyOffsets[vertexId + 1]; ++j)
+			{
+				const uint32_t triangleId = adjacentTriangles[j];
+				if (isTriangleUsed[triangleId])
+				{
+					continue;
+				}
+
+				const uint32_t numNew = countNewVertices(triangleId);
+				if (numNew < bestNumNew)
+				{
+					bestTriangle = triangleId;
+					bestNumNew = numNew;
+
+					if (numNew == 0)
+					{
+						break;
+					}
+				}
+			}
+		}
+
+		// nothing adjacent is left, continue with the next triangle in index order
+		if (bestTriangle == INVALID_TRIANGLE)
+		{
+			while (isTriangleUsed[scanCursor])
+			{
+				++scanCursor;
+			}
+
+			bestTriangle = static_cast<uint32_t>(scanCursor);
+			bestNumNew = countNewVertices(bestTriangle);
+		}
+
+		if (curVertices.size() + bestNumNew > MAX_VERTICES || curTriangleIndices.size() / 3 + 1 > MAX_TRIANGLES)
+		{
+			flushMeshlet();
+		}
+
+		for (uint32_t i = 0; i < 3; ++i)
+		{
+			const uint32_t vertexId = indices[bestTriangle * 3 + i];
+			if (localVertexIds[vertexId] == NOT_IN_MESHLET)
+			{
+				localVertexIds[vertexId] = static_cast<uint8_t>(curVertices.size());
+				curVertices.push_back(vertexId);
+			}
+
+			curTriangleIndices.push_back(vertexId);
+		}
+
+		isTriangleUsed[bestTriangle] = true;
+	}
+
+	flushMeshlet();
+
+	mesh.indices = std::move(resIndices);
+}
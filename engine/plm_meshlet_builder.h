@@ -0,0 +1,27 @@
+#pragma once
+
+#include "plm_common.h"
+#include "../render/shaders/host_device_common.h"
+
+#include <vector>
+
+
+namespace Plume
+{
+
+struct Mesh;
+
+// Import-time clusterization of meshes into meshlets for cluster culling and mesh shading
+namespace MeshletBuilder
+{
+
+constexpr size_t MAX_VERTICES = MESHLET_MAX_VERTICES;
+constexpr size_t MAX_TRIANGLES = MESHLET_MAX_TRIANGLES;
+
+// Grows meshlets greedily over shared vertices, starting from the current index order. Rewrites the mesh index buffer
+// so that the triangles of every meshlet are contiguous, then fills meshlets, meshletVertices and meshletTriangles.
+void Build(Mesh& mesh);
+
+} // namespace MeshletBuilder
+
+} // namespace Plume
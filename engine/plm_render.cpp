@@ -1,11 +1,27 @@
 #include "plm_render.h"
+#include "plm_tracer.h"
 #include "imgui.h"
 #include "imgui_impl_sdl3.h"
 #include "imgui_impl_vulkan.h"
 
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
 
 void Plume::RenderManager::Init(Render::System::InitData& initData)
 {
+	_isHeadless = initData.isHeadless;
+
+	if (_isHeadless)
+	{
+		initData.pWindow = nullptr;
+		initData.windowExtent = _windowExtent;
+
+		_renderSystem.Init(initData);
+		return;
+	}
+
 	// We initialize SDL and create a window with it. 
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -44,6 +60,10 @@ void Plume::RenderManager::ProcessInputEvents(const std::array<Plume::InputManag
 
 			break;
 
+		case Plume::InputManager::EventType::eWriteTrace:
+			PLM_TRACE_WRITE(Plume::Tracer::TRACE_PATH);
+			break;
+
 		default:
 			break;
 		}
@@ -58,6 +78,24 @@ void Plume::RenderManager::RenderFrame()
 }
 
 
+void Plume::RenderManager::RenderFrames(uint32_t numFrames)
+{
+	const auto renderStart = std::chrono::steady_clock::now();
+
+	for (uint32_t frameId = 0; frameId < numFrames; ++frameId)
+	{
+		_renderSystem.RenderFrame();
+	}
+
+	// frames still in flight are waited for on termination, the average is close enough for many frames
+	const std::chrono::duration<double, std::milli> renderTime = std::chrono::steady_clock::now() - renderStart;
+	std::cout << "Rendered " << numFrames << " frames in " << renderTime.count() << " ms, "
+		<< renderTime.count() / std::max(numFrames, 1u) << " ms per frame" << std::endl;
+
+	Render::Backend::AcquireInstance()->GetGpuProfiler().ExportCsv(Render::GpuProfiler::CSV_PATH);
+}
+
+
 void Plume::RenderManager::Terminate()
 {
 	_renderSystem.Cleanup();
@@ -25,10 +25,16 @@ public:
 	void RenderFrame();
 	void Terminate();
 
+	// Renders numFrames frames without input and reports the average frame time, for headless runs
+	void RenderFrames(uint32_t numFrames);
+
+	bool IsHeadless() const { return _isHeadless; }
+
 private:
 	Render::System _renderSystem;
 
 	bool _defocusMode = false;
+	bool _isHeadless = false;
 
 	vk::Extent2D _windowExtent{ 1920, 1080 };
 	SDL_Window* _pWindow = nullptr;
@@ -1,29 +1,216 @@
 #include "plm_scene.h"
+#include "plm_mesh_cache.h"
+#include "plm_mesh_optimizer.h"
+#include "plm_mesh_simplifier.h"
+#include "plm_meshlet_builder.h"
+#include "plm_thread_pool.h"
+#include "plm_tracer.h"
 
 #include "tiny_obj_loader.h"
 #include <iostream>
+#include <algorithm>
 
+#include <assimp/DefaultIOSystem.h>
 
-bool Plume::Model::LoadAssimp(std::string filePath)
+
+namespace
 {
-	Scene& parentScene = *pParentScene;
 
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_FlipUVs
-		| aiProcess_CalcTangentSpace);
+constexpr uint32_t MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
-	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+// Records every file the importer opens, so that the mesh cache gets invalidated when any of them changes
+class DependencyTrackingIOSystem : public Assimp::DefaultIOSystem
+{
+public:
+	explicit DependencyTrackingIOSystem(std::vector<std::string>& openedFiles) : _openedFiles(openedFiles) {}
+
+	Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb") override
+	{
+		Assimp::IOStream* pStream = Assimp::DefaultIOSystem::Open(pFile, pMode);
+		if (pStream && std::find(_openedFiles.begin(), _openedFiles.end(), pFile) == _openedFiles.end())
+		{
+			_openedFiles.push_back(pFile);
+		}
+		return pStream;
+	}
+
+private:
+	std::vector<std::string>& _openedFiles;
+};
+
+
+void OptimizeMeshes(const std::string& filePath, std::vector<Plume::Mesh>& meshes)
+{
+	size_t numVerticesBefore = 0;
+	size_t numVerticesAfter = 0;
+	size_t numIndices = 0;
+	float weightedAcmrBefore = 0.0f;
+	float weightedAcmrAfter = 0.0f;
+
+	for (auto& mesh : meshes)
+	{
+		const Plume::MeshOptimizer::Stats statsBefore = Plume::MeshOptimizer::ComputeStats(mesh.indices, mesh.vertices.size());
+		Plume::MeshOptimizer::Optimize(mesh);
+		const Plume::MeshOptimizer::Stats statsAfter = Plume::MeshOptimizer::ComputeStats(mesh.indices, mesh.vertices.size());
+
+		numVerticesBefore += statsBefore.vertexCount;
+		numVerticesAfter += statsAfter.vertexCount;
+		numIndices += statsAfter.indexCount;
+		weightedAcmrBefore += statsBefore.acmr * statsBefore.indexCount;
+		weightedAcmrAfter += statsAfter.acmr * statsAfter.indexCount;
+	}
+
+	if (numIndices == 0)
+	{
+		return;
+	}
+
+	std::cout << "Optimized " << filePath << ": vertices " << numVerticesBefore << " -> " << numVerticesAfter
+		<< ", ACMR " << weightedAcmrBefore / numIndices << " -> " << weightedAcmrAfter / numIndices << std::endl;
+}
+
+
+void GenerateLods(const std::string& filePath, std::vector<Plume::Mesh>& meshes, const Plume::ImportSettings& settings)
+{
+	// a LOD has to drop at least this share of the previous level's triangles to be worth keeping
+	constexpr float MIN_LOD_REDUCTION = 0.1f;
+
+	size_t numBaseIndices = 0;
+	size_t numCoarsestIndices = 0;
+
+	for (auto& mesh : meshes)
+	{
+		const float extent = Plume::MeshSimplifier::GetMeshExtent(mesh.vertices);
+
+		const std::vector<uint32_t>* pPrevIndices = &mesh.indices;
+		float prevError = 0.0f;
+
+		for (uint32_t i = 0; i < settings.numLods; ++i)
+		{
+			const size_t targetIndexCount = static_cast<size_t>(pPrevIndices->size() / 3 * settings.lodReductionRatio) * 3;
+
+			Plume::MeshLod lod;
+			const float relativeError = Plume::MeshSimplifier::Simplify(mesh.vertices, *pPrevIndices, targetIndexCount,
+				settings.lodMaxError, lod.indices);
+
+			if (lod.indices.empty() || lod.indices.size() > pPrevIndices->size() * (1.0f - MIN_LOD_REDUCTION))
+			{
+				break;
+			}
+
+			Plume::MeshOptimizer::OptimizeVertexCache(lod.indices, mesh.vertices.size());
+
+			// every level is simplified from the previous one, so their errors add up
+			lod.error = prevError + relativeError * extent;
+			prevError = lod.error;
+
+			mesh.lods.push_back(std::move(lod));
+			pPrevIndices = &mesh.lods.back().indices;
+		}
+
+		numBaseIndices += mesh.indices.size();
+		numCoarsestIndices += pPrevIndices->size();
+	}
+
+	if (numBaseIndices == 0)
+	{
+		return;
+	}
+
+	std::cout << "Generated LODs for " << filePath << ": triangles " << numBaseIndices / 3 << " -> " << numCoarsestIndices / 3
+		<< " at the coarsest level" << std::endl;
+}
+
+
+void BuildMeshlets(const std::string& filePath, std::vector<Plume::Mesh>& meshes)
+{
+	size_t numMeshlets = 0;
+	size_t numTriangles = 0;
+
+	for (auto& mesh : meshes)
+	{
+		Plume::MeshletBuilder::Build(mesh);
+
+		numMeshlets += mesh.meshlets.size();
+		numTriangles += mesh.indices.size() / 3;
+	}
+
+	if (numMeshlets == 0)
+	{
+		return;
+	}
+
+	std::cout << "Built meshlets for " << filePath << ": " << numMeshlets << " meshlets, "
+		<< static_cast<float>(numTriangles) / numMeshlets << " triangles per meshlet on average" << std::endl;
+}
+
+
+void AppendTo(std::vector<std::string>& target, const std::vector<std::string>& source)
+{
+	target.insert(target.end(), source.begin(), source.end());
+}
+
+} // anonymous namespace
+
+
+bool Plume::Model::LoadAssimp(std::string filePath)
+{
+	PLM_TRACE_ZONE("LoadAssimp");
+
+	ImportedModel importedModel;
+	if (!Import(filePath, importedModel, pParentScene->importSettings))
 	{
-		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
 		return false;
 	}
 
+	pParentScene->MergeImportedModel(std::move(importedModel), *this);
+
+	return true;
+}
+
+
+uint64_t Plume::ImportSettings::Hash(uint32_t importerFlags) const
+{
+	uint64_t hash = HashBytes(&importerFlags, sizeof(importerFlags));
+	hash = HashBytes(&optimizeMeshes, sizeof(optimizeMeshes), hash);
+	hash = HashBytes(&numLods, sizeof(numLods), hash);
+	hash = HashBytes(&lodReductionRatio, sizeof(lodReductionRatio), hash);
+	hash = HashBytes(&lodMaxError, sizeof(lodMaxError), hash);
+	hash = HashBytes(&buildMeshlets, sizeof(buildMeshlets), hash);
+
+	return hash;
+}
+
+
+bool Plume::Model::Import(const std::string& filePath, ImportedModel& result, const ImportSettings& settings /* = {} */)
+{
 	size_t dirPosWin = filePath.find_last_of('\\');
 	size_t dirPosUnix = filePath.find_last_of('/');
 
-	parentScene.directory = filePath.substr(0, dirPosUnix == std::string::npos ? dirPosWin : dirPosUnix) + '/';
+	result.directory = filePath.substr(0, dirPosUnix == std::string::npos ? dirPosWin : dirPosUnix) + '/';
 
-	parentScene.matOffset = parentScene.diffuseTexNames.size();
+	const uint64_t settingsHash = settings.Hash(MODEL_IMPORT_FLAGS);
+
+	if (MeshCache::Load(filePath, settingsHash, result.meshes, result.materials))
+	{
+		return true;
+	}
+
+	std::vector<std::string> dependencies;
+
+	Assimp::Importer importer;
+	// the importer takes ownership of the IO handler
+	importer.SetIOHandler(new DependencyTrackingIOSystem(dependencies));
+
+	const aiScene* scene = importer.ReadFile(filePath, MODEL_IMPORT_FLAGS);
+
+	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+	{
+		std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+		return false;
+	}
+
+	MaterialTables& materials = result.materials;
 
 	for (size_t i = 0; i < scene->mNumMaterials; ++i)
 	{
@@ -32,39 +219,57 @@ bool Plume::Model::LoadAssimp(std::string filePath)
 		std::string matName = material->GetName().C_Str();
 		std::string diffTexName = "";
 
-		LoadTextureNames(material, aiTextureType_DIFFUSE, parentScene.diffuseTexNames, &diffTexName);
-		LoadTextureNames(material, aiTextureType_METALNESS, parentScene.metallicTexNames);
-		LoadTextureNames(material, aiTextureType_DIFFUSE_ROUGHNESS, parentScene.roughnessTexNames);
-		LoadTextureNames(material, aiTextureType_NORMALS, parentScene.normalMapNames);
+		LoadTextureNames(material, aiTextureType_DIFFUSE, result.directory, materials.diffuseTexNames, &diffTexName);
+		LoadTextureNames(material, aiTextureType_METALNESS, result.directory, materials.metallicTexNames);
+		LoadTextureNames(material, aiTextureType_DIFFUSE_ROUGHNESS, result.directory, materials.roughnessTexNames);
+		LoadTextureNames(material, aiTextureType_NORMALS, result.directory, materials.normalMapNames);
 
 		if (matName.empty())
 		{
 			matName = diffTexName;
 		}
-		parentScene.matNames.push_back(matName);
+		materials.matNames.push_back(matName);
 	}
 
-	ProcessNode(scene->mRootNode, *scene);
+	ProcessNode(scene->mRootNode, *scene, result);
+
+	if (settings.optimizeMeshes)
+	{
+		OptimizeMeshes(filePath, result.meshes);
+	}
+
+	if (settings.numLods > 0)
+	{
+		GenerateLods(filePath, result.meshes, settings);
+	}
+
+	if (settings.buildMeshlets)
+	{
+		BuildMeshlets(filePath, result.meshes);
+	}
+
+	MeshCache::Store(filePath, settingsHash, dependencies, result.meshes, materials);
+
 	return true;
 }
 
 
-void Plume::Model::ProcessNode(aiNode* node, const aiScene& scene)
+void Plume::Model::ProcessNode(aiNode* node, const aiScene& scene, ImportedModel& result)
 {
 	for (size_t i = 0; i < node->mNumMeshes; ++i)
 	{
 		aiMesh* mesh = scene.mMeshes[node->mMeshes[i]];
-		ProcessMesh(mesh, scene);
+		ProcessMesh(mesh, scene, result);
 	}
 
 	for (size_t i = 0; i < node->mNumChildren; ++i)
 	{
-		ProcessNode(node->mChildren[i], scene);
+		ProcessNode(node->mChildren[i], scene, result);
 	}
 }
 
 
-void Plume::Model::ProcessMesh(aiMesh* mesh, const aiScene& scene)
+void Plume::Model::ProcessMesh(aiMesh* mesh, const aiScene& scene, ImportedModel& result)
 {
 	Mesh newMesh = {};
 
@@ -73,7 +278,7 @@ void Plume::Model::ProcessMesh(aiMesh* mesh, const aiScene& scene)
 	if (mesh->mMaterialIndex >= 0)
 	{
 		material = scene.mMaterials[mesh->mMaterialIndex];
-		newMesh.matIndex = static_cast<int32_t>(pParentScene->matOffset + mesh->mMaterialIndex);
+		newMesh.matIndex = static_cast<int32_t>(mesh->mMaterialIndex);
 		material->Get(AI_MATKEY_COLOR_EMISSIVE, newMesh.emittance);
 	}
 
@@ -103,8 +308,6 @@ void Plume::Model::ProcessMesh(aiMesh* mesh, const aiScene& scene)
 			newVertex.uv = glm::vec2(0.0f, 0.0f);
 		}
 
-		newVertex.color = newVertex.normal;
-
 		newMesh.vertices.push_back(newVertex);
 	}
 
@@ -117,11 +320,12 @@ void Plume::Model::ProcessMesh(aiMesh* mesh, const aiScene& scene)
 		}
 	}
 
-	meshes.push_back(std::move(newMesh));
+	result.meshes.push_back(std::move(newMesh));
 }
 
 
-void Plume::Model::LoadTextureNames(aiMaterial* mat, aiTextureType type, std::vector<std::string>& names, std::string* curName) const
+void Plume::Model::LoadTextureNames(aiMaterial* mat, aiTextureType type, const std::string& directory, std::vector<std::string>& names,
+	std::string* curName /* = nullptr */)
 {
 	size_t texCount = mat->GetTextureCount(type);
 	if (texCount == 0)
@@ -134,7 +338,7 @@ void Plume::Model::LoadTextureNames(aiMaterial* mat, aiTextureType type, std::ve
 		aiString name;
 		if (mat->GetTexture(type, i, &name) != aiReturn_FAILURE)
 		{
-			names.push_back(pParentScene->directory + name.C_Str());
+			names.push_back(directory + name.C_Str());
 			if (curName)
 			{
 				*curName = name.C_Str();
@@ -151,30 +355,81 @@ void Plume::Model::LoadTextureNames(aiMaterial* mat, aiTextureType type, std::ve
 void Plume::Scene::DefaultInit()
 {
 	// TODO: support runtime scene loading with ImGui interface
-	
-	Model suzanneModel;
-	suzanneModel.pParentScene = this;
-	suzanneModel.LoadAssimp("../../../assets/suzanne/Suzanne.gltf");
-	suzanneModel.transformMatrix = glm::translate(glm::mat4{ 1.0f }, glm::vec3(2.8f, -8.0f, 0));
 
-	models["suzanne"] = suzanneModel;
+	struct ModelDesc
+	{
+		std::string name;
+		std::string filePath;
+		std::vector<glm::mat4> instanceTransforms;
+	};
+
+	const std::vector<ModelDesc> modelDescs = {
+		{ "suzanne", "../../../assets/suzanne/Suzanne.gltf", { glm::translate(glm::mat4{ 1.0f }, glm::vec3(2.8f, -8.0f, 0)) } },
+		{ "sponza", "../../../assets/sponza/Sponza.gltf", { glm::translate(glm::vec3{ 5, -10, 0 }) * glm::rotate(glm::radians(90.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f)) * glm::scale(glm::mat4{ 1.0f }, glm::vec3(0.05f, 0.05f, 0.05f)) } },
+		{ "skybox", "../../../assets/cube.gltf", { glm::scale(glm::mat4{ 1.0f }, glm::vec3(6000.0f, 6000.0f, 6000.0f)) } },
+	};
+
+	ThreadPool* pThreadPool = ThreadPool::AcquireInstance();
+
+	std::vector<std::future<std::unique_ptr<ImportedModel>>> imports;
+	imports.reserve(modelDescs.size());
+
+	for (const auto& modelDesc : modelDescs)
+	{
+		const std::string filePath = modelDesc.filePath;
+		const ImportSettings settings = importSettings;
+		imports.push_back(pThreadPool->Submit([filePath, settings]() {
+			auto pImportedModel = std::make_unique<ImportedModel>();
+			if (!Model::Import(filePath, *pImportedModel, settings))
+			{
+				pImportedModel.reset();
+			}
+			return pImportedModel;
+		}));
+	}
+
+	// merge in declaration order, regardless of which import finished first
+	for (size_t i = 0; i < modelDescs.size(); ++i)
+	{
+		std::unique_ptr<ImportedModel> pImportedModel = imports[i].get();
+
+		Model model;
+		model.pParentScene = this;
+		model.instanceTransforms = modelDescs[i].instanceTransforms;
+
+		if (pImportedModel)
+		{
+			MergeImportedModel(std::move(*pImportedModel), model);
+		}
+
+		models[modelDescs[i].name] = std::move(model);
+	}
+}
 
 
-	Model sponza;
-	sponza.pParentScene = this;
-	sponza.LoadAssimp("../../../assets/sponza/Sponza.gltf");
-	sponza.transformMatrix = glm::translate(glm::vec3{ 5, -10, 0 }) * glm::rotate(glm::radians(90.0f),
-		glm::vec3(0.0f, 1.0f, 0.0f)) * glm::scale(glm::mat4{ 1.0f }, glm::vec3(0.05f, 0.05f, 0.05f));
+void Plume::Scene::MergeImportedModel(ImportedModel&& importedModel, Model& model)
+{
+	directory = importedModel.directory;
+	matOffset = diffuseTexNames.size();
 
-	models["sponza"] = sponza;
+	for (auto& mesh : importedModel.meshes)
+	{
+		if (mesh.matIndex >= 0)
+		{
+			mesh.matIndex += static_cast<int32_t>(matOffset);
+		}
+	}
 
+	model.meshes = std::move(importedModel.meshes);
 
-	Model cube;
-	cube.pParentScene = this;
-	cube.LoadAssimp("../../../assets/cube.gltf");
-	cube.transformMatrix = glm::scale(glm::mat4{ 1.0f }, glm::vec3(6000.0f, 6000.0f, 6000.0f));
+	const MaterialTables& materials = importedModel.materials;
 
-	models["skybox"] = cube;
+	AppendTo(matNames, materials.matNames);
+	AppendTo(diffuseTexNames, materials.diffuseTexNames);
+	AppendTo(metallicTexNames, materials.metallicTexNames);
+	AppendTo(roughnessTexNames, materials.roughnessTexNames);
+	AppendTo(normalMapNames, materials.normalMapNames);
 }
 
 
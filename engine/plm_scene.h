@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <unordered_map>
+#include <memory>
 
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
@@ -17,30 +18,134 @@
 namespace Plume
 {
 
+class MappedFile;
+
+// Simplified version of a mesh, indexing into the vertices of its base mesh
+struct MeshLod
+{
+	std::vector<uint32_t> indices;
+	ArrayView<uint32_t> cachedIndices;
+
+	// object-space deviation from the base mesh
+	float error = 0.0f;
+};
+
+// Cluster of at most MeshletBuilder::MAX_VERTICES vertices and MAX_TRIANGLES triangles. The triangles of a meshlet
+// are contiguous in the index buffer of its mesh, starting at index triangleOffset * 3.
+struct Meshlet
+{
+	// object-space bounding sphere
+	glm::vec3 center{ 0.0f };
+	float radius = 0.0f;
+
+	// every triangle faces away from viewers at positions p with
+	// dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius
+	glm::vec3 coneAxis{ 0.0f, 0.0f, 1.0f };
+	float coneCutoff = 1.0f;
+
+	uint32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+	uint32_t triangleOffset = 0;
+	uint32_t triangleCount = 0;
+};
+
 struct Mesh
 {
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
 	int32_t matIndex = -1;
 	glm::vec3 emittance{ 0.0f };
+
+	// Set when the geometry is served straight from a memory-mapped mesh cache instead of the vectors above
+	std::shared_ptr<const MappedFile> pCacheFile;
+	ArrayView<Vertex> cachedVertices;
+	ArrayView<uint32_t> cachedIndices;
+
+	// progressively coarser LODs, lods[i] is LOD i + 1
+	std::vector<MeshLod> lods;
+
+	// meshlets of the base mesh, their mesh vertex ids and triangles as three 8-bit meshlet-local vertex ids per entry
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint32_t> meshletTriangles;
+	ArrayView<Meshlet> cachedMeshlets;
+	ArrayView<uint32_t> cachedMeshletVertices;
+	ArrayView<uint32_t> cachedMeshletTriangles;
+
+	ArrayView<Vertex> GetVertices() const { return pCacheFile ? cachedVertices : ArrayView<Vertex>(vertices); }
+	ArrayView<uint32_t> GetIndices() const { return pCacheFile ? cachedIndices : ArrayView<uint32_t>(indices); }
+	ArrayView<uint32_t> GetLodIndices(size_t lodId) const
+	{
+		return pCacheFile ? lods[lodId].cachedIndices : ArrayView<uint32_t>(lods[lodId].indices);
+	}
+	ArrayView<Meshlet> GetMeshlets() const { return pCacheFile ? cachedMeshlets : ArrayView<Meshlet>(meshlets); }
+	ArrayView<uint32_t> GetMeshletVertices() const { return pCacheFile ? cachedMeshletVertices : ArrayView<uint32_t>(meshletVertices); }
+	ArrayView<uint32_t> GetMeshletTriangles() const { return pCacheFile ? cachedMeshletTriangles : ArrayView<uint32_t>(meshletTriangles); }
 };
 
 
 struct Scene;
 
+// Material name tables of a single model, laid out like the scene-wide tables they are appended to
+struct MaterialTables
+{
+	std::vector<std::string> matNames;
+	std::vector<std::string> diffuseTexNames;
+	std::vector<std::string> metallicTexNames;
+	std::vector<std::string> roughnessTexNames;
+	std::vector<std::string> normalMapNames;
+};
+
+struct ImportSettings
+{
+	// weld identical vertices and reorder indices and vertices for post-transform cache, overdraw and fetch efficiency
+	bool optimizeMeshes = true;
+
+	// number of simplified LODs generated per mesh, each one targeting lodReductionRatio of the previous triangle count
+	uint32_t numLods = 3;
+	float lodReductionRatio = 0.5f;
+	// simplification error limit relative to the mesh extent
+	float lodMaxError = 0.01f;
+
+	// split meshes into meshlets for cluster culling, reorders the triangles of the base mesh
+	bool buildMeshlets = true;
+
+	// hashed into the mesh cache key, so that changing a setting invalidates baked models
+	uint64_t Hash(uint32_t importerFlags) const;
+};
+
+
+// Result of importing a single model file. It owns everything it produced and does not touch any scene state,
+// so several models can be imported concurrently and merged into a scene afterwards.
+struct ImportedModel
+{
+	std::string directory;
+
+	// material indices are model-local until the model is merged into a scene
+	std::vector<Mesh> meshes;
+	MaterialTables materials;
+};
+
+
 struct Model
 {
 	Scene* pParentScene = nullptr;
 
 	std::vector<Mesh> meshes;
-	glm::mat4 transformMatrix = glm::identity<glm::mat4>();
+
+	// one entry per placement of the model in the scene, all placements share the meshes above
+	std::vector<glm::mat4> instanceTransforms;
 
 	bool LoadAssimp(std::string filePath);
 
-	void ProcessNode(aiNode* node, const aiScene& scene);
-	void ProcessMesh(aiMesh* mesh, const aiScene& scene);
+	// Safe to call from any thread, every call uses its own importer
+	static bool Import(const std::string& filePath, ImportedModel& result, const ImportSettings& settings = {});
+
+	static void ProcessNode(aiNode* node, const aiScene& scene, ImportedModel& result);
+	static void ProcessMesh(aiMesh* mesh, const aiScene& scene, ImportedModel& result);
 
-	void LoadTextureNames(aiMaterial* mat, aiTextureType type, std::vector<std::string>& names, std::string* curName = nullptr) const;
+	static void LoadTextureNames(aiMaterial* mat, aiTextureType type, const std::string& directory, std::vector<std::string>& names,
+		std::string* curName = nullptr);
 };
 
 
@@ -49,6 +154,12 @@ struct Scene
 	void DefaultInit();
 	const Plume::Model* GetPModel(const std::string& modelName) const;
 
+	// Appends the imported material tables to the scene ones and hands the meshes over to the model.
+	// Merging in a fixed order keeps material offsets independent of import timing.
+	void MergeImportedModel(ImportedModel&& importedModel, Model& model);
+
+	ImportSettings importSettings;
+
 	size_t matOffset = 0;
 
 	std::unordered_map<std::string, Model> models;
@@ -0,0 +1,787 @@
+#include "plm_texture_cooker.h"
+#include "plm_mapped_file.h"
+
+#include "stb_image.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+
+namespace
+{
+
+constexpr size_t PAYLOAD_ALIGNMENT = 16;
+
+constexpr uint32_t BLOCK_DIM = 4;
+constexpr uint32_t TEXELS_PER_BLOCK = BLOCK_DIM * BLOCK_DIM;
+
+struct CacheHeader
+{
+	uint32_t magic = Plume::TextureCooker::MAGIC;
+	uint32_t version = Plume::TextureCooker::VERSION;
+	uint32_t compression = 0;
+	uint32_t maskChannel = 0;
+	uint32_t numMips = 0;
+	uint32_t padding = 0;
+	uint64_t sourceHash = 0;
+	uint64_t blocksOffset = 0;
+	uint64_t blocksSize = 0;
+};
+
+struct CachedMipRecord
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+};
+
+
+float SrgbToLinear(uint8_t value)
+{
+	const float c = value / 255.0f;
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+
+uint8_t LinearToSrgb(float value)
+{
+	const float c = std::clamp(value, 0.0f, 1.0f);
+	const float srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	return static_cast<uint8_t>(srgb * 255.0f + 0.5f);
+}
+
+
+uint8_t UnormToByte(float value)
+{
+	return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+
+// Packs fields into a 128-bit block, starting at the least significant bit
+class BlockBitWriter
+{
+public:
+	void Write(uint32_t value, uint32_t numBits)
+	{
+		for (uint32_t i = 0; i < numBits; ++i, ++_bitPos)
+		{
+			if ((value >> i) & 1)
+			{
+				_bytes[_bitPos / 8] |= static_cast<uint8_t>(1u << (_bitPos % 8));
+			}
+		}
+	}
+
+	void Store(uint8_t* pBlock) const { memcpy(pBlock, _bytes.data(), _bytes.size()); }
+
+private:
+	std::array<uint8_t, 16> _bytes = {};
+	uint32_t _bitPos = 0;
+};
+
+
+// 8-value mode with the block extremes as endpoints
+void EncodeBC4Block(const std::array<uint8_t, TEXELS_PER_BLOCK>& values, uint8_t* pBlock)
+{
+	const auto [minIt, maxIt] = std::minmax_element(values.begin(), values.end());
+	const uint32_t red0 = *maxIt;
+	const uint32_t red1 = *minIt;
+
+	std::array<uint32_t, 8> palette;
+	palette[0] = red0;
+	palette[1] = red1;
+	for (uint32_t i = 2; i < 8; ++i)
+	{
+		palette[i] = ((8 - i) * red0 + (i - 1) * red1 + 3) / 7;
+	}
+
+	pBlock[0] = static_cast<uint8_t>(red0);
+	pBlock[1] = static_cast<uint8_t>(red1);
+
+	uint64_t indexBits = 0;
+	for (uint32_t texelId = 0; texelId < TEXELS_PER_BLOCK; ++texelId)
+	{
+		uint32_t bestIndex = 0;
+		int32_t bestDistance = std::numeric_limits<int32_t>::max();
+		for (uint32_t i = 0; i < palette.size(); ++i)
+		{
+			const int32_t distance = std::abs(static_cast<int32_t>(palette[i]) - values[texelId]);
+			if (distance < bestDistance)
+			{
+				bestIndex = i;
+				bestDistance = distance;
+			}
+		}
+
+		indexBits |= static_cast<uint64_t>(bestIndex) << (3 * texelId);
+	}
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		pBlock[2 + i] = static_cast<uint8_t>(indexBits >> (8 * i));
+	}
+}
+
+
+// Mode 6: one subset, RGBA endpoints with 7 bits per channel plus a p-bit each, 4-bit indices.
+// Endpoints are the extent of the block along the principal axis of its texels.
+void EncodeBC7Block(const std::array<glm::vec4, TEXELS_PER_BLOCK>& texels, uint8_t* pBlock)
+{
+	static constexpr std::array<uint32_t, 16> WEIGHTS = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	glm::vec4 mean{ 0.0f };
+	for (const auto& texel : texels)
+	{
+		mean += texel;
+	}
+	mean /= static_cast<float>(TEXELS_PER_BLOCK);
+
+	glm::mat4 covariance{ 0.0f };
+	for (const auto& texel : texels)
+	{
+		const glm::vec4 d = texel - mean;
+		covariance += glm::outerProduct(d, d);
+	}
+
+	// power iteration, starting from the diagonal of the bounding box
+	glm::vec4 minTexel = texels[0];
+	glm::vec4 maxTexel = texels[0];
+	for (const auto& texel : texels)
+	{
+		minTexel = glm::min(minTexel, texel);
+		maxTexel = glm::max(maxTexel, texel);
+	}
+
+	glm::vec4 axis = maxTexel - minTexel;
+	for (uint32_t i = 0; i < 8 && glm::dot(axis, axis) > 0.0f; ++i)
+	{
+		axis = covariance * axis;
+		const float length = glm::length(axis);
+		if (length <= std::numeric_limits<float>::min())
+		{
+			break;
+		}
+		axis /= length;
+	}
+
+	float minProj = 0.0f;
+	float maxProj = 0.0f;
+	if (glm::dot(axis, axis) > 0.0f)
+	{
+		axis = glm::normalize(axis);
+		minProj = std::numeric_limits<float>::max();
+		maxProj = std::numeric_limits<float>::lowest();
+		for (const auto& texel : texels)
+		{
+			const float proj = glm::dot(texel - mean, axis);
+			minProj = std::min(minProj, proj);
+			maxProj = std::max(maxProj, proj);
+		}
+	}
+
+	const std::array<glm::vec4, 2> endpoints = {
+		glm::clamp(mean + axis * minProj, glm::vec4(0.0f), glm::vec4(255.0f)),
+		glm::clamp(mean + axis * maxProj, glm::vec4(0.0f), glm::vec4(255.0f))
+	};
+
+	// 7-bit endpoint channels share the lowest bit of their 8-bit value, the p-bit
+	std::array<std::array<uint32_t, 4>, 2> quantized;
+	std::array<uint32_t, 2> pBits;
+	std::array<std::array<uint32_t, 4>, 2> unquantized;
+
+	for (uint32_t e = 0; e < 2; ++e)
+	{
+		float bestError = std::numeric_limits<float>::max();
+		for (uint32_t p = 0; p < 2; ++p)
+		{
+			std::array<uint32_t, 4> q;
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				q[c] = static_cast<uint32_t>(std::clamp(std::round((endpoints[e][c] - p) / 2.0f), 0.0f, 127.0f));
+				const float d = static_cast<float>(q[c] * 2 + p) - endpoints[e][c];
+				error += d * d;
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				quantized[e] = q;
+				pBits[e] = p;
+			}
+		}
+
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			unquantized[e][c] = quantized[e][c] * 2 + pBits[e];
+		}
+	}
+
+	std::array<glm::vec4, 16> palette;
+	for (uint32_t i = 0; i < palette.size(); ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			palette[i][c] = static_cast<float>(((64 - WEIGHTS[i]) * unquantized[0][c] + WEIGHTS[i] * unquantized[1][c] + 32) >> 6);
+		}
+	}
+
+	std::array<uint32_t, TEXELS_PER_BLOCK> indices;
+	for (uint32_t texelId = 0; texelId < TEXELS_PER_BLOCK; ++texelId)
+	{
+		float bestDistance = std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < palette.size(); ++i)
+		{
+			const glm::vec4 d = palette[i] - texels[texelId];
+			const float distance = glm::dot(d, d);
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				indices[texelId] = i;
+			}
+		}
+	}
+
+	// the most significant bit of the first index is implicitly zero
+	if (indices[0] >= 8)
+	{
+		std::swap(quantized[0], quantized[1]);
+		std::swap(pBits[0], pBits[1]);
+		for (auto& index : indices)
+		{
+			index = 15 - index;
+		}
+	}
+
+	BlockBitWriter writer;
+	writer.Write(1u << 6, 7);
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		writer.Write(quantized[0][c], 7);
+		writer.Write(quantized[1][c], 7);
+	}
+	writer.Write(pBits[0], 1);
+	writer.Write(pBits[1], 1);
+
+	writer.Write(indices[0], 3);
+	for (uint32_t texelId = 1; texelId < TEXELS_PER_BLOCK; ++texelId)
+	{
+		writer.Write(indices[texelId], 4);
+	}
+
+	writer.Store(pBlock);
+}
+
+
+// Texels are linear color, normals in [-1, 1] or the mask value in x
+void EncodeLevel(const std::vector<glm::vec4>& texels, uint32_t width, uint32_t height, const Plume::TextureCookSettings& settings,
+	std::vector<uint8_t>& blocks)
+{
+	const uint32_t blockSize = Plume::TextureCooker::GetBlockSize(settings.compression);
+
+	const uint32_t numBlocksX = (width + BLOCK_DIM - 1) / BLOCK_DIM;
+	const uint32_t numBlocksY = (height + BLOCK_DIM - 1) / BLOCK_DIM;
+
+	const size_t firstBlockOffset = blocks.size();
+	blocks.resize(firstBlockOffset + static_cast<size_t>(numBlocksX) * numBlocksY * blockSize);
+
+	for (uint32_t blockY = 0; blockY < numBlocksY; ++blockY)
+	{
+		for (uint32_t blockX = 0; blockX < numBlocksX; ++blockX)
+		{
+			// blocks overhanging the level repeat its last row and column
+			std::array<glm::vec4, TEXELS_PER_BLOCK> blockTexels;
+			for (uint32_t y = 0; y < BLOCK_DIM; ++y)
+			{
+				for (uint32_t x = 0; x < BLOCK_DIM; ++x)
+				{
+					const uint32_t texelX = std::min(blockX * BLOCK_DIM + x, width - 1);
+					const uint32_t texelY = std::min(blockY * BLOCK_DIM + y, height - 1);
+					blockTexels[y * BLOCK_DIM + x] = texels[static_cast<size_t>(texelY) * width + texelX];
+				}
+			}
+
+			uint8_t* pBlock = blocks.data() + firstBlockOffset + (static_cast<size_t>(blockY) * numBlocksX + blockX) * blockSize;
+
+			switch (settings.compression)
+			{
+			case Plume::TextureCompression::eBC7:
+			{
+				for (auto& texel : blockTexels)
+				{
+					texel = glm::vec4(LinearToSrgb(texel.r), LinearToSrgb(texel.g), LinearToSrgb(texel.b), UnormToByte(texel.a));
+				}
+				EncodeBC7Block(blockTexels, pBlock);
+				break;
+			}
+			case Plume::TextureCompression::eBC5:
+			{
+				std::array<uint8_t, TEXELS_PER_BLOCK> xValues;
+				std::array<uint8_t, TEXELS_PER_BLOCK> yValues;
+				for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i)
+				{
+					xValues[i] = UnormToByte(blockTexels[i].x * 0.5f + 0.5f);
+					yValues[i] = UnormToByte(blockTexels[i].y * 0.5f + 0.5f);
+				}
+				EncodeBC4Block(xValues, pBlock);
+				EncodeBC4Block(yValues, pBlock + 8);
+				break;
+			}
+			case Plume::TextureCompression::eBC4:
+			{
+				std::array<uint8_t, TEXELS_PER_BLOCK> values;
+				for (uint32_t i = 0; i < TEXELS_PER_BLOCK; ++i)
+				{
+					values[i] = UnormToByte(blockTexels[i].x);
+				}
+				EncodeBC4Block(values, pBlock);
+				break;
+			}
+			case Plume::TextureCompression::eBC7Linear:
+			{
+				for (auto& texel : blockTexels)
+				{
+					texel = glm::vec4(UnormToByte(texel.r), UnormToByte(texel.g), UnormToByte(texel.b), UnormToByte(texel.a));
+				}
+				EncodeBC7Block(blockTexels, pBlock);
+				break;
+			}
+			}
+		}
+	}
+}
+
+
+// 2x2 box filter, odd dimensions reuse their last row or column
+std::vector<glm::vec4> Downsample(const std::vector<glm::vec4>& texels, uint32_t width, uint32_t height, bool renormalize)
+{
+	const uint32_t resWidth = std::max(width / 2, 1u);
+	const uint32_t resHeight = std::max(height / 2, 1u);
+
+	std::vector<glm::vec4> resTexels(static_cast<size_t>(resWidth) * resHeight);
+
+	for (uint32_t y = 0; y < resHeight; ++y)
+	{
+		for (uint32_t x = 0; x < resWidth; ++x)
+		{
+			const uint32_t x0 = std::min(2 * x, width - 1);
+			const uint32_t x1 = std::min(2 * x + 1, width - 1);
+			const uint32_t y0 = std::min(2 * y, height - 1);
+			const uint32_t y1 = std::min(2 * y + 1, height - 1);
+
+			glm::vec4 sum = texels[static_cast<size_t>(y0) * width + x0] + texels[static_cast<size_t>(y0) * width + x1] +
+				texels[static_cast<size_t>(y1) * width + x0] + texels[static_cast<size_t>(y1) * width + x1];
+
+			glm::vec4 average = 0.25f * sum;
+			if (renormalize && glm::dot(glm::vec3(average), glm::vec3(average)) > 0.0f)
+			{
+				average = glm::vec4(glm::normalize(glm::vec3(average)), average.w);
+			}
+
+			resTexels[static_cast<size_t>(y) * resWidth + x] = average;
+		}
+	}
+
+	return resTexels;
+}
+
+
+bool LoadCached(const std::string& cachePath, const Plume::TextureCookSettings& settings, uint64_t sourceHash,
+	Plume::CookedTexture& outTexture)
+{
+	auto pCacheFile = std::make_shared<Plume::MappedFile>();
+	if (!pCacheFile->Open(cachePath))
+	{
+		return false;
+	}
+
+	const uint8_t* pData = pCacheFile->GetData();
+	const size_t fileSize = pCacheFile->GetSize();
+
+	CacheHeader header = {};
+	if (fileSize < sizeof(CacheHeader))
+	{
+		return false;
+	}
+	memcpy(&header, pData, sizeof(CacheHeader));
+
+	if (header.magic != Plume::TextureCooker::MAGIC || header.version != Plume::TextureCooker::VERSION ||
+		header.compression != static_cast<uint32_t>(settings.compression) || header.maskChannel != settings.maskChannel ||
+		header.sourceHash != sourceHash)
+	{
+		return false;
+	}
+
+	const size_t mipRecordsSize = static_cast<size_t>(header.numMips) * sizeof(CachedMipRecord);
+	if (header.numMips == 0 || fileSize - sizeof(CacheHeader) < mipRecordsSize || header.blocksOffset > fileSize ||
+		header.blocksSize > fileSize - header.blocksOffset || header.blocksOffset % PAYLOAD_ALIGNMENT != 0)
+	{
+		return false;
+	}
+
+	Plume::CookedTexture cachedTexture;
+	cachedTexture.settings = settings;
+	cachedTexture.mips.resize(header.numMips);
+
+	const uint64_t blockSize = Plume::TextureCooker::GetBlockSize(settings.compression);
+
+	for (uint32_t i = 0; i < header.numMips; ++i)
+	{
+		CachedMipRecord record = {};
+		memcpy(&record, pData + sizeof(CacheHeader) + i * sizeof(CachedMipRecord), sizeof(CachedMipRecord));
+
+		// every mip halves the previous one, as Cook() builds the chain
+		const bool isExtentValid = (i == 0) ? (record.width > 0 && record.height > 0) :
+			(record.width == std::max(cachedTexture.mips[i - 1].width / 2, 1u) &&
+			record.height == std::max(cachedTexture.mips[i - 1].height / 2, 1u));
+
+		if (!isExtentValid)
+		{
+			return false;
+		}
+
+		const uint64_t numBlocksX = (static_cast<uint64_t>(record.width) + BLOCK_DIM - 1) / BLOCK_DIM;
+		const uint64_t numBlocksY = (static_cast<uint64_t>(record.height) + BLOCK_DIM - 1) / BLOCK_DIM;
+
+		if (record.size != numBlocksX * numBlocksY * blockSize || record.offset > header.blocksSize ||
+			record.size > header.blocksSize - record.offset)
+		{
+			return false;
+		}
+
+		cachedTexture.mips[i] = { record.width, record.height, record.offset, record.size };
+	}
+
+	cachedTexture.cachedBlocks = Plume::ArrayView<uint8_t>(pData + header.blocksOffset, header.blocksSize);
+	cachedTexture.pCacheFile = std::move(pCacheFile);
+
+	outTexture = std::move(cachedTexture);
+
+	return true;
+}
+
+
+bool StoreCached(const std::string& cachePath, uint64_t sourceHash, const Plume::CookedTexture& texture)
+{
+	CacheHeader header = {};
+	header.compression = static_cast<uint32_t>(texture.settings.compression);
+	header.maskChannel = texture.settings.maskChannel;
+	header.numMips = static_cast<uint32_t>(texture.mips.size());
+	header.sourceHash = sourceHash;
+	header.blocksOffset = AlignUp(sizeof(CacheHeader) + texture.mips.size() * sizeof(CachedMipRecord), PAYLOAD_ALIGNMENT);
+	header.blocksSize = texture.blocks.size();
+
+	std::vector<uint8_t> blob(header.blocksOffset + header.blocksSize, 0);
+	memcpy(blob.data(), &header, sizeof(CacheHeader));
+
+	for (size_t i = 0; i < texture.mips.size(); ++i)
+	{
+		const Plume::CookedTexture::Mip& mip = texture.mips[i];
+		const CachedMipRecord record = { mip.width, mip.height, mip.offset, mip.size };
+		memcpy(blob.data() + sizeof(CacheHeader) + i * sizeof(CachedMipRecord), &record, sizeof(CachedMipRecord));
+	}
+
+	memcpy(blob.data() + header.blocksOffset, texture.blocks.data(), texture.blocks.size());
+
+	if (!Plume::WriteFileAtomically(cachePath, blob))
+	{
+		std::cout << "Failed to write texture cache " << cachePath << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+
+// decodeSource() fills tightly packed RGBA8 texels and is only called if the cache is missing or out of date
+template<typename DecodeFunc>
+bool LoadOrCookSource(const std::string& cachePath, uint64_t sourceHash, const Plume::TextureCookSettings& settings,
+	DecodeFunc&& decodeSource, Plume::CookedTexture& outTexture)
+{
+	if (LoadCached(cachePath, settings, sourceHash, outTexture))
+	{
+		return true;
+	}
+
+	std::vector<uint8_t> texels;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	if (!decodeSource(texels, width, height))
+	{
+		return false;
+	}
+
+	Plume::TextureCooker::Cook(texels.data(), width, height, settings, outTexture);
+
+	if (StoreCached(cachePath, sourceHash, outTexture))
+	{
+		std::cout << "Cooked texture " << cachePath << std::endl;
+	}
+
+	return true;
+}
+
+} // anonymous namespace
+
+
+uint32_t Plume::TextureCooker::GetBlockSize(TextureCompression compression)
+{
+	return compression == TextureCompression::eBC4 ? 8 : 16;
+}
+
+
+std::string Plume::TextureCooker::GetCachePath(const std::string& sourcePath, const TextureCookSettings& settings)
+{
+	switch (settings.compression)
+	{
+	case TextureCompression::eBC7:
+		return sourcePath + ".bc7.plmtex";
+	case TextureCompression::eBC5:
+		return sourcePath + ".bc5.plmtex";
+	case TextureCompression::eBC4:
+		return sourcePath + ".bc4_" + std::to_string(settings.maskChannel) + ".plmtex";
+	case TextureCompression::eBC7Linear:
+		return sourcePath + ".bc7_linear.plmtex";
+	}
+
+	return sourcePath + ".plmtex";
+}
+
+
+std::string Plume::TextureCooker::GetCachePath(const PackedTextureSources& sources, const TextureCookSettings& settings)
+{
+	// the same file can be packed with different sources, so the path depends on all of them
+	uint64_t sourcesHash = FNV1A_64_OFFSET_BASIS;
+	const TextureChannelSource* pFirstSource = nullptr;
+
+	for (const auto& source : sources)
+	{
+		sourcesHash = HashBytes(source.fileName.data(), source.fileName.size(), sourcesHash);
+		sourcesHash = HashBytes(&source.fillValue, sizeof(source.fillValue), sourcesHash);
+
+		if (!pFirstSource && !source.fileName.empty())
+		{
+			pFirstSource = &source;
+		}
+	}
+
+	ASSERT(pFirstSource != nullptr, "Packed texture without sources");
+
+	std::ostringstream packedPath;
+	packedPath << pFirstSource->fileName << ".packed_" << std::hex << sourcesHash;
+
+	return GetCachePath(packedPath.str(), settings);
+}
+
+
+void Plume::TextureCooker::Cook(const uint8_t* pTexels, uint32_t width, uint32_t height, const TextureCookSettings& settings,
+	CookedTexture& outTexture)
+{
+	ASSERT(settings.maskChannel < 4, "Invalid mask channel");
+
+	std::vector<glm::vec4> level(static_cast<size_t>(width) * height);
+	for (size_t i = 0; i < level.size(); ++i)
+	{
+		const uint8_t* pTexel = pTexels + i * 4;
+
+		switch (settings.compression)
+		{
+		case TextureCompression::eBC7:
+			level[i] = glm::vec4(SrgbToLinear(pTexel[0]), SrgbToLinear(pTexel[1]), SrgbToLinear(pTexel[2]), pTexel[3] / 255.0f);
+			break;
+		case TextureCompression::eBC5:
+			level[i] = glm::vec4(glm::vec3(pTexel[0], pTexel[1], pTexel[2]) / 127.5f - 1.0f, 0.0f);
+			break;
+		case TextureCompression::eBC4:
+			level[i] = glm::vec4(pTexel[settings.maskChannel] / 255.0f, 0.0f, 0.0f, 0.0f);
+			break;
+		case TextureCompression::eBC7Linear:
+			level[i] = glm::vec4(pTexel[0], pTexel[1], pTexel[2], pTexel[3]) / 255.0f;
+			break;
+		}
+	}
+
+	CookedTexture resTexture;
+	resTexture.settings = settings;
+
+	const bool isNormalMap = settings.compression == TextureCompression::eBC5;
+
+	while (true)
+	{
+		resTexture.blocks.resize(AlignUp(resTexture.blocks.size(), PAYLOAD_ALIGNMENT), 0);
+
+		CookedTexture::Mip mip;
+		mip.width = width;
+		mip.height = height;
+		mip.offset = resTexture.blocks.size();
+
+		EncodeLevel(level, width, height, settings, resTexture.blocks);
+
+		mip.size = resTexture.blocks.size() - mip.offset;
+		resTexture.mips.push_back(mip);
+
+		if (width == 1 && height == 1)
+		{
+			break;
+		}
+
+		level = Downsample(level, width, height, isNormalMap);
+		width = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+
+	outTexture = std::move(resTexture);
+}
+
+
+bool Plume::TextureCooker::LoadOrCook(const std::string& sourcePath, const TextureCookSettings& settings, CookedTexture& outTexture)
+{
+	MappedFile sourceFile;
+	if (!sourceFile.Open(sourcePath))
+	{
+		return false;
+	}
+
+	const uint64_t sourceHash = HashBytes(sourceFile.GetData(), sourceFile.GetSize());
+
+	auto decodeSource = [&sourceFile](std::vector<uint8_t>& texels, uint32_t& width, uint32_t& height) {
+		int texWidth, texHeight, texChannels;
+		stbi_uc* pixels = stbi_load_from_memory(sourceFile.GetData(), static_cast<int>(sourceFile.GetSize()), &texWidth, &texHeight,
+			&texChannels, STBI_rgb_alpha);
+
+		if (!pixels)
+		{
+			return false;
+		}
+
+		width = static_cast<uint32_t>(texWidth);
+		height = static_cast<uint32_t>(texHeight);
+		texels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+
+		stbi_image_free(pixels);
+
+		return true;
+	};
+
+	return LoadOrCookSource(GetCachePath(sourcePath, settings), sourceHash, settings, decodeSource, outTexture);
+}
+
+
+bool Plume::TextureCooker::DecodePacked(const PackedTextureSources& sources, std::vector<uint8_t>& outTexels, uint32_t& outWidth,
+	uint32_t& outHeight)
+{
+	struct DecodedSource
+	{
+		stbi_uc* pixels = nullptr;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	std::array<DecodedSource, 4> decodedSources;
+
+	auto freeSources = [&decodedSources]() {
+		for (auto& decoded : decodedSources)
+		{
+			stbi_image_free(decoded.pixels);
+		}
+	};
+
+	outWidth = 0;
+	outHeight = 0;
+
+	for (size_t channel = 0; channel < sources.size(); ++channel)
+	{
+		if (sources[channel].fileName.empty())
+		{
+			continue;
+		}
+
+		int texWidth, texHeight, texChannels;
+		decodedSources[channel].pixels = stbi_load(sources[channel].fileName.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+		if (!decodedSources[channel].pixels)
+		{
+			freeSources();
+			return false;
+		}
+
+		decodedSources[channel].width = static_cast<uint32_t>(texWidth);
+		decodedSources[channel].height = static_cast<uint32_t>(texHeight);
+
+		outWidth = std::max(outWidth, decodedSources[channel].width);
+		outHeight = std::max(outHeight, decodedSources[channel].height);
+	}
+
+	if (outWidth == 0 || outHeight == 0)
+	{
+		freeSources();
+		return false;
+	}
+
+	outTexels.resize(static_cast<size_t>(outWidth) * outHeight * 4);
+
+	for (size_t channel = 0; channel < sources.size(); ++channel)
+	{
+		const DecodedSource& decoded = decodedSources[channel];
+
+		for (uint32_t y = 0; y < outHeight; ++y)
+		{
+			for (uint32_t x = 0; x < outWidth; ++x)
+			{
+				uint8_t& value = outTexels[(static_cast<size_t>(y) * outWidth + x) * 4 + channel];
+
+				if (!decoded.pixels)
+				{
+					value = sources[channel].fillValue;
+					continue;
+				}
+
+				// nearest texel of smaller sources
+				const uint32_t srcX = static_cast<uint32_t>(static_cast<uint64_t>(x) * decoded.width / outWidth);
+				const uint32_t srcY = static_cast<uint32_t>(static_cast<uint64_t>(y) * decoded.height / outHeight);
+				value = decoded.pixels[(static_cast<size_t>(srcY) * decoded.width + srcX) * 4 + channel];
+			}
+		}
+	}
+
+	freeSources();
+
+	return true;
+}
+
+
+bool Plume::TextureCooker::LoadOrCookPacked(const PackedTextureSources& sources, const TextureCookSettings& settings,
+	CookedTexture& outTexture)
+{
+	uint64_t sourceHash = FNV1A_64_OFFSET_BASIS;
+
+	for (const auto& source : sources)
+	{
+		if (source.fileName.empty())
+		{
+			sourceHash = HashBytes(&source.fillValue, sizeof(source.fillValue), sourceHash);
+			continue;
+		}
+
+		MappedFile sourceFile;
+		if (!sourceFile.Open(source.fileName))
+		{
+			return false;
+		}
+
+		sourceHash = HashBytes(sourceFile.GetData(), sourceFile.GetSize(), sourceHash);
+	}
+
+	auto decodeSource = [&sources](std::vector<uint8_t>& texels, uint32_t& width, uint32_t& height) {
+		return DecodePacked(sources, texels, width, height);
+	};
+
+	return LoadOrCookSource(GetCachePath(sources, settings), sourceHash, settings, decodeSource, outTexture);
+}
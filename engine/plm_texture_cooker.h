@@ -0,0 +1,102 @@
+#pragma once
+
+#include "plm_common.h"
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace Plume
+{
+
+class MappedFile;
+
+enum class TextureCompression : uint32_t
+{
+	// sRGB color and alpha
+	eBC7 = 0,
+	// tangent-space normal map, only x and y are stored
+	eBC5 = 1,
+	// single channel of a linear mask
+	eBC4 = 2,
+	// linear data, such as channel-packed material masks
+	eBC7Linear = 3,
+};
+
+struct TextureCookSettings
+{
+	TextureCompression compression = TextureCompression::eBC7;
+
+	// source channel stored by BC4
+	uint32_t maskChannel = 0;
+};
+
+// Channel of a packed texture, taken from the same channel of fileName
+struct TextureChannelSource
+{
+	std::string fileName;
+
+	// used when fileName is empty
+	uint8_t fillValue = 0;
+};
+
+using PackedTextureSources = std::array<TextureChannelSource, 4>;
+
+// Block-compressed texture with its full mip chain, either cooked in memory or mapped from the texture cache
+struct CookedTexture
+{
+	struct Mip
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// relative to the start of the blocks
+		uint64_t offset = 0;
+		uint64_t size = 0;
+	};
+
+	TextureCookSettings settings;
+	std::vector<Mip> mips;
+
+	std::vector<uint8_t> blocks;
+
+	std::shared_ptr<MappedFile> pCacheFile;
+	ArrayView<uint8_t> cachedBlocks;
+
+	ArrayView<uint8_t> GetBlocks() const { return pCacheFile ? cachedBlocks : ArrayView<uint8_t>(blocks); }
+};
+
+// Import-time block compression of material textures. Cooked textures are stored next to their source file, keyed by
+// the hash of the source contents, so that later runs upload the blocks without decoding or encoding anything.
+namespace TextureCooker
+{
+
+constexpr uint32_t MAGIC = 0x54584c50; // "PLXT"
+constexpr uint32_t VERSION = 2;
+
+// Bytes per 4x4 block
+uint32_t GetBlockSize(TextureCompression compression);
+
+std::string GetCachePath(const std::string& sourcePath, const TextureCookSettings& settings);
+std::string GetCachePath(const PackedTextureSources& sources, const TextureCookSettings& settings);
+
+// Encodes tightly packed RGBA8 texels and a box-filtered mip chain down to 1x1. Color is filtered in linear space,
+// normals are renormalized after filtering.
+void Cook(const uint8_t* pTexels, uint32_t width, uint32_t height, const TextureCookSettings& settings, CookedTexture& outTexture);
+
+// Maps the cached texture if it is up to date, otherwise decodes and cooks the source and stores the result.
+// Returns false if the source can't be read or decoded.
+bool LoadOrCook(const std::string& sourcePath, const TextureCookSettings& settings, CookedTexture& outTexture);
+
+// Decodes the sources into tightly packed RGBA8 texels. Sources of different sizes are resampled to the largest one.
+// Returns false if a source can't be read or decoded, or if all of them are empty.
+bool DecodePacked(const PackedTextureSources& sources, std::vector<uint8_t>& outTexels, uint32_t& outWidth, uint32_t& outHeight);
+
+// Same as LoadOrCook() for a texture packed from the channels of several sources. The cache is stored next to the
+// first source and depends on the contents of all of them.
+bool LoadOrCookPacked(const PackedTextureSources& sources, const TextureCookSettings& settings, CookedTexture& outTexture);
+
+} // namespace TextureCooker
+
+} // namespace Plume
@@ -0,0 +1,68 @@
+#include "plm_thread_pool.h"
+#include "plm_tracer.h"
+
+#include <algorithm>
+
+
+Plume::ThreadPool::ThreadPool(size_t numWorkers)
+{
+	numWorkers = std::max<size_t>(numWorkers, 1);
+
+	_workers.reserve(numWorkers);
+	for (size_t i = 0; i < numWorkers; ++i)
+	{
+		_workers.emplace_back([this]() { WorkerLoop(); });
+	}
+}
+
+
+Plume::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_queueMutex);
+		_isStopping = true;
+	}
+	_queueCondition.notify_all();
+
+	for (auto& worker : _workers)
+	{
+		worker.join();
+	}
+}
+
+
+Plume::ThreadPool* Plume::ThreadPool::AcquireInstance()
+{
+	static ThreadPool instance(std::thread::hardware_concurrency());
+
+	return &instance;
+}
+
+
+void Plume::ThreadPool::WorkerLoop()
+{
+	PLM_TRACE_THREAD_NAME("Worker");
+
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(_queueMutex);
+			_queueCondition.wait(lock, [this]() { return _isStopping || !_tasks.empty(); });
+
+			// remaining tasks are still drained on shutdown so that no future is left without a value
+			if (_tasks.empty())
+			{
+				return;
+			}
+
+			task = std::move(_tasks.front());
+			_tasks.pop();
+		}
+
+		PLM_TRACE_ZONE("Task");
+
+		task();
+	}
+}
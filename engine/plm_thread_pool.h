@@ -0,0 +1,62 @@
+#pragma once
+
+#include "plm_common.h"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace Plume
+{
+
+// Fixed-size pool of worker threads shared by the engine's loading code
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t numWorkers);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+
+	// Lazily created with one worker per hardware thread
+	static ThreadPool* AcquireInstance();
+
+	size_t GetNumWorkers() const { return _workers.size(); }
+
+	template <typename F>
+	auto Submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>>
+	{
+		using ResultType = std::invoke_result_t<std::decay_t<F>>;
+
+		auto pTask = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(task));
+		std::future<ResultType> result = pTask->get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(_queueMutex);
+			_tasks.emplace([pTask]() { (*pTask)(); });
+		}
+		_queueCondition.notify_one();
+
+		return result;
+	}
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> _workers;
+	std::queue<std::function<void()>> _tasks;
+
+	std::mutex _queueMutex;
+	std::condition_variable _queueCondition;
+	bool _isStopping = false;
+};
+
+} // namespace Plume
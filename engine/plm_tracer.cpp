@@ -0,0 +1,207 @@
+#include "plm_tracer.h"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+
+namespace
+{
+
+constexpr uint32_t GPU_TRACK_ID = 0;
+
+
+void WriteJsonString(std::ofstream& file, const char* str)
+{
+	file << '"';
+	for (const char* pChar = str; *pChar != '\0'; ++pChar)
+	{
+		if (*pChar == '"' || *pChar == '\\')
+		{
+			file << '\\';
+		}
+		file << *pChar;
+	}
+	file << '"';
+}
+
+} // anonymous namespace
+
+
+Plume::Tracer::Track::Track(uint32_t trackId) : id(trackId)
+{
+	pFirstChunk = new Chunk();
+	pLastChunk = pFirstChunk;
+	numChunks = 1;
+}
+
+
+Plume::Tracer::Track::~Track()
+{
+	Chunk* pChunk = pFirstChunk;
+	while (pChunk)
+	{
+		Chunk* pNextChunk = pChunk->pNext.load(std::memory_order_relaxed);
+		delete pChunk;
+		pChunk = pNextChunk;
+	}
+}
+
+
+void Plume::Tracer::Track::Append(const Zone& zone)
+{
+	uint32_t numZones = pLastChunk->numZones.load(std::memory_order_relaxed);
+
+	if (numZones == CHUNK_SIZE)
+	{
+		if (numChunks == MAX_TRACK_CHUNKS)
+		{
+			numDroppedZones.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		Chunk* pNewChunk = new Chunk();
+		pLastChunk->pNext.store(pNewChunk, std::memory_order_release);
+		pLastChunk = pNewChunk;
+		++numChunks;
+
+		numZones = 0;
+	}
+
+	pLastChunk->zones[numZones] = zone;
+
+	// publishes the zone to readers
+	pLastChunk->numZones.store(numZones + 1, std::memory_order_release);
+}
+
+
+Plume::Tracer::Tracer() : _startTime(std::chrono::steady_clock::now())
+{
+	_tracks.push_back(std::make_unique<Track>(GPU_TRACK_ID));
+	_pGpuTrack = _tracks.back().get();
+	_pGpuTrack->name.store("GPU", std::memory_order_relaxed);
+}
+
+
+Plume::Tracer* Plume::Tracer::AcquireInstance()
+{
+	static Tracer* pInstance = new Tracer();
+
+	return pInstance;
+}
+
+
+uint64_t Plume::Tracer::GetTimeNs()
+{
+	const auto timeSinceStart = std::chrono::steady_clock::now() - AcquireInstance()->_startTime;
+
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(timeSinceStart).count());
+}
+
+
+void Plume::Tracer::AddZone(const char* name, uint64_t beginNs, uint64_t endNs)
+{
+	GetThreadTrack().Append({ name, beginNs, endNs });
+}
+
+
+void Plume::Tracer::AddGpuZone(const char* name, uint64_t beginNs, uint64_t endNs)
+{
+	_pGpuTrack->Append({ name, beginNs, endNs });
+}
+
+
+void Plume::Tracer::SetThreadName(const char* name)
+{
+	GetThreadTrack().name.store(name, std::memory_order_relaxed);
+}
+
+
+Plume::Tracer::Track& Plume::Tracer::GetThreadTrack()
+{
+	thread_local Track* pThreadTrack = nullptr;
+
+	if (!pThreadTrack)
+	{
+		std::lock_guard<std::mutex> lock(_trackMutex);
+
+		_tracks.push_back(std::make_unique<Track>(static_cast<uint32_t>(_tracks.size())));
+		pThreadTrack = _tracks.back().get();
+	}
+
+	return *pThreadTrack;
+}
+
+
+bool Plume::Tracer::WriteChromeTrace(const std::string& fileName) const
+{
+	std::ofstream file(fileName, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "Tracer: failed to write " << fileName << std::endl;
+		return false;
+	}
+
+	// Chrome trace timestamps are in microseconds
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool isFirstEvent = true;
+	size_t numZones = 0;
+	uint64_t numDroppedZones = 0;
+
+	std::lock_guard<std::mutex> lock(_trackMutex);
+
+	for (const auto& pTrack : _tracks)
+	{
+		const char* trackName = pTrack->name.load(std::memory_order_relaxed);
+
+		file << (isFirstEvent ? "\n" : ",\n");
+		file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << pTrack->id << ",\"args\":{\"name\":";
+		if (trackName)
+		{
+			WriteJsonString(file, trackName);
+		}
+		else
+		{
+			file << "\"Thread " << pTrack->id << '"';
+		}
+		file << "}}";
+
+		// keeps the GPU track on top
+		file << ",\n{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":1,\"tid\":" << pTrack->id << ",\"args\":{\"sort_index\":"
+			<< pTrack->id << "}}";
+
+		isFirstEvent = false;
+
+		for (const Chunk* pChunk = pTrack->pFirstChunk; pChunk; pChunk = pChunk->pNext.load(std::memory_order_acquire))
+		{
+			const uint32_t numChunkZones = pChunk->numZones.load(std::memory_order_acquire);
+
+			for (uint32_t i = 0; i < numChunkZones; ++i)
+			{
+				const Zone& zone = pChunk->zones[i];
+
+				file << ",\n{\"ph\":\"X\",\"name\":";
+				WriteJsonString(file, zone.name);
+				file << ",\"cat\":\"" << (pTrack->id == GPU_TRACK_ID ? "gpu" : "cpu") << "\",\"pid\":1,\"tid\":" << pTrack->id
+					<< ",\"ts\":" << zone.beginNs / 1000.0 << ",\"dur\":" << (zone.endNs - zone.beginNs) / 1000.0 << '}';
+			}
+
+			numZones += numChunkZones;
+		}
+
+		numDroppedZones += pTrack->numDroppedZones.load(std::memory_order_relaxed);
+	}
+
+	file << "\n]}\n";
+
+	std::cout << "Tracer: " << numZones << " zones written to " << fileName;
+	if (numDroppedZones > 0)
+	{
+		std::cout << ", " << numDroppedZones << " dropped after the buffers filled up";
+	}
+	std::cout << std::endl;
+
+	return true;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "plm_common.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Zones are traced in debug builds only, unless PLM_ENABLE_TRACING is defined to 0 or 1
+#ifndef PLM_ENABLE_TRACING
+#ifndef NDEBUG
+#define PLM_ENABLE_TRACING 1
+#else
+#define PLM_ENABLE_TRACING 0
+#endif
+#endif
+
+#if PLM_ENABLE_TRACING
+#define PLM_TRACE_CONCAT_IMPL(a, b) a##b
+#define PLM_TRACE_CONCAT(a, b) PLM_TRACE_CONCAT_IMPL(a, b)
+
+// Traces the enclosing scope, name must be a string literal
+#define PLM_TRACE_ZONE(name) Plume::TraceZone PLM_TRACE_CONCAT(traceZone, __LINE__)(name)
+#define PLM_TRACE_THREAD_NAME(name) Plume::Tracer::AcquireInstance()->SetThreadName(name)
+#define PLM_TRACE_WRITE(fileName) Plume::Tracer::AcquireInstance()->WriteChromeTrace(fileName)
+#else
+#define PLM_TRACE_ZONE(name) do { } while (false)
+#define PLM_TRACE_THREAD_NAME(name) do { } while (false)
+#define PLM_TRACE_WRITE(fileName) do { } while (false)
+#endif
+
+
+namespace Plume
+{
+
+// Records the zones of every thread into a buffer only that thread appends to, so tracing takes no locks, and writes
+// them as a Chrome trace that chrome://tracing and ui.perfetto.dev open. GPU zones go to a track of their own on the
+// same clock. Zone and thread names are stored as pointers and must outlive the tracer.
+class Tracer
+{
+public:
+	// Never destroyed, so that threads can still trace during static destruction
+	static Tracer* AcquireInstance();
+
+	// Nanoseconds on the steady clock since the tracer was created
+	static uint64_t GetTimeNs();
+
+	// Adds the zone to the track of the calling thread
+	void AddZone(const char* name, uint64_t beginNs, uint64_t endNs);
+	// Adds the zone to the GPU track, from one thread at a time
+	void AddGpuZone(const char* name, uint64_t beginNs, uint64_t endNs);
+
+	void SetThreadName(const char* name);
+
+	// Can be called while other threads trace, zones they add meanwhile may be left out
+	bool WriteChromeTrace(const std::string& fileName) const;
+
+	static constexpr const char* TRACE_PATH = "cpu_trace.json";
+
+private:
+	Tracer();
+
+	struct Zone
+	{
+		const char* name = nullptr;
+		uint64_t beginNs = 0;
+		uint64_t endNs = 0;
+	};
+
+	static constexpr uint32_t CHUNK_SIZE = 4096;
+	// zones beyond CHUNK_SIZE * MAX_TRACK_CHUNKS per track are dropped
+	static constexpr uint32_t MAX_TRACK_CHUNKS = 256;
+
+	// Zones below numZones are never written again, readers load numZones and pNext with acquire semantics
+	struct Chunk
+	{
+		std::array<Zone, CHUNK_SIZE> zones;
+		std::atomic<uint32_t> numZones{ 0 };
+		std::atomic<Chunk*> pNext{ nullptr };
+	};
+
+	// Appended to by a single thread, read by any
+	struct Track
+	{
+		explicit Track(uint32_t trackId);
+		~Track();
+
+		Track(const Track& other) = delete;
+		Track& operator=(const Track& other) = delete;
+
+		void Append(const Zone& zone);
+
+		uint32_t id = 0;
+		std::atomic<const char*> name{ nullptr };
+
+		Chunk* pFirstChunk = nullptr;
+		// owned by the appending thread
+		Chunk* pLastChunk = nullptr;
+		uint32_t numChunks = 0;
+
+		std::atomic<uint64_t> numDroppedZones{ 0 };
+	};
+
+	// Registers a track for the calling thread on its first zone
+	Track& GetThreadTrack();
+
+	const std::chrono::steady_clock::time_point _startTime;
+
+	// guards the track list, not the tracks
+	mutable std::mutex _trackMutex;
+	std::vector<std::unique_ptr<Track>> _tracks;
+
+	Track* _pGpuTrack = nullptr;
+};
+
+
+// Adds the lifetime of the object to the trace of the calling thread
+class TraceZone
+{
+public:
+	explicit TraceZone(const char* name) : _name(name), _beginNs(Tracer::GetTimeNs()) {}
+	~TraceZone() { Tracer::AcquireInstance()->AddZone(_name, _beginNs, Tracer::GetTimeNs()); }
+
+	TraceZone(const TraceZone& other) = delete;
+	TraceZone& operator=(const TraceZone& other) = delete;
+
+private:
+	const char* _name;
+	uint64_t _beginNs;
+};
+
+} // namespace Plume
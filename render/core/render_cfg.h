@@ -12,18 +12,31 @@ struct ConfigurationVariables
 	bool SHADER_EXECUTION_REORDERING = true;
 	bool FXAA = true;
 	int32_t MAX_BOUNCES = 4;
+	// largest allowed screen-space LOD error in pixels for the hybrid renderer
+	float LOD_ERROR_PIXELS = 1.0f;
+	// trace secondary path tracing bounces against the coarsest mesh LODs, which are only built for ray tracing if this
+	// is set at startup
+	bool COARSE_SECONDARY_LODS = false;
+	// sample the environment map explicitly at every path vertex, combined with BSDF sampling by MIS
+	bool ENVIRONMENT_SAMPLING = true;
+	// cull meshlets of full-detail objects against the frustum before the geometry pass
+	bool CLUSTER_CULLING = true;
+	// additionally cull meshlets whose triangles all face away from the camera. Off by default, since the geometry pass
+	// doesn't cull backfaces and double-sided surfaces would disappear when seen from behind.
+	bool CLUSTER_CONE_CULLING = false;
+	// cull and draw clusters with task and mesh shaders, reset at startup if the device lacks VK_EXT_mesh_shader
+	bool MESH_SHADERS = true;
 };
 
 
-constexpr int NUM_MATERIAL_TEXTURE_TYPES = 4;
+constexpr int NUM_MATERIAL_TEXTURE_TYPES = 3;
 
 constexpr int NUM_GBUFFER_ATTACHMENTS = 4;
 
 constexpr uint32_t DIFFUSE_TEX_SLOT = 0;
-constexpr uint32_t METALLIC_TEX_SLOT = 1;
-constexpr uint32_t ROUGHNESS_TEX_SLOT = 2;
-constexpr uint32_t NORMAL_MAP_SLOT = 3;
-constexpr uint32_t TLAS_SLOT = 4;
+constexpr uint32_t ORM_TEX_SLOT = 1;
+constexpr uint32_t NORMAL_MAP_SLOT = 2;
+constexpr uint32_t TLAS_SLOT = 3;
 
 constexpr uint32_t GBUFFER_POSITION_SLOT = 0;
 constexpr uint32_t GBUFFER_NORMAL_SLOT = 1;
@@ -32,4 +45,6 @@ constexpr uint32_t GBUFFER_METALLIC_ROUGHNESS_SLOT = 3;
 
 constexpr size_t MAX_BINDING_SLOTS_PER_SET = 20;
 
+constexpr size_t MAX_OBJECTS = 10000;
+
 } // namespace Render
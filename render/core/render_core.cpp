@@ -1,5 +1,10 @@
 #include "render_core.h"
 #include "render_shader.h"
+#include "render_mesh_utils.h"
+#include "render_rt_backend_utils.h"
+#include "../engine/plm_mapped_file.h"
+#include "../engine/plm_thread_pool.h"
+#include "../engine/plm_tracer.h"
 #include "VkBootstrap.h"
 
 #define VMA_IMPLEMENTATION
@@ -11,6 +16,14 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 #include "imgui_impl_sdl3.h"
 #include "imgui_impl_vulkan.h"
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <unordered_map>
+
 
 #ifdef _DEBUG
 	constexpr static bool ENABLE_VALIDATION_LAYERS = true;
@@ -19,6 +32,63 @@ VULKAN_HPP_DEFAULT_DISPATCH_LOADER_DYNAMIC_STORAGE
 #endif // _DEBUG
 
 
+namespace
+{
+
+constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43504c50; // "PLPC"
+constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+// Drivers are expected to reject foreign cache data themselves, but not all of them do so gracefully. The cache is
+// only handed to the driver if it was written for the same device and driver version.
+struct PipelineCacheHeader
+{
+	uint32_t magic = PIPELINE_CACHE_MAGIC;
+	uint32_t version = PIPELINE_CACHE_VERSION;
+	uint32_t vendorId = 0;
+	uint32_t deviceId = 0;
+	uint32_t driverVersion = 0;
+	uint32_t padding = 0;
+	uint8_t deviceUuid[VK_UUID_SIZE] = {};
+	uint8_t pipelineCacheUuid[VK_UUID_SIZE] = {};
+	uint64_t dataSize = 0;
+	uint64_t dataHash = 0;
+};
+
+
+PipelineCacheHeader MakePipelineCacheHeader(vk::PhysicalDevice gpu)
+{
+	const auto properties = gpu.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+	const vk::PhysicalDeviceProperties& deviceProperties = properties.get<vk::PhysicalDeviceProperties2>().properties;
+	const vk::PhysicalDeviceIDProperties& idProperties = properties.get<vk::PhysicalDeviceIDProperties>();
+
+	PipelineCacheHeader header;
+	header.vendorId = deviceProperties.vendorID;
+	header.deviceId = deviceProperties.deviceID;
+	header.driverVersion = deviceProperties.driverVersion;
+	std::memcpy(header.deviceUuid, idProperties.deviceUUID.data(), VK_UUID_SIZE);
+	std::memcpy(header.pipelineCacheUuid, deviceProperties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+
+	return header;
+}
+
+
+bool IsSamePipelineCacheDevice(const PipelineCacheHeader& header, const PipelineCacheHeader& deviceHeader)
+{
+	return header.magic == PIPELINE_CACHE_MAGIC && header.version == PIPELINE_CACHE_VERSION && header.vendorId == deviceHeader.vendorId &&
+		header.deviceId == deviceHeader.deviceId && header.driverVersion == deviceHeader.driverVersion &&
+		std::memcmp(header.deviceUuid, deviceHeader.deviceUuid, VK_UUID_SIZE) == 0 &&
+		std::memcmp(header.pipelineCacheUuid, deviceHeader.pipelineCacheUuid, VK_UUID_SIZE) == 0;
+}
+
+
+// SBT records per region, the raygen region has a single one
+constexpr uint32_t SBT_MISS_COUNT = 2;
+constexpr uint32_t SBT_HIT_COUNT = 1;
+constexpr uint32_t SBT_HANDLE_COUNT = 1 + SBT_MISS_COUNT + SBT_HIT_COUNT;
+
+} // anonymous namespace
+
+
 void Render::Image::LayoutTransition(vk::CommandBuffer cmd, const TransitionInfo& info) const
 {
 	vk::ImageMemoryBarrier transition;
@@ -141,6 +211,15 @@ void Render::Buffer::MemoryBarrier(vk::CommandBuffer cmd, const MemoryBarrierInf
 }
 
 
+void Render::Image::DestroyManually()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	backend->GetPDevice()->destroyImageView(_view);
+	vmaDestroyImage(backend->_allocator, _handle, _allocation);
+}
+
+
 void Render::Buffer::DestroyManually()
 {
 	auto* backend = Render::Backend::AcquireInstance();
@@ -149,6 +228,93 @@ void Render::Buffer::DestroyManually()
 }
 
 
+Render::GeometryArena::Range Render::GeometryArena::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	Range resRange = {};
+
+	if (size == 0)
+	{
+		return resRange;
+	}
+
+	uint64_t offset = 0;
+	uint32_t blockId = 0;
+	for (; blockId < _blocks.size(); ++blockId)
+	{
+		if (_blocks[blockId].allocator.Allocate(size, alignment, offset))
+		{
+			break;
+		}
+	}
+
+	if (blockId == _blocks.size())
+	{
+		AddBlock(std::max(DEFAULT_BLOCK_SIZE, size));
+
+		bool isAllocated = _blocks.back().allocator.Allocate(size, alignment, offset);
+		ASSERT(isAllocated, "Geometry arena allocation failed");
+	}
+
+	const Block& block = _blocks[blockId];
+
+	resRange.blockId = blockId;
+	resRange.offset = offset;
+	resRange.size = size;
+	resRange.buffer = block.buffer.GetHandle();
+	resRange.deviceAddress = block.baseAddress + offset;
+
+	return resRange;
+}
+
+
+void Render::GeometryArena::Free(const Range& range)
+{
+	if (range.size == 0)
+	{
+		return;
+	}
+
+	ASSERT(range.blockId < _blocks.size(), "Invalid geometry arena range");
+
+	_blocks[range.blockId].allocator.Free(range.offset, range.size);
+}
+
+
+void Render::GeometryArena::AddBlock(vk::DeviceSize size)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	Render::Buffer::CreateInfo blockInfo = {};
+	blockInfo.allocSize = size;
+	blockInfo.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer |
+		vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eShaderDeviceAddress |
+		vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eStorageBuffer;
+	blockInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+	// blocks are large and kept resident before anything else
+	blockInfo.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+	blockInfo.priority = 1.0f;
+
+	Block& block = _blocks.emplace_back();
+	block.buffer = backend->CreateBuffer(blockInfo);
+	block.baseAddress = block.buffer.GetDeviceAddress();
+	block.allocator.Init(size);
+}
+
+
+uint32_t Render::Mesh::GetFirstIndex(uint32_t lodId /* = 0 */) const
+{
+	const vk::DeviceSize indexSize = (indexType == vk::IndexType::eUint16) ? sizeof(uint16_t) : sizeof(uint32_t);
+
+	return static_cast<uint32_t>(GetIndexRange(lodId).offset / indexSize);
+}
+
+
+int32_t Render::Mesh::GetVertexOffset() const
+{
+	return static_cast<int32_t>(vertexRange.offset / sizeof(GPUVertex));
+}
+
+
 std::unique_ptr<Render::Backend> Render::Backend::_pInstance = nullptr;
 bool Render::Backend::_isInitialized = false;
 
@@ -170,9 +336,13 @@ Render::Backend* Render::Backend::AcquireInstance()
 
 void Render::Backend::Init()
 {
+	PLM_TRACE_ZONE("Render::Backend::Init");
+
 	vkb::InstanceBuilder builder;
 
+	// headless instances go without surface extensions, and devices are selected without present support
 	auto inst_ret = builder.set_app_name("Plume Start")
+		.set_headless(_isHeadless)
 		.request_validation_layers(ENABLE_VALIDATION_LAYERS)
 		.require_api_version(1, 3, 0)
 		.use_default_debug_messenger()
@@ -184,9 +354,12 @@ void Render::Backend::Init()
 	_libInstance = vkb_inst.instance;
 	_debug_messenger = vkb_inst.debug_messenger;
 
-	VkSurfaceKHR surfaceC;
-	SDL_Vulkan_CreateSurface(_pWindow, _libInstance, nullptr, &surfaceC);
-	_surface = surfaceC;
+	if (!_isHeadless)
+	{
+		VkSurfaceKHR surfaceC;
+		SDL_Vulkan_CreateSurface(_pWindow, _libInstance, nullptr, &surfaceC);
+		_surface = surfaceC;
+	}
 
 	// use VkBootstrap to select a GPU
 	// the GPU should be able to write to SDL surface and support Vulkan 1.3
@@ -195,6 +368,12 @@ void Render::Backend::Init()
 	vk::PhysicalDeviceFeatures miscFeatures;
 	miscFeatures.shaderInt64 = VK_TRUE;
 	miscFeatures.samplerAnisotropy = VK_TRUE;
+	miscFeatures.textureCompressionBC = VK_TRUE;
+	// cluster culling draws every cluster with its own indirect command, addressing objects through firstInstance
+	miscFeatures.multiDrawIndirect = VK_TRUE;
+	miscFeatures.drawIndirectFirstInstance = VK_TRUE;
+	// streamed textures clamp sampling to their resident mips
+	miscFeatures.shaderResourceMinLod = VK_TRUE;
 
 	vk::PhysicalDeviceVulkan13Features v13Features;
 	v13Features.synchronization2 = VK_TRUE;
@@ -213,6 +392,35 @@ void Render::Backend::Init()
 
 	_renderCfg.SHADER_EXECUTION_REORDERING = physicalDevice.enable_extension_if_present("VK_NV_ray_tracing_invocation_reorder");
 
+	// without mesh shaders, cluster culling falls back to compute culling and indexed indirect draws
+	vk::PhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures;
+	meshShaderFeatures.taskShader = VK_TRUE;
+	meshShaderFeatures.meshShader = VK_TRUE;
+
+	_meshShadersSupported = physicalDevice.enable_extension_if_present("VK_EXT_mesh_shader") &&
+		physicalDevice.enable_extension_features_if_present(static_cast<VkPhysicalDeviceMeshShaderFeaturesEXT>(meshShaderFeatures));
+	_renderCfg.MESH_SHADERS = _meshShadersSupported;
+
+	// without sparse residency, streamed textures are allocated with all of their mips
+	vk::PhysicalDeviceFeatures sparseFeatures;
+	sparseFeatures.sparseBinding = VK_TRUE;
+	sparseFeatures.sparseResidencyImage2D = VK_TRUE;
+
+	_sparseTexturesSupported = physicalDevice.enable_features_if_present(static_cast<VkPhysicalDeviceFeatures>(sparseFeatures));
+
+	// VMA tracks heap usage against the budget reported by the driver, without the extension it estimates both
+	_memoryBudgetSupported = physicalDevice.enable_extension_if_present("VK_EXT_memory_budget");
+
+	// without pipeline libraries, ray tracing pipelines are compiled as a whole
+	_rtPipelineLibrariesSupported = physicalDevice.enable_extension_if_present("VK_KHR_pipeline_library");
+
+	// geometry is allocated with a higher priority than textures, which the texture streamer can drop mips of
+	vk::PhysicalDeviceMemoryPriorityFeaturesEXT memoryPriorityFeatures;
+	memoryPriorityFeatures.memoryPriority = VK_TRUE;
+
+	const bool memoryPrioritySupported = physicalDevice.enable_extension_if_present("VK_EXT_memory_priority") &&
+		physicalDevice.enable_extension_features_if_present(static_cast<VkPhysicalDeviceMemoryPriorityFeaturesEXT>(memoryPriorityFeatures));
+
 	vkb::DeviceBuilder deviceBuilder{ physicalDevice };
 
 	vk::PhysicalDeviceShaderDrawParametersFeatures shaderDrawParametersFeatures = {};
@@ -256,25 +464,69 @@ void Render::Backend::Init()
 	_graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
 	_graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+	// memory is bound to sparse images on the graphics queue
+	const auto queueFamilies = _chosenGPU.getQueueFamilyProperties();
+	_sparseTexturesSupported = _sparseTexturesSupported &&
+		(queueFamilies[_graphicsQueueFamily].queueFlags & vk::QueueFlagBits::eSparseBinding);
+
 	VmaAllocatorCreateInfo allocatorInfo = {};
 	allocatorInfo.physicalDevice = _chosenGPU;
 	allocatorInfo.device = _device;
 	allocatorInfo.instance = _libInstance;
+	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
 	allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+	if (_memoryBudgetSupported)
+	{
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+	}
+	if (memoryPrioritySupported)
+	{
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_PRIORITY_BIT;
+	}
 	vmaCreateAllocator(&allocatorInfo, &_allocator);
 
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(_libInstance);
 	VULKAN_HPP_DEFAULT_DISPATCHER.init(_device);
 
-	InitSwapchain();
+	if (_isHeadless)
+	{
+		InitOffscreenTargets();
+	}
+	else
+	{
+		InitSwapchain();
+	}
+
 	InitCommands();
 
 	_descMng.Init(&_device, &_mainDeletionQueue);
 
 	InitSyncStructures();
+
+	_gpuProfiler.Init(_device, _gpuProperties.properties.limits.timestampPeriod,
+		queueFamilies[_graphicsQueueFamily].timestampValidBits);
+	_mainDeletionQueue.PushFunction([=]() {
+		_gpuProfiler.Destroy();
+	});
+
+#if PLM_ENABLE_TRACING
+	// puts the GPU zones on the timeline of the CPU trace
+	const uint64_t calibrationSubmitTimeNs = Plume::Tracer::GetTimeNs();
+	SubmitCmdImmediately([this](vk::CommandBuffer cmd) {
+		_gpuProfiler.WriteCalibrationTimestamp(cmd);
+	}, _uploadContext._commandBuffer);
+	_gpuProfiler.Calibrate(calibrationSubmitTimeNs, Plume::Tracer::GetTimeNs());
+#endif // PLM_ENABLE_TRACING
+
 	InitRaytracingProperties();
 	InitSamplers();
-	InitImGui();
+	InitPipelineCache();
+
+	// the debug UI needs a window
+	if (!_isHeadless)
+	{
+		InitImGui();
+	}
 
 	_isInitialized = true;
 }
@@ -286,11 +538,30 @@ void Render::Backend::Terminate()
 	ASSERT_VK(_device.waitForFences(GetCurrentFrameData()._renderFence, true, 1000000000), "Render fence timeout");
 	++_frameId;
 
+	SavePipelineCache();
+
+	for (auto& frameDeleter : _frameDeleters)
+	{
+		frameDeleter.deleter();
+	}
+	_frameDeleters.clear();
+
 	_mainDeletionQueue.Flush();
 
+	for (const auto& [key, library] : _rtPipelineLibraries)
+	{
+		_device.destroyPipeline(library);
+	}
+	_rtPipelineLibraries.clear();
+
+	_device.destroyPipelineCache(_pipelineCache);
+
 	vmaDestroyAllocator(_allocator);
 	_device.destroy();
-	_libInstance.destroySurfaceKHR(_surface);
+	if (_surface)
+	{
+		_libInstance.destroySurfaceKHR(_surface);
+	}
 	vkb::destroy_debug_utils_messenger(_libInstance, _debug_messenger);
 	_libInstance.destroy();
 
@@ -346,14 +617,34 @@ Render::Image Render::Backend::CreateImage(const Image::CreateInfo& createInfo)
 	imageVkCreateInfo.usage = createInfo.usageFlags;
 	imageVkCreateInfo.flags = (createInfo.type == Image::Type::eCubemap) ? vk::ImageCreateFlagBits::eCubeCompatible : vk::ImageCreateFlagBits(0);
 
-	VkImageCreateInfo imageInfoC = static_cast<VkImageCreateInfo>(imageVkCreateInfo);
-
-	VkImage imageC = {};
+	// usages the image format lacks, e.g. storage of sRGB images, are left to views of other formats
+	if (createInfo.isMutableFormat)
+	{
+		imageVkCreateInfo.flags |= vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage;
+	}
 
 	VmaAllocation allocation = {};
-	ASSERT_VK(vmaCreateImage(_allocator, &imageInfoC, &imgAllocInfo, &imageC, &allocation, nullptr), "Image creation failed");
 
-	resImage._handle = imageC;
+	if (createInfo.isSparse)
+	{
+		ASSERT(_sparseTexturesSupported, "Sparse images are not supported");
+
+		imageVkCreateInfo.flags |= vk::ImageCreateFlagBits::eSparseBinding | vk::ImageCreateFlagBits::eSparseResidency;
+
+		resImage._handle = _device.createImage(imageVkCreateInfo);
+	}
+	else
+	{
+		VkImageCreateInfo imageInfoC = static_cast<VkImageCreateInfo>(imageVkCreateInfo);
+
+		VkImage imageC = {};
+
+		ASSERT_VK(vmaCreateImage(_allocator, &imageInfoC, &imgAllocInfo, &imageC, &allocation, nullptr), "Image creation failed");
+
+		resImage._handle = imageC;
+	}
+
+	resImage._allocation = allocation;
 
 
 	vk::ImageViewType viewType = {};
@@ -378,6 +669,7 @@ Render::Image Render::Backend::CreateImage(const Image::CreateInfo& createInfo)
 	viewCreateInfo.viewType = viewType;
 	viewCreateInfo.image = resImage._handle;
 	viewCreateInfo.format = createInfo.format;
+	viewCreateInfo.components = createInfo.components;
 	viewCreateInfo.subresourceRange.baseMipLevel = 0;
 	viewCreateInfo.subresourceRange.levelCount = createInfo.mipLevels;
 	viewCreateInfo.subresourceRange.baseArrayLayer = 0;
@@ -385,12 +677,27 @@ Render::Image Render::Backend::CreateImage(const Image::CreateInfo& createInfo)
 	viewCreateInfo.subresourceRange.aspectMask = createInfo.aspectMask;
 	resImage._aspectMask = createInfo.aspectMask;
 
+	// the default view would inherit the storage usage its format doesn't support
+	vk::ImageViewUsageCreateInfo viewUsageInfo = {};
+	viewUsageInfo.usage = createInfo.usageFlags & ~vk::ImageUsageFlags(vk::ImageUsageFlagBits::eStorage);
+
+	const bool isStorageSupported = static_cast<bool>(GetFormatProperties(createInfo.format).optimalTilingFeatures &
+		vk::FormatFeatureFlagBits::eStorageImage);
+
+	if (createInfo.isMutableFormat && (createInfo.usageFlags & vk::ImageUsageFlagBits::eStorage) && !isStorageSupported)
+	{
+		viewCreateInfo.pNext = &viewUsageInfo;
+	}
+
 	resImage._view = _device.createImageView(viewCreateInfo);
 
-	_mainDeletionQueue.PushFunction([=]() {
-		vmaDestroyImage(_allocator, resImage._handle, allocation);
-		_device.destroyImageView(resImage.GetView());
-	});
+	if (createInfo.isLifetimeManaged)
+	{
+		_mainDeletionQueue.PushFunction([=]() {
+			vmaDestroyImage(_allocator, resImage._handle, allocation);
+			_device.destroyImageView(resImage.GetView());
+		});
+	}
 
 	return resImage;
 }
@@ -408,6 +715,7 @@ Render::Buffer Render::Backend::CreateBuffer(const Buffer::CreateInfo& createInf
 	vmaAllocInfo.usage = createInfo.memUsage;
 	vmaAllocInfo.flags = createInfo.flags;
 	vmaAllocInfo.requiredFlags = static_cast<VkMemoryPropertyFlags>(createInfo.reqFlags);
+	vmaAllocInfo.priority = createInfo.priority;
 
 	VkBuffer cBuffer;
 
@@ -428,6 +736,29 @@ Render::Buffer Render::Backend::CreateBuffer(const Buffer::CreateInfo& createInf
 }
 
 
+Render::Backend::MemoryBudget Render::Backend::GetDeviceLocalMemoryBudget() const
+{
+	const VkPhysicalDeviceMemoryProperties* pMemProperties = nullptr;
+	vmaGetMemoryProperties(_allocator, &pMemProperties);
+
+	std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> heapBudgets = {};
+	vmaGetHeapBudgets(_allocator, heapBudgets.data());
+
+	MemoryBudget resBudget;
+
+	for (uint32_t heapId = 0; heapId < pMemProperties->memoryHeapCount; ++heapId)
+	{
+		if (pMemProperties->memoryHeaps[heapId].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			resBudget.usage += heapBudgets[heapId].usage;
+			resBudget.budget += heapBudgets[heapId].budget;
+		}
+	}
+
+	return resBudget;
+}
+
+
 void Render::Backend::CopyImage(const Render::Image& srcImage, const Render::Image& dstImage)
 {
 	vk::ImageCopy copyInfo;
@@ -458,6 +789,23 @@ void Render::Backend::CopyDataToBuffer(const void* data, size_t dataSize, Render
 }
 
 
+void Render::Backend::CopyDataFromBuffer(const Render::Buffer& srcBuffer, void* data, size_t dataSize, uint32_t offset /* = 0 */)
+{
+	void* mappedData;
+	vmaMapMemory(_allocator, srcBuffer._allocation, &mappedData);
+
+	// no-op for host-coherent memory
+	vmaInvalidateAllocation(_allocator, srcBuffer._allocation, offset, dataSize);
+
+	const auto* mappedDataBytes = reinterpret_cast<const uint8_t*>(mappedData);
+	mappedDataBytes += offset;
+
+	std::memcpy(data, mappedDataBytes, dataSize);
+
+	vmaUnmapMemory(_allocator, srcBuffer._allocation);
+}
+
+
 void Render::Backend::CopyBufferToImage(vk::CommandBuffer cmd, const Render::Buffer& srcBuffer, Render::Image& dstImage)
 {
 	vk::BufferImageCopy copyRegion = {};
@@ -594,75 +942,268 @@ void Render::Backend::RegisterAccelerationStructure(RegisteredDescriptorSet desc
 }
 
 
-Render::Mesh Render::Backend::UploadMesh(const Plume::Mesh& engineMesh)
+std::vector<Render::Mesh> Render::Backend::UploadMeshes(const std::vector<const Plume::Mesh*>& engineMeshes)
 {
-	Render::Mesh gpuMesh = {};
-	gpuMesh.pEngineMesh = &engineMesh;
-	gpuMesh.numOfIndices = engineMesh.indices.size();
+	constexpr size_t MAX_16BIT_INDEXED_VERTICES = size_t(std::numeric_limits<uint16_t>::max()) + 1;
 
-	vk::BufferUsageFlags vertexBufferUsage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst |
-		vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR |
-		vk::BufferUsageFlagBits::eStorageBuffer;
+	// whole 32-bit words, ray tracing shaders read 16-bit indices in pairs
+	constexpr vk::DeviceSize INDEX_ALIGNMENT = sizeof(uint32_t);
+	constexpr vk::DeviceSize BLAS_TRANSFORM_ALIGNMENT = 16;
 
-	Render::Buffer::CreateInfo vertexBufferInfo = {};
-	vertexBufferInfo.usage = vertexBufferUsage;
-	vertexBufferInfo.allocSize = engineMesh.vertices.size() * sizeof(Vertex);
-	vertexBufferInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+	std::vector<Render::Mesh> gpuMeshes(engineMeshes.size());
 
-	gpuMesh.vertexBuffer = CreateBuffer(vertexBufferInfo);
+	// content hash -> ids of unique meshes with that hash
+	std::unordered_map<uint64_t, std::vector<size_t>> uniqueMeshesByHash;
+	std::vector<size_t> uniqueMeshIds;
 
-	UploadBufferImmediately(gpuMesh.vertexBuffer, engineMesh.vertices);
+	// duplicate mesh id -> id of the unique mesh it shares geometry with
+	std::vector<std::pair<size_t, size_t>> duplicateMeshIds;
 
+	auto hasSameGeometry = [](const Plume::Mesh& lhs, const Plume::Mesh& rhs) {
+		Plume::ArrayView<Vertex> lhsVertices = lhs.GetVertices();
+		Plume::ArrayView<Vertex> rhsVertices = rhs.GetVertices();
+		Plume::ArrayView<uint32_t> lhsIndices = lhs.GetIndices();
+		Plume::ArrayView<uint32_t> rhsIndices = rhs.GetIndices();
 
-	vk::BufferUsageFlags indexBufferUsage = vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst |
-		vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR |
-		vk::BufferUsageFlagBits::eStorageBuffer;
+		return lhsVertices.size() == rhsVertices.size() && lhsIndices.size() == rhsIndices.size() &&
+			std::memcmp(lhsVertices.data(), rhsVertices.data(), lhsVertices.size() * sizeof(Vertex)) == 0 &&
+			std::memcmp(lhsIndices.data(), rhsIndices.data(), lhsIndices.size() * sizeof(uint32_t)) == 0;
+	};
 
-	Render::Buffer::CreateInfo indexBufferInfo = {};
-	indexBufferInfo.usage = indexBufferUsage;
-	indexBufferInfo.allocSize = engineMesh.indices.size() * sizeof(uint32_t);
-	indexBufferInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+	vk::DeviceSize stagingSize = 0;
 
-	gpuMesh.indexBuffer = CreateBuffer(indexBufferInfo);
+	for (size_t i = 0; i < engineMeshes.size(); ++i)
+	{
+		const Plume::Mesh& engineMesh = *engineMeshes[i];
+		Render::Mesh& gpuMesh = gpuMeshes[i];
 
-	UploadBufferImmediately(gpuMesh.indexBuffer, engineMesh.indices);
+		Plume::ArrayView<Vertex> vertices = engineMesh.GetVertices();
+		Plume::ArrayView<uint32_t> indices = engineMesh.GetIndices();
 
-	return gpuMesh;
-}
+		uint64_t geometryHash = Plume::HashBytes(vertices.data(), vertices.size() * sizeof(Vertex));
+		geometryHash = Plume::HashBytes(indices.data(), indices.size() * sizeof(uint32_t), geometryHash);
 
+		std::vector<size_t>& candidateIds = uniqueMeshesByHash[geometryHash];
+		auto duplicateIt = std::find_if(candidateIds.begin(), candidateIds.end(), [&](size_t candidateId) {
+			return hasSameGeometry(*engineMeshes[candidateId], engineMesh);
+		});
 
-Render::Backend::BLASInput Render::Backend::ConvertMeshToBlasInput(const Mesh& mesh, vk::GeometryFlagBitsKHR rtGeometryFlags)
-{
-	vk::DeviceAddress vertexAddress = mesh.vertexBuffer.GetDeviceAddress();
-	vk::DeviceAddress indexAddress = mesh.indexBuffer.GetDeviceAddress();
+		if (duplicateIt != candidateIds.end())
+		{
+			duplicateMeshIds.emplace_back(i, *duplicateIt);
+			continue;
+		}
 
-	ASSERT(mesh.pEngineMesh != nullptr, "Invalid engine mesh");
+		candidateIds.push_back(i);
+
+		gpuMesh.geometryId = static_cast<uint32_t>(uniqueMeshIds.size());
+		uniqueMeshIds.push_back(i);
+
+		gpuMesh.pEngineMesh = &engineMesh;
+		gpuMesh.numOfVertices = engineMesh.GetVertices().size();
+		gpuMesh.numOfIndices = engineMesh.GetIndices().size();
+
+		gpuMesh.indexType = (gpuMesh.numOfVertices <= MAX_16BIT_INDEXED_VERTICES) ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+		const size_t indexSize = (gpuMesh.indexType == vk::IndexType::eUint16) ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		// vertex ranges are aligned to the vertex size so that they can be addressed with vertexOffset
+		gpuMesh.vertexRange = _geometryArena.Allocate(gpuMesh.numOfVertices * sizeof(GPUVertex), sizeof(GPUVertex));
+		gpuMesh.indexRange = _geometryArena.Allocate(AlignUp(gpuMesh.numOfIndices * indexSize, INDEX_ALIGNMENT), INDEX_ALIGNMENT);
+#if USE_COMPACT_VERTICES
+		gpuMesh.blasTransformRange = _geometryArena.Allocate(sizeof(vk::TransformMatrixKHR), BLAS_TRANSFORM_ALIGNMENT);
+#endif
+
+		stagingSize += gpuMesh.vertexRange.size + gpuMesh.indexRange.size + gpuMesh.blasTransformRange.size;
+
+		// LODs reuse the vertex range, so they only add index ranges of the same index type
+		gpuMesh.lods.resize(engineMesh.lods.size());
+		for (size_t lodId = 0; lodId < gpuMesh.lods.size(); ++lodId)
+		{
+			Render::Mesh::Lod& lod = gpuMesh.lods[lodId];
+			lod.numOfIndices = engineMesh.GetLodIndices(lodId).size();
+			lod.error = engineMesh.lods[lodId].error;
+			lod.indexRange = _geometryArena.Allocate(AlignUp(lod.numOfIndices * indexSize, INDEX_ALIGNMENT), INDEX_ALIGNMENT);
+
+			stagingSize += lod.indexRange.size;
+		}
+
+		// meshlets are optional, see Plume::ImportSettings::buildMeshlets
+		if (!engineMesh.GetMeshlets().empty())
+		{
+			gpuMesh.meshletVerticesRange = _geometryArena.Allocate(engineMesh.GetMeshletVertices().size() * sizeof(uint32_t),
+				sizeof(uint32_t));
+			gpuMesh.meshletTrianglesRange = _geometryArena.Allocate(engineMesh.GetMeshletTriangles().size() * sizeof(uint32_t),
+				sizeof(uint32_t));
+
+			stagingSize += gpuMesh.meshletVerticesRange.size + gpuMesh.meshletTrianglesRange.size;
+		}
+
+		if (!vertices.empty())
+		{
+			glm::vec3 minPos = vertices[0].position;
+			glm::vec3 maxPos = vertices[0].position;
+			for (const auto& vertex : vertices)
+			{
+				minPos = glm::min(minPos, vertex.position);
+				maxPos = glm::max(maxPos, vertex.position);
+			}
+
+			gpuMesh.boundsCenter = 0.5f * (minPos + maxPos);
+			gpuMesh.boundsRadius = 0.5f * glm::length(maxPos - minPos);
+		}
+	}
+
+	if (uniqueMeshIds.size() < engineMeshes.size())
+	{
+		std::cout << "Deduplicated meshes: " << engineMeshes.size() << " -> " << uniqueMeshIds.size() << std::endl;
+	}
+
+	if (stagingSize == 0)
+	{
+		return gpuMeshes;
+	}
+
+	Render::Buffer::CreateInfo stagingInfo = {};
+	stagingInfo.allocSize = stagingSize;
+	stagingInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+	stagingInfo.memUsage = VMA_MEMORY_USAGE_CPU_ONLY;
+	stagingInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	stagingInfo.isLifetimeManaged = false;
+
+	Render::Buffer stagingBuffer = CreateBuffer(stagingInfo);
+	auto* pStagingData = static_cast<uint8_t*>(stagingBuffer._allocationInfo.pMappedData);
+
+	// copy regions grouped by destination arena block
+	std::map<VkBuffer, std::vector<vk::BufferCopy>> copyRegions;
+	vk::DeviceSize stagingOffset = 0;
 
-	const Plume::Mesh& engineMesh = *mesh.pEngineMesh;
+	auto stageData = [&](const GeometryArena::Range& range, const void* data, size_t dataSize) {
+		if (dataSize == 0)
+		{
+			return;
+		}
+
+		std::memcpy(pStagingData + stagingOffset, data, dataSize);
+
+		vk::BufferCopy copy;
+		copy.srcOffset = stagingOffset;
+		copy.dstOffset = range.offset;
+		copy.size = dataSize;
+		copyRegions[static_cast<VkBuffer>(range.buffer)].push_back(copy);
+
+		stagingOffset += dataSize;
+	};
+
+	auto stageIndices = [&](const GeometryArena::Range& range, vk::IndexType indexType, Plume::ArrayView<uint32_t> indices) {
+		if (indexType == vk::IndexType::eUint16)
+		{
+			std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+
+			stageData(range, shortIndices.data(), shortIndices.size() * sizeof(uint16_t));
+		}
+		else
+		{
+			stageData(range, indices.data(), indices.size() * sizeof(uint32_t));
+		}
+	};
+
+	for (size_t meshId : uniqueMeshIds)
+	{
+		Render::Mesh& gpuMesh = gpuMeshes[meshId];
+
+		// either owned by the engine mesh or pointing straight into the mapped mesh cache
+		Plume::ArrayView<Vertex> vertices = gpuMesh.pEngineMesh->GetVertices();
+		Plume::ArrayView<uint32_t> indices = gpuMesh.pEngineMesh->GetIndices();
+
+#if USE_COMPACT_VERTICES
+		std::vector<CompactVertex> packedVertices;
+		RenderUtil::PackVertices(vertices, packedVertices, gpuMesh.positionOffset, gpuMesh.positionScale);
+
+		stageData(gpuMesh.vertexRange, packedVertices.data(), packedVertices.size() * sizeof(CompactVertex));
+
+		glm::mat4 dequantizationMatrix = glm::translate(glm::mat4{ 1.0f }, gpuMesh.positionOffset) *
+			glm::scale(glm::mat4{ 1.0f }, gpuMesh.positionScale);
+		vk::TransformMatrixKHR blasTransform = RenderBackendRTUtils::ConvertToTransformKHR(dequantizationMatrix);
+
+		stageData(gpuMesh.blasTransformRange, &blasTransform, sizeof(blasTransform));
+#else
+		stageData(gpuMesh.vertexRange, vertices.data(), vertices.size() * sizeof(Vertex));
+#endif
+
+		stageIndices(gpuMesh.indexRange, gpuMesh.indexType, indices);
+
+		for (size_t lodId = 0; lodId < gpuMesh.lods.size(); ++lodId)
+		{
+			stageIndices(gpuMesh.lods[lodId].indexRange, gpuMesh.indexType, gpuMesh.pEngineMesh->GetLodIndices(lodId));
+		}
+
+		if (!gpuMesh.pEngineMesh->GetMeshlets().empty())
+		{
+			Plume::ArrayView<uint32_t> meshletVertices = gpuMesh.pEngineMesh->GetMeshletVertices();
+			Plume::ArrayView<uint32_t> meshletTriangles = gpuMesh.pEngineMesh->GetMeshletTriangles();
+
+			stageData(gpuMesh.meshletVerticesRange, meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+			stageData(gpuMesh.meshletTrianglesRange, meshletTriangles.data(), meshletTriangles.size() * sizeof(uint32_t));
+		}
+	}
 
-	uint32_t maxVertices = static_cast<uint32_t>(engineMesh.indices.size());
-	uint32_t maxPrimCount = static_cast<uint32_t>(engineMesh.indices.size()) / 3;
+	SubmitCmdImmediately([&](vk::CommandBuffer cmd) {
+		for (const auto& [dstBuffer, regions] : copyRegions)
+		{
+			cmd.copyBuffer(stagingBuffer.GetHandle(), static_cast<vk::Buffer>(dstBuffer), regions);
+		}
+	}, _uploadContext._commandBuffer);
+
+	stagingBuffer.DestroyManually();
+
+	for (const auto& [duplicateId, uniqueId] : duplicateMeshIds)
+	{
+		// material and emittance still come from the duplicate's own engine mesh
+		gpuMeshes[duplicateId] = gpuMeshes[uniqueId];
+		gpuMeshes[duplicateId].pEngineMesh = engineMeshes[duplicateId];
+	}
+
+	return gpuMeshes;
+}
 
-	BLASInput blasInput = {};
 
-	blasInput._triangles.vertexFormat = vk::Format::eR32G32B32Sfloat;
-	blasInput._triangles.vertexData.deviceAddress = vertexAddress;
-	blasInput._triangles.vertexStride = sizeof(Vertex);
+void Render::Backend::AddMeshToBlasInput(const Mesh& mesh, vk::GeometryFlagBitsKHR rtGeometryFlags, BLASInput& blasInput,
+	uint32_t lodId /* = 0 */)
+{
+	vk::DeviceAddress vertexAddress = mesh.vertexRange.deviceAddress;
+	vk::DeviceAddress indexAddress = mesh.GetIndexRange(lodId).deviceAddress;
 
-	blasInput._triangles.indexType = vk::IndexType::eUint32;
-	blasInput._triangles.indexData = indexAddress;
-	blasInput._triangles.maxVertex = maxVertices;
+	ASSERT(mesh.pEngineMesh != nullptr, "Invalid engine mesh");
 
-	blasInput._geometry.geometryType = vk::GeometryTypeKHR::eTriangles;
-	blasInput._geometry.flags = rtGeometryFlags;
-	blasInput._geometry.setGeometry(blasInput._triangles);
+	uint32_t maxVertex = static_cast<uint32_t>(mesh.numOfVertices > 0 ? mesh.numOfVertices - 1 : 0);
+	uint32_t maxPrimCount = static_cast<uint32_t>(mesh.GetNumOfIndices(lodId)) / 3;
 
-	blasInput._buildRangeInfo.firstVertex = 0;
-	blasInput._buildRangeInfo.primitiveCount = maxPrimCount;
-	blasInput._buildRangeInfo.primitiveOffset = 0;
-	blasInput._buildRangeInfo.transformOffset = 0;
+	vk::AccelerationStructureGeometryTrianglesDataKHR triangles;
 
-	return blasInput;
+#if USE_COMPACT_VERTICES
+	// positions are snorm16 relative to the mesh bounds, the transform below maps them back to object space
+	triangles.vertexFormat = vk::Format::eR16G16B16A16Snorm;
+	triangles.transformData.deviceAddress = mesh.blasTransformRange.deviceAddress;
+#else
+	triangles.vertexFormat = vk::Format::eR32G32B32Sfloat;
+#endif
+	triangles.vertexData.deviceAddress = vertexAddress;
+	triangles.vertexStride = sizeof(GPUVertex);
+
+	triangles.indexType = mesh.indexType;
+	triangles.indexData = indexAddress;
+	triangles.maxVertex = maxVertex;
+
+	vk::AccelerationStructureGeometryKHR& geometry = blasInput._geometries.emplace_back();
+	geometry.geometryType = vk::GeometryTypeKHR::eTriangles;
+	geometry.flags = rtGeometryFlags;
+	geometry.setGeometry(triangles);
+
+	vk::AccelerationStructureBuildRangeInfoKHR& buildRangeInfo = blasInput._buildRangeInfos.emplace_back();
+	buildRangeInfo.firstVertex = 0;
+	buildRangeInfo.primitiveCount = maxPrimCount;
+	buildRangeInfo.primitiveOffset = 0;
+	buildRangeInfo.transformOffset = 0;
 }
 
 
@@ -718,13 +1259,33 @@ vk::RenderingAttachmentInfo Render::Backend::CreateAttachment(vk::Format format,
 
 void Render::Backend::BeginFrameRendering()
 {
+	PLM_TRACE_ZONE("BeginFrameRendering");
+
 	const FrameData& currentFrameData = GetCurrentFrameData();
 
 	// wait until the GPU has finished rendering the last frame, with timeout of 1 second
 	ASSERT_VK(_device.waitForFences(currentFrameData._renderFence, true, 1000000000), "Render fence timeout.");
 	_device.resetFences(currentFrameData._renderFence);
 
-	_swapchainImageIndex = _device.acquireNextImageKHR(_swapchain, 1000000000, currentFrameData._presentSemaphore, {}).value;
+	// the fence of the frame FRAME_OVERLAP frames ago has been waited for, so it and all frames before it are done
+	while (!_frameDeleters.empty() && _frameId >= _frameDeleters.front().frameId + FRAME_OVERLAP)
+	{
+		_frameDeleters.front().deleter();
+		_frameDeleters.pop_front();
+	}
+
+	// refreshes the heap budgets
+	vmaSetCurrentFrameIndex(_allocator, static_cast<uint32_t>(_frameId));
+
+	if (_isHeadless)
+	{
+		// the fence of the frame guarantees that the GPU is done with its target
+		_swapchainImageIndex = static_cast<int32_t>(_frameId % _swapchainImages.size());
+	}
+	else
+	{
+		_swapchainImageIndex = _device.acquireNextImageKHR(_swapchain, 1000000000, currentFrameData._presentSemaphore, {}).value;
+	}
 
 	// we know that everything finished rendering, so we safely reset the command buffer and reuse it
 	ASSERT_VK(vkResetCommandBuffer(currentFrameData._mainCommandBuffer, 0), "Command buffer reset failed.");
@@ -737,12 +1298,18 @@ void Render::Backend::BeginFrameRendering()
 	cmdBeginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
 
 	cmd.begin(cmdBeginInfo);
+
+	_gpuProfiler.BeginFrame(cmd, _frameId);
 }
 
 
 void Render::Backend::EndFrameRendering()
 {
-	const FrameData& currentFrameData = GetCurrentFrameData();
+	PLM_TRACE_ZONE("EndFrameRendering");
+
+	FrameData& currentFrameData = GetCurrentFrameData();
+
+	_gpuProfiler.EndFrame(currentFrameData._mainCommandBuffer);
 
 	// stop recording to command buffer (we can no longer add commands, but it can now be submitted and executed)
 	currentFrameData._mainCommandBuffer.end();
@@ -752,20 +1319,36 @@ void Render::Backend::EndFrameRendering()
 	// signal the render semaphore, showing that rendering is finished
 
 	vk::SubmitInfo submit = {};
-	vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
 
-	submit.pWaitDstStageMask = &waitStage;
+	std::vector<vk::Semaphore> waitSemaphores;
+	std::vector<vk::PipelineStageFlags> waitStages;
 
-	submit.waitSemaphoreCount = 1;
-	submit.pWaitSemaphores = &currentFrameData._presentSemaphore;
+	// offscreen targets are neither acquired nor presented
+	if (!_isHeadless)
+	{
+		waitSemaphores.push_back(currentFrameData._presentSemaphore);
+		waitStages.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
 
-	submit.signalSemaphoreCount = 1;
-	submit.pSignalSemaphores = &currentFrameData._renderSemaphore;
+		submit.signalSemaphoreCount = 1;
+		submit.pSignalSemaphores = &currentFrameData._renderSemaphore;
+	}
 
-	submit.commandBufferCount = 1;
-	submit.pCommandBuffers = &currentFrameData._mainCommandBuffer;
+	// memory bound for the frame must be bound before any of its commands access it
+	if (currentFrameData._isSparseBindPending)
+	{
+		waitSemaphores.push_back(currentFrameData._sparseBindSemaphore);
+		waitStages.push_back(vk::PipelineStageFlagBits::eAllCommands);
 
-	// submit the buffer
+		currentFrameData._isSparseBindPending = false;
+	}
+
+	submit.setWaitSemaphores(waitSemaphores);
+	submit.setWaitDstStageMask(waitStages);
+
+	submit.commandBufferCount = 1;
+	submit.pCommandBuffers = &currentFrameData._mainCommandBuffer;
+
+	// submit the buffer
 	// render fence blocks until graphics commands are done
 	_graphicsQueue.submit(submit, currentFrameData._renderFence);
 }
@@ -773,6 +1356,14 @@ void Render::Backend::EndFrameRendering()
 
 void Render::Backend::Present()
 {
+	PLM_TRACE_ZONE("Present");
+
+	if (_isHeadless)
+	{
+		++_frameId;
+		return;
+	}
+
 	vk::PresentInfoKHR presentInfo = {};
 	presentInfo.pSwapchains = &_swapchain;
 	presentInfo.swapchainCount = 1;
@@ -808,41 +1399,64 @@ void Render::Backend::DrawObjects(const std::vector<Render::Object>& objects, co
 		cmd.pushConstants(pass.GetPipelineLayout(), pushConstantsInfo.shaderStages, 0, pushConstantsInfo.size, pushConstantsInfo.pData);
 	}
 
+	ASSERT(pass.IsBuilt(), "The pipeline of the pass is not built, see Pass::RequirePipeline()");
 	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pass.GetPipeline());
 
 	int32_t frameInFlightId = _frameId % FRAME_OVERLAP;
 
+	auto pipelineDescriptorSets = _descMng.GetDescriptorSets(pass._usedDescSets, frameInFlightId);
+
+	if (useCamLightingBuffer)
+	{
+		// scene & camera dynamic descriptor offset
+		auto dynamicDescOffset = static_cast<uint32_t>(PadUniformBufferSize(sizeof(CameraDataGPU) +
+			sizeof(LightingData)) * frameInFlightId);
+
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pass.GetPipelineLayout(), 0,
+			pipelineDescriptorSets, dynamicDescOffset);
+	}
+	else
+	{
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pass.GetPipelineLayout(), 0,
+			pipelineDescriptorSets, {});
+	}
+
+	// all meshes normally share one geometry arena block, so buffers are only rebound when the block or index type changes
+	vk::Buffer boundVertexBuffer;
+	vk::Buffer boundIndexBuffer;
+	vk::IndexType boundIndexType = vk::IndexType::eNoneKHR;
+
 	for (int32_t i = 0; i < objects.size(); ++i)
 	{
 		const Render::Object& object = objects[i];
 
-		if (!object.model)
+		// clustered objects are drawn by DrawIndexedIndirect or DrawMeshTasks after culling
+		if (!object.model || object.isDrawnAsClusters)
 		{
 			continue;
 		}
 
-		auto pipelineDescriptorSets = _descMng.GetDescriptorSets(pass._usedDescSets, frameInFlightId);
+		const Render::Mesh& mesh = object.mesh;
 
-		if (useCamLightingBuffer)
+		if (mesh.vertexRange.buffer != boundVertexBuffer)
 		{
-			// scene & camera dynamic descriptor offset
-			auto dynamicDescOffset = static_cast<uint32_t>(PadUniformBufferSize(sizeof(CameraDataGPU) +
-				sizeof(LightingData)) * frameInFlightId);
-
-			cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pass.GetPipelineLayout(), 0,
-				pipelineDescriptorSets, dynamicDescOffset);
+			vk::DeviceSize offset = 0;
+			cmd.bindVertexBuffers(0, mesh.vertexRange.buffer, offset);
+			boundVertexBuffer = mesh.vertexRange.buffer;
 		}
-		else
+
+		// LODs may live in a different arena block than the base mesh
+		const GeometryArena::Range& indexRange = mesh.GetIndexRange(object.lodId);
+
+		if (indexRange.buffer != boundIndexBuffer || mesh.indexType != boundIndexType)
 		{
-			cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pass.GetPipelineLayout(), 0,
-				pipelineDescriptorSets, {});
+			cmd.bindIndexBuffer(indexRange.buffer, 0, mesh.indexType);
+			boundIndexBuffer = indexRange.buffer;
+			boundIndexType = mesh.indexType;
 		}
 
-		vk::DeviceSize offset = 0;
-		cmd.bindVertexBuffers(0, object.mesh.vertexBuffer.GetHandle(), offset);
-		cmd.bindIndexBuffer(object.mesh.indexBuffer.GetHandle(), offset, vk::IndexType::eUint32);
-
-		cmd.drawIndexed(static_cast<uint32_t>(object.mesh.numOfIndices), 1, 0, 0, i);
+		cmd.drawIndexed(static_cast<uint32_t>(mesh.GetNumOfIndices(object.lodId)), 1, mesh.GetFirstIndex(object.lodId),
+			mesh.GetVertexOffset(), i);
 	}
 
 	cmd.endRendering();
@@ -867,6 +1481,7 @@ void Render::Backend::DrawScreenQuad(const Render::Pass& pass, PushConstantsInfo
 		cmd.pushConstants(pass.GetPipelineLayout(), pushConstantsInfo.shaderStages, 0, pushConstantsInfo.size, pushConstantsInfo.pData);
 	}
 
+	ASSERT(pass.IsBuilt(), "The pipeline of the pass is not built, see Pass::RequirePipeline()");
 	cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pass.GetPipeline());
 
 	int32_t frameInFlightId = _frameId % FRAME_OVERLAP;
@@ -905,6 +1520,7 @@ void Render::Backend::TraceRays(const Render::Pass& pass, PushConstantsInfo* pPu
 		cmd.pushConstants(pass.GetPipelineLayout(), pushConstantsInfo.shaderStages, 0, pushConstantsInfo.size, pushConstantsInfo.pData);
 	}
 
+	ASSERT(pass.IsBuilt(), "The pipeline of the pass is not built, see Pass::RequirePipeline()");
 	cmd.bindPipeline(vk::PipelineBindPoint::eRayTracingKHR, pass.GetPipeline());
 
 	int32_t frameInFlightId = _frameId % FRAME_OVERLAP;
@@ -930,6 +1546,127 @@ void Render::Backend::TraceRays(const Render::Pass& pass, PushConstantsInfo* pPu
 }
 
 
+void Render::Backend::Dispatch(const Render::Pass& pass, uint32_t groupCountX, PushConstantsInfo* pPushConstantsInfo /* = nullptr */)
+{
+	vk::CommandBuffer cmd = GetCurrentCommandBuffer();
+
+	BindPassResources(cmd, pass, vk::PipelineBindPoint::eCompute, pPushConstantsInfo, false);
+
+	cmd.dispatch(groupCountX, 1, 1);
+}
+
+
+void Render::Backend::Dispatch(vk::CommandBuffer cmd, const Render::Pass& pass, const vk::Extent3D& groupCount,
+	const std::vector<vk::DescriptorSet>& extraSets, PushConstantsInfo* pPushConstantsInfo /* = nullptr */)
+{
+	BindPassResources(cmd, pass, vk::PipelineBindPoint::eCompute, pPushConstantsInfo, false);
+
+	if (!extraSets.empty())
+	{
+		const auto firstSet = static_cast<uint32_t>(_descMng.GetLayouts(pass._usedDescSets).size());
+
+		cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pass.GetPipelineLayout(), firstSet, extraSets, {});
+	}
+
+	cmd.dispatch(groupCount.width, groupCount.height, groupCount.depth);
+}
+
+
+void Render::Backend::DrawIndexedIndirect(const std::vector<IndirectDrawBatch>& batches, const Render::Buffer& commandBuffer,
+	const Render::Pass& pass, PushConstantsInfo* pPushConstantsInfo /* = nullptr */, bool useCamLightingBuffer /* = false */)
+{
+	if (pass._swapchainTargetId > -1)
+	{
+		ASSERT(pass._swapchainImageIsSet, "Please set current swapchain image before trying to render to it");
+	}
+
+	vk::CommandBuffer cmd = GetCurrentCommandBuffer();
+
+	cmd.beginRendering(pass._renderingInfo);
+
+	BindPassResources(cmd, pass, vk::PipelineBindPoint::eGraphics, pPushConstantsInfo, useCamLightingBuffer);
+
+	constexpr uint32_t commandStride = sizeof(vk::DrawIndexedIndirectCommand);
+
+	for (const auto& batch : batches)
+	{
+		if (batch.numCommands == 0)
+		{
+			continue;
+		}
+
+		vk::DeviceSize offset = 0;
+		cmd.bindVertexBuffers(0, batch.vertexBuffer, offset);
+		cmd.bindIndexBuffer(batch.indexBuffer, 0, batch.indexType);
+
+		cmd.drawIndexedIndirect(commandBuffer.GetHandle(), static_cast<vk::DeviceSize>(batch.firstCommand) * commandStride,
+			batch.numCommands, commandStride);
+	}
+
+	cmd.endRendering();
+}
+
+
+void Render::Backend::DrawMeshTasks(uint32_t groupCountX, const Render::Pass& pass, PushConstantsInfo* pPushConstantsInfo /* = nullptr */,
+	bool useCamLightingBuffer /* = false */)
+{
+	ASSERT(_meshShadersSupported, "Mesh shaders are not supported by the device");
+
+	if (pass._swapchainTargetId > -1)
+	{
+		ASSERT(pass._swapchainImageIsSet, "Please set current swapchain image before trying to render to it");
+	}
+
+	vk::CommandBuffer cmd = GetCurrentCommandBuffer();
+
+	cmd.beginRendering(pass._renderingInfo);
+
+	BindPassResources(cmd, pass, vk::PipelineBindPoint::eGraphics, pPushConstantsInfo, useCamLightingBuffer);
+
+	cmd.drawMeshTasksEXT(groupCountX, 1, 1);
+
+	cmd.endRendering();
+}
+
+
+void Render::Backend::BindPassResources(vk::CommandBuffer cmd, const Render::Pass& pass, vk::PipelineBindPoint bindPoint,
+	PushConstantsInfo* pPushConstantsInfo, bool useCamLightingBuffer)
+{
+	if (pPushConstantsInfo)
+	{
+		const PushConstantsInfo& pushConstantsInfo = *pPushConstantsInfo;
+
+		cmd.pushConstants(pass.GetPipelineLayout(), pushConstantsInfo.shaderStages, 0, pushConstantsInfo.size, pushConstantsInfo.pData);
+	}
+
+	ASSERT(pass.IsBuilt(), "The pipeline of the pass is not built, see Pass::RequirePipeline()");
+	cmd.bindPipeline(bindPoint, pass.GetPipeline());
+
+	// passes reading everything through buffer references have no descriptor sets
+	if (!pass._usedDescSets)
+	{
+		return;
+	}
+
+	int32_t frameInFlightId = _frameId % FRAME_OVERLAP;
+
+	auto pipelineDescriptorSets = _descMng.GetDescriptorSets(pass._usedDescSets, frameInFlightId);
+
+	if (useCamLightingBuffer)
+	{
+		// scene & camera dynamic descriptor offset
+		auto dynamicDescOffset = static_cast<uint32_t>(PadUniformBufferSize(sizeof(CameraDataGPU) +
+			sizeof(LightingData)) * frameInFlightId);
+
+		cmd.bindDescriptorSets(bindPoint, pass.GetPipelineLayout(), 0, pipelineDescriptorSets, dynamicDescOffset);
+	}
+	else
+	{
+		cmd.bindDescriptorSets(bindPoint, pass.GetPipelineLayout(), 0, pipelineDescriptorSets, {});
+	}
+}
+
+
 vk::CommandPool Render::Backend::CreateCommandPool(uint32_t queueFamilyIndex, vk::CommandPoolCreateFlags flags /* = {} */)
 {
 	vk::CommandPoolCreateInfo commandPoolInfo = {};
@@ -980,6 +1717,66 @@ void Render::Backend::SubmitCmdImmediately(std::function<void(vk::CommandBuffer
 }
 
 
+void Render::Backend::SubmitCmdAsync(std::function<void(vk::CommandBuffer cmd)>&& function, uint32_t contextId)
+{
+	UploadContext& context = _asyncUploadContexts[contextId];
+
+	WaitForAsyncUpload(contextId);
+
+	_device.resetFences(context._uploadFence);
+	_device.resetCommandPool(context._commandPool);
+
+	vk::CommandBufferBeginInfo cmdBeginInfo = vkinit::CmdBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+
+	context._commandBuffer.begin(cmdBeginInfo);
+
+	function(context._commandBuffer);
+
+	context._commandBuffer.end();
+
+	vk::SubmitInfo submitInfo = vkinit::CmdSubmitInfo(&context._commandBuffer);
+
+	_graphicsQueue.submit(submitInfo, context._uploadFence);
+}
+
+
+void Render::Backend::WaitForAsyncUpload(uint32_t contextId)
+{
+	ASSERT_VK(_device.waitForFences(_asyncUploadContexts[contextId]._uploadFence, true, 9999999999), "Timeout on uploadFence");
+}
+
+
+void Render::Backend::DestroyAfterFramesInFlight(std::function<void()>&& deleter)
+{
+	_frameDeleters.push_back({ _frameId, std::move(deleter) });
+}
+
+
+void Render::Backend::BindSparseMemory(const vk::BindSparseInfo& bindInfo)
+{
+	// waiting on the host orders the binding before all later submits
+	_graphicsQueue.bindSparse(bindInfo, _uploadContext._uploadFence);
+
+	ASSERT_VK(_device.waitForFences(_uploadContext._uploadFence, true, 9999999999), "Timeout on uploadFence");
+	_device.resetFences(_uploadContext._uploadFence);
+}
+
+
+void Render::Backend::BindSparseMemoryBeforeFrame(vk::BindSparseInfo bindInfo)
+{
+	FrameData& currentFrameData = GetCurrentFrameData();
+
+	ASSERT(!currentFrameData._isSparseBindPending, "Sparse memory is bound once per frame");
+
+	// queue operations don't wait for each other, the frame's submit waits for the semaphore instead of the host
+	bindInfo.setSignalSemaphores(currentFrameData._sparseBindSemaphore);
+
+	_graphicsQueue.bindSparse(bindInfo, {});
+
+	currentFrameData._isSparseBindPending = true;
+}
+
+
 void Render::Backend::InitSwapchain()
 {
 	vkb::SwapchainBuilder swapchainBuilder{ _chosenGPU, _device, _surface };
@@ -1016,6 +1813,40 @@ void Render::Backend::InitSwapchain()
 		}
 	});
 
+	_mainDeletionQueue.PushFunction([=]() {
+		_device.destroySwapchainKHR(_swapchain);
+	});
+
+	InitIntermediateImage();
+}
+
+
+void Render::Backend::InitOffscreenTargets()
+{
+	// the format the swapchain would most likely have, passes don't need to know the difference
+	_swapchainImageFormat = vk::Format::eB8G8R8A8Srgb;
+
+	Image::CreateInfo targetInfo;
+	targetInfo.aspectMask = vk::ImageAspectFlagBits::eColor;
+	targetInfo.extent = _windowExtent3D;
+	targetInfo.format = _swapchainImageFormat;
+	targetInfo.usageFlags = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst |
+		vk::ImageUsageFlagBits::eTransferSrc;
+
+	// one target per frame in flight, rendering into them is synchronized by the frame fences alone
+	_swapchainImages.resize(FRAME_OVERLAP);
+
+	for (auto& image : _swapchainImages)
+	{
+		image = CreateImage(targetInfo);
+	}
+
+	InitIntermediateImage();
+}
+
+
+void Render::Backend::InitIntermediateImage()
+{
 	Image::CreateInfo intermediateImageInfo;
 	intermediateImageInfo.aspectMask = vk::ImageAspectFlagBits::eColor;
 	intermediateImageInfo.extent = _windowExtent3D;
@@ -1024,10 +1855,6 @@ void Render::Backend::InitSwapchain()
 		vk::ImageUsageFlagBits::eTransferSrc;
 
 	_intermediateImage = CreateImage(intermediateImageInfo);
-
-	_mainDeletionQueue.PushFunction([=]() {
-		_device.destroySwapchainKHR(_swapchain);
-	});
 }
 
 
@@ -1036,6 +1863,12 @@ void Render::Backend::InitCommands()
 	_uploadContext._commandPool = CreateCommandPool(_graphicsQueueFamily);
 	_uploadContext._commandBuffer = CreateCommandBuffer(_uploadContext._commandPool);
 
+	for (auto& context : _asyncUploadContexts)
+	{
+		context._commandPool = CreateCommandPool(_graphicsQueueFamily);
+		context._commandBuffer = CreateCommandBuffer(context._commandPool);
+	}
+
 	for (int i = 0; i < FRAME_OVERLAP; ++i)
 	{
 		_frames[i]._commandPool = CreateCommandPool(_graphicsQueueFamily, vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
@@ -1058,6 +1891,15 @@ void Render::Backend::InitSyncStructures()
 	vk::FenceCreateInfo fenceCreateInfo = vkinit::FenceCreateInfo(vk::FenceCreateFlagBits::eSignaled);
 	vk::SemaphoreCreateInfo semaphoreCreateInfo = vkinit::SemaphoreCreateInfo();
 
+	for (auto& context : _asyncUploadContexts)
+	{
+		context._uploadFence = _device.createFence(fenceCreateInfo);
+
+		_mainDeletionQueue.PushFunction([=]() {
+			_device.destroyFence(context._uploadFence);
+		});
+	}
+
 	for (int i = 0; i < FRAME_OVERLAP; ++i)
 	{
 		_frames[i]._renderFence = _device.createFence(fenceCreateInfo);
@@ -1068,10 +1910,12 @@ void Render::Backend::InitSyncStructures()
 
 		_frames[i]._renderSemaphore = _device.createSemaphore(semaphoreCreateInfo);
 		_frames[i]._presentSemaphore = _device.createSemaphore(semaphoreCreateInfo);
+		_frames[i]._sparseBindSemaphore = _device.createSemaphore(semaphoreCreateInfo);
 
 		_mainDeletionQueue.PushFunction([=]() {
 			_device.destroySemaphore(_frames[i]._renderSemaphore);
 			_device.destroySemaphore(_frames[i]._presentSemaphore);
+			_device.destroySemaphore(_frames[i]._sparseBindSemaphore);
 		});
 	}
 }
@@ -1109,6 +1953,88 @@ void Render::Backend::InitSamplers()
 }
 
 
+void Render::Backend::InitPipelineCache()
+{
+	const PipelineCacheHeader deviceHeader = MakePipelineCacheHeader(_chosenGPU);
+
+	std::vector<uint8_t> cacheData;
+
+	std::error_code errorCode;
+	const uintmax_t fileSize = std::filesystem::file_size(PIPELINE_CACHE_PATH, errorCode);
+
+	std::ifstream file(PIPELINE_CACHE_PATH, std::ios::binary);
+	PipelineCacheHeader header;
+	if (!errorCode && file.read(reinterpret_cast<char*>(&header), sizeof(header)) && IsSamePipelineCacheDevice(header, deviceHeader) &&
+		header.dataSize == fileSize - sizeof(header))
+	{
+		cacheData.resize(header.dataSize);
+		if (!file.read(reinterpret_cast<char*>(cacheData.data()), cacheData.size()) ||
+			Plume::HashBytes(cacheData.data(), cacheData.size()) != header.dataHash)
+		{
+			cacheData.clear();
+		}
+	}
+
+	if (cacheData.empty())
+	{
+		std::cout << "No pipeline cache for this device and driver, pipelines are compiled from scratch" << std::endl;
+	}
+	else
+	{
+		std::cout << "Loaded pipeline cache of " << cacheData.size() / 1024 << " KB" << std::endl;
+	}
+
+	vk::PipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.initialDataSize = cacheData.size();
+	cacheInfo.pInitialData = cacheData.data();
+
+	_pipelineCache = _device.createPipelineCache(cacheInfo);
+}
+
+
+void Render::Backend::SavePipelineCache() const
+{
+	PipelineCacheHeader header = MakePipelineCacheHeader(_chosenGPU);
+
+	const std::vector<uint8_t> cacheData = _device.getPipelineCacheData(_pipelineCache);
+	header.dataSize = cacheData.size();
+	header.dataHash = Plume::HashBytes(cacheData.data(), cacheData.size());
+
+	std::vector<uint8_t> blob(sizeof(header) + cacheData.size());
+	std::memcpy(blob.data(), &header, sizeof(header));
+	std::memcpy(blob.data() + sizeof(header), cacheData.data(), cacheData.size());
+
+	if (!Plume::WriteFileAtomically(PIPELINE_CACHE_PATH, blob))
+	{
+		std::cout << "Failed to write pipeline cache " << PIPELINE_CACHE_PATH << std::endl;
+	}
+}
+
+
+vk::Pipeline Render::Backend::FindRTPipelineLibrary(const std::string& key)
+{
+	std::lock_guard<std::mutex> lock(_rtPipelineLibraryMutex);
+
+	auto it = _rtPipelineLibraries.find(key);
+
+	return (it != _rtPipelineLibraries.end()) ? it->second : vk::Pipeline{};
+}
+
+
+vk::Pipeline Render::Backend::AddRTPipelineLibrary(const std::string& key, vk::Pipeline library)
+{
+	std::lock_guard<std::mutex> lock(_rtPipelineLibraryMutex);
+
+	auto [it, isAdded] = _rtPipelineLibraries.emplace(key, library);
+	if (!isAdded)
+	{
+		_device.destroyPipeline(library);
+	}
+
+	return it->second;
+}
+
+
 void Render::Backend::InitImGui()
 {
 	vk::DescriptorPoolSize poolSizes[] = { { vk::DescriptorType::eSampler, 1000 },
@@ -1142,6 +2068,7 @@ void Render::Backend::InitImGui()
 	initInfo.Device = _device;
 	initInfo.Queue = _graphicsQueue;
 	initInfo.DescriptorPool = imguiPool;
+	initInfo.PipelineCache = _pipelineCache;
 	initInfo.MinImageCount = FRAME_OVERLAP;
 	initInfo.ImageCount = FRAME_OVERLAP;
 	initInfo.UseDynamicRendering = true;
@@ -1167,87 +2094,101 @@ void Render::Backend::InitImGui()
 void Render::Pass::BuildShaderBindingTable()
 {
 	// TODO: make SBT more flexible -- currently it only supports one (very specific) set of shader regions.
-	//       Tie it to RT pipeline initialization.
 
 	auto* backend = Render::Backend::AcquireInstance();
 
-	uint32_t rmissCount = 2;
-	uint32_t rchitCount = 1;
-	uint32_t handleCount = 1 + rmissCount + rchitCount;
 	uint32_t handleSize = backend->_rtProperties.shaderGroupHandleSize;
 
-	vk::DeviceSize alignedHandleSize = AlignUp(handleSize, backend->_rtProperties.shaderGroupHandleAlignment);
-
-	_rtSbt._rgenRegion.stride = AlignUp(alignedHandleSize, backend->_rtProperties.shaderGroupBaseAlignment);
-	_rtSbt._rgenRegion.size = _rtSbt._rgenRegion.stride; // for raygen size == stride
-	_rtSbt._rmissRegion.stride = alignedHandleSize;
-	_rtSbt._rmissRegion.size = AlignUp(rmissCount * alignedHandleSize, backend->_rtProperties.shaderGroupBaseAlignment);
-	_rtSbt._rchitRegion.stride = alignedHandleSize;
-	_rtSbt._rchitRegion.size = AlignUp(rchitCount * alignedHandleSize, backend->_rtProperties.shaderGroupBaseAlignment);
-
 	const auto& device = *backend->GetPDevice();
 
 	// get shader group handles
-	uint32_t dataSize = handleCount * handleSize;
+	uint32_t dataSize = SBT_HANDLE_COUNT * handleSize;
 	std::vector<uint8_t> handles(dataSize);
-	ASSERT_VK(device.getRayTracingShaderGroupHandlesKHR(_pso._pipeline, 0, handleCount, dataSize, handles.data()), "Failed to get shader group handles");
+	ASSERT_VK(device.getRayTracingShaderGroupHandlesKHR(_pso._pipeline, 0, SBT_HANDLE_COUNT, dataSize, handles.data()), "Failed to get shader group handles");
 
-	vk::DeviceSize sbtSize = _rtSbt._rgenRegion.size + _rtSbt._rmissRegion.size + _rtSbt._rchitRegion.size + _rtSbt._rcallRegion.size;
-
-	Render::Buffer::CreateInfo sbtBufferInfo = {};
-	sbtBufferInfo.allocSize = sbtSize;
-	sbtBufferInfo.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst |
-		vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eShaderBindingTableKHR;
-	sbtBufferInfo.memUsage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	if (!_rtSbt._buffer.GetHandle())
+	{
+		vk::DeviceSize alignedHandleSize = AlignUp(handleSize, backend->_rtProperties.shaderGroupHandleAlignment);
+
+		_rtSbt._rgenRegion.stride = AlignUp(alignedHandleSize, backend->_rtProperties.shaderGroupBaseAlignment);
+		_rtSbt._rgenRegion.size = _rtSbt._rgenRegion.stride; // for raygen size == stride
+		_rtSbt._rmissRegion.stride = alignedHandleSize;
+		_rtSbt._rmissRegion.size = AlignUp(SBT_MISS_COUNT * alignedHandleSize, backend->_rtProperties.shaderGroupBaseAlignment);
+		_rtSbt._rchitRegion.stride = alignedHandleSize;
+		_rtSbt._rchitRegion.size = AlignUp(SBT_HIT_COUNT * alignedHandleSize, backend->_rtProperties.shaderGroupBaseAlignment);
+
+		vk::DeviceSize sbtSize = _rtSbt._rgenRegion.size + _rtSbt._rmissRegion.size + _rtSbt._rchitRegion.size + _rtSbt._rcallRegion.size;
+
+		// records are written in place when the pipeline is relinked
+		Render::Buffer::CreateInfo sbtBufferInfo = {};
+		sbtBufferInfo.allocSize = sbtSize;
+		sbtBufferInfo.usage = vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst |
+			vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eShaderBindingTableKHR;
+		sbtBufferInfo.memUsage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+		sbtBufferInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		_rtSbt._buffer = backend->CreateBuffer(sbtBufferInfo);
+		std::memset(_rtSbt._buffer.GetMappedData(), 0, sbtSize);
+
+		// find shader group device addresses
+		vk::DeviceAddress sbtAddress = _rtSbt._buffer.GetDeviceAddress();
+		_rtSbt._rgenRegion.deviceAddress = sbtAddress;
+		_rtSbt._rmissRegion.deviceAddress = sbtAddress + _rtSbt._rgenRegion.size;
+		_rtSbt._rchitRegion.deviceAddress = sbtAddress + _rtSbt._rgenRegion.size + _rtSbt._rmissRegion.size;
+
+		_rtGroupHandles.clear();
+	}
 
-	_rtSbt._buffer = backend->CreateBuffer(sbtBufferInfo);
+	// record offsets of the groups, in the order of the handles
+	std::array<vk::DeviceSize, SBT_HANDLE_COUNT> recordOffsets;
+	uint32_t handleIndex = 0;
 
-	// find shader group device addresses
-	vk::BufferDeviceAddressInfo addressInfo;
-	addressInfo.buffer = _rtSbt._buffer.GetHandle();
-	vk::DeviceAddress sbtAddress = device.getBufferAddress(addressInfo);
-	_rtSbt._rgenRegion.deviceAddress = sbtAddress;
-	_rtSbt._rmissRegion.deviceAddress = sbtAddress + _rtSbt._rgenRegion.size;
-	_rtSbt._rchitRegion.deviceAddress = sbtAddress + _rtSbt._rgenRegion.size + _rtSbt._rmissRegion.size;
+	recordOffsets[handleIndex++] = 0;
 
-	// helper lambda to retrieve ith handle data
-	auto getHandle = [&](int i) {
-		return handles.data() + i * handleSize;
-	};
+	for (uint32_t c = 0; c < SBT_MISS_COUNT; ++c)
+	{
+		recordOffsets[handleIndex++] = _rtSbt._rgenRegion.size + c * _rtSbt._rmissRegion.stride;
+	}
 
-	// upload the SBT
-	std::vector<uint8_t> sbtBufferRaw(sbtSize);
-	uint8_t* pData = sbtBufferRaw.data();
-	uint32_t handleIndex = 0;
+	for (uint32_t c = 0; c < SBT_HIT_COUNT; ++c)
+	{
+		recordOffsets[handleIndex++] = _rtSbt._rgenRegion.size + _rtSbt._rmissRegion.size + c * _rtSbt._rchitRegion.stride;
+	}
 
-	// copy raygen region
-	std::memcpy(pData, getHandle(handleIndex++), handleSize);
+	// groups of libraries that weren't rebuilt usually keep their handles in the relinked pipeline, so only the records
+	// of changed handles are written
+	auto* pSbtData = static_cast<uint8_t*>(_rtSbt._buffer.GetMappedData());
+	uint32_t numWrittenRecords = 0;
 
-	// copy miss region
-	pData = sbtBufferRaw.data() + _rtSbt._rgenRegion.size;
-	for (uint32_t c = 0; c < rmissCount; ++c)
+	for (uint32_t i = 0; i < SBT_HANDLE_COUNT; ++i)
 	{
-		std::memcpy(pData, getHandle(handleIndex++), handleSize);
-		pData += _rtSbt._rmissRegion.stride;
+		const uint8_t* pHandle = handles.data() + i * handleSize;
+
+		if (!_rtGroupHandles.empty() && std::memcmp(_rtGroupHandles.data() + i * handleSize, pHandle, handleSize) == 0)
+		{
+			continue;
+		}
+
+		std::memcpy(pSbtData + recordOffsets[i], pHandle, handleSize);
+		++numWrittenRecords;
 	}
 
-	// copy hit region
-	pData = sbtBufferRaw.data() + _rtSbt._rgenRegion.size + _rtSbt._rmissRegion.size;
-	for (uint32_t c = 0; c < rchitCount; ++c)
+	// no-op for host-coherent memory
+	if (numWrittenRecords > 0)
 	{
-		std::memcpy(pData, getHandle(handleIndex++), handleSize);
-		pData += _rtSbt._rchitRegion.stride;
+		vmaFlushAllocation(backend->_allocator, _rtSbt._buffer.GetAllocation(), 0, VK_WHOLE_SIZE);
 	}
 
-	backend->UploadBufferImmediately(_rtSbt._buffer, sbtBufferRaw);
+	_rtGroupHandles = std::move(handles);
 }
 
 
-void Render::Pass::BuildPipeline()
+void Render::Pass::StartBuild(BuildMode buildMode)
 {
 	auto* backend = Render::Backend::AcquireInstance();
 
 	auto setLayouts = backend->GetPDescriptorManager()->GetLayouts(_usedDescSets);
+	setLayouts.insert(setLayouts.end(), _extraSetLayouts.begin(), _extraSetLayouts.end());
 
 	vk::PipelineLayoutCreateInfo pipelineLayoutInfo = vkinit::PipelineLayoutInfo();
 	pipelineLayoutInfo.setSetLayouts(setLayouts);
@@ -1261,10 +2202,101 @@ void Render::Pass::BuildPipeline()
 	vk::PipelineLayout pipelineLayout = device.createPipelineLayout(pipelineLayoutInfo);
 	_pso._pipelineLayout = pipelineLayout;
 
-	backend->_mainDeletionQueue.PushFunction([=](){
+	backend->_mainDeletionQueue.PushFunction([=]() {
 		device.destroyPipelineLayout(pipelineLayout);
 	});
 
+	auto build = [this]() {
+		PLM_TRACE_ZONE("BuildPipeline");
+
+		LoadShaders();
+
+		switch (_bindPoint)
+		{
+		case vk::PipelineBindPoint::eGraphics:
+			BuildPipeline();
+			break;
+		case vk::PipelineBindPoint::eCompute:
+			BuildComputePipeline();
+			break;
+		case vk::PipelineBindPoint::eRayTracingKHR:
+			BuildRTPipeline();
+			break;
+		default:
+			ASSERT(false, "Unsupported pipeline bind point");
+		}
+	};
+
+	_buildMode = buildMode;
+
+	switch (buildMode)
+	{
+	case BuildMode::eImmediate:
+		build();
+		FinishBuild();
+		break;
+	case BuildMode::eAsync:
+		_buildFuture = Plume::ThreadPool::AcquireInstance()->Submit(build).share();
+		break;
+	case BuildMode::eLazy:
+		// deferred futures run on the first wait, which RequirePipeline() does on the main thread
+		_buildFuture = std::async(std::launch::deferred, build).share();
+		break;
+	}
+}
+
+
+void Render::Pass::RequirePipeline()
+{
+	if (_pso.IsBuilt())
+	{
+		return;
+	}
+
+	ASSERT(_buildFuture.valid(), "The pass is not initialized");
+
+	// rethrows what the build has thrown
+	_buildFuture.get();
+
+	FinishBuild();
+}
+
+
+void Render::Pass::LoadShaders()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	if (_bindPoint == vk::PipelineBindPoint::eRayTracingKHR)
+	{
+		// pipeline libraries load the shaders of their group themselves
+		if (backend->AreRTPipelineLibrariesSupported())
+		{
+			return;
+		}
+
+		auto shaderStages = MakeRTShaderStages(&_shaderNames);
+		_shaderStages.assign(shaderStages.begin(), shaderStages.end());
+
+		return;
+	}
+
+	size_t numShaderStages = _shaderNames.size();
+
+	_shaders.resize(numShaderStages);
+	_shaderStages.resize(numShaderStages);
+
+	for (int32_t i = 0; i < numShaderStages; ++i)
+	{
+		_shaders[i].Create(backend->GetPDevice(), _shaderNames[i]);
+		_shaderStages[i] = _shaders[i].GetStageCreateInfo();
+	}
+}
+
+
+void Render::Pass::BuildPipeline()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
 	vk::PipelineViewportStateCreateInfo viewportState = {};
 	viewportState.viewportCount = 1;
 	viewportState.pViewports = &_viewport;
@@ -1289,58 +2321,242 @@ void Render::Pass::BuildPipeline()
 	pipelineInfo.pNext = &_pipelineRenderingCreateInfo;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	auto pipelineResVal = backend->GetPDevice()->createGraphicsPipelines({}, pipelineInfo);
+	auto pipelineResVal = backend->GetPDevice()->createGraphicsPipelines(backend->GetPipelineCache(), pipelineInfo);
 	ASSERT(pipelineResVal.result == vk::Result::eSuccess, "Failed to create pipeline");
 
 	_pso._pipeline = pipelineResVal.value[0];
+}
 
-	// shader modules are now built into the pipelines, we don't need them anymore
-	for (auto& shader : _shaders)
+
+void Render::Pass::BuildComputePipeline()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	ASSERT(_shaderStages.size() == 1, "Compute pipelines consist of a single shader stage");
+
+	vk::ComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.stage = _shaderStages[0];
+	pipelineInfo.layout = _pso._pipelineLayout;
+
+	auto pipelineResVal = backend->GetPDevice()->createComputePipeline(backend->GetPipelineCache(), pipelineInfo);
+	ASSERT(pipelineResVal.result == vk::Result::eSuccess, "Failed to create compute pipeline");
+
+	_pso._pipeline = pipelineResVal.value;
+}
+
+
+void Render::Pass::BuildRTPipeline()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	if (backend->AreRTPipelineLibrariesSupported())
 	{
-		shader.Destroy();
+		for (size_t i = 0; i < RT_PIPELINE_LIBRARY_COUNT; ++i)
+		{
+			_rtPipelineLibraries[i] = AcquireRTPipelineLibrary(static_cast<RTShaderGroup>(i));
+		}
+
+		LinkRTPipeline();
+		return;
 	}
 
-	backend->_mainDeletionQueue.PushFunction([=]() {
-		device.destroyPipeline(pipelineResVal.value[0]);
-	});
+	auto shaderGroups = MakeRTShaderGroups();
+
+	vk::RayTracingPipelineCreateInfoKHR rtPipelineInfo;
+	rtPipelineInfo.setStages(_shaderStages);
+	rtPipelineInfo.setGroups(shaderGroups);
+	rtPipelineInfo.maxPipelineRayRecursionDepth = 1;
+	rtPipelineInfo.layout = _pso._pipelineLayout;
+
+	auto rtPipelineResVal = backend->GetPDevice()->createRayTracingPipelineKHR({}, backend->GetPipelineCache(), rtPipelineInfo);
+
+	ASSERT(rtPipelineResVal.result == vk::Result::eSuccess, "Failed to build RT pipeline");
+	_pso._pipeline = rtPipelineResVal.value;
 }
 
 
-void Render::Pass::BuildRTPipeline(const std::array<vk::PipelineShaderStageCreateInfo, Render::Pass::RAY_TRACING_SHADER_GROUP_COUNT>& shaderStages)
+Render::Pass::RTShaderGroup Render::Pass::GetRTShaderGroup(const std::string& shaderName)
+{
+	switch (Shader::GetRTShaderIndexFromFileName(shaderName))
+	{
+	case Shader::RTStageIndices::eRaygen:
+		return RTShaderGroup::eRaygen;
+	case Shader::RTStageIndices::eMiss:
+		return RTShaderGroup::eMiss;
+	case Shader::RTStageIndices::eShadowMiss:
+		return RTShaderGroup::eShadowMiss;
+	default:
+		return RTShaderGroup::eHit;
+	}
+}
+
+
+std::string Render::Pass::MakeRTPipelineLibraryKey(RTShaderGroup group) const
+{
+	// libraries are only linked into pipelines with a compatible layout
+	std::string key = "sets:" + std::to_string(_usedDescSets) + "|pc:" + std::to_string(_pushConstantRange.size) + ':' +
+		std::to_string(static_cast<uint32_t>(_pushConstantRange.stageFlags));
+
+	for (const auto& shaderName : _shaderNames)
+	{
+		if (GetRTShaderGroup(shaderName) == group)
+		{
+			key += '|' + shaderName;
+		}
+	}
+
+	return key;
+}
+
+
+vk::Pipeline Render::Pass::AcquireRTPipelineLibrary(RTShaderGroup group)
 {
 	auto* backend = Render::Backend::AcquireInstance();
 
-	auto setLayouts = backend->GetPDescriptorManager()->GetLayouts(_usedDescSets);
+	const std::string key = MakeRTPipelineLibraryKey(group);
+
+	vk::Pipeline library = backend->FindRTPipelineLibrary(key);
+	if (library)
+	{
+		return library;
+	}
 
-	vk::PipelineLayoutCreateInfo rtPipelineLayoutInfo = vkinit::PipelineLayoutInfo();
-	rtPipelineLayoutInfo.setSetLayouts(setLayouts);
+	std::vector<Render::Shader> shaders;
+	std::vector<vk::PipelineShaderStageCreateInfo> stages;
 
-	if (_pushConstantRange.size > 0)
+	vk::RayTracingShaderGroupCreateInfoKHR shaderGroupInfo;
+	shaderGroupInfo.type = (group == RTShaderGroup::eHit) ? vk::RayTracingShaderGroupTypeKHR::eTrianglesHitGroup :
+		vk::RayTracingShaderGroupTypeKHR::eGeneral;
+	shaderGroupInfo.anyHitShader = VK_SHADER_UNUSED_KHR;
+	shaderGroupInfo.closestHitShader = VK_SHADER_UNUSED_KHR;
+	shaderGroupInfo.generalShader = VK_SHADER_UNUSED_KHR;
+	shaderGroupInfo.intersectionShader = VK_SHADER_UNUSED_KHR;
+
+	for (const auto& shaderName : _shaderNames)
 	{
-		rtPipelineLayoutInfo.setPushConstantRanges(_pushConstantRange);
+		if (GetRTShaderGroup(shaderName) != group)
+		{
+			continue;
+		}
+
+		const auto stageIndex = static_cast<uint32_t>(stages.size());
+
+		switch (Shader::GetRTShaderIndexFromFileName(shaderName))
+		{
+		case Shader::RTStageIndices::eClosestHit:
+			shaderGroupInfo.closestHitShader = stageIndex;
+			break;
+		case Shader::RTStageIndices::eAnyHit:
+			shaderGroupInfo.anyHitShader = stageIndex;
+			break;
+		default:
+			shaderGroupInfo.generalShader = stageIndex;
+		}
+
+		Render::Shader& shader = shaders.emplace_back();
+		shader.Create(backend->GetPDevice(), shaderName);
+		stages.push_back(shader.GetStageCreateInfo());
 	}
 
-	vk::Device& device = *backend->GetPDevice();
-	vk::PipelineLayout pipelineLayout = device.createPipelineLayout(rtPipelineLayoutInfo);
+	ASSERT(!stages.empty(), "Every ray tracing shader group needs a shader");
 
-	_pso._pipelineLayout = pipelineLayout;
+	vk::RayTracingPipelineInterfaceCreateInfoKHR libraryInterface;
+	libraryInterface.maxPipelineRayPayloadSize = RT_MAX_RAY_PAYLOAD_SIZE;
+	libraryInterface.maxPipelineRayHitAttributeSize = RT_MAX_HIT_ATTRIBUTE_SIZE;
 
-	backend->_mainDeletionQueue.PushFunction([=]() {
-		device.destroyPipelineLayout(pipelineLayout);
-	});
+	vk::RayTracingPipelineCreateInfoKHR libraryInfo;
+	libraryInfo.flags = vk::PipelineCreateFlagBits::eLibraryKHR;
+	libraryInfo.setStages(stages);
+	libraryInfo.setGroups(shaderGroupInfo);
+	libraryInfo.maxPipelineRayRecursionDepth = 1;
+	libraryInfo.pLibraryInterface = &libraryInterface;
+	libraryInfo.layout = _pso._pipelineLayout;
 
-	auto shaderGroups = MakeRTShaderGroups();
+	auto libraryResVal = backend->GetPDevice()->createRayTracingPipelineKHR({}, backend->GetPipelineCache(), libraryInfo);
+	ASSERT(libraryResVal.result == vk::Result::eSuccess, "Failed to build RT pipeline library");
+
+	for (auto& shader : shaders)
+	{
+		shader.Destroy();
+	}
+
+	return backend->AddRTPipelineLibrary(key, libraryResVal.value);
+}
+
+
+void Render::Pass::LinkRTPipeline()
+{
+	auto* backend = Render::Backend::AcquireInstance();
 
+	vk::PipelineLibraryCreateInfoKHR libraryInfo;
+	libraryInfo.setLibraries(_rtPipelineLibraries);
+
+	vk::RayTracingPipelineInterfaceCreateInfoKHR libraryInterface;
+	libraryInterface.maxPipelineRayPayloadSize = RT_MAX_RAY_PAYLOAD_SIZE;
+	libraryInterface.maxPipelineRayHitAttributeSize = RT_MAX_HIT_ATTRIBUTE_SIZE;
+
+	// the groups of the libraries follow each other in library order, which is the SBT order
 	vk::RayTracingPipelineCreateInfoKHR rtPipelineInfo;
-	rtPipelineInfo.setStages(shaderStages);
-	rtPipelineInfo.setGroups(shaderGroups);
+	rtPipelineInfo.pLibraryInfo = &libraryInfo;
+	rtPipelineInfo.pLibraryInterface = &libraryInterface;
 	rtPipelineInfo.maxPipelineRayRecursionDepth = 1;
-	rtPipelineInfo.layout = pipelineLayout;
+	rtPipelineInfo.layout = _pso._pipelineLayout;
 
-	auto rtPipelineResVal = backend->GetPDevice()->createRayTracingPipelineKHR({}, {}, rtPipelineInfo);
+	auto rtPipelineResVal = backend->GetPDevice()->createRayTracingPipelineKHR({}, backend->GetPipelineCache(), rtPipelineInfo);
 
-	ASSERT(rtPipelineResVal.result == vk::Result::eSuccess, "Failed to build RT pipeline");
+	ASSERT(rtPipelineResVal.result == vk::Result::eSuccess, "Failed to link RT pipeline");
 	_pso._pipeline = rtPipelineResVal.value;
+}
+
+
+void Render::Pass::SetRTShaderGroup(RTShaderGroup group, const std::vector<std::string>& shaderNames)
+{
+	ASSERT(_bindPoint == vk::PipelineBindPoint::eRayTracingKHR, "Only ray tracing passes have shader groups");
+
+	RequirePipeline();
+
+	_shaderNames.erase(std::remove_if(_shaderNames.begin(), _shaderNames.end(), [group](const std::string& shaderName) {
+		return GetRTShaderGroup(shaderName) == group;
+	}), _shaderNames.end());
+
+	for (const auto& shaderName : shaderNames)
+	{
+		ASSERT(GetRTShaderGroup(shaderName) == group, "Shader " << shaderName << " doesn't belong to the group");
+		_shaderNames.push_back(shaderName);
+	}
+
+	auto* backend = Render::Backend::AcquireInstance();
+
+	// the SBT is changed in place
+	backend->GetPDevice()->waitIdle();
+
+	vk::Device& device = *backend->GetPDevice();
+	const vk::Pipeline prevPipeline = _pso._pipeline;
+
+	if (backend->AreRTPipelineLibrariesSupported())
+	{
+		_rtPipelineLibraries[static_cast<size_t>(group)] = AcquireRTPipelineLibrary(group);
+
+		LinkRTPipeline();
+	}
+	else
+	{
+		LoadShaders();
+		BuildRTPipeline();
+	}
+
+	// the frame being recorded may have bound the previous pipeline already
+	backend->DestroyAfterFramesInFlight([=]() {
+		device.destroyPipeline(prevPipeline);
+	});
+
+	FinishBuild();
+}
+
+
+void Render::Pass::FinishBuild()
+{
+	auto* backend = Render::Backend::AcquireInstance();
 
 	// shader modules are now built into the pipelines, we don't need them anymore
 	for (auto& shader : _shaders)
@@ -1348,11 +2564,23 @@ void Render::Pass::BuildRTPipeline(const std::array<vk::PipelineShaderStageCreat
 		shader.Destroy();
 	}
 
-	backend->_mainDeletionQueue.PushFunction([=]() {
-		device.destroyPipeline(rtPipelineResVal.value);
-	});
+	_shaders.clear();
+	_shaderStages.clear();
 
-	BuildShaderBindingTable();
+	// relinked pipelines replace the one destroyed here, passes outlive the backend termination
+	if (!_pso._isBuilt)
+	{
+		backend->_mainDeletionQueue.PushFunction([this]() {
+			Render::Backend::AcquireInstance()->GetPDevice()->destroyPipeline(_pso._pipeline);
+		});
+	}
+
+	if (_bindPoint == vk::PipelineBindPoint::eRayTracingKHR)
+	{
+		BuildShaderBindingTable();
+	}
+
+	_pso._isBuilt = true;
 }
 
 
@@ -1361,11 +2589,43 @@ void Render::VertexInputDescription::ConstructFromVertex()
 	// 1 vertex buffer binding, per-vertex rate
 	vk::VertexInputBindingDescription mainBinding = {};
 	mainBinding.binding = 0;
-	mainBinding.stride = sizeof(Vertex);
+	mainBinding.stride = sizeof(GPUVertex);
 	mainBinding.inputRate = vk::VertexInputRate::eVertex;
 
 	this->bindings.push_back(mainBinding);
 
+#if USE_COMPACT_VERTICES
+	// the formats below make the hardware do the snorm/half conversion, the shaders decode the rest
+	// exactly like ray tracing shaders do for vertices fetched through buffer references
+
+	// position relative to the mesh bounds at location 0, w is unused
+	vk::VertexInputAttributeDescription positionAttribute = {};
+	positionAttribute.binding = 0;
+	positionAttribute.location = 0;
+	positionAttribute.format = vk::Format::eR16G16B16A16Snorm;
+	positionAttribute.offset = offsetof(CompactVertex, positionXY);
+
+	// octahedral normals at location 1
+	vk::VertexInputAttributeDescription normalAttribute = {};
+	normalAttribute.binding = 0;
+	normalAttribute.location = 1;
+	normalAttribute.format = vk::Format::eR16G16Snorm;
+	normalAttribute.offset = offsetof(CompactVertex, normal);
+
+	// UV at location 2
+	vk::VertexInputAttributeDescription uvAttribute = {};
+	uvAttribute.binding = 0;
+	uvAttribute.location = 2;
+	uvAttribute.format = vk::Format::eR16G16Sfloat;
+	uvAttribute.offset = offsetof(CompactVertex, uv);
+
+	// octahedral tangents at location 3
+	vk::VertexInputAttributeDescription tangentAttribute = {};
+	tangentAttribute.binding = 0;
+	tangentAttribute.location = 3;
+	tangentAttribute.format = vk::Format::eR16G16Snorm;
+	tangentAttribute.offset = offsetof(CompactVertex, tangent);
+#else
 	// store position at location 0
 	vk::VertexInputAttributeDescription positionAttribute = {};
 	positionAttribute.binding = 0;
@@ -1380,30 +2640,23 @@ void Render::VertexInputDescription::ConstructFromVertex()
 	normalAttribute.format = vk::Format::eR32G32B32Sfloat;
 	normalAttribute.offset = offsetof(Vertex, normal);
 
-	// colors at location 2
-	vk::VertexInputAttributeDescription colorAttribute = {};
-	colorAttribute.binding = 0;
-	colorAttribute.location = 2;
-	colorAttribute.format = vk::Format::eR32G32B32Sfloat;
-	colorAttribute.offset = offsetof(Vertex, color);
-
-	// UV at location 3
+	// UV at location 2
 	vk::VertexInputAttributeDescription uvAttribute = {};
 	uvAttribute.binding = 0;
-	uvAttribute.location = 3;
+	uvAttribute.location = 2;
 	uvAttribute.format = vk::Format::eR32G32Sfloat;
 	uvAttribute.offset = offsetof(Vertex, uv);
 
-	// tangents at location 4
+	// tangents at location 3
 	vk::VertexInputAttributeDescription tangentAttribute = {};
 	tangentAttribute.binding = 0;
-	tangentAttribute.location = 4;
+	tangentAttribute.location = 3;
 	tangentAttribute.format = vk::Format::eR32G32B32Sfloat;
 	tangentAttribute.offset = offsetof(Vertex, tangent);
+#endif
 
 	this->attributes.push_back(positionAttribute);
 	this->attributes.push_back(normalAttribute);
-	this->attributes.push_back(colorAttribute);
 	this->attributes.push_back(uvAttribute);
 	this->attributes.push_back(tangentAttribute);
 }
@@ -1491,7 +2744,7 @@ void Render::Pass::Init(const InitInfo& initInfo)
 
 	// Color attachment handling
 
-	std::vector<vk::Format> colorAttachmentFormats(numColorAttachments);
+	_colorAttachmentFormats.resize(numColorAttachments);
 
 	_colorRenderingAttachmentInfos.resize(numColorAttachments);
 
@@ -1502,14 +2755,14 @@ void Render::Pass::Init(const InitInfo& initInfo)
 
 		if (attachmentInfos[i].isSwapchainImage)
 		{
-			colorAttachmentFormats[i] = backend->_swapchainImageFormat;
+			_colorAttachmentFormats[i] = backend->_swapchainImageFormat;
 			_colorRenderingAttachmentInfos[i].imageView = VK_NULL_HANDLE;
 			_swapchainTargetId = i;
 			_swapchainImageIsSet = false;
 		}
 		else
 		{
-			colorAttachmentFormats[i] = attachmentInfos[i].pImage->GetFormat();
+			_colorAttachmentFormats[i] = attachmentInfos[i].pImage->GetFormat();
 			_colorRenderingAttachmentInfos[i].imageView = attachmentInfos[i].pImage->GetView();
 		}
 
@@ -1522,7 +2775,7 @@ void Render::Pass::Init(const InitInfo& initInfo)
 		_colorRenderingAttachmentInfos[i].clearValue = clearValue;
 	}
 
-	_pipelineRenderingCreateInfo.setColorAttachmentFormats(colorAttachmentFormats);
+	_pipelineRenderingCreateInfo.setColorAttachmentFormats(_colorAttachmentFormats);
 
 	// Depth attachment handling
 
@@ -1544,24 +2797,14 @@ void Render::Pass::Init(const InitInfo& initInfo)
 	MakeDepthStencilState(initInfo.bDepthTest, initInfo.bDepthWrite, initInfo.compareOp);
 
 	ASSERT(initInfo.pShaderNames, "Invalid shader stage names");
-	size_t numShaderStages = initInfo.pShaderNames->size();
-
-	_shaders.resize(numShaderStages);
-	_shaderStages.resize(numShaderStages);
-
-	const auto& shaderFileNames = *initInfo.pShaderNames;
-
-	for (int32_t i = 0; i < numShaderStages; ++i)
-	{
-		_shaders[i].Create(backend->GetPDevice(), shaderFileNames[i]);
-		_shaderStages[i] = _shaders[i].GetStageCreateInfo();
-	}
+	_shaderNames = *initInfo.pShaderNames;
 
 	_pushConstantRange.offset = 0;
 	_pushConstantRange.size = initInfo.pcInitInfo.pcBufferSize;
 	_pushConstantRange.stageFlags = initInfo.pcInitInfo.stageFlags;
 
-	BuildPipeline();
+	_bindPoint = vk::PipelineBindPoint::eGraphics;
+	StartBuild(initInfo.buildMode);
 
 	if (_swapchainTargetId < 0)
 	{
@@ -1585,15 +2828,33 @@ void Render::Pass::SetSwapchainImage(Image& curSwapchainImage)
 
 void Render::Pass::InitRT(const RTInitInfo& initInfo)
 {
-	std::array<vk::PipelineShaderStageCreateInfo, Render::Pass::RAY_TRACING_SHADER_GROUP_COUNT> shaderStages = MakeRTShaderStages(initInfo.pShaderNames);
+	ASSERT(initInfo.pShaderNames, "Invalid shader names");
+	_shaderNames = *initInfo.pShaderNames;
+
+	_usedDescSets = initInfo.usedDescSets;
+
+	_pushConstantRange.offset = 0;
+	_pushConstantRange.size = initInfo.pcInitInfo.pcBufferSize;
+	_pushConstantRange.stageFlags = initInfo.pcInitInfo.stageFlags;
+
+	_bindPoint = vk::PipelineBindPoint::eRayTracingKHR;
+	StartBuild(initInfo.buildMode);
+}
 
+
+void Render::Pass::InitCompute(const ComputeInitInfo& initInfo)
+{
 	_usedDescSets = initInfo.usedDescSets;
+	_extraSetLayouts = initInfo.extraSetLayouts;
+
+	_shaderNames = { initInfo.shaderName };
 
 	_pushConstantRange.offset = 0;
 	_pushConstantRange.size = initInfo.pcInitInfo.pcBufferSize;
 	_pushConstantRange.stageFlags = initInfo.pcInitInfo.stageFlags;
 
-	BuildRTPipeline(shaderStages);
+	_bindPoint = vk::PipelineBindPoint::eCompute;
+	StartBuild(initInfo.buildMode);
 }
 
 
@@ -5,9 +5,14 @@
 #include "render_descriptors.h"
 #include "render_shader.h"
 #include "render_cfg.h"
+#include "render_free_list.h"
+#include "render_gpu_profiler.h"
 #include "../engine/plm_scene.h"
+#include <future>
+#include <mutex>
 #include <thread>
 #include <memory>
+#include <unordered_map>
 
 #include <SDL.h>
 #include <SDL_vulkan.h>
@@ -39,11 +44,19 @@ public:
 		Type type = Type::eTexture;
 		vk::ImageAspectFlags aspectMask = vk::ImageAspectFlagBits::eColor;
 		VmaMemoryUsage memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+		vk::ComponentMapping components = {};
+		bool isLifetimeManaged = true;
+		// created without memory, the owner binds memory to its mips with Backend::BindSparseMemory()
+		bool isSparse = false;
+		// views may use other compatible formats, e.g. UNORM storage views of sRGB images
+		bool isMutableFormat = false;
 	};
 
 	vk::Image GetHandle() const { return _handle; }
 	vk::ImageView GetView() const { return _view; }
 	vk::Format GetFormat() const { return _format; }
+	const vk::Extent3D& GetExtent() const { return _extent; }
+	uint32_t GetLevelCount() const { return _levelCount; }
 
 	struct TransitionInfo
 	{
@@ -60,11 +73,14 @@ public:
 
 	void GenerateMipmaps(vk::CommandBuffer cmd) const;
 
+	void DestroyManually();
+
 private:
 	uint32_t _levelCount = 1;
 	uint32_t _layerCount = 1;
 
 	vk::Image _handle;
+	VmaAllocation _allocation = {};
 	vk::Format _format;
 	vk::ImageView _view;
 	vk::ImageAspectFlags _aspectMask;
@@ -93,12 +109,17 @@ public:
 		VmaAllocationCreateFlags flags = 0;
 		vk::MemoryPropertyFlags reqFlags = {};
 		bool isLifetimeManaged = true;
+		// residency priority with VK_EXT_memory_priority, only applies to dedicated allocations
+		float priority = 0.5f;
 	};
 
 	vk::Buffer GetHandle() const { return _handle; }
 	VmaAllocation GetAllocation() const { return _allocation; }
 	vk::DeviceAddress GetDeviceAddress() const;
 
+	// Only for buffers created with VMA_ALLOCATION_CREATE_MAPPED_BIT
+	void* GetMappedData() const { return _allocationInfo.pMappedData; }
+
 	struct MemoryBarrierInfo
 	{
 		vk::AccessFlags2 srcAccess = vk::AccessFlagBits2::eNone;
@@ -120,14 +141,94 @@ private:
 };
 
 
+// Geometry storage shared by all meshes: a few large device-local buffers, sub-allocated with a free list.
+// Vertex, index and BLAS transform data of every mesh live side by side, so draws can keep the same buffers bound.
+class GeometryArena
+{
+public:
+	static constexpr vk::DeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+	struct Range
+	{
+		uint32_t blockId = 0;
+		vk::DeviceSize offset = 0;
+		vk::DeviceSize size = 0;
+
+		vk::Buffer buffer;
+		vk::DeviceAddress deviceAddress = 0;
+	};
+
+	// Falls back to a new block if none of the existing ones has a large enough free range
+	Range Allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+	void Free(const Range& range);
+
+private:
+	struct Block
+	{
+		Render::Buffer buffer;
+		vk::DeviceAddress baseAddress = 0;
+		FreeListAllocator allocator;
+	};
+
+	void AddBlock(vk::DeviceSize size);
+
+	std::vector<Block> _blocks;
+};
+
+
 struct Mesh
 {
+	// Simplified index buffer over the vertices of the base mesh
+	struct Lod
+	{
+		GeometryArena::Range indexRange;
+		size_t numOfIndices = 0;
+
+		// object-space deviation from the base mesh
+		float error = 0.0f;
+	};
+
 	const Plume::Mesh* pEngineMesh = nullptr;
 
-	Render::Buffer vertexBuffer;
-	Render::Buffer indexBuffer;
+	// sub-allocations in the backend's geometry arena
+	GeometryArena::Range vertexRange;
+	GeometryArena::Range indexRange;
 
 	size_t numOfIndices = 0;
+	size_t numOfVertices = 0;
+
+	// uint16 whenever all vertices are addressable with 16 bits
+	vk::IndexType indexType = vk::IndexType::eUint32;
+
+	// dequantization of compact vertex positions, identity for full-precision vertices
+	glm::vec3 positionOffset{ 0.0f };
+	glm::vec3 positionScale{ 1.0f };
+
+	// VkTransformMatrixKHR applying the dequantization above during BLAS builds
+	GeometryArena::Range blasTransformRange;
+
+	// Meshes with identical vertex and index data share one geometry, i.e. the same arena ranges and BLAS
+	uint32_t geometryId = 0;
+
+	// progressively coarser LODs, lods[i] is LOD i + 1, LOD 0 is the mesh itself
+	std::vector<Lod> lods;
+
+	// per-meshlet vertex ids and packed triangles for mesh shaders, meshlet bounds stay on the engine mesh
+	GeometryArena::Range meshletVerticesRange;
+	GeometryArena::Range meshletTrianglesRange;
+
+	// object-space bounding sphere
+	glm::vec3 boundsCenter{ 0.0f };
+	float boundsRadius = 0.0f;
+
+	uint32_t GetNumOfLods() const { return static_cast<uint32_t>(lods.size()) + 1; }
+	const GeometryArena::Range& GetIndexRange(uint32_t lodId) const { return lodId == 0 ? indexRange : lods[lodId - 1].indexRange; }
+	size_t GetNumOfIndices(uint32_t lodId) const { return lodId == 0 ? numOfIndices : lods[lodId - 1].numOfIndices; }
+	float GetLodError(uint32_t lodId) const { return lodId == 0 ? 0.0f : lods[lodId - 1].error; }
+
+	// Draw parameters relative to the start of the arena block
+	uint32_t GetFirstIndex(uint32_t lodId = 0) const;
+	int32_t GetVertexOffset() const;
 };
 
 
@@ -162,6 +263,7 @@ public:
 	void CopyImage(const Render::Image& srcImage, const Render::Image& dstImage);
 
 	void CopyDataToBuffer(const void* data, size_t dataSize, Render::Buffer& targetBuffer, uint32_t offset = 0);
+	void CopyDataFromBuffer(const Render::Buffer& srcBuffer, void* data, size_t dataSize, uint32_t offset = 0);
 
 	void CopyBufferToImage(vk::CommandBuffer cmd, const Render::Buffer& srcBuffer, Render::Image& dstImage);
 	void CopyBufferToImage(const Render::Buffer& srcBuffer, Render::Image& dstImage);
@@ -192,21 +294,29 @@ public:
 	void RegisterAccelerationStructure(RegisteredDescriptorSet descriptorSetType, vk::ShaderStageFlags shaderStages,
 		vk::AccelerationStructureKHR accelStructure, uint32_t binding, bool isPerFrame = false);
 
-	Render::Mesh UploadMesh(const Plume::Mesh& engineMesh);
+	// Packs and uploads all meshes to the geometry arena with a single staging buffer and submission. Meshes with
+	// identical geometry are uploaded once and share their ranges.
+	std::vector<Render::Mesh> UploadMeshes(const std::vector<const Plume::Mesh*>& engineMeshes);
 
+	// Geometries of a single BLAS, shaders see geometry i as gl_GeometryIndexEXT == i
 	struct BLASInput
 	{
-		vk::AccelerationStructureGeometryTrianglesDataKHR _triangles;
-		vk::AccelerationStructureGeometryKHR _geometry;
-		vk::AccelerationStructureBuildRangeInfoKHR _buildRangeInfo;
+		std::vector<vk::AccelerationStructureGeometryKHR> _geometries;
+		std::vector<vk::AccelerationStructureBuildRangeInfoKHR> _buildRangeInfos;
 	};
 
-	BLASInput ConvertMeshToBlasInput(const Mesh& mesh, vk::GeometryFlagBitsKHR rtGeometryFlags);
+	void AddMeshToBlasInput(const Mesh& mesh, vk::GeometryFlagBitsKHR rtGeometryFlags, BLASInput& blasInput, uint32_t lodId = 0);
 
 	vk::RenderingAttachmentInfo CreateAttachment(vk::Format format, vk::ImageUsageFlagBits usage, Render::Image* image);
 
 	void SubmitCmdImmediately(std::function<void(vk::CommandBuffer cmd)>&& function, vk::CommandBuffer cmd);
 
+	// Binds on the graphics queue and waits for it, the bound ranges must not be in use by the GPU
+	void BindSparseMemory(const vk::BindSparseInfo& bindInfo);
+	// Binds on the graphics queue without waiting, the current frame's submit waits for the binding on the GPU. At most
+	// once per frame, between BeginFrameRendering() and EndFrameRendering().
+	void BindSparseMemoryBeforeFrame(vk::BindSparseInfo bindInfo);
+
 	struct UploadContext
 	{
 		vk::Fence _uploadFence;
@@ -216,8 +326,20 @@ public:
 
 	const UploadContext& GetUploadContext() const { return _uploadContext; }
 
+	// Upload contexts for submits that don't wait for each other, e.g. to fill a staging buffer while another one is copied
+	static constexpr uint32_t NUM_ASYNC_UPLOAD_CONTEXTS = 3;
+
+	// Waits for the previous submit of the context, then submits like SubmitCmdImmediately() without waiting
+	void SubmitCmdAsync(std::function<void(vk::CommandBuffer cmd)>&& function, uint32_t contextId);
+	// Waits for the last submit of the context, resources it uses can be reused afterwards
+	void WaitForAsyncUpload(uint32_t contextId);
+
 	SDL_Window* _pWindow;
 	vk::Extent2D _windowExtent;
+
+	// No window, surface or swapchain. Frames are rendered into a ring of offscreen images that take the place of the
+	// swapchain images, on any device with ray tracing support, software implementations included.
+	bool _isHeadless = false;
 	vk::Extent3D _windowExtent3D;
 
 	vk::Format _swapchainImageFormat = {};
@@ -235,6 +357,10 @@ public:
 
 	DeletionQueue _mainDeletionQueue;
 
+	// Runs deleter once the frames recorded so far have finished on the GPU, for resources replaced while rendering.
+	// Main thread only.
+	void DestroyAfterFramesInFlight(std::function<void()>&& deleter);
+
 	Image _intermediateImage;
 
 	vk::SwapchainKHR _swapchain;
@@ -245,6 +371,10 @@ public:
 		vk::Semaphore _presentSemaphore, _renderSemaphore;
 		vk::Fence _renderFence;
 
+		// signaled by the sparse binds of the frame, see BindSparseMemoryBeforeFrame()
+		vk::Semaphore _sparseBindSemaphore;
+		bool _isSparseBindPending = false;
+
 		vk::CommandPool _commandPool;
 		vk::CommandBuffer _mainCommandBuffer;
 
@@ -275,10 +405,68 @@ public:
 
 	void TraceRays(const Render::Pass& pass, PushConstantsInfo* pPushConstantsInfo = nullptr, bool useCamLightingBuffer = false);
 
+	// Records a compute pass, outside of any rendering
+	void Dispatch(const Render::Pass& pass, uint32_t groupCountX, PushConstantsInfo* pPushConstantsInfo = nullptr);
+
+	// Same for any command buffer. extraSets are bound after the registered sets of the pass, see
+	// Pass::ComputeInitInfo::extraSetLayouts.
+	void Dispatch(vk::CommandBuffer cmd, const Render::Pass& pass, const vk::Extent3D& groupCount,
+		const std::vector<vk::DescriptorSet>& extraSets, PushConstantsInfo* pPushConstantsInfo = nullptr);
+
+	// Draws sharing vertex and index buffers, stored contiguously in an indirect command buffer
+	struct IndirectDrawBatch
+	{
+		vk::Buffer vertexBuffer;
+		vk::Buffer indexBuffer;
+		vk::IndexType indexType = vk::IndexType::eUint32;
+
+		uint32_t firstCommand = 0;
+		uint32_t numCommands = 0;
+	};
+
+	void DrawIndexedIndirect(const std::vector<IndirectDrawBatch>& batches, const Render::Buffer& commandBuffer, const Render::Pass& pass,
+		PushConstantsInfo* pPushConstantsInfo = nullptr, bool useCamLightingBuffer = false);
+	void DrawMeshTasks(uint32_t groupCountX, const Render::Pass& pass, PushConstantsInfo* pPushConstantsInfo = nullptr,
+		bool useCamLightingBuffer = false);
+
+	bool AreMeshShadersSupported() const { return _meshShadersSupported; }
+	bool AreSparseTexturesSupported() const { return _sparseTexturesSupported; }
+	bool IsMemoryBudgetSupported() const { return _memoryBudgetSupported; }
+	bool AreRTPipelineLibrariesSupported() const { return _rtPipelineLibrariesSupported; }
+
+	struct MemoryBudget
+	{
+		vk::DeviceSize usage = 0;
+		vk::DeviceSize budget = 0;
+	};
+
+	// Summed over the device-local heaps, as of the current frame
+	MemoryBudget GetDeviceLocalMemoryBudget() const;
+
+	uint64_t GetFrameId() const { return _frameId; }
+
+	// Times the frame command buffers, zones are recorded with Render::GpuZone
+	GpuProfiler& GetGpuProfiler() { return _gpuProfiler; }
+	const GpuProfiler& GetGpuProfiler() const { return _gpuProfiler; }
+
+	// Shared by all pipeline builds. Loaded on Init() if it was written for the same device and driver, written back
+	// on Terminate().
+	vk::PipelineCache GetPipelineCache() const { return _pipelineCache; }
+
+	static constexpr const char* PIPELINE_CACHE_PATH = "../../../render/shader_binaries/pipelines.plmpso";
+
+	// Ray tracing pipeline libraries shared by all RT passes, keyed by their shaders and pipeline layout. Thread-safe,
+	// the libraries are destroyed on Terminate().
+	vk::Pipeline FindRTPipelineLibrary(const std::string& key);
+	// If another thread has added a library for the key first, library is destroyed and the cached one returned
+	vk::Pipeline AddRTPipelineLibrary(const std::string& key, vk::Pipeline library);
+
 private:
 	static std::unique_ptr<Backend> _pInstance;
 
 	UploadContext _uploadContext;
+	// fences are created signaled, so that the first submit of every context doesn't wait
+	std::array<UploadContext, NUM_ASYNC_UPLOAD_CONTEXTS> _asyncUploadContexts;
 
 	vk::Instance _libInstance; // Vulkan library handle
 	vk::DebugUtilsMessengerEXT _debug_messenger;
@@ -288,24 +476,55 @@ private:
 
 	Render::DescriptorManager _descMng;
 
+	Render::GeometryArena _geometryArena;
+
 	uint64_t _frameId = 0;
 	int32_t _swapchainImageIndex = -1;
 
+	bool _meshShadersSupported = false;
+	bool _sparseTexturesSupported = false;
+	bool _memoryBudgetSupported = false;
+	bool _rtPipelineLibrariesSupported = false;
+
 	static bool _isInitialized;
 
 	static constexpr size_t MAX_NUM_OF_SAMPLERS = 8;
 	std::array<vk::Sampler, MAX_NUM_OF_SAMPLERS> _samplers;
 
+	vk::PipelineCache _pipelineCache;
+
+	GpuProfiler _gpuProfiler;
+
+	struct FrameDeleter
+	{
+		// frame being recorded when the deleter was added
+		uint64_t frameId = 0;
+		std::function<void()> deleter;
+	};
+
+	std::deque<FrameDeleter> _frameDeleters;
+
+	std::mutex _rtPipelineLibraryMutex;
+	std::unordered_map<std::string, vk::Pipeline> _rtPipelineLibraries;
+
 	vk::CommandPool CreateCommandPool(uint32_t queueFamilyIndex, vk::CommandPoolCreateFlags flags = {});
 	vk::CommandBuffer CreateCommandBuffer(vk::CommandPool pool, uint32_t count = 1, vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
 
 	void InitSwapchain();
+	void InitOffscreenTargets();
+	void InitIntermediateImage();
 	void InitCommands();
 	void InitSyncStructures();
 	void InitRaytracingProperties();
 	void InitSamplers();
+	void InitPipelineCache();
+	void SavePipelineCache() const;
 	void InitImGui();
 
+	// Pushes constants and binds the pipeline and descriptor sets of a pass
+	void BindPassResources(vk::CommandBuffer cmd, const Render::Pass& pass, vk::PipelineBindPoint bindPoint,
+		PushConstantsInfo* pPushConstantsInfo, bool useCamLightingBuffer);
+
 	void AllocateDescriptorSets() { _descMng.AllocateSets(); }
 	void UpdateDescriptorSets() { _descMng.UpdateSets(); }
 };
@@ -361,6 +580,9 @@ public:
 		ePostprocess,
 		eSky,
 		ePathTracing,
+		eClusterCulling,
+		eClusterGeometryPass,
+		eMeshletGeometryPass,
 
 		eMaxValue
 	};
@@ -380,7 +602,16 @@ public:
 	struct PushConstantsInitInfo
 	{
 		uint32_t pcBufferSize = 0;
-		vk::ShaderStageFlagBits stageFlags = {};
+		vk::ShaderStageFlags stageFlags = {};
+	};
+
+	// When the Init...() functions build the pipeline. eAsync loads the shaders and creates the pipeline on the engine
+	// thread pool, eLazy on the first RequirePipeline() call. The pass must stay in place until then.
+	enum class BuildMode
+	{
+		eImmediate,
+		eAsync,
+		eLazy
 	};
 
 	struct InitInfo
@@ -400,6 +631,7 @@ public:
 		bool useVertexAttributes = false;
 		vk::CompareOp compareOp = vk::CompareOp::eLessOrEqual;
 		PushConstantsInitInfo pcInitInfo = {};
+		BuildMode buildMode = BuildMode::eImmediate;
 	};
 
 	void Init(const InitInfo& initInfo);
@@ -418,10 +650,51 @@ public:
 		Render::DescriptorSetFlags usedDescSets;
 		const std::vector<std::string>* pShaderNames = nullptr;
 		PushConstantsInitInfo pcInitInfo = {};
+		BuildMode buildMode = BuildMode::eImmediate;
 	};
 
 	void InitRT(const RTInitInfo& initInfo);
 
+	// Shader groups of ray tracing passes in SBT order. With VK_KHR_pipeline_library every group is compiled into its
+	// own library, which the pipeline of the pass is linked from.
+	enum class RTShaderGroup
+	{
+		eRaygen,
+		eMiss,
+		eShadowMiss,
+		eHit,
+
+		eMaxValue
+	};
+
+	// Recompiles only the library of the group and relinks the pipeline, SBT records of unchanged groups are kept.
+	// Waits for the GPU to be idle, meant for swapping and iterating on shaders. Call from the main thread.
+	void SetRTShaderGroup(RTShaderGroup group, const std::vector<std::string>& shaderNames);
+
+	struct ComputeInitInfo
+	{
+		Render::DescriptorSetFlags usedDescSets = 0;
+		std::string shaderName;
+		PushConstantsInitInfo pcInitInfo = {};
+		// sets the caller allocates and writes itself, they follow the registered ones
+		std::vector<vk::DescriptorSetLayout> extraSetLayouts;
+		BuildMode buildMode = BuildMode::eImmediate;
+	};
+
+	void InitCompute(const ComputeInitInfo& initInfo);
+
+	// Call from the main thread before the pass is used. Builds lazy pipelines, waits for asynchronous builds and
+	// finishes them, which is a no-op once the pipeline is built.
+	void RequirePipeline();
+
+	// Ready once the pipeline is created, RequirePipeline() still has to be called. Invalid before Init...(), deferred
+	// for lazy builds.
+	const std::shared_future<void>& GetBuildFuture() const { return _buildFuture; }
+
+	bool IsBuilt() const { return _pso.IsBuilt(); }
+	// An asynchronous build is running or done but not finished by RequirePipeline()
+	bool IsBuildPending() const { return _buildMode == BuildMode::eAsync && !_pso.IsBuilt(); }
+
 	vk::Pipeline GetPipeline() const { return _pso._pipeline; }
 	vk::PipelineLayout GetPipelineLayout() const { return _pso._pipelineLayout; }
 
@@ -448,12 +721,15 @@ private:
 	vk::PipelineDepthStencilStateCreateInfo _depthStencil;
 
 	Render::DescriptorSetFlags _usedDescSets;
+	std::vector<vk::DescriptorSetLayout> _extraSetLayouts;
 
 	vk::RenderingInfo _renderingInfo;
 	vk::PipelineRenderingCreateInfo _pipelineRenderingCreateInfo;
 	vk::PushConstantRange _pushConstantRange;
+	std::vector<std::string> _shaderNames;
 	std::vector<Render::Shader> _shaders;
 	std::vector<vk::PipelineShaderStageCreateInfo> _shaderStages;
+	std::vector<vk::Format> _colorAttachmentFormats;
 
 	std::vector<vk::RenderingAttachmentInfo> _colorRenderingAttachmentInfos;
 	vk::RenderingAttachmentInfo _depthAttachmentInfo;
@@ -465,8 +741,37 @@ private:
 
 	void BuildShaderBindingTable();
 
+	// Main thread, creates the pipeline layout and starts the build
+	void StartBuild(BuildMode buildMode);
+
+	// Safe on worker threads: they only load shaders and create the pipeline, nothing is pushed to the deletion queue
+	void LoadShaders();
 	void BuildPipeline();
-	void BuildRTPipeline(const std::array<vk::PipelineShaderStageCreateInfo, Render::Pass::RAY_TRACING_SHADER_GROUP_COUNT>& shaderStages);
+	void BuildComputePipeline();
+	void BuildRTPipeline();
+
+	// Main thread, once the pipeline is created
+	void FinishBuild();
+
+	static RTShaderGroup GetRTShaderGroup(const std::string& shaderName);
+	std::string MakeRTPipelineLibraryKey(RTShaderGroup group) const;
+	vk::Pipeline AcquireRTPipelineLibrary(RTShaderGroup group);
+	void LinkRTPipeline();
+
+	static constexpr size_t RT_PIPELINE_LIBRARY_COUNT = static_cast<size_t>(RTShaderGroup::eMaxValue);
+
+	// Upper bounds of RayPayload in ray_common.glsl and of the barycentric hit attribute, all libraries linked together
+	// have to agree on them
+	static constexpr uint32_t RT_MAX_RAY_PAYLOAD_SIZE = 128;
+	static constexpr uint32_t RT_MAX_HIT_ATTRIBUTE_SIZE = sizeof(glm::vec3);
+
+	std::array<vk::Pipeline, RT_PIPELINE_LIBRARY_COUNT> _rtPipelineLibraries = {};
+	// group handles the SBT was last written with
+	std::vector<uint8_t> _rtGroupHandles;
+
+	vk::PipelineBindPoint _bindPoint = vk::PipelineBindPoint::eGraphics;
+	BuildMode _buildMode = BuildMode::eImmediate;
+	std::shared_future<void> _buildFuture;
 
 	PipelineState _pso;
 };
@@ -477,6 +782,20 @@ struct Object
 	Mesh mesh;
 	const Plume::Model* model;
 	glm::mat4 transformMatrix;
+
+	// shared by all objects placing the same geometry
+	uint32_t blasId = 0;
+	// geometry of this object within its BLAS. The object of geometry 0 owns the TLAS instance, the ones of the following
+	// geometries are expected to come right after it, as shaders address them by instance custom index + geometry index.
+	uint32_t blasGeometryIndex = 0;
+
+	// BLAS built from the coarsest mesh LODs, see System::_useCoarseRTLods
+	uint32_t coarseBlasId = 0;
+
+	// LOD rasterized this frame by the hybrid renderer
+	uint32_t lodId = 0;
+	// meshlets of the object are culled and drawn individually this frame
+	bool isDrawnAsClusters = false;
 };
 
 
@@ -16,17 +16,16 @@ namespace Render
 enum DescriptorSetFlagBits
 {
 	eDiffuseTextures = 1 << 0,
-	eMetallicTextures = 1 << 1,
-	eRoughnessTextures = 1 << 2,
-	eNormalMapTextures = 1 << 3,
-	eSkyboxTextures = 1 << 4,
-	eObjects = 1 << 5,
-	eGBuffer = 1 << 6,
-	ePostprocess = 1 << 7,
-	eRTXPerFrame = 1 << 8,
-	eRTXGeneral = 1 << 9,
-	eGlobal = 1 << 10,
-	eTLAS = 1 << 11
+	eOrmTextures = 1 << 1,
+	eNormalMapTextures = 1 << 2,
+	eSkyboxTextures = 1 << 3,
+	eObjects = 1 << 4,
+	eGBuffer = 1 << 5,
+	ePostprocess = 1 << 6,
+	eRTXPerFrame = 1 << 7,
+	eRTXGeneral = 1 << 8,
+	eGlobal = 1 << 9,
+	eTLAS = 1 << 10
 };
 
 typedef uint32_t DescriptorSetFlags;
@@ -35,8 +34,8 @@ typedef uint32_t DescriptorSetFlags;
 enum class RegisteredDescriptorSet
 {
 	eDiffuseTextures,
-	eMetallicTextures,
-	eRoughnessTextures,
+	// occlusion, roughness and metallic in r, g and b
+	eOrmTextures,
 	eNormalMapTextures,
 	eSkyboxTextures,
 	eObjects,
@@ -0,0 +1,248 @@
+#include "render_environment_map.h"
+
+#include "../engine/plm_thread_pool.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+
+namespace
+{
+
+// rows of the map per CDF build task
+constexpr uint32_t CDF_ROWS_PER_TASK = 32;
+
+constexpr double PI = 3.14159265358979323846;
+
+
+struct EnvironmentDistribution
+{
+	std::vector<float> conditionalCdf;
+	std::vector<float> marginalCdf;
+};
+
+
+// Non-finite texels, which some HDR files contain, are never sampled
+double GetSamplingWeight(const float* pTexel, double sinTheta)
+{
+	const double luminance = 0.2126 * pTexel[0] + 0.7152 * pTexel[1] + 0.0722 * pTexel[2];
+
+	return std::isfinite(luminance) ? std::max(luminance, 0.0) * sinTheta : 0.0;
+}
+
+
+// Normalized CDF of the weights, uniform if they sum to zero. The last entry is exactly 1, which the binary searches
+// in environment_sampling.glsl rely on.
+double BuildCdf(const double* pWeights, uint32_t count, float* pCdf)
+{
+	double sum = 0.0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		sum += pWeights[i];
+	}
+
+	double partialSum = 0.0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		partialSum += pWeights[i];
+		pCdf[i] = sum > 0.0 ? static_cast<float>(partialSum / sum) : static_cast<float>(i + 1) / static_cast<float>(count);
+	}
+
+	pCdf[count - 1] = 1.0f;
+
+	return sum;
+}
+
+
+// Conditional CDFs of the rows [firstRow, endRow), returns the weight sum of every row
+std::vector<double> BuildConditionalCdfs(const float* pTexels, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t endRow,
+	float* pConditionalCdf)
+{
+	std::vector<double> rowSums;
+	rowSums.reserve(endRow - firstRow);
+
+	std::vector<double> weights(width);
+
+	for (uint32_t row = firstRow; row < endRow; ++row)
+	{
+		const double sinTheta = std::sin(PI * (row + 0.5) / height);
+		const float* pRow = pTexels + static_cast<size_t>(row) * width * 4;
+
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			weights[x] = GetSamplingWeight(pRow + x * 4, sinTheta);
+		}
+
+		rowSums.push_back(BuildCdf(weights.data(), width, pConditionalCdf + static_cast<size_t>(row) * width));
+	}
+
+	return rowSums;
+}
+
+
+EnvironmentDistribution BuildDistribution(const float* pTexels, uint32_t width, uint32_t height)
+{
+	EnvironmentDistribution distribution;
+	distribution.conditionalCdf.resize(static_cast<size_t>(width) * height);
+	distribution.marginalCdf.resize(height);
+
+	Plume::ThreadPool* pThreadPool = Plume::ThreadPool::AcquireInstance();
+
+	std::vector<std::future<std::vector<double>>> rowTasks;
+
+	for (uint32_t firstRow = 0; firstRow < height; firstRow += CDF_ROWS_PER_TASK)
+	{
+		const uint32_t endRow = std::min(firstRow + CDF_ROWS_PER_TASK, height);
+		float* pConditionalCdf = distribution.conditionalCdf.data();
+
+		// every future is waited for below, so the texels and CDFs outlive the task
+		rowTasks.push_back(pThreadPool->Submit([pTexels, width, height, firstRow, endRow, pConditionalCdf]() {
+			return BuildConditionalCdfs(pTexels, width, height, firstRow, endRow, pConditionalCdf);
+		}));
+	}
+
+	std::vector<double> rowSums;
+	rowSums.reserve(height);
+
+	for (auto& rowTask : rowTasks)
+	{
+		const std::vector<double> taskRowSums = rowTask.get();
+		rowSums.insert(rowSums.end(), taskRowSums.begin(), taskRowSums.end());
+	}
+
+	BuildCdf(rowSums.data(), height, distribution.marginalCdf.data());
+
+	return distribution;
+}
+
+} // anonymous namespace
+
+
+void Render::EnvironmentMap::Init(const std::string& fileName, const glm::vec3& fallbackRadiance)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	std::unique_ptr<float, void (*)(void*)> texels(stbi_loadf(fileName.c_str(), &width, &height, &channels, STBI_rgb_alpha),
+		stbi_image_free);
+
+	_isLoadedFromFile = texels != nullptr;
+
+	const float fallbackTexel[4] = { fallbackRadiance.r, fallbackRadiance.g, fallbackRadiance.b, 1.0f };
+	const float* pTexels = fallbackTexel;
+
+	if (_isLoadedFromFile)
+	{
+		_width = static_cast<uint32_t>(width);
+		_height = static_cast<uint32_t>(height);
+		pTexels = texels.get();
+
+		std::cout << "Environment map from " << fileName << " loaded successfully" << std::endl;
+	}
+	else
+	{
+		_width = 1;
+		_height = 1;
+
+		std::cout << "Failed to load environment map " << fileName << ", using a constant sky" << std::endl;
+	}
+
+	EnvironmentDistribution distribution = BuildDistribution(pTexels, _width, _height);
+
+	Upload(pTexels);
+
+	Render::Buffer::CreateInfo cdfBufferInfo = {};
+	cdfBufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
+		vk::BufferUsageFlagBits::eTransferDst;
+	cdfBufferInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	cdfBufferInfo.allocSize = distribution.conditionalCdf.size() * sizeof(float);
+	_conditionalCdfBuffer = backend->CreateBuffer(cdfBufferInfo);
+	backend->UploadBufferImmediately(_conditionalCdfBuffer, distribution.conditionalCdf);
+
+	cdfBufferInfo.allocSize = distribution.marginalCdf.size() * sizeof(float);
+	_marginalCdfBuffer = backend->CreateBuffer(cdfBufferInfo);
+	backend->UploadBufferImmediately(_marginalCdfBuffer, distribution.marginalCdf);
+}
+
+
+EnvironmentMapGPU Render::EnvironmentMap::GetGPUData() const
+{
+	EnvironmentMapGPU gpuData = {};
+	gpuData.conditionalCdfAddress = _conditionalCdfBuffer.GetDeviceAddress();
+	gpuData.marginalCdfAddress = _marginalCdfBuffer.GetDeviceAddress();
+	gpuData.width = _width;
+	gpuData.height = _height;
+
+	return gpuData;
+}
+
+
+void Render::EnvironmentMap::Upload(const float* pTexels)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	const vk::DeviceSize imageSize = static_cast<vk::DeviceSize>(_width) * _height * 4 * sizeof(float);
+
+	Render::Buffer::CreateInfo stagingInfo = {};
+	stagingInfo.allocSize = imageSize;
+	stagingInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+	stagingInfo.memUsage = VMA_MEMORY_USAGE_CPU_ONLY;
+	stagingInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	stagingInfo.isLifetimeManaged = false;
+
+	Render::Buffer stagingBuffer = backend->CreateBuffer(stagingInfo);
+	std::memcpy(stagingBuffer.GetMappedData(), pTexels, imageSize);
+
+	// no-op for host-coherent memory
+	vmaFlushAllocation(backend->_allocator, stagingBuffer.GetAllocation(), 0, VK_WHOLE_SIZE);
+
+	Render::Image::CreateInfo imageInfo = {};
+	imageInfo.format = vk::Format::eR32G32B32A32Sfloat;
+	imageInfo.usageFlags = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+	imageInfo.extent = vk::Extent3D{ _width, _height, 1 };
+	imageInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	_image = backend->CreateImage(imageInfo);
+
+	backend->SubmitCmdImmediately([&](vk::CommandBuffer cmd) {
+		Render::Image::TransitionInfo transferDstTransition = {};
+		transferDstTransition.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		transferDstTransition.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+		transferDstTransition.srcStageMask = vk::PipelineStageFlagBits::eTopOfPipe;
+		transferDstTransition.dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+
+		_image.LayoutTransition(cmd, transferDstTransition);
+
+		vk::BufferImageCopy copyRegion = {};
+		copyRegion.bufferOffset = 0;
+		copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+		copyRegion.imageSubresource.mipLevel = 0;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent = imageInfo.extent;
+
+		backend->CopyBufferRegionsToImage(cmd, stagingBuffer, _image, { copyRegion });
+
+		Render::Image::TransitionInfo readableTransition = {};
+		readableTransition.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		readableTransition.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+		readableTransition.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		readableTransition.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+		readableTransition.srcStageMask = vk::PipelineStageFlagBits::eTransfer;
+		readableTransition.dstStageMask = vk::PipelineStageFlagBits::eRayTracingShaderKHR;
+
+		_image.LayoutTransition(cmd, readableTransition);
+	}, backend->GetUploadContext()._commandBuffer);
+
+	stagingBuffer.DestroyManually();
+}
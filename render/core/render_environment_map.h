@@ -0,0 +1,45 @@
+#pragma once
+
+#include "render_core.h"
+
+#include "../shaders/host_device_common.h"
+
+#include <string>
+
+namespace Render
+{
+
+// Equirectangular HDR environment map for the path tracer, with the 2D distribution its directions are importance
+// sampled by (see environment_sampling.glsl). Texels are sampled proportionally to luminance * sin(theta): a marginal
+// CDF picks the row, the conditional CDF of that row the texel. Rows are independent, so their CDFs are built in
+// parallel on the engine thread pool.
+class EnvironmentMap
+{
+public:
+	// Loads a Radiance .hdr file. If that fails, the map is a single texel of fallbackRadiance, which keeps
+	// environment sampling valid for a constant sky. Everything is destroyed on backend termination.
+	void Init(const std::string& fileName, const glm::vec3& fallbackRadiance);
+
+	bool IsLoadedFromFile() const { return _isLoadedFromFile; }
+
+	// RGBA32F, in eShaderReadOnlyOptimal
+	const Render::Image& GetImage() const { return _image; }
+
+	EnvironmentMapGPU GetGPUData() const;
+
+private:
+	void Upload(const float* pTexels);
+
+	Render::Image _image;
+
+	// CDFs of the texels of every row, rows one after another, and of the rows
+	Render::Buffer _conditionalCdfBuffer;
+	Render::Buffer _marginalCdfBuffer;
+
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+
+	bool _isLoadedFromFile = false;
+};
+
+} // namespace Render
@@ -0,0 +1,92 @@
+#include "render_free_list.h"
+
+#include <iterator>
+
+
+void Render::FreeListAllocator::Init(uint64_t capacity)
+{
+	_freeRanges.clear();
+	_capacity = capacity;
+	_usedSize = 0;
+
+	if (capacity > 0)
+	{
+		_freeRanges.emplace(0, capacity);
+	}
+}
+
+
+bool Render::FreeListAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& resOffset)
+{
+	ASSERT(size > 0, "Zero-sized allocation");
+
+	alignment = alignment > 0 ? alignment : 1;
+
+	for (auto it = _freeRanges.begin(); it != _freeRanges.end(); ++it)
+	{
+		const uint64_t rangeOffset = it->first;
+		const uint64_t rangeEnd = it->first + it->second;
+
+		const uint64_t alignedOffset = (rangeOffset + alignment - 1) / alignment * alignment;
+		if (alignedOffset + size > rangeEnd)
+		{
+			continue;
+		}
+
+		_freeRanges.erase(it);
+
+		// alignment padding stays free, so Free() only has to return the allocated part
+		if (alignedOffset > rangeOffset)
+		{
+			_freeRanges.emplace(rangeOffset, alignedOffset - rangeOffset);
+		}
+		if (alignedOffset + size < rangeEnd)
+		{
+			_freeRanges.emplace(alignedOffset + size, rangeEnd - alignedOffset - size);
+		}
+
+		_usedSize += size;
+		resOffset = alignedOffset;
+
+		return true;
+	}
+
+	return false;
+}
+
+
+void Render::FreeListAllocator::Free(uint64_t offset, uint64_t size)
+{
+	ASSERT(offset + size <= _capacity, "Freed range is out of bounds");
+	ASSERT(_usedSize >= size, "Freeing more than was allocated");
+
+	_usedSize -= size;
+
+	auto next = _freeRanges.lower_bound(offset);
+
+	if (next != _freeRanges.begin())
+	{
+		auto prev = std::prev(next);
+		ASSERT(prev->first + prev->second <= offset, "Double free");
+
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			size += prev->second;
+			_freeRanges.erase(prev);
+		}
+	}
+
+	if (next != _freeRanges.end())
+	{
+		ASSERT(offset + size <= next->first, "Double free");
+
+		if (offset + size == next->first)
+		{
+			size += next->second;
+			_freeRanges.erase(next);
+		}
+	}
+
+	_freeRanges.emplace(offset, size);
+}
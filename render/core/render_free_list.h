@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../engine/plm_common.h"
+
+#include <map>
+
+namespace Render
+{
+
+// Offset allocator over a fixed-size range. Free ranges are kept sorted by offset and merged with their neighbours
+// on release, allocation is first-fit. Alignments don't have to be powers of two.
+class FreeListAllocator
+{
+public:
+	FreeListAllocator() = default;
+	explicit FreeListAllocator(uint64_t capacity) { Init(capacity); }
+
+	void Init(uint64_t capacity);
+
+	// Returns false if no free range is large enough
+	bool Allocate(uint64_t size, uint64_t alignment, uint64_t& resOffset);
+	void Free(uint64_t offset, uint64_t size);
+
+	uint64_t GetCapacity() const { return _capacity; }
+	uint64_t GetUsedSize() const { return _usedSize; }
+
+private:
+	// offset -> size
+	std::map<uint64_t, uint64_t> _freeRanges;
+
+	uint64_t _capacity = 0;
+	uint64_t _usedSize = 0;
+};
+
+} // namespace Render
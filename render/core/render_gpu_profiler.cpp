@@ -0,0 +1,293 @@
+#include "render_gpu_profiler.h"
+
+#include "../engine/plm_tracer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+
+void Render::GpuProfiler::Init(vk::Device device, float timestampPeriod, uint32_t timestampValidBits)
+{
+	_device = device;
+	_timestampPeriod = timestampPeriod;
+	_timestampMask = (timestampValidBits >= 64) ? std::numeric_limits<uint64_t>::max() : (1ull << timestampValidBits) - 1;
+
+	_isEnabled = timestampValidBits > 0;
+	if (!_isEnabled)
+	{
+		std::cout << "GPU profiler: the graphics queue doesn't support timestamps, profiling is disabled" << std::endl;
+		return;
+	}
+
+	vk::QueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.queryType = vk::QueryType::eTimestamp;
+	queryPoolInfo.queryCount = 2 * MAX_FRAME_ZONES;
+
+	for (auto& frameQueries : _frameQueries)
+	{
+		frameQueries.queryPool = _device.createQueryPool(queryPoolInfo);
+		frameQueries.zones.reserve(MAX_FRAME_ZONES);
+	}
+}
+
+
+void Render::GpuProfiler::Destroy()
+{
+	for (auto& frameQueries : _frameQueries)
+	{
+		if (frameQueries.queryPool)
+		{
+			_device.destroyQueryPool(frameQueries.queryPool);
+			frameQueries.queryPool = vk::QueryPool{};
+		}
+	}
+
+	_isEnabled = false;
+}
+
+
+void Render::GpuProfiler::BeginFrame(vk::CommandBuffer cmd, uint64_t frameId)
+{
+	if (!_isEnabled)
+	{
+		return;
+	}
+
+	_currentFrameId = frameId;
+
+	FrameQueries& frameQueries = GetCurrentFrameQueries();
+
+	// the fence of the frame that used the pool before has been waited for, its results are available
+	if (!frameQueries.zones.empty())
+	{
+		ReadBack(frameQueries);
+	}
+
+	frameQueries.frameId = frameId;
+	frameQueries.zones.clear();
+
+	cmd.resetQueryPool(frameQueries.queryPool, 0, 2 * MAX_FRAME_ZONES);
+
+	_openZones.clear();
+	_frameZoneId = BeginZone(cmd, "Frame");
+}
+
+
+void Render::GpuProfiler::EndFrame(vk::CommandBuffer cmd)
+{
+	if (!_isEnabled)
+	{
+		return;
+	}
+
+	EndZone(cmd, _frameZoneId);
+
+	ASSERT(_openZones.empty(), "GPU zones were left open at the end of the frame");
+}
+
+
+void Render::GpuProfiler::WriteCalibrationTimestamp(vk::CommandBuffer cmd)
+{
+	if (!_isEnabled)
+	{
+		return;
+	}
+
+	// the first frame resets the pool again before using it
+	cmd.resetQueryPool(_frameQueries[0].queryPool, 0, 1);
+	cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, _frameQueries[0].queryPool, 0);
+}
+
+
+void Render::GpuProfiler::Calibrate(uint64_t submitTimeNs, uint64_t completionTimeNs)
+{
+	if (!_isEnabled)
+	{
+		return;
+	}
+
+	const vk::Result result = _device.getQueryPoolResults(_frameQueries[0].queryPool, 0, 1, sizeof(uint64_t), &_calibrationTimestamp,
+		sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait);
+
+	// the timestamp was written somewhere between the two, the error is at most half the round trip
+	_isCalibrated = result == vk::Result::eSuccess;
+	_calibrationTimeNs = submitTimeNs + (completionTimeNs - submitTimeNs) / 2;
+}
+
+
+Render::GpuProfiler::ZoneId Render::GpuProfiler::BeginZone(vk::CommandBuffer cmd, const char* name)
+{
+	if (!_isEnabled)
+	{
+		return INVALID_ZONE_ID;
+	}
+
+	FrameQueries& frameQueries = GetCurrentFrameQueries();
+
+	if (frameQueries.zones.size() >= MAX_FRAME_ZONES)
+	{
+		return INVALID_ZONE_ID;
+	}
+
+	const auto zoneId = static_cast<ZoneId>(frameQueries.zones.size());
+
+	RecordedZone& zone = frameQueries.zones.emplace_back();
+	zone.name = name;
+	zone.depth = static_cast<uint32_t>(_openZones.size());
+	zone.path = _openZones.empty() ? name : frameQueries.zones[_openZones.back()].path + '/' + name;
+
+	_openZones.push_back(zoneId);
+
+	cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, frameQueries.queryPool, 2 * zoneId);
+
+	return zoneId;
+}
+
+
+void Render::GpuProfiler::EndZone(vk::CommandBuffer cmd, ZoneId zoneId)
+{
+	if (zoneId == INVALID_ZONE_ID)
+	{
+		return;
+	}
+
+	ASSERT(!_openZones.empty() && _openZones.back() == zoneId, "GPU zones must end in the reverse order they begin in");
+	_openZones.pop_back();
+
+	cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, GetCurrentFrameQueries().queryPool, 2 * zoneId + 1);
+}
+
+
+void Render::GpuProfiler::ReadBack(FrameQueries& frameQueries)
+{
+	const auto numQueries = static_cast<uint32_t>(2 * frameQueries.zones.size());
+	std::vector<uint64_t> timestamps(numQueries);
+
+	const vk::Result result = _device.getQueryPoolResults(frameQueries.queryPool, 0, numQueries, numQueries * sizeof(uint64_t),
+		timestamps.data(), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+
+	if (result != vk::Result::eSuccess)
+	{
+		return;
+	}
+
+	const uint32_t historyId = _historyHead;
+
+	for (auto& zoneHistory : _zoneHistories)
+	{
+		zoneHistory.timesMs[historyId] = 0.0f;
+	}
+
+	for (size_t i = 0; i < frameQueries.zones.size(); ++i)
+	{
+		const RecordedZone& zone = frameQueries.zones[i];
+
+		auto it = _zoneHistoryIdsByPath.find(zone.path);
+		if (it == _zoneHistoryIdsByPath.end())
+		{
+			ZoneHistory newHistory;
+			newHistory.path = zone.path;
+			newHistory.name = zone.path.substr(zone.path.find_last_of('/') + 1);
+			newHistory.depth = zone.depth;
+
+			// new zones go after the last zone sharing their parent, which keeps parents before their children
+			const size_t parentPathLength = zone.path.size() - newHistory.name.size();
+			auto insertPos = _zoneHistories.end();
+
+			if (parentPathLength > 0)
+			{
+				const std::string parentPrefix = zone.path.substr(0, parentPathLength);
+
+				auto lastRelative = std::find_if(_zoneHistories.rbegin(), _zoneHistories.rend(), [&](const ZoneHistory& history) {
+					return history.path.compare(0, parentPrefix.size(), parentPrefix) == 0 ||
+						history.path == parentPrefix.substr(0, parentPrefix.size() - 1);
+				});
+
+				if (lastRelative != _zoneHistories.rend())
+				{
+					insertPos = lastRelative.base();
+				}
+			}
+
+			_zoneHistories.insert(insertPos, std::move(newHistory));
+
+			_zoneHistoryIdsByPath.clear();
+			for (size_t zoneHistoryId = 0; zoneHistoryId < _zoneHistories.size(); ++zoneHistoryId)
+			{
+				_zoneHistoryIdsByPath.emplace(_zoneHistories[zoneHistoryId].path, zoneHistoryId);
+			}
+
+			it = _zoneHistoryIdsByPath.find(zone.path);
+		}
+
+		// masking the difference handles timestamps wrapping around
+		const uint64_t ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) & _timestampMask;
+
+		// zones recorded more than once in a frame add up
+		_zoneHistories[it->second].timesMs[historyId] += static_cast<float>(static_cast<double>(ticks) * _timestampPeriod / 1.0e6);
+
+#if PLM_ENABLE_TRACING
+		if (_isCalibrated)
+		{
+			const uint64_t beginTicks = (timestamps[2 * i] - _calibrationTimestamp) & _timestampMask;
+			const uint64_t beginNs = _calibrationTimeNs + static_cast<uint64_t>(static_cast<double>(beginTicks) * _timestampPeriod);
+			const uint64_t endNs = beginNs + static_cast<uint64_t>(static_cast<double>(ticks) * _timestampPeriod);
+
+			Plume::Tracer::AcquireInstance()->AddGpuZone(zone.name, beginNs, endNs);
+		}
+#endif // PLM_ENABLE_TRACING
+	}
+
+	_historyFrameIds[historyId] = frameQueries.frameId;
+	_historyHead = (_historyHead + 1) % HISTORY_SIZE;
+	_numHistoryFrames = std::min(_numHistoryFrames + 1, HISTORY_SIZE);
+}
+
+
+bool Render::GpuProfiler::ExportCsv(const std::string& fileName) const
+{
+	std::ofstream file(fileName, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "GPU profiler: failed to write " << fileName << std::endl;
+		return false;
+	}
+
+	file << "frame";
+	for (const auto& zoneHistory : _zoneHistories)
+	{
+		file << ',' << zoneHistory.path;
+	}
+	file << '\n';
+
+	const uint32_t oldestHistoryId = (_historyHead + HISTORY_SIZE - _numHistoryFrames) % HISTORY_SIZE;
+
+	for (uint32_t i = 0; i < _numHistoryFrames; ++i)
+	{
+		const uint32_t historyId = (oldestHistoryId + i) % HISTORY_SIZE;
+
+		file << _historyFrameIds[historyId];
+		for (const auto& zoneHistory : _zoneHistories)
+		{
+			file << ',' << zoneHistory.timesMs[historyId];
+		}
+		file << '\n';
+	}
+
+	std::cout << "GPU profiler: " << _numHistoryFrames << " frames written to " << fileName << std::endl;
+
+	return true;
+}
+
+
+Render::GpuZone::GpuZone(GpuProfiler& profiler, vk::CommandBuffer cmd, const char* name)
+	: _profiler(profiler), _cmd(cmd), _zoneId(profiler.BeginZone(cmd, name))
+{
+}
+
+
+Render::GpuZone::~GpuZone()
+{
+	_profiler.EndZone(_cmd, _zoneId);
+}
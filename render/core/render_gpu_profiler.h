@@ -0,0 +1,140 @@
+#pragma once
+
+#include "render_types.h"
+
+#include <array>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Render
+{
+
+// Measures the GPU time of nestable zones of the frame command buffers with timestamp queries. Every frame in flight
+// has its own query pool, which is read back once the fence of the frame has been waited for, so reading results never
+// stalls. Zones are identified by their path ("Frame/G-Buffer Geometry/Cluster Culling"), their times are kept for the
+// last HISTORY_SIZE frames read back.
+class GpuProfiler
+{
+public:
+	using ZoneId = uint32_t;
+
+	static constexpr ZoneId INVALID_ZONE_ID = std::numeric_limits<ZoneId>::max();
+
+	// zones per frame, the ones beyond are not measured
+	static constexpr uint32_t MAX_FRAME_ZONES = 64;
+
+	static constexpr uint32_t HISTORY_SIZE = 240;
+
+	static constexpr const char* CSV_PATH = "gpu_profile.csv";
+
+	struct ZoneHistory
+	{
+		std::string path;
+		std::string name;
+		uint32_t depth = 0;
+
+		// milliseconds, aligned with the frames of GetHistoryFrameIds(), 0 for frames without the zone
+		std::array<float, HISTORY_SIZE> timesMs = {};
+	};
+
+	// Profiling is disabled if the queue can't write timestamps. Destroy() has to be called before the device is destroyed.
+	void Init(vk::Device device, float timestampPeriod, uint32_t timestampValidBits);
+	void Destroy();
+
+	bool IsEnabled() const { return _isEnabled; }
+
+	// Call after the fence of the frame has been waited for and cmd has begun. Reads back the results of the frame that
+	// used the query pool before, then opens the "Frame" zone.
+	void BeginFrame(vk::CommandBuffer cmd, uint64_t frameId);
+	// Closes the "Frame" zone, call before cmd ends
+	void EndFrame(vk::CommandBuffer cmd);
+
+	// Maps GPU timestamps onto the clock of Plume::Tracer, whose GPU track then gets every zone read back. cmd is submitted
+	// after WriteCalibrationTimestamp(), Calibrate() is called with the tracer times before the submit and after its
+	// completion.
+	void WriteCalibrationTimestamp(vk::CommandBuffer cmd);
+	void Calibrate(uint64_t submitTimeNs, uint64_t completionTimeNs);
+
+	// Zones end in the reverse order they begin in, name must outlive the profiler
+	ZoneId BeginZone(vk::CommandBuffer cmd, const char* name);
+	void EndZone(vk::CommandBuffer cmd, ZoneId zoneId);
+
+	// In the order zones have first been measured in, parents before their children
+	const std::vector<ZoneHistory>& GetZoneHistories() const { return _zoneHistories; }
+
+	const std::array<uint64_t, HISTORY_SIZE>& GetHistoryFrameIds() const { return _historyFrameIds; }
+
+	// Index of the oldest frame in the histories, which are ring buffers
+	uint32_t GetHistoryOffset() const { return _historyHead; }
+	uint32_t GetNumHistoryFrames() const { return _numHistoryFrames; }
+
+	// One row per frame of the history, oldest first, and one column per zone
+	bool ExportCsv(const std::string& fileName) const;
+
+private:
+	struct RecordedZone
+	{
+		const char* name = nullptr;
+		std::string path;
+		uint32_t depth = 0;
+	};
+
+	struct FrameQueries
+	{
+		vk::QueryPool queryPool;
+
+		uint64_t frameId = 0;
+		// zone i has timestamps 2 * i and 2 * i + 1
+		std::vector<RecordedZone> zones;
+	};
+
+	void ReadBack(FrameQueries& frameQueries);
+
+	FrameQueries& GetCurrentFrameQueries() { return _frameQueries[_currentFrameId % FRAME_OVERLAP]; }
+
+	vk::Device _device;
+
+	bool _isEnabled = false;
+
+	float _timestampPeriod = 1.0f;
+	uint64_t _timestampMask = std::numeric_limits<uint64_t>::max();
+
+	bool _isCalibrated = false;
+	uint64_t _calibrationTimestamp = 0;
+	uint64_t _calibrationTimeNs = 0;
+
+	std::array<FrameQueries, FRAME_OVERLAP> _frameQueries;
+
+	uint64_t _currentFrameId = 0;
+	// zones that have begun but not ended this frame
+	std::vector<ZoneId> _openZones;
+	ZoneId _frameZoneId = INVALID_ZONE_ID;
+
+	std::vector<ZoneHistory> _zoneHistories;
+	std::unordered_map<std::string, size_t> _zoneHistoryIdsByPath;
+
+	std::array<uint64_t, HISTORY_SIZE> _historyFrameIds = {};
+	uint32_t _historyHead = 0;
+	uint32_t _numHistoryFrames = 0;
+};
+
+
+// Measures the GPU time of the commands recorded into cmd during its lifetime
+class GpuZone
+{
+public:
+	GpuZone(GpuProfiler& profiler, vk::CommandBuffer cmd, const char* name);
+	~GpuZone();
+
+	GpuZone(const GpuZone& other) = delete;
+	GpuZone& operator=(const GpuZone& other) = delete;
+
+private:
+	GpuProfiler& _profiler;
+	vk::CommandBuffer _cmd;
+	GpuProfiler::ZoneId _zoneId;
+};
+
+} // namespace Render
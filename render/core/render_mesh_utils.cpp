@@ -0,0 +1,67 @@
+#include "render_mesh_utils.h"
+
+#include <limits>
+
+#include <glm/gtc/packing.hpp>
+
+
+uint32_t RenderUtil::OctEncode(const glm::vec3& v)
+{
+	const float l1Norm = glm::abs(v.x) + glm::abs(v.y) + glm::abs(v.z);
+	if (l1Norm <= 0.0f)
+	{
+		// degenerate input, e.g. a missing tangent. (0, 0) decodes to +Z
+		return glm::packSnorm2x16(glm::vec2(0.0f));
+	}
+
+	glm::vec2 encoded = glm::vec2(v.x, v.y) / l1Norm;
+	if (v.z < 0.0f)
+	{
+		const glm::vec2 signNotZero(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+		encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * signNotZero;
+	}
+
+	return glm::packSnorm2x16(encoded);
+}
+
+
+void RenderUtil::PackVertices(Plume::ArrayView<Vertex> vertices, std::vector<CompactVertex>& packedVertices,
+	glm::vec3& positionOffset, glm::vec3& positionScale)
+{
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+
+	if (vertices.empty())
+	{
+		boundsMin = glm::vec3(0.0f);
+		boundsMax = glm::vec3(0.0f);
+	}
+
+	// flat meshes still need a non-zero scale on every axis
+	constexpr float MIN_HALF_EXTENT = 1e-6f;
+
+	positionOffset = (boundsMin + boundsMax) * 0.5f;
+	positionScale = glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(MIN_HALF_EXTENT));
+
+	packedVertices.resize(vertices.size());
+
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		const Vertex& vertex = vertices[i];
+		CompactVertex& packed = packedVertices[i];
+
+		const glm::vec3 relativePosition = (vertex.position - positionOffset) / positionScale;
+
+		packed.positionXY = glm::packSnorm2x16(glm::vec2(relativePosition.x, relativePosition.y));
+		packed.positionZW = glm::packSnorm2x16(glm::vec2(relativePosition.z, 0.0f));
+		packed.normal = OctEncode(vertex.normal);
+		packed.uv = glm::packHalf2x16(vertex.uv);
+		packed.tangent = OctEncode(vertex.tangent);
+	}
+}
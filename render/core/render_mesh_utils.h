@@ -0,0 +1,17 @@
+#pragma once
+
+#include "render_types.h"
+#include "../engine/plm_common.h"
+
+#include <vector>
+
+namespace RenderUtil
+{
+	// Quantizes full-precision vertices into the compact GPU format. Positions are stored relative to the mesh bounds,
+	// decode them with position = positionOffset + snorm * positionScale.
+	void PackVertices(Plume::ArrayView<Vertex> vertices, std::vector<CompactVertex>& packedVertices,
+		glm::vec3& positionOffset, glm::vec3& positionScale);
+
+	// Octahedral encoding of a unit vector into two snorm16 values
+	uint32_t OctEncode(const glm::vec3& v);
+}
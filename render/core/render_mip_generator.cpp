@@ -0,0 +1,319 @@
+#include "render_mip_generator.h"
+
+#include <algorithm>
+
+
+namespace
+{
+
+vk::ImageMemoryBarrier MakeMipsBarrier(const Render::Image& image, uint32_t baseMip, uint32_t numMips, vk::ImageLayout oldLayout,
+	vk::ImageLayout newLayout, vk::AccessFlags srcAccessMask, vk::AccessFlags dstAccessMask)
+{
+	vk::ImageMemoryBarrier barrier = {};
+	barrier.image = image.GetHandle();
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+	barrier.subresourceRange.baseMipLevel = baseMip;
+	barrier.subresourceRange.levelCount = numMips;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	return barrier;
+}
+
+
+uint32_t GetMipSize(uint32_t size, uint32_t mip)
+{
+	return std::max(size >> mip, 1u);
+}
+
+} // anonymous namespace
+
+
+void Render::MipGenerator::Init()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+	vk::Device& device = *backend->GetPDevice();
+
+	const std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+		vkinit::SetLayoutBinding(vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eCompute, 0),
+		vkinit::SetLayoutBinding(vk::DescriptorType::eStorageImage, vk::ShaderStageFlagBits::eCompute, 1)
+	};
+
+	vk::DescriptorSetLayoutCreateInfo layoutInfo;
+	layoutInfo.setBindings(bindings);
+
+	vk::DescriptorSetLayout setLayout = device.createDescriptorSetLayout(layoutInfo);
+	_setLayout = setLayout;
+
+	Render::Pass::ComputeInitInfo passInfo = {};
+	passInfo.pcInitInfo.pcBufferSize = sizeof(MipDownsamplePushConstants);
+	passInfo.pcInitInfo.stageFlags = vk::ShaderStageFlagBits::eCompute;
+	passInfo.extraSetLayouts = { _setLayout };
+
+	passInfo.shaderName = "mip_downsample_rgba8.comp";
+	_rgba8Pass.InitCompute(passInfo);
+
+	passInfo.shaderName = "mip_downsample_rgba32f.comp";
+	_rgba32fPass.InitCompute(passInfo);
+
+	backend->_mainDeletionQueue.PushFunction([this, device, setLayout]() {
+		ReleaseRecorded();
+		device.destroyDescriptorSetLayout(setLayout);
+	});
+
+	_isInitialized = true;
+}
+
+
+bool Render::MipGenerator::IsFormatSupported(vk::Format format) const
+{
+	const vk::Format storageFormat = GetStorageFormat(format);
+	if (!_isInitialized || storageFormat == vk::Format::eUndefined)
+	{
+		return false;
+	}
+
+	auto* backend = Render::Backend::AcquireInstance();
+
+	return static_cast<bool>(backend->GetFormatProperties(storageFormat).optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage) &&
+		static_cast<bool>(backend->GetFormatProperties(format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage);
+}
+
+
+vk::Format Render::MipGenerator::GetStorageFormat(vk::Format format)
+{
+	switch (format)
+	{
+	case vk::Format::eR8G8B8A8Srgb:
+		[[fallthrough]];
+	case vk::Format::eR8G8B8A8Unorm:
+		return vk::Format::eR8G8B8A8Unorm;
+	case vk::Format::eR32G32B32A32Sfloat:
+		return vk::Format::eR32G32B32A32Sfloat;
+	default:
+		return vk::Format::eUndefined;
+	}
+}
+
+
+void Render::MipGenerator::AddImage(const Render::Image& image, bool isNormalMap)
+{
+	ASSERT(IsFormatSupported(image.GetFormat()), "Mips of the image format can't be generated with compute");
+
+	PendingImage& pendingImage = _pendingImages.emplace_back();
+	pendingImage.image = image;
+	pendingImage.isNormalMap = isNormalMap;
+}
+
+
+void Render::MipGenerator::Record(vk::CommandBuffer cmd)
+{
+	ASSERT(_recordedImages.empty(), "Release the recorded images first");
+
+	if (_pendingImages.empty())
+	{
+		return;
+	}
+
+	auto* backend = Render::Backend::AcquireInstance();
+	vk::Device& device = *backend->GetPDevice();
+
+	uint32_t numSets = 0;
+	uint32_t maxNumMips = 1;
+
+	for (const PendingImage& pendingImage : _pendingImages)
+	{
+		numSets += pendingImage.image.GetLevelCount() - 1;
+		maxNumMips = std::max(maxNumMips, pendingImage.image.GetLevelCount());
+	}
+
+	// one set per generated mip, the pool lives until the upload is done
+	const std::vector<vk::DescriptorPoolSize> poolSizes = {
+		{ vk::DescriptorType::eCombinedImageSampler, std::max(numSets, 1u) },
+		{ vk::DescriptorType::eStorageImage, std::max(numSets, 1u) }
+	};
+
+	vk::DescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.maxSets = std::max(numSets, 1u);
+	poolInfo.setPoolSizes(poolSizes);
+
+	_recordedPool = device.createDescriptorPool(poolInfo);
+
+	const vk::Sampler sampler = backend->GetSampler(Render::SamplerType::eLinearClamp);
+
+	std::vector<vk::ImageMemoryBarrier> barriers;
+
+	for (PendingImage& pendingImage : _pendingImages)
+	{
+		const Render::Image& image = pendingImage.image;
+		const uint32_t numMips = image.GetLevelCount();
+		const vk::Format storageFormat = GetStorageFormat(image.GetFormat());
+
+		pendingImage.sampledViews.resize(numMips);
+		pendingImage.storageViews.resize(numMips);
+
+		for (uint32_t mip = 0; mip + 1 < numMips; ++mip)
+		{
+			pendingImage.sampledViews[mip] = CreateMipView(image, image.GetFormat(), mip);
+			pendingImage.storageViews[mip + 1] = CreateMipView(image, storageFormat, mip + 1);
+		}
+
+		if (numMips > 1)
+		{
+			const std::vector<vk::DescriptorSetLayout> setLayouts(numMips - 1, _setLayout);
+
+			vk::DescriptorSetAllocateInfo allocateInfo = {};
+			allocateInfo.descriptorPool = _recordedPool;
+			allocateInfo.setSetLayouts(setLayouts);
+
+			pendingImage.descriptorSets = device.allocateDescriptorSets(allocateInfo);
+		}
+
+		std::vector<vk::DescriptorImageInfo> imageInfos;
+		imageInfos.reserve(2 * (numMips - 1));
+
+		std::vector<vk::WriteDescriptorSet> writes;
+
+		for (uint32_t mip = 1; mip < numMips; ++mip)
+		{
+			const vk::DescriptorSet set = pendingImage.descriptorSets[mip - 1];
+
+			// the source mip is sampled in eGeneral, right after it was written
+			vk::DescriptorImageInfo& srcInfo = imageInfos.emplace_back(sampler, pendingImage.sampledViews[mip - 1], vk::ImageLayout::eGeneral);
+			vk::DescriptorImageInfo& dstInfo = imageInfos.emplace_back(vk::Sampler{}, pendingImage.storageViews[mip], vk::ImageLayout::eGeneral);
+
+			writes.push_back(vkinit::WriteDescriptorImage(vk::DescriptorType::eCombinedImageSampler, set, &srcInfo, 0));
+			writes.push_back(vkinit::WriteDescriptorImage(vk::DescriptorType::eStorageImage, set, &dstInfo, 1));
+		}
+
+		device.updateDescriptorSets(writes, {});
+
+		barriers.push_back(MakeMipsBarrier(image, 0, 1, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eGeneral,
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead));
+
+		if (numMips > 1)
+		{
+			barriers.push_back(MakeMipsBarrier(image, 1, numMips - 1, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+				vk::AccessFlagBits::eNone, vk::AccessFlagBits::eShaderWrite));
+		}
+	}
+
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, {}, {}, barriers);
+
+	// every level of all images is one batch of dispatches, followed by a single barrier
+	for (uint32_t mip = 1; mip < maxNumMips; ++mip)
+	{
+		barriers.clear();
+
+		for (const PendingImage& pendingImage : _pendingImages)
+		{
+			const Render::Image& image = pendingImage.image;
+			if (mip >= image.GetLevelCount())
+			{
+				continue;
+			}
+
+			const vk::Format storageFormat = GetStorageFormat(image.GetFormat());
+
+			MipDownsamplePushConstants pushConstants = {};
+			pushConstants.IS_NORMAL_MAP = pendingImage.isNormalMap;
+			pushConstants.ENCODE_SRGB = storageFormat != image.GetFormat();
+
+			Render::Backend::PushConstantsInfo pcInfo = {};
+			pcInfo.pData = &pushConstants;
+			pcInfo.size = sizeof(MipDownsamplePushConstants);
+			pcInfo.shaderStages = vk::ShaderStageFlagBits::eCompute;
+
+			const vk::Extent3D groupCount = {
+				(GetMipSize(image.GetExtent().width, mip) + MIP_DOWNSAMPLE_GROUP_SIZE - 1) / MIP_DOWNSAMPLE_GROUP_SIZE,
+				(GetMipSize(image.GetExtent().height, mip) + MIP_DOWNSAMPLE_GROUP_SIZE - 1) / MIP_DOWNSAMPLE_GROUP_SIZE,
+				1
+			};
+
+			backend->Dispatch(cmd, GetPass(storageFormat), groupCount, { pendingImage.descriptorSets[mip - 1] }, &pcInfo);
+
+			barriers.push_back(MakeMipsBarrier(image, mip, 1, vk::ImageLayout::eGeneral, vk::ImageLayout::eGeneral,
+				vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead));
+		}
+
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, {}, {}, {}, barriers);
+	}
+
+	barriers.clear();
+
+	for (const PendingImage& pendingImage : _pendingImages)
+	{
+		barriers.push_back(MakeMipsBarrier(pendingImage.image, 0, pendingImage.image.GetLevelCount(), vk::ImageLayout::eGeneral,
+			vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead));
+	}
+
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, barriers);
+
+	_recordedImages = std::move(_pendingImages);
+	_pendingImages.clear();
+}
+
+
+void Render::MipGenerator::ReleaseRecorded()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+	vk::Device& device = *backend->GetPDevice();
+
+	for (const PendingImage& recordedImage : _recordedImages)
+	{
+		for (vk::ImageView view : recordedImage.sampledViews)
+		{
+			if (view)
+			{
+				device.destroyImageView(view);
+			}
+		}
+
+		for (vk::ImageView view : recordedImage.storageViews)
+		{
+			if (view)
+			{
+				device.destroyImageView(view);
+			}
+		}
+	}
+
+	_recordedImages.clear();
+
+	// frees the descriptor sets along
+	if (_recordedPool)
+	{
+		device.destroyDescriptorPool(_recordedPool);
+		_recordedPool = vk::DescriptorPool{};
+	}
+}
+
+
+Render::Pass& Render::MipGenerator::GetPass(vk::Format storageFormat)
+{
+	return storageFormat == vk::Format::eR32G32B32A32Sfloat ? _rgba32fPass : _rgba8Pass;
+}
+
+
+vk::ImageView Render::MipGenerator::CreateMipView(const Render::Image& image, vk::Format format, uint32_t mip) const
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	vk::ImageViewCreateInfo viewInfo = {};
+	viewInfo.viewType = vk::ImageViewType::e2D;
+	viewInfo.image = image.GetHandle();
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+	viewInfo.subresourceRange.baseMipLevel = mip;
+	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	return backend->GetPDevice()->createImageView(viewInfo);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "render_core.h"
+
+#include "../shaders/host_device_common.h"
+
+#include <vector>
+
+namespace Render
+{
+
+// Generates the mips of many images with compute shaders (see mip_downsample.glsl). All images are downsampled level by
+// level, with one barrier per level shared by all of them, instead of two barriers per level and image with blits.
+// sRGB images are filtered in linear space, normal maps as unit vectors.
+class MipGenerator
+{
+public:
+	// Builds the pipelines, which are destroyed on backend termination
+	void Init();
+
+	bool IsInitialized() const { return _isInitialized; }
+
+	// Images need storage usage, and a mutable format if their storage view format differs, see GetStorageFormat()
+	bool IsFormatSupported(vk::Format format) const;
+	static vk::Format GetStorageFormat(vk::Format format);
+
+	// Mip 0 must be written with a transfer and be in eTransferDstOptimal, the other mips are overwritten. The image
+	// has to stay alive until ReleaseRecorded().
+	void AddImage(const Render::Image& image, bool isNormalMap);
+
+	// Records the downsampling of all images added since the last call, they end up in eShaderReadOnlyOptimal
+	void Record(vk::CommandBuffer cmd);
+
+	// Destroys the views and descriptor sets of the recorded images, the GPU must be done with them
+	void ReleaseRecorded();
+
+private:
+	struct PendingImage
+	{
+		Render::Image image;
+		bool isNormalMap = false;
+
+		// per mip, the storage views of mip 0 and the sampled views of the last mip are unused
+		std::vector<vk::ImageView> sampledViews;
+		std::vector<vk::ImageView> storageViews;
+		std::vector<vk::DescriptorSet> descriptorSets;
+	};
+
+	Render::Pass& GetPass(vk::Format storageFormat);
+
+	vk::ImageView CreateMipView(const Render::Image& image, vk::Format format, uint32_t mip) const;
+
+	Render::Pass _rgba8Pass;
+	Render::Pass _rgba32fPass;
+
+	vk::DescriptorSetLayout _setLayout;
+
+	std::vector<PendingImage> _pendingImages;
+	std::vector<PendingImage> _recordedImages;
+	vk::DescriptorPool _recordedPool;
+
+	bool _isInitialized = false;
+};
+
+} // namespace Render
@@ -65,7 +65,8 @@ void RenderBackendRTUtils::CmdCreateBLAS(vk::CommandBuffer cmd, std::vector<uint
 		buildAs[index]._geometryInfo.scratchData = scratchAddress;
 
 		// finally build the BLAS
-		cmd.buildAccelerationStructuresKHR(buildAs[index]._geometryInfo, &buildAs[index]._rangeInfo);
+		const vk::AccelerationStructureBuildRangeInfoKHR* pRangeInfos = buildAs[index]._rangeInfos.data();
+		cmd.buildAccelerationStructuresKHR(buildAs[index]._geometryInfo, pRangeInfos);
 
 		// reusing the same scratch buffer for now, ensuring previous build is finished via barrier
 		vk::MemoryBarrier barrier;
@@ -144,13 +145,19 @@ void RenderBackendRTUtils::BuildBLAS(Render::System* renderSys, const std::vecto
 		buildAs[i]._geometryInfo.type = vk::AccelerationStructureTypeKHR::eBottomLevel;
 		buildAs[i]._geometryInfo.mode = vk::BuildAccelerationStructureModeKHR::eBuild;
 		buildAs[i]._geometryInfo.flags = flags;
-		buildAs[i]._geometryInfo.setGeometries(inputs[i]._geometry);
+		buildAs[i]._geometryInfo.setGeometries(inputs[i]._geometries);
 
-		buildAs[i]._rangeInfo = inputs[i]._buildRangeInfo;
+		buildAs[i]._rangeInfos = inputs[i]._buildRangeInfos;
+
+		std::vector<uint32_t> maxPrimCounts;
+		maxPrimCounts.reserve(inputs[i]._buildRangeInfos.size());
+		for (const auto& rangeInfo : inputs[i]._buildRangeInfos)
+		{
+			maxPrimCounts.push_back(rangeInfo.primitiveCount);
+		}
 
-		uint32_t maxPrimCount = inputs[i]._buildRangeInfo.primitiveCount;
 		buildAs[i]._sizesInfo = backend->GetPDevice()->getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice,
-			buildAs[i]._geometryInfo, maxPrimCount);
+			buildAs[i]._geometryInfo, maxPrimCounts);
 
 		blasTotalSize += buildAs[i]._sizesInfo.accelerationStructureSize;
 		maxScratchSize = std::max(maxScratchSize, buildAs[i]._sizesInfo.buildScratchSize);
@@ -97,6 +97,14 @@ vk::ShaderStageFlagBits Render::Shader::GetShaderStageFromFileName(std::string s
 	{
 		resStage = vk::ShaderStageFlagBits::eCompute;
 	}
+	else if (extensionSubstr == "task")
+	{
+		resStage = vk::ShaderStageFlagBits::eTaskEXT;
+	}
+	else if (extensionSubstr == "mesh")
+	{
+		resStage = vk::ShaderStageFlagBits::eMeshEXT;
+	}
 	else if (extensionSubstr == "rgen")
 	{
 		resStage = vk::ShaderStageFlagBits::eRaygenKHR;
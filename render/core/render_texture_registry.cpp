@@ -0,0 +1,240 @@
+#include "render_texture_registry.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+
+namespace
+{
+
+// Falls back to the path as given if it can't be resolved, loading reports the error then
+std::string GetCanonicalPath(const std::string& path)
+{
+	if (path.empty())
+	{
+		return path;
+	}
+
+	std::error_code errorCode;
+	const std::filesystem::path canonicalPath = std::filesystem::weakly_canonical(path, errorCode);
+
+	return errorCode ? path : canonicalPath.generic_string();
+}
+
+} // anonymous namespace
+
+
+void Render::TextureRegistry::Init(Render::TextureStreamer* pStreamer /* = nullptr */, Render::MipGenerator* pMipGenerator /* = nullptr */)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	_pStreamer = pStreamer;
+	_pMipGenerator = pMipGenerator;
+
+	backend->_mainDeletionQueue.PushFunction([this]() {
+		Clear();
+	});
+}
+
+
+Render::TextureRegistry::TextureId Render::TextureRegistry::Acquire(const RenderUtil::ImageLoadInfo& loadInfo)
+{
+	++_numReferences;
+
+	// streaming needs cooked textures and a streamer, everything else is loaded as a whole
+	RenderUtil::ImageLoadInfo entryLoadInfo = loadInfo;
+	entryLoadInfo.isLifetimeManaged = false;
+	entryLoadInfo.isStreamed = loadInfo.isStreamed && loadInfo.cook && _pStreamer;
+
+	std::string key = MakeKey(entryLoadInfo);
+
+	auto it = _idsByKey.find(key);
+	if (it != _idsByKey.end())
+	{
+		++_entries[it->second].refCount;
+		return it->second;
+	}
+
+	TextureId textureId = INVALID_TEXTURE_ID;
+	if (!_freeIds.empty())
+	{
+		textureId = _freeIds.back();
+		_freeIds.pop_back();
+	}
+	else
+	{
+		textureId = static_cast<TextureId>(_entries.size());
+		_entries.emplace_back();
+	}
+
+	Entry& entry = _entries[textureId];
+	entry.key = key;
+	entry.loadInfo = entryLoadInfo;
+	entry.isLoaded = false;
+	entry.refCount = 1;
+
+	_idsByKey.emplace(std::move(key), textureId);
+	_pendingIds.push_back(textureId);
+
+	return textureId;
+}
+
+
+void Render::TextureRegistry::Release(TextureId textureId)
+{
+	Entry& entry = _entries[textureId];
+
+	ASSERT(entry.refCount > 0, "Texture released more often than acquired");
+
+	--_numReferences;
+	if (--entry.refCount > 0)
+	{
+		return;
+	}
+
+	if (entry.isLoaded)
+	{
+		DestroyImage(entry);
+	}
+
+	_pendingIds.erase(std::remove(_pendingIds.begin(), _pendingIds.end(), textureId), _pendingIds.end());
+	_idsByKey.erase(entry.key);
+
+	entry = Entry{};
+	_freeIds.push_back(textureId);
+}
+
+
+void Render::TextureRegistry::LoadPending()
+{
+	if (_pendingIds.empty())
+	{
+		return;
+	}
+
+	std::vector<TextureId> loadedIds;
+	std::vector<TextureId> streamedIds;
+
+	std::vector<RenderUtil::ImageLoadInfo> loadInfos;
+	std::vector<RenderUtil::ImageLoadInfo> streamedLoadInfos;
+
+	for (TextureId textureId : _pendingIds)
+	{
+		const RenderUtil::ImageLoadInfo& loadInfo = _entries[textureId].loadInfo;
+
+		(loadInfo.isStreamed ? streamedIds : loadedIds).push_back(textureId);
+		(loadInfo.isStreamed ? streamedLoadInfos : loadInfos).push_back(loadInfo);
+	}
+
+	if (!loadInfos.empty())
+	{
+		std::vector<Render::Image> loadedImages;
+		std::vector<bool> isLoaded = RenderUtil::LoadImagesFromFiles(loadInfos, loadedImages, _pMipGenerator);
+
+		for (size_t i = 0; i < loadedIds.size(); ++i)
+		{
+			Entry& entry = _entries[loadedIds[i]];
+			entry.image = loadedImages[i];
+			entry.isLoaded = isLoaded[i];
+		}
+	}
+
+	if (!streamedLoadInfos.empty())
+	{
+		std::vector<Render::TextureStreamer::TextureId> streamerIds;
+		_pStreamer->AddTextures(streamedLoadInfos, streamerIds);
+
+		for (size_t i = 0; i < streamedIds.size(); ++i)
+		{
+			Entry& entry = _entries[streamedIds[i]];
+			entry.streamedId = streamerIds[i];
+			entry.isLoaded = streamerIds[i] != Render::TextureStreamer::INVALID_TEXTURE_ID;
+		}
+	}
+
+	_pendingIds.clear();
+
+	std::cout << "Texture registry: " << GetNumTextures() << " unique textures for " << GetNumReferences() << " references"
+		<< std::endl;
+}
+
+
+const Render::Image& Render::TextureRegistry::GetImage(TextureId textureId) const
+{
+	const Entry& entry = _entries[textureId];
+
+	ASSERT(entry.isLoaded, "Texture is not loaded");
+
+	return entry.loadInfo.isStreamed ? _pStreamer->GetImage(entry.streamedId) : entry.image;
+}
+
+
+void Render::TextureRegistry::Clear()
+{
+	// the streamer destroys its images itself on termination
+	for (auto& entry : _entries)
+	{
+		if (entry.isLoaded && !entry.loadInfo.isStreamed)
+		{
+			entry.image.DestroyManually();
+		}
+	}
+
+	_entries.clear();
+	_freeIds.clear();
+	_idsByKey.clear();
+	_pendingIds.clear();
+	_numReferences = 0;
+}
+
+
+void Render::TextureRegistry::DestroyImage(Entry& entry)
+{
+	if (entry.loadInfo.isStreamed)
+	{
+		_pStreamer->RemoveTexture(entry.streamedId);
+	}
+	else
+	{
+		entry.image.DestroyManually();
+	}
+}
+
+
+std::string Render::TextureRegistry::MakeKey(const RenderUtil::ImageLoadInfo& loadInfo)
+{
+	std::ostringstream key;
+
+	if (loadInfo.isPacked)
+	{
+		key << "packed";
+		for (const auto& source : loadInfo.packedSources)
+		{
+			key << '|' << GetCanonicalPath(source.fileName) << ':' << static_cast<uint32_t>(source.fillValue);
+		}
+	}
+	else
+	{
+		key << GetCanonicalPath(loadInfo.fileName);
+	}
+
+	// cooked images only depend on the cook settings
+	if (loadInfo.cook)
+	{
+		key << "|cook:" << static_cast<uint32_t>(loadInfo.cookSettings.compression) << ':' << loadInfo.cookSettings.maskChannel;
+	}
+	else
+	{
+		key << "|format:" << static_cast<uint32_t>(loadInfo.imageFormat) << ":mips:" << loadInfo.generateMipmaps << ':'
+			<< loadInfo.useComputeMips << ':' << loadInfo.isNormalMap;
+	}
+
+	if (loadInfo.isStreamed)
+	{
+		key << "|streamed";
+	}
+
+	return key.str();
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "render_core.h"
+#include "render_texture_streamer.h"
+#include "render_texture_utils.h"
+
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Render
+{
+
+// Textures shared between materials. Entries are keyed by the canonical paths of their sources plus everything that
+// changes the uploaded image (format, mips, cooking, packing), so every unique texture is decoded and uploaded once
+// no matter how many materials reference it.
+class TextureRegistry
+{
+public:
+	using TextureId = uint32_t;
+
+	static constexpr TextureId INVALID_TEXTURE_ID = std::numeric_limits<TextureId>::max();
+
+	// Destroys the remaining images on backend termination. Streamed load infos are handed to pStreamer, which owns
+	// their images. Mips of load infos with useComputeMips are generated by pMipGenerator.
+	void Init(Render::TextureStreamer* pStreamer = nullptr, Render::MipGenerator* pMipGenerator = nullptr);
+
+	// Adds a reference to the texture, new textures are loaded by the next LoadPending() call
+	TextureId Acquire(const RenderUtil::ImageLoadInfo& loadInfo);
+
+	// The image is destroyed with the last reference, the GPU must not use it anymore
+	void Release(TextureId textureId);
+
+	// Loads all textures acquired since the last call as one batch
+	void LoadPending();
+
+	bool IsLoaded(TextureId textureId) const { return _entries[textureId].isLoaded; }
+	const Render::Image& GetImage(TextureId textureId) const;
+
+	// INVALID_TEXTURE_ID of the streamer for textures that aren't streamed
+	Render::TextureStreamer::TextureId GetStreamedId(TextureId textureId) const { return _entries[textureId].streamedId; }
+
+	uint32_t GetNumTextures() const { return static_cast<uint32_t>(_idsByKey.size()); }
+	uint32_t GetNumReferences() const { return _numReferences; }
+
+	void Clear();
+
+private:
+	struct Entry
+	{
+		std::string key;
+		RenderUtil::ImageLoadInfo loadInfo;
+
+		Render::Image image;
+		bool isLoaded = false;
+
+		Render::TextureStreamer::TextureId streamedId = Render::TextureStreamer::INVALID_TEXTURE_ID;
+
+		uint32_t refCount = 0;
+	};
+
+	void DestroyImage(Entry& entry);
+
+	static std::string MakeKey(const RenderUtil::ImageLoadInfo& loadInfo);
+
+	std::vector<Entry> _entries;
+	std::vector<TextureId> _freeIds;
+	std::unordered_map<std::string, TextureId> _idsByKey;
+
+	std::vector<TextureId> _pendingIds;
+
+	uint32_t _numReferences = 0;
+
+	Render::TextureStreamer* _pStreamer = nullptr;
+	Render::MipGenerator* _pMipGenerator = nullptr;
+};
+
+} // namespace Render
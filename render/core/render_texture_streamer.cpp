@@ -0,0 +1,1038 @@
+#include "render_texture_streamer.h"
+
+#include "../engine/plm_thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <iostream>
+
+
+namespace
+{
+
+// covers the block size of every cooked format
+constexpr vk::DeviceSize STREAMING_STAGING_ALIGNMENT = 16;
+
+constexpr uint32_t NO_FEEDBACK = std::numeric_limits<uint32_t>::max();
+
+constexpr vk::PipelineStageFlags TEXTURE_SAMPLING_STAGES = vk::PipelineStageFlagBits::eFragmentShader |
+	vk::PipelineStageFlagBits::eRayTracingShaderKHR;
+
+
+uint32_t DivideRoundUp(uint32_t value, uint32_t divisor)
+{
+	return (value + divisor - 1) / divisor;
+}
+
+
+// Fails instead of exceeding the heap budget
+bool AllocateSparseMemory(vk::DeviceSize size, const vk::MemoryRequirements& imageRequirements, VmaAllocation& outAllocation,
+	VmaAllocationInfo& outAllocInfo)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	VkMemoryRequirements memRequirements = {};
+	memRequirements.size = size;
+	memRequirements.alignment = imageRequirements.alignment;
+	memRequirements.memoryTypeBits = imageRequirements.memoryTypeBits;
+
+	VmaAllocationCreateInfo allocCreateInfo = {};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+
+	return vmaAllocateMemory(backend->_allocator, &memRequirements, &allocCreateInfo, &outAllocation, &outAllocInfo) == VK_SUCCESS;
+}
+
+
+vk::ImageMemoryBarrier MakeMipBarrier(const Render::Image& image, uint32_t mip, vk::ImageLayout oldLayout, vk::ImageLayout newLayout,
+	vk::AccessFlags srcAccessMask, vk::AccessFlags dstAccessMask)
+{
+	vk::ImageMemoryBarrier barrier = {};
+	barrier.image = image.GetHandle();
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+	barrier.subresourceRange.baseMipLevel = mip;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	return barrier;
+}
+
+
+vk::BufferImageCopy MakeMipCopyRegion(const Plume::CookedTexture& cooked, uint32_t mip, vk::DeviceSize stagingOffset)
+{
+	vk::BufferImageCopy copyRegion = {};
+	copyRegion.bufferOffset = stagingOffset;
+	copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+	copyRegion.imageSubresource.mipLevel = mip;
+	copyRegion.imageSubresource.baseArrayLayer = 0;
+	copyRegion.imageSubresource.layerCount = 1;
+	copyRegion.imageExtent = vk::Extent3D{ cooked.mips[mip].width, cooked.mips[mip].height, 1 };
+
+	return copyRegion;
+}
+
+} // anonymous namespace
+
+
+void Render::TextureStreamer::Init(uint32_t numEntries)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	_entryTextures.assign(numEntries, INVALID_TEXTURE_ID);
+
+	// at least one entry, so that the buffers are valid
+	const size_t numBufferEntries = std::max(numEntries, 1u);
+
+	Render::Buffer::CreateInfo feedbackInfo = {};
+	feedbackInfo.allocSize = numBufferEntries * sizeof(uint32_t);
+	feedbackInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+	feedbackInfo.memUsage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+	feedbackInfo.isLifetimeManaged = false;
+
+	Render::Buffer::CreateInfo minLodInfo = {};
+	minLodInfo.allocSize = numBufferEntries * sizeof(float);
+	minLodInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+	minLodInfo.memUsage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	minLodInfo.isLifetimeManaged = false;
+
+	Render::Buffer::CreateInfo stagingInfo = {};
+	stagingInfo.allocSize = FRAME_UPLOAD_BUDGET;
+	stagingInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+	stagingInfo.memUsage = VMA_MEMORY_USAGE_CPU_ONLY;
+	// written by several workers at once
+	stagingInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	stagingInfo.isLifetimeManaged = false;
+
+	const std::vector<uint32_t> noFeedback(numBufferEntries, NO_FEEDBACK);
+	const std::vector<float> noMinLods(numBufferEntries, 0.0f);
+
+	for (uint32_t i = 0; i < FRAME_OVERLAP; ++i)
+	{
+		_feedbackBuffers[i] = backend->CreateBuffer(feedbackInfo);
+		_minLodBuffers[i] = backend->CreateBuffer(minLodInfo);
+		_stagingBuffers[i] = backend->CreateBuffer(stagingInfo);
+
+		backend->CopyDataToBuffer(noFeedback.data(), noFeedback.size() * sizeof(uint32_t), _feedbackBuffers[i]);
+		backend->CopyDataToBuffer(noMinLods.data(), noMinLods.size() * sizeof(float), _minLodBuffers[i]);
+	}
+
+	backend->_mainDeletionQueue.PushFunction([this]() {
+		Clear();
+	});
+
+	_isInitialized = true;
+}
+
+
+void Render::TextureStreamer::AddTextures(const std::vector<RenderUtil::ImageLoadInfo>& loadInfos, std::vector<TextureId>& outIds)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	Plume::ThreadPool* pThreadPool = Plume::ThreadPool::AcquireInstance();
+
+	std::vector<Plume::CookedTexture> cookedTextures(loadInfos.size());
+
+	std::vector<std::future<bool>> cooks;
+	cooks.reserve(loadInfos.size());
+
+	for (size_t i = 0; i < loadInfos.size(); ++i)
+	{
+		ASSERT(loadInfos[i].cook, "Only cooked textures can be streamed");
+
+		// every future is waited for below, so the load info and the output outlive the task
+		cooks.push_back(pThreadPool->Submit([&loadInfo = loadInfos[i], &cooked = cookedTextures[i]]() {
+			return loadInfo.isPacked ? Plume::TextureCooker::LoadOrCookPacked(loadInfo.packedSources, loadInfo.cookSettings, cooked) :
+				Plume::TextureCooker::LoadOrCook(loadInfo.fileName, loadInfo.cookSettings, cooked);
+		}));
+	}
+
+	outIds.assign(loadInfos.size(), INVALID_TEXTURE_ID);
+
+	std::vector<TextureId> addedIds;
+	SparseBindBatch bindBatch;
+	vk::DeviceSize stagingSize = 0;
+
+	for (size_t i = 0; i < loadInfos.size(); ++i)
+	{
+		if (!cooks[i].get())
+		{
+			std::cout << "Failed to load texture file " << loadInfos[i].fileName << std::endl;
+			continue;
+		}
+
+		TextureId textureId = INVALID_TEXTURE_ID;
+		if (!_freeIds.empty())
+		{
+			textureId = _freeIds.back();
+			_freeIds.pop_back();
+		}
+		else
+		{
+			textureId = static_cast<TextureId>(_textures.size());
+			_textures.emplace_back();
+		}
+
+		StreamedTexture& texture = _textures[textureId];
+		texture = StreamedTexture{};
+		texture.cooked = std::move(cookedTextures[i]);
+		texture.priority = loadInfos[i].residencyPriority;
+		texture.lastRequestFrame = backend->GetFrameId();
+		texture.isUsed = true;
+
+		// the texture is left out rather than allocated with all of its mips
+		if (!CreateImage(texture, bindBatch))
+		{
+			std::cout << "Streamed texture from " << loadInfos[i].fileName << " doesn't fit into the memory budget" << std::endl;
+
+			texture.image.DestroyManually();
+			texture = StreamedTexture{};
+			_freeIds.push_back(textureId);
+			continue;
+		}
+
+		const Plume::CookedTexture::Mip& lastMip = texture.cooked.mips.back();
+		const vk::DeviceSize tailSize = lastMip.offset + lastMip.size - texture.cooked.mips[texture.tailMip].offset;
+
+		stagingSize = AlignUp(stagingSize, STREAMING_STAGING_ALIGNMENT) + tailSize;
+		_residentSize += tailSize;
+
+		outIds[i] = textureId;
+		addedIds.push_back(textureId);
+
+		std::cout << "Streamed texture from " << loadInfos[i].fileName << " loaded with "
+			<< texture.cooked.mips.size() - texture.tailMip << " of " << texture.cooked.mips.size() << " mips" << std::endl;
+	}
+
+	bindBatch.Submit();
+
+	if (addedIds.empty())
+	{
+		return;
+	}
+
+	// the mip tails of all textures are uploaded with one submit, mips are contiguous in the cooked blocks
+	Render::Buffer::CreateInfo stagingInfo = {};
+	stagingInfo.allocSize = stagingSize;
+	stagingInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+	stagingInfo.memUsage = VMA_MEMORY_USAGE_CPU_ONLY;
+	stagingInfo.isLifetimeManaged = false;
+
+	Render::Buffer stagingBuffer = backend->CreateBuffer(stagingInfo);
+
+	std::vector<std::vector<vk::BufferImageCopy>> copyRegions(addedIds.size());
+	vk::DeviceSize stagingOffset = 0;
+
+	for (size_t i = 0; i < addedIds.size(); ++i)
+	{
+		const StreamedTexture& texture = _textures[addedIds[i]];
+		const Plume::ArrayView<uint8_t> blocks = texture.cooked.GetBlocks();
+
+		const uint64_t tailOffset = texture.cooked.mips[texture.tailMip].offset;
+		const Plume::CookedTexture::Mip& lastMip = texture.cooked.mips.back();
+
+		stagingOffset = AlignUp(stagingOffset, STREAMING_STAGING_ALIGNMENT);
+
+		backend->CopyDataToBuffer(blocks.data() + tailOffset, lastMip.offset + lastMip.size - tailOffset, stagingBuffer,
+			static_cast<uint32_t>(stagingOffset));
+
+		for (uint32_t mip = texture.tailMip; mip < texture.cooked.mips.size(); ++mip)
+		{
+			copyRegions[i].push_back(MakeMipCopyRegion(texture.cooked, mip, stagingOffset + texture.cooked.mips[mip].offset - tailOffset));
+		}
+
+		stagingOffset += lastMip.offset + lastMip.size - tailOffset;
+	}
+
+	backend->SubmitCmdImmediately([&](vk::CommandBuffer cmd) {
+		for (size_t i = 0; i < addedIds.size(); ++i)
+		{
+			Render::Image& image = _textures[addedIds[i]].image;
+
+			Render::Image::TransitionInfo transferTransition = {};
+			transferTransition.newLayout = vk::ImageLayout::eTransferDstOptimal;
+			transferTransition.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+			transferTransition.srcStageMask = vk::PipelineStageFlagBits::eTopOfPipe;
+			transferTransition.dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+
+			image.LayoutTransition(cmd, transferTransition);
+
+			backend->CopyBufferRegionsToImage(cmd, stagingBuffer, image, copyRegions[i]);
+
+			// mips that aren't resident yet are transitioned along, streaming overwrites them as a whole
+			Render::Image::TransitionInfo readableTransition = {};
+			readableTransition.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+			readableTransition.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+			readableTransition.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			readableTransition.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+			readableTransition.srcStageMask = vk::PipelineStageFlagBits::eTransfer;
+			readableTransition.dstStageMask = TEXTURE_SAMPLING_STAGES;
+
+			image.LayoutTransition(cmd, readableTransition);
+		}
+	}, backend->GetUploadContext()._commandBuffer);
+
+	stagingBuffer.DestroyManually();
+}
+
+
+void Render::TextureStreamer::RemoveTexture(TextureId textureId)
+{
+	StreamedTexture& texture = _textures[textureId];
+
+	ASSERT(texture.isUsed, "Texture is not streamed");
+
+	CancelPendingUploads(textureId);
+
+	// the memory of pending evictions is freed with the texture
+	for (const PendingEviction& eviction : _pendingEvictions)
+	{
+		if (eviction.textureId == textureId)
+		{
+			_pendingEvictionSize -= GetMipMemorySize(texture, eviction.mip);
+		}
+	}
+
+	_pendingEvictions.erase(std::remove_if(_pendingEvictions.begin(), _pendingEvictions.end(), [textureId](const PendingEviction& eviction) {
+		return eviction.textureId == textureId;
+	}), _pendingEvictions.end());
+
+	std::replace(_entryTextures.begin(), _entryTextures.end(), textureId, INVALID_TEXTURE_ID);
+
+	const uint64_t residentOffset = texture.cooked.mips[texture.residentMip].offset;
+	const Plume::CookedTexture::Mip& lastMip = texture.cooked.mips.back();
+	_residentSize -= lastMip.offset + lastMip.size - residentOffset;
+
+	// sparse images are created without an allocation of their own
+	texture.image.DestroyManually();
+	FreeMemory(texture);
+
+	texture = StreamedTexture{};
+	_freeIds.push_back(textureId);
+}
+
+
+void Render::TextureStreamer::SetEntryTexture(uint32_t entryId, TextureId textureId)
+{
+	ASSERT(entryId < _entryTextures.size(), "Invalid texture streaming entry");
+
+	_entryTextures[entryId] = textureId;
+}
+
+
+void Render::TextureStreamer::Update(vk::CommandBuffer cmd)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	const uint64_t frameId = backend->GetFrameId();
+	const uint32_t frameIndex = frameId % FRAME_OVERLAP;
+
+	SparseBindBatch bindBatch;
+	UnbindEvictedMips(frameId, bindBatch);
+
+	// the fence wait of this frame guarantees the last frame that used these buffers is done
+	std::vector<uint32_t> feedback(_entryTextures.size(), NO_FEEDBACK);
+	backend->CopyDataFromBuffer(_feedbackBuffers[frameIndex], feedback.data(), feedback.size() * sizeof(uint32_t));
+
+	std::vector<uint32_t> requestedMips(_textures.size(), NO_FEEDBACK);
+	for (size_t entryId = 0; entryId < _entryTextures.size(); ++entryId)
+	{
+		const TextureId textureId = _entryTextures[entryId];
+		if (textureId != INVALID_TEXTURE_ID)
+		{
+			requestedMips[textureId] = std::min(requestedMips[textureId], feedback[entryId]);
+		}
+	}
+
+	std::vector<TextureId> streamCandidates;
+	for (TextureId textureId = 0; textureId < _textures.size(); ++textureId)
+	{
+		StreamedTexture& texture = _textures[textureId];
+		if (!texture.isUsed)
+		{
+			continue;
+		}
+
+		const uint32_t requestedMip = requestedMips[textureId];
+		if (requestedMip <= texture.residentMip)
+		{
+			texture.lastRequestFrame = frameId;
+		}
+
+		if (texture.isUploadPending)
+		{
+			continue;
+		}
+
+		if (requestedMip < texture.residentMip && texture.residentMip > texture.firstStreamedMip)
+		{
+			streamCandidates.push_back(textureId);
+		}
+		else if (texture.isSparse && texture.residentMip < texture.tailMip && frameId - texture.lastRequestFrame > EVICTION_DELAY_FRAMES)
+		{
+			EvictMip(textureId, frameId);
+		}
+	}
+
+	// pending evictions are freed within FRAME_OVERLAP frames and no longer count as used
+	const Render::Backend::MemoryBudget memBudget = backend->GetDeviceLocalMemoryBudget();
+	const auto evictionThreshold = static_cast<vk::DeviceSize>(static_cast<double>(memBudget.budget) * EVICTION_BUDGET_FRACTION);
+	const auto streamingThreshold = static_cast<vk::DeviceSize>(static_cast<double>(memBudget.budget) * STREAMING_BUDGET_FRACTION);
+
+	vk::DeviceSize memUsage = memBudget.usage - std::min(memBudget.usage, _pendingEvictionSize);
+	if (memUsage > evictionThreshold)
+	{
+		EvictForBudget(memUsage - evictionThreshold, frameId);
+		memUsage = memBudget.usage - std::min(memBudget.usage, _pendingEvictionSize);
+	}
+
+	// only sparse mips take new memory, the other images hold all of their mips from the start
+	vk::DeviceSize streamingHeadroom = streamingThreshold > memUsage ? streamingThreshold - memUsage : 0;
+
+	// higher priorities first, then the blurriest textures, every texture gets one mip finer per frame
+	std::sort(streamCandidates.begin(), streamCandidates.end(), [&](TextureId lhs, TextureId rhs) {
+		if (_textures[lhs].priority != _textures[rhs].priority)
+		{
+			return _textures[lhs].priority > _textures[rhs].priority;
+		}
+
+		return _textures[lhs].residentMip - requestedMips[lhs] > _textures[rhs].residentMip - requestedMips[rhs];
+	});
+
+	// the staging buffer of the frame takes no new copies until the uploads from it are recorded and done on the GPU
+	const bool isStagingFree = frameId >= _stagingFreeFrames[frameIndex] &&
+		std::none_of(_pendingUploads.begin(), _pendingUploads.end(), [frameIndex](const PendingUpload& upload) {
+			return upload.stagingId == frameIndex;
+		});
+
+	std::vector<PendingUpload> uploads;
+	vk::DeviceSize stagingOffset = 0;
+
+	for (TextureId textureId : streamCandidates)
+	{
+		StreamedTexture& texture = _textures[textureId];
+		const uint32_t mip = texture.residentMip - 1;
+		const vk::DeviceSize mipSize = texture.cooked.mips[mip].size;
+		const vk::DeviceSize memorySize = texture.isSparse ? GetMipMemorySize(texture, mip) : 0;
+
+		if (memorySize > streamingHeadroom)
+		{
+			continue;
+		}
+
+		// mips evicted within the last frames are still bound and keep their contents
+		auto evictionIt = std::find_if(_pendingEvictions.begin(), _pendingEvictions.end(), [&](const PendingEviction& eviction) {
+			return eviction.textureId == textureId && eviction.mip == mip;
+		});
+
+		if (evictionIt != _pendingEvictions.end())
+		{
+			_pendingEvictions.erase(evictionIt);
+			_pendingEvictionSize -= memorySize;
+			streamingHeadroom -= memorySize;
+
+			texture.residentMip = mip;
+			_residentSize += mipSize;
+			continue;
+		}
+
+		const vk::DeviceSize alignedOffset = AlignUp(stagingOffset, STREAMING_STAGING_ALIGNMENT);
+		if (!isStagingFree || alignedOffset + mipSize > FRAME_UPLOAD_BUDGET)
+		{
+			continue;
+		}
+
+		// the mip stays blurry if the heap is full after all
+		if (texture.isSparse && !BindMip(texture, mip, bindBatch))
+		{
+			continue;
+		}
+
+		streamingHeadroom -= memorySize;
+		texture.isUploadPending = true;
+
+		PendingUpload& upload = uploads.emplace_back();
+		upload.textureId = textureId;
+		upload.mip = mip;
+		upload.stagingId = frameIndex;
+		upload.stagingOffset = alignedOffset;
+
+		stagingOffset = alignedOffset + mipSize;
+	}
+
+	// the frame's commands wait for the binds, uploads recorded by later frames are submitted after them
+	bindBatch.SubmitBeforeFrame();
+
+	// mip data is paged in from the mapped texture cache on the workers, the pointers stay valid while the texture is
+	// streamed
+	Plume::ThreadPool* pThreadPool = Plume::ThreadPool::AcquireInstance();
+	uint8_t* pStagingData = static_cast<uint8_t*>(_stagingBuffers[frameIndex].GetMappedData());
+
+	for (PendingUpload& upload : uploads)
+	{
+		const Plume::CookedTexture& cooked = _textures[upload.textureId].cooked;
+		const Plume::CookedTexture::Mip& mip = cooked.mips[upload.mip];
+
+		const uint8_t* pMipData = cooked.GetBlocks().data() + mip.offset;
+		uint8_t* pDst = pStagingData + upload.stagingOffset;
+		const size_t mipSize = mip.size;
+
+		upload.copy = pThreadPool->Submit([pMipData, pDst, mipSize]() {
+			std::memcpy(pDst, pMipData, mipSize);
+		});
+
+		_pendingUploads.push_back(std::move(upload));
+	}
+
+	RecordFinishedUploads(cmd, frameId);
+
+	// the frame samples every texture down to the mips resident now
+	std::vector<float> minLods(_entryTextures.size(), 0.0f);
+	for (size_t entryId = 0; entryId < _entryTextures.size(); ++entryId)
+	{
+		const TextureId textureId = _entryTextures[entryId];
+		if (textureId != INVALID_TEXTURE_ID)
+		{
+			minLods[entryId] = static_cast<float>(_textures[textureId].residentMip);
+		}
+	}
+
+	std::fill(feedback.begin(), feedback.end(), NO_FEEDBACK);
+
+	if (!_entryTextures.empty())
+	{
+		backend->CopyDataToBuffer(minLods.data(), minLods.size() * sizeof(float), _minLodBuffers[frameIndex]);
+		backend->CopyDataToBuffer(feedback.data(), feedback.size() * sizeof(uint32_t), _feedbackBuffers[frameIndex]);
+	}
+}
+
+
+TextureStreamingGPU Render::TextureStreamer::GetGPUData() const
+{
+	TextureStreamingGPU gpuData = {};
+
+	if (!_isInitialized)
+	{
+		return gpuData;
+	}
+
+	auto* backend = Render::Backend::AcquireInstance();
+
+	const uint64_t frameId = backend->GetFrameId();
+	const uint32_t frameIndex = frameId % FRAME_OVERLAP;
+
+	gpuData.minLodsAddress = _minLodBuffers[frameIndex].GetDeviceAddress();
+	gpuData.feedbackAddress = _feedbackBuffers[frameIndex].GetDeviceAddress();
+	gpuData.frame = static_cast<uint32_t>(frameId);
+	gpuData.ENABLED = 1;
+
+	return gpuData;
+}
+
+
+void Render::TextureStreamer::Clear()
+{
+	CancelPendingUploads();
+
+	for (auto& texture : _textures)
+	{
+		if (texture.isUsed)
+		{
+			texture.image.DestroyManually();
+			FreeMemory(texture);
+		}
+	}
+
+	if (_isInitialized)
+	{
+		for (uint32_t i = 0; i < FRAME_OVERLAP; ++i)
+		{
+			_feedbackBuffers[i].DestroyManually();
+			_minLodBuffers[i].DestroyManually();
+			_stagingBuffers[i].DestroyManually();
+		}
+	}
+
+	_textures.clear();
+	_freeIds.clear();
+	_entryTextures.clear();
+	_pendingEvictions.clear();
+	_pendingEvictionSize = 0;
+	_stagingFreeFrames = {};
+	_residentSize = 0;
+	_isInitialized = false;
+}
+
+
+void Render::TextureStreamer::SparseBindBatch::Submit()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	Bind([backend](const vk::BindSparseInfo& bindInfo) {
+		backend->BindSparseMemory(bindInfo);
+	});
+
+	for (VmaAllocation allocation : freedAllocations)
+	{
+		vmaFreeMemory(backend->_allocator, allocation);
+	}
+
+	freedAllocations.clear();
+}
+
+
+void Render::TextureStreamer::SparseBindBatch::SubmitBeforeFrame()
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	Bind([backend](const vk::BindSparseInfo& bindInfo) {
+		backend->BindSparseMemoryBeforeFrame(bindInfo);
+	});
+
+	if (freedAllocations.empty())
+	{
+		return;
+	}
+
+	// the unbinding is done once the frame is
+	backend->DestroyAfterFramesInFlight([allocator = backend->_allocator, allocations = std::move(freedAllocations)]() {
+		for (VmaAllocation allocation : allocations)
+		{
+			vmaFreeMemory(allocator, allocation);
+		}
+	});
+
+	freedAllocations.clear();
+}
+
+
+void Render::TextureStreamer::SparseBindBatch::Bind(const std::function<void(const vk::BindSparseInfo& bindInfo)>& bind) const
+{
+	if (mipBinds.empty() && tailBinds.empty())
+	{
+		return;
+	}
+
+	// binds of the same image may be spread over several infos
+	std::vector<vk::SparseImageMemoryBindInfo> imageBindInfos;
+	imageBindInfos.reserve(mipBinds.size());
+
+	for (size_t i = 0; i < mipBinds.size(); ++i)
+	{
+		const auto& [image, mipBind] = mipBinds[i];
+
+		// binds within a batch aren't ordered, a later bind of the same mip replaces its unbind
+		const bool isRebound = !mipBind.memory && std::any_of(mipBinds.begin() + i + 1, mipBinds.end(), [&](const auto& laterBind) {
+			return laterBind.first == image && laterBind.second.subresource == mipBind.subresource;
+		});
+
+		if (!isRebound)
+		{
+			imageBindInfos.emplace_back(image, 1, &mipBind);
+		}
+	}
+
+	std::vector<vk::SparseImageOpaqueMemoryBindInfo> opaqueBindInfos;
+	opaqueBindInfos.reserve(tailBinds.size());
+
+	for (const auto& [image, tailBind] : tailBinds)
+	{
+		opaqueBindInfos.emplace_back(image, 1, &tailBind);
+	}
+
+	vk::BindSparseInfo bindInfo = {};
+	bindInfo.setImageBinds(imageBindInfos);
+	bindInfo.setImageOpaqueBinds(opaqueBindInfos);
+
+	bind(bindInfo);
+}
+
+
+bool Render::TextureStreamer::CreateImage(StreamedTexture& texture, SparseBindBatch& bindBatch)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	const auto& mips = texture.cooked.mips;
+	const uint32_t numMips = static_cast<uint32_t>(mips.size());
+
+	texture.tailMip = numMips - 1;
+	for (uint32_t mip = 0; mip < numMips; ++mip)
+	{
+		if (std::max(mips[mip].width, mips[mip].height) <= MIP_TAIL_SIZE)
+		{
+			texture.tailMip = mip;
+			break;
+		}
+	}
+
+	texture.firstStreamedMip = 0;
+	while (texture.firstStreamedMip < texture.tailMip && mips[texture.firstStreamedMip].size > FRAME_UPLOAD_BUDGET)
+	{
+		++texture.firstStreamedMip;
+	}
+
+	Render::Image::CreateInfo imageInfo = RenderUtil::GetCookedImageInfo(texture.cooked);
+	imageInfo.isLifetimeManaged = false;
+
+	if (backend->AreSparseTexturesSupported() && texture.tailMip > 0)
+	{
+		imageInfo.isSparse = true;
+		texture.image = backend->CreateImage(imageInfo);
+
+		if (InitSparseLayout(texture))
+		{
+			texture.residentMip = texture.tailMip;
+
+			if (BindSparseTail(texture, bindBatch))
+			{
+				return true;
+			}
+
+			// a fully allocated image would only take more of the heap, the finest mips of other textures make room instead
+			EvictForBudgetImmediately(GetTailMemorySize(texture));
+
+			return BindSparseTail(texture, bindBatch);
+		}
+
+		// nothing is bound yet
+		texture.image.DestroyManually();
+		imageInfo.isSparse = false;
+	}
+
+	texture.image = backend->CreateImage(imageInfo);
+	texture.residentMip = texture.tailMip;
+
+	return true;
+}
+
+
+bool Render::TextureStreamer::InitSparseLayout(StreamedTexture& texture)
+{
+	vk::Device* pDevice = Render::Backend::AcquireInstance()->GetPDevice();
+
+	const vk::Image image = texture.image.GetHandle();
+	const auto sparseRequirements = pDevice->getImageSparseMemoryRequirements(image);
+
+	// formats that need a metadata aspect bound as well are allocated regularly
+	if (sparseRequirements.size() != 1 || sparseRequirements.front().formatProperties.aspectMask != vk::ImageAspectFlagBits::eColor)
+	{
+		return false;
+	}
+
+	const vk::SparseImageMemoryRequirements& requirements = sparseRequirements.front();
+	const uint32_t numMips = static_cast<uint32_t>(texture.cooked.mips.size());
+
+	texture.isSparse = true;
+	texture.memRequirements = pDevice->getImageMemoryRequirements(image);
+	texture.sparseGranularity = requirements.formatProperties.imageGranularity;
+	texture.sparseTailMip = std::min(requirements.imageMipTailFirstLod, numMips);
+	texture.sparseTailOffset = requirements.imageMipTailOffset;
+	texture.sparseTailSize = texture.sparseTailMip < numMips ? requirements.imageMipTailSize : 0;
+	texture.tailMip = std::min(texture.tailMip, texture.sparseTailMip);
+	texture.mipAllocations.assign(texture.sparseTailMip, VmaAllocation{});
+
+	return true;
+}
+
+
+bool Render::TextureStreamer::BindSparseTail(StreamedTexture& texture, SparseBindBatch& bindBatch)
+{
+	const vk::Image image = texture.image.GetHandle();
+
+	SparseBindBatch textureBindBatch;
+
+	bool isAllocated = true;
+
+	if (texture.sparseTailSize > 0)
+	{
+		VmaAllocationInfo allocInfo = {};
+		isAllocated = AllocateSparseMemory(texture.sparseTailSize, texture.memRequirements, texture.tailAllocation, allocInfo);
+
+		vk::SparseMemoryBind tailBind = {};
+		tailBind.resourceOffset = texture.sparseTailOffset;
+		tailBind.size = texture.sparseTailSize;
+		tailBind.memory = allocInfo.deviceMemory;
+		tailBind.memoryOffset = allocInfo.offset;
+
+		textureBindBatch.tailBinds.push_back({ image, tailBind });
+	}
+
+	// mips between the hardware mip tail and MIP_TAIL_SIZE are always resident as well
+	for (uint32_t mip = texture.tailMip; isAllocated && mip < texture.sparseTailMip; ++mip)
+	{
+		isAllocated = BindMip(texture, mip, textureBindBatch);
+	}
+
+	// nothing is bound before the batch is submitted
+	if (!isAllocated)
+	{
+		FreeMemory(texture);
+		return false;
+	}
+
+	bindBatch.mipBinds.insert(bindBatch.mipBinds.end(), textureBindBatch.mipBinds.begin(), textureBindBatch.mipBinds.end());
+	bindBatch.tailBinds.insert(bindBatch.tailBinds.end(), textureBindBatch.tailBinds.begin(), textureBindBatch.tailBinds.end());
+
+	return true;
+}
+
+
+bool Render::TextureStreamer::BindMip(StreamedTexture& texture, uint32_t mip, SparseBindBatch& bindBatch)
+{
+	ASSERT(mip < texture.sparseTailMip && !texture.mipAllocations[mip], "Mip is bound already");
+
+	const Plume::CookedTexture::Mip& cookedMip = texture.cooked.mips[mip];
+
+	VmaAllocationInfo allocInfo = {};
+	if (!AllocateSparseMemory(GetMipMemorySize(texture, mip), texture.memRequirements, texture.mipAllocations[mip], allocInfo))
+	{
+		texture.mipAllocations[mip] = {};
+		return false;
+	}
+
+	vk::SparseImageMemoryBind mipBind = {};
+	mipBind.subresource = vk::ImageSubresource{ vk::ImageAspectFlagBits::eColor, mip, 0 };
+	mipBind.extent = vk::Extent3D{ cookedMip.width, cookedMip.height, 1 };
+	mipBind.memory = allocInfo.deviceMemory;
+	mipBind.memoryOffset = allocInfo.offset;
+
+	bindBatch.mipBinds.push_back({ texture.image.GetHandle(), mipBind });
+
+	return true;
+}
+
+
+void Render::TextureStreamer::EvictMip(TextureId textureId, uint64_t frameId)
+{
+	StreamedTexture& texture = _textures[textureId];
+
+	_pendingEvictions.push_back({ textureId, texture.residentMip, frameId });
+	_pendingEvictionSize += GetMipMemorySize(texture, texture.residentMip);
+
+	_residentSize -= texture.cooked.mips[texture.residentMip].size;
+	++texture.residentMip;
+}
+
+
+void Render::TextureStreamer::UnbindEvictedMips(uint64_t frameId, SparseBindBatch& bindBatch)
+{
+	auto isDone = [frameId](const PendingEviction& eviction) {
+		return frameId >= eviction.frameId + FRAME_OVERLAP;
+	};
+
+	for (const PendingEviction& eviction : _pendingEvictions)
+	{
+		if (!isDone(eviction))
+		{
+			continue;
+		}
+
+		StreamedTexture& texture = _textures[eviction.textureId];
+		const Plume::CookedTexture::Mip& cookedMip = texture.cooked.mips[eviction.mip];
+
+		vk::SparseImageMemoryBind unbind = {};
+		unbind.subresource = vk::ImageSubresource{ vk::ImageAspectFlagBits::eColor, eviction.mip, 0 };
+		unbind.extent = vk::Extent3D{ cookedMip.width, cookedMip.height, 1 };
+
+		bindBatch.mipBinds.push_back({ texture.image.GetHandle(), unbind });
+		bindBatch.freedAllocations.push_back(texture.mipAllocations[eviction.mip]);
+		_pendingEvictionSize -= GetMipMemorySize(texture, eviction.mip);
+
+		texture.mipAllocations[eviction.mip] = {};
+	}
+
+	_pendingEvictions.erase(std::remove_if(_pendingEvictions.begin(), _pendingEvictions.end(), isDone), _pendingEvictions.end());
+}
+
+
+void Render::TextureStreamer::RecordFinishedUploads(vk::CommandBuffer cmd, uint64_t frameId)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	// unfinished copies are polled again by the next frame
+	auto isCopyDone = [](const PendingUpload& upload) {
+		return upload.copy.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	};
+
+	auto finishedEnd = std::stable_partition(_pendingUploads.begin(), _pendingUploads.end(), isCopyDone);
+	if (finishedEnd == _pendingUploads.begin())
+	{
+		return;
+	}
+
+	std::vector<vk::ImageMemoryBarrier> transferBarriers;
+	std::vector<vk::ImageMemoryBarrier> readableBarriers;
+
+	for (auto it = _pendingUploads.begin(); it != finishedEnd; ++it)
+	{
+		const Render::Image& image = _textures[it->textureId].image;
+
+		// the previous contents of the mip are never sampled
+		transferBarriers.push_back(MakeMipBarrier(image, it->mip, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+			vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite));
+		readableBarriers.push_back(MakeMipBarrier(image, it->mip, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+			vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead));
+	}
+
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, transferBarriers);
+
+	for (auto it = _pendingUploads.begin(); it != finishedEnd; ++it)
+	{
+		it->copy.get();
+
+		StreamedTexture& texture = _textures[it->textureId];
+		Render::Buffer& stagingBuffer = _stagingBuffers[it->stagingId];
+		const vk::DeviceSize mipSize = texture.cooked.mips[it->mip].size;
+
+		// no-op for host-coherent memory
+		vmaFlushAllocation(backend->_allocator, stagingBuffer.GetAllocation(), it->stagingOffset, mipSize);
+
+		backend->CopyBufferRegionsToImage(cmd, stagingBuffer, texture.image, { MakeMipCopyRegion(texture.cooked, it->mip, it->stagingOffset) });
+
+		_stagingFreeFrames[it->stagingId] = frameId + FRAME_OVERLAP;
+
+		texture.residentMip = it->mip;
+		texture.isUploadPending = false;
+		_residentSize += mipSize;
+	}
+
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, TEXTURE_SAMPLING_STAGES, {}, {}, {}, readableBarriers);
+
+	_pendingUploads.erase(_pendingUploads.begin(), finishedEnd);
+}
+
+
+void Render::TextureStreamer::CancelPendingUploads(TextureId textureId)
+{
+	auto isCanceled = [textureId](const PendingUpload& upload) {
+		return textureId == INVALID_TEXTURE_ID || upload.textureId == textureId;
+	};
+
+	// the workers read the mapped texture cache, which is released with the texture
+	for (PendingUpload& upload : _pendingUploads)
+	{
+		if (isCanceled(upload))
+		{
+			upload.copy.wait();
+		}
+	}
+
+	_pendingUploads.erase(std::remove_if(_pendingUploads.begin(), _pendingUploads.end(), isCanceled), _pendingUploads.end());
+}
+
+
+void Render::TextureStreamer::EvictForBudget(vk::DeviceSize size, uint64_t frameId)
+{
+	std::vector<TextureId> evictableIds;
+	for (TextureId textureId = 0; textureId < _textures.size(); ++textureId)
+	{
+		const StreamedTexture& texture = _textures[textureId];
+		if (texture.isUsed && texture.isSparse && !texture.isUploadPending && texture.residentMip < texture.tailMip)
+		{
+			evictableIds.push_back(textureId);
+		}
+	}
+
+	// lower priorities first, the least recently requested textures first within a priority
+	std::sort(evictableIds.begin(), evictableIds.end(), [this](TextureId lhs, TextureId rhs) {
+		if (_textures[lhs].priority != _textures[rhs].priority)
+		{
+			return _textures[lhs].priority < _textures[rhs].priority;
+		}
+
+		return _textures[lhs].lastRequestFrame < _textures[rhs].lastRequestFrame;
+	});
+
+	// one mip per texture and pass, so that textures lose their finest mips before anything else
+	vk::DeviceSize evictedSize = 0;
+	while (evictedSize < size && !evictableIds.empty())
+	{
+		for (TextureId textureId : evictableIds)
+		{
+			if (evictedSize >= size)
+			{
+				break;
+			}
+
+			evictedSize += GetMipMemorySize(_textures[textureId], _textures[textureId].residentMip);
+			EvictMip(textureId, frameId);
+		}
+
+		evictableIds.erase(std::remove_if(evictableIds.begin(), evictableIds.end(), [this](TextureId textureId) {
+			return _textures[textureId].residentMip >= _textures[textureId].tailMip;
+		}), evictableIds.end());
+	}
+}
+
+
+void Render::TextureStreamer::EvictForBudgetImmediately(vk::DeviceSize size)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	const uint64_t frameId = backend->GetFrameId();
+
+	EvictForBudget(size, frameId);
+
+	// no frame samples the evicted mips anymore, so they can be unbound without waiting for FRAME_OVERLAP frames
+	if (!_pendingEvictions.empty())
+	{
+		backend->GetPDevice()->waitIdle();
+
+		SparseBindBatch unbindBatch;
+		UnbindEvictedMips(frameId + FRAME_OVERLAP, unbindBatch);
+		unbindBatch.Submit();
+	}
+}
+
+
+vk::DeviceSize Render::TextureStreamer::GetMipMemorySize(const StreamedTexture& texture, uint32_t mip)
+{
+	const Plume::CookedTexture::Mip& cookedMip = texture.cooked.mips[mip];
+
+	// every sparse block takes the alignment of the image in memory
+	const vk::DeviceSize numSparseBlocks = static_cast<vk::DeviceSize>(DivideRoundUp(cookedMip.width, texture.sparseGranularity.width)) *
+		DivideRoundUp(cookedMip.height, texture.sparseGranularity.height);
+
+	return numSparseBlocks * texture.memRequirements.alignment;
+}
+
+
+vk::DeviceSize Render::TextureStreamer::GetTailMemorySize(const StreamedTexture& texture)
+{
+	vk::DeviceSize size = texture.sparseTailSize;
+	for (uint32_t mip = texture.tailMip; mip < texture.sparseTailMip; ++mip)
+	{
+		size += GetMipMemorySize(texture, mip);
+	}
+
+	return size;
+}
+
+
+void Render::TextureStreamer::FreeMemory(StreamedTexture& texture)
+{
+	auto* backend = Render::Backend::AcquireInstance();
+
+	for (VmaAllocation& allocation : texture.mipAllocations)
+	{
+		if (allocation)
+		{
+			vmaFreeMemory(backend->_allocator, allocation);
+			allocation = {};
+		}
+	}
+
+	if (texture.tailAllocation)
+	{
+		vmaFreeMemory(backend->_allocator, texture.tailAllocation);
+		texture.tailAllocation = {};
+	}
+}
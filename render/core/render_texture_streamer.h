@@ -0,0 +1,192 @@
+#pragma once
+
+#include "render_core.h"
+#include "render_texture_utils.h"
+
+#include "../engine/plm_texture_cooker.h"
+#include "../shaders/host_device_common.h"
+
+#include <array>
+#include <functional>
+#include <future>
+#include <limits>
+#include <vector>
+
+namespace Render
+{
+
+// Streams the mips of cooked textures on demand. Textures start with only their mip tail resident. Shaders clamp
+// sampling to the resident mips and report the finest mip they would sample through a feedback buffer (see
+// texture_streaming.glsl). Finer mips are then copied from the mapped texture cache within a per-frame budget.
+// With sparse residency, memory is only bound to resident mips, and mips that stop being requested are evicted again.
+// Without it, images are allocated with all of their mips and streamed mips stay resident.
+// Device-local memory is kept within the budget reported by VMA: streaming stops short of the budget, and once usage
+// exceeds it, sparse textures drop their finest mips by residency priority, least recently requested first.
+class TextureStreamer
+{
+public:
+	using TextureId = uint32_t;
+
+	static constexpr TextureId INVALID_TEXTURE_ID = std::numeric_limits<TextureId>::max();
+
+	// mips up to this size are loaded with the texture and always stay resident
+	static constexpr uint32_t MIP_TAIL_SIZE = 256;
+
+	// mip data copied to the GPU per frame, larger mips are never streamed
+	static constexpr vk::DeviceSize FRAME_UPLOAD_BUDGET = 32ull * 1024 * 1024;
+
+	// sparse textures evict their finest mip once it hasn't been requested for that many frames
+	static constexpr uint64_t EVICTION_DELAY_FRAMES = 300;
+
+	// fractions of the device-local memory budget, sparse mips are only streamed below the first one and evicted above
+	// the second one
+	static constexpr double STREAMING_BUDGET_FRACTION = 0.9;
+	static constexpr double EVICTION_BUDGET_FRACTION = 0.95;
+
+	// Creates the per-frame feedback and min LOD buffers of numEntries feedback entries, see STREAMED_TEXTURE_SLOTS.
+	// Everything is destroyed on backend termination.
+	void Init(uint32_t numEntries);
+
+	// Maps or cooks the textures on the thread pool and uploads their mip tails. outIds has an entry for every load
+	// info, INVALID_TEXTURE_ID for the ones that failed.
+	void AddTextures(const std::vector<RenderUtil::ImageLoadInfo>& loadInfos, std::vector<TextureId>& outIds);
+
+	// Destroys the image and frees its memory, the GPU must not use it anymore
+	void RemoveTexture(TextureId textureId);
+
+	const Render::Image& GetImage(TextureId textureId) const { return _textures[textureId].image; }
+
+	// Shaders clamp and report through the feedback entry, entries without a texture are never clamped
+	void SetEntryTexture(uint32_t entryId, TextureId textureId);
+
+	// Consumes the feedback of the last frame that used the current frame's buffers, evicts mips if over the memory
+	// budget and starts copying newly requested mips into staging memory on the workers. Uploads of the copies that are
+	// done are recorded, the rest are recorded by a later frame. Must be called after the frame fence wait, before the
+	// first pass samples a texture.
+	void Update(vk::CommandBuffer cmd);
+
+	// Buffers of the current frame
+	TextureStreamingGPU GetGPUData() const;
+
+	vk::DeviceSize GetResidentSize() const { return _residentSize; }
+
+	void Clear();
+
+private:
+	struct StreamedTexture
+	{
+		Plume::CookedTexture cooked;
+		Render::Image image;
+
+		// first mip of the tail, which is always resident
+		uint32_t tailMip = 0;
+		// finest resident mip
+		uint32_t residentMip = 0;
+		// finer mips don't fit into the upload budget
+		uint32_t firstStreamedMip = 0;
+
+		bool isSparse = false;
+		// first mip of the hardware mip tail, which is bound as a whole
+		uint32_t sparseTailMip = 0;
+		vk::DeviceSize sparseTailOffset = 0;
+		vk::DeviceSize sparseTailSize = 0;
+		vk::Extent3D sparseGranularity;
+		vk::MemoryRequirements memRequirements;
+		// memory bound to the mips before the hardware mip tail, and to the tail itself
+		std::vector<VmaAllocation> mipAllocations;
+		VmaAllocation tailAllocation = {};
+
+		uint32_t priority = 0;
+		uint64_t lastRequestFrame = 0;
+		bool isUsed = false;
+		// the next finer mip is being copied to staging memory, the texture is neither streamed nor evicted meanwhile
+		bool isUploadPending = false;
+	};
+
+	// Binds of one queue operation
+	struct SparseBindBatch
+	{
+		std::vector<std::pair<vk::Image, vk::SparseImageMemoryBind>> mipBinds;
+		std::vector<std::pair<vk::Image, vk::SparseMemoryBind>> tailBinds;
+		// memory that was unbound by the batch, freed once the binding is done
+		std::vector<VmaAllocation> freedAllocations;
+
+		// Binds and waits for the binding, outside of frames
+		void Submit();
+		// Binds before the submit of the current frame, without waiting
+		void SubmitBeforeFrame();
+
+	private:
+		void Bind(const std::function<void(const vk::BindSparseInfo& bindInfo)>& bind) const;
+	};
+
+	// Mip copied into a staging buffer by a worker, uploaded by the first frame that finds the copy done
+	struct PendingUpload
+	{
+		TextureId textureId = INVALID_TEXTURE_ID;
+		uint32_t mip = 0;
+		uint32_t stagingId = 0;
+		vk::DeviceSize stagingOffset = 0;
+		std::future<void> copy;
+	};
+
+	// A mip is unbound once the frames that could still sample it are done
+	struct PendingEviction
+	{
+		TextureId textureId = INVALID_TEXTURE_ID;
+		uint32_t mip = 0;
+		uint64_t frameId = 0;
+	};
+
+	// False if the mip tail doesn't fit into the budget even after evicting the finest mips of other textures
+	bool CreateImage(StreamedTexture& texture, SparseBindBatch& bindBatch);
+	// False if the format can't be bound sparsely, the image is then allocated with all of its mips
+	bool InitSparseLayout(StreamedTexture& texture);
+	// False if the memory of the mip tail doesn't fit into the budget, nothing is bound then
+	bool BindSparseTail(StreamedTexture& texture, SparseBindBatch& bindBatch);
+
+	// False if the memory doesn't fit into the budget
+	bool BindMip(StreamedTexture& texture, uint32_t mip, SparseBindBatch& bindBatch);
+	void EvictMip(TextureId textureId, uint64_t frameId);
+	// Adds the unbinds of the evicted mips that no frame samples anymore to bindBatch
+	void UnbindEvictedMips(uint64_t frameId, SparseBindBatch& bindBatch);
+
+	// Records the uploads of the pending copies that are done
+	void RecordFinishedUploads(vk::CommandBuffer cmd, uint64_t frameId);
+	// Waits for the copies of the texture, or of all textures, and drops their uploads
+	void CancelPendingUploads(TextureId textureId = INVALID_TEXTURE_ID);
+
+	// Evicts the finest mips of sparse textures until at least size bytes are freed or nothing is left to evict
+	void EvictForBudget(vk::DeviceSize size, uint64_t frameId);
+	// Evicts for size bytes and frees the memory right away, waits for the GPU to be idle
+	void EvictForBudgetImmediately(vk::DeviceSize size);
+
+	static vk::DeviceSize GetMipMemorySize(const StreamedTexture& texture, uint32_t mip);
+	// memory bound from tailMip on, the hardware mip tail included
+	static vk::DeviceSize GetTailMemorySize(const StreamedTexture& texture);
+
+	void FreeMemory(StreamedTexture& texture);
+
+	std::vector<StreamedTexture> _textures;
+	std::vector<TextureId> _freeIds;
+
+	std::vector<TextureId> _entryTextures;
+
+	std::array<Render::Buffer, FRAME_OVERLAP> _feedbackBuffers;
+	std::array<Render::Buffer, FRAME_OVERLAP> _minLodBuffers;
+	std::array<Render::Buffer, FRAME_OVERLAP> _stagingBuffers;
+	// the GPU is done with the copies recorded from a staging buffer once this frame begins
+	std::array<uint64_t, FRAME_OVERLAP> _stagingFreeFrames = {};
+
+	std::vector<PendingUpload> _pendingUploads;
+
+	std::vector<PendingEviction> _pendingEvictions;
+	// memory of the pending evictions, which is still bound but counts as freed
+	vk::DeviceSize _pendingEvictionSize = 0;
+
+	vk::DeviceSize _residentSize = 0;
+
+	bool _isInitialized = false;
+};
+
+} // namespace Render
@@ -4,184 +4,613 @@
 
 #include "render_initializers.h"
 
+#include "../engine/plm_texture_cooker.h"
+#include "../engine/plm_thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <future>
+#include <memory>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PLM_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 
-bool RenderUtil::LoadImageFromFile(Render::System* renderSys, const std::string& fileName, Render::Image& outImage,
-	bool generateMipmaps/* = true */, vk::Format imageFormat/* = vk::Format::eR8G8B8A8Srgb */)
+namespace
 {
-	int texWidth, texHeight, texChannels;
 
-	stbi_uc* pixels = stbi_load(fileName.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+// One per async upload context, shared by the uploads of a LoadImagesFromFiles() call. Larger images get a staging
+// buffer of their own.
+constexpr vk::DeviceSize TEXTURE_STAGING_SEGMENT_SIZE = 64ull * 1024 * 1024;
+
+// decoded images per worker held ahead of the one being staged
+constexpr size_t DECODES_IN_FLIGHT_PER_WORKER = 2;
+
+// covers the texel size of every supported format and the block size of cooked formats
+constexpr vk::DeviceSize TEXTURE_STAGING_ALIGNMENT = 16;
+
+
+struct DecodedImage
+{
+	bool isValid = false;
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	// 8-bit RGBA texels as decoded, converted to the requested format while they are staged
+	std::unique_ptr<stbi_uc, void (*)(void*)> stbTexels{ nullptr, stbi_image_free };
+	std::vector<uint8_t> packedTexels;
+
+	// set instead of texels for cooked load infos
+	bool isCooked = false;
+	Plume::CookedTexture cooked;
+
+	const uint8_t* GetTexels() const { return stbTexels ? stbTexels.get() : packedTexels.data(); }
+};
+
 
-	if (!pixels)
+// Unorm to float, 16 components per iteration with SSE2
+void ConvertUnormToFloat(const uint8_t* pSrc, size_t numComponents, float* pDst)
+{
+	constexpr float UNORM_SCALE = 1.0f / 255.0f;
+
+	size_t i = 0;
+
+#if defined(PLM_USE_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scale = _mm_set1_ps(UNORM_SCALE);
+
+	for (; i + 16 <= numComponents; i += 16)
 	{
-		ASSERT(false, "Failed to load texture file");
-		std::cout << fileName << std::endl;
-		return false;
+		const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc + i));
+
+		const __m128i lowWords = _mm_unpacklo_epi8(bytes, zero);
+		const __m128i highWords = _mm_unpackhi_epi8(bytes, zero);
+
+		_mm_storeu_ps(pDst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lowWords, zero)), scale));
+		_mm_storeu_ps(pDst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lowWords, zero)), scale));
+		_mm_storeu_ps(pDst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(highWords, zero)), scale));
+		_mm_storeu_ps(pDst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(highWords, zero)), scale));
+	}
+#endif
+
+	for (; i < numComponents; ++i)
+	{
+		pDst[i] = pSrc[i] * UNORM_SCALE;
+	}
+}
+
+
+vk::DeviceSize GetStagingSize(const RenderUtil::ImageLoadInfo& loadInfo, const DecodedImage& decoded)
+{
+	if (decoded.isCooked)
+	{
+		return decoded.cooked.GetBlocks().size();
 	}
 
-	void* pixel_ptr = pixels;
+	const vk::DeviceSize texelSize = loadInfo.imageFormat == vk::Format::eR32G32B32A32Sfloat ? 4 * sizeof(float) : 4;
+
+	return static_cast<vk::DeviceSize>(decoded.width) * decoded.height * texelSize;
+}
 
-	vk::DeviceSize imageSize = static_cast<uint64_t>(texWidth) * texHeight * 4;
 
-	std::vector<float> pixBuffer(imageSize);
-	for (size_t i = 0; i < imageSize; ++i)
+// Writes the image in its upload format straight to mapped staging memory
+void WriteStagingData(const RenderUtil::ImageLoadInfo& loadInfo, const DecodedImage& decoded, uint8_t* pDst)
+{
+	if (decoded.isCooked)
 	{
-		pixBuffer[i] = pixels[i] / 255.0f;
+		const Plume::ArrayView<uint8_t> blocks = decoded.cooked.GetBlocks();
+		std::memcpy(pDst, blocks.data(), blocks.size());
+		return;
 	}
 
-	switch (imageFormat)
+	const size_t numComponents = static_cast<size_t>(decoded.width) * decoded.height * 4;
+
+	switch (loadInfo.imageFormat)
 	{
 	case vk::Format::eR32G32B32A32Sfloat:
-		pixel_ptr = pixBuffer.data();
-		imageSize *= 4;
+		ConvertUnormToFloat(decoded.GetTexels(), numComponents, reinterpret_cast<float*>(pDst));
 		break;
 	default:
+		std::memcpy(pDst, decoded.GetTexels(), numComponents);
 		break;
 	}
+}
 
-	auto* backend = Render::Backend::AcquireInstance();
 
-	// hold texture data
-	Render::Buffer::CreateInfo stagingInfo = {};
-	stagingInfo.allocSize = imageSize;
-	stagingInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
-	stagingInfo.memUsage = VMA_MEMORY_USAGE_CPU_ONLY;
+DecodedImage DecodeImage(const RenderUtil::ImageLoadInfo& loadInfo)
+{
+	DecodedImage decoded;
 
-	Render::Buffer stagingBuffer = backend->CreateBuffer(stagingInfo);
+	if (loadInfo.cook)
+	{
+		const bool isCooked = loadInfo.isPacked ?
+			Plume::TextureCooker::LoadOrCookPacked(loadInfo.packedSources, loadInfo.cookSettings, decoded.cooked) :
+			Plume::TextureCooker::LoadOrCook(loadInfo.fileName, loadInfo.cookSettings, decoded.cooked);
 
-	backend->CopyDataToBuffer(pixel_ptr, imageSize, stagingBuffer);
+		if (isCooked)
+		{
+			decoded.width = decoded.cooked.mips.front().width;
+			decoded.height = decoded.cooked.mips.front().height;
+			decoded.isCooked = true;
+			decoded.isValid = true;
+		}
 
-	stbi_image_free(pixels);
+		return decoded;
+	}
 
-	vk::Extent3D imageExtent;
-	imageExtent.width = static_cast<uint32_t>(texWidth);
-	imageExtent.height = static_cast<uint32_t>(texHeight);
-	imageExtent.depth = 1;
+	if (loadInfo.isPacked)
+	{
+		decoded.isValid = Plume::TextureCooker::DecodePacked(loadInfo.packedSources, decoded.packedTexels, decoded.width, decoded.height);
+		return decoded;
+	}
+
+	int width, height, texChannels;
+	decoded.stbTexels.reset(stbi_load(loadInfo.fileName.c_str(), &width, &height, &texChannels, STBI_rgb_alpha));
+
+	if (!decoded.stbTexels)
+	{
+		return decoded;
+	}
+
+	decoded.width = static_cast<uint32_t>(width);
+	decoded.height = static_cast<uint32_t>(height);
+	decoded.isValid = true;
+
+	return decoded;
+}
+
+
+Render::Image CreateTextureImage(const RenderUtil::ImageLoadInfo& loadInfo, const DecodedImage& decoded, bool useComputeMips)
+{
+	auto* backend = Render::Backend::AcquireInstance();
 
 	Render::Image::CreateInfo loadedImageInfo = {};
-	loadedImageInfo.format = imageFormat;
 	loadedImageInfo.usageFlags = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
-	loadedImageInfo.extent = imageExtent;
-	loadedImageInfo.mipLevels = generateMipmaps ? static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1 : 1;
+	loadedImageInfo.extent = vk::Extent3D{ decoded.width, decoded.height, 1 };
 	loadedImageInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-	outImage = backend->CreateImage(loadedImageInfo);
+	if (decoded.isCooked)
+	{
+		loadedImageInfo = RenderUtil::GetCookedImageInfo(decoded.cooked);
+	}
+	else
+	{
+		loadedImageInfo.format = loadInfo.imageFormat;
+		loadedImageInfo.mipLevels = loadInfo.generateMipmaps ?
+			static_cast<uint32_t>(std::floor(std::log2(std::max(decoded.width, decoded.height)))) + 1 : 1;
+	}
 
-	backend->SubmitCmdImmediately([&](vk::CommandBuffer cmd)
+	// the downsampler writes sRGB images through UNORM views
+	if (useComputeMips)
 	{
-		Render::Image::TransitionInfo outImageTransitionInfo = {};
-		outImageTransitionInfo.newLayout = vk::ImageLayout::eTransferDstOptimal;
-		outImageTransitionInfo.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
-		outImageTransitionInfo.srcStageMask = vk::PipelineStageFlagBits::eTopOfPipe;
-		outImageTransitionInfo.dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+		loadedImageInfo.usageFlags |= vk::ImageUsageFlagBits::eStorage;
+		loadedImageInfo.isMutableFormat = Render::MipGenerator::GetStorageFormat(loadedImageInfo.format) != loadedImageInfo.format;
+	}
 
-		outImage.LayoutTransition(cmd, outImageTransitionInfo);
+	loadedImageInfo.isLifetimeManaged = loadInfo.isLifetimeManaged;
 
-		backend->CopyBufferToImage(cmd, stagingBuffer, outImage);
+	return backend->CreateImage(loadedImageInfo);
+}
 
-		vk::FormatProperties formatProperties = backend->GetFormatProperties(imageFormat);
-		
-		if (!(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear) || !generateMipmaps)
-		{
-			// change layout to shader read optimal
-			Render::Image::TransitionInfo transitionToReadable = {};
-			transitionToReadable.oldLayout = vk::ImageLayout::eTransferDstOptimal;
-			transitionToReadable.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
 
-			transitionToReadable.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
-			transitionToReadable.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+// One region per mip of a cooked image, a single one for mip 0 otherwise
+std::vector<vk::BufferImageCopy> GetCopyRegions(const DecodedImage& decoded, vk::DeviceSize stagingOffset)
+{
+	vk::BufferImageCopy copyRegion = {};
+	copyRegion.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+	copyRegion.imageSubresource.baseArrayLayer = 0;
+	copyRegion.imageSubresource.layerCount = 1;
 
-			transitionToReadable.srcStageMask = vk::PipelineStageFlagBits::eTransfer;
-			transitionToReadable.dstStageMask = vk::PipelineStageFlagBits::eFragmentShader;
+	if (!decoded.isCooked)
+	{
+		copyRegion.bufferOffset = stagingOffset;
+		copyRegion.imageSubresource.mipLevel = 0;
+		copyRegion.imageExtent = vk::Extent3D{ decoded.width, decoded.height, 1 };
 
-			outImage.LayoutTransition(cmd, transitionToReadable);
-		}
-		else
-		{
-			outImage.GenerateMipmaps(cmd);
-		}
+		return { copyRegion };
+	}
 
-	}, backend->GetUploadContext()._commandBuffer);
+	std::vector<vk::BufferImageCopy> copyRegions;
+	copyRegions.reserve(decoded.cooked.mips.size());
 
-	std::cout << "Texture from " << fileName << " loaded successfully" << std::endl;
+	for (size_t mipId = 0; mipId < decoded.cooked.mips.size(); ++mipId)
+	{
+		const Plume::CookedTexture::Mip& mip = decoded.cooked.mips[mipId];
 
-	return true;
+		copyRegion.bufferOffset = stagingOffset + mip.offset;
+		copyRegion.imageSubresource.mipLevel = static_cast<uint32_t>(mipId);
+		copyRegion.imageExtent = vk::Extent3D{ mip.width, mip.height, 1 };
+
+		copyRegions.push_back(copyRegion);
+	}
+
+	return copyRegions;
 }
 
 
-bool RenderUtil::LoadCubemapFromFiles(Render::System* renderSys, const std::vector<std::string>& files,
-	Render::Image& outImage)
+// Mips generated with compute are only queued to pMipGenerator, which records them for all images at once
+void RecordImageUpload(vk::CommandBuffer cmd, const Render::Buffer& stagingBuffer, const std::vector<vk::BufferImageCopy>& copyRegions,
+	bool generateMipmaps, Render::MipGenerator* pMipGenerator, bool isNormalMap, Render::Image& outImage)
 {
-	vk::DeviceSize imageSize = 0;
+	auto* backend = Render::Backend::AcquireInstance();
+
+	Render::Image::TransitionInfo outImageTransitionInfo = {};
+	outImageTransitionInfo.newLayout = vk::ImageLayout::eTransferDstOptimal;
+	outImageTransitionInfo.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+	outImageTransitionInfo.srcStageMask = vk::PipelineStageFlagBits::eTopOfPipe;
+	outImageTransitionInfo.dstStageMask = vk::PipelineStageFlagBits::eTransfer;
+
+	outImage.LayoutTransition(cmd, outImageTransitionInfo);
+
+	backend->CopyBufferRegionsToImage(cmd, stagingBuffer, outImage, copyRegions);
 
-	uint8_t* pCurPixel = nullptr;
+	if (generateMipmaps && pMipGenerator)
+	{
+		pMipGenerator->AddImage(outImage, isNormalMap);
+		return;
+	}
+
+	vk::FormatProperties formatProperties = backend->GetFormatProperties(outImage.GetFormat());
+
+	if (!(formatProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear) || !generateMipmaps)
+	{
+		// change layout to shader read optimal
+		Render::Image::TransitionInfo transitionToReadable = {};
+		transitionToReadable.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		transitionToReadable.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
 
-	const std::string& first = files.front();
+		transitionToReadable.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		transitionToReadable.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(first.data(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		transitionToReadable.srcStageMask = vk::PipelineStageFlagBits::eTransfer;
+		transitionToReadable.dstStageMask = vk::PipelineStageFlagBits::eFragmentShader;
 
-	if (!pixels)
+		outImage.LayoutTransition(cmd, transitionToReadable);
+	}
+	else
+	{
+		outImage.GenerateMipmaps(cmd);
+	}
+}
+
+} // anonymous namespace
+
+
+vk::Format RenderUtil::GetCookedFormat(Plume::TextureCompression compression)
+{
+	switch (compression)
+	{
+	case Plume::TextureCompression::eBC7:
+		return vk::Format::eBc7SrgbBlock;
+	case Plume::TextureCompression::eBC5:
+		return vk::Format::eBc5UnormBlock;
+	case Plume::TextureCompression::eBC4:
+		return vk::Format::eBc4UnormBlock;
+	case Plume::TextureCompression::eBC7Linear:
+		return vk::Format::eBc7UnormBlock;
+	}
+
+	ASSERT(false, "Invalid texture compression");
+	return vk::Format::eUndefined;
+}
+
+
+Render::Image::CreateInfo RenderUtil::GetCookedImageInfo(const Plume::CookedTexture& cooked)
+{
+	Render::Image::CreateInfo imageInfo = {};
+	imageInfo.format = GetCookedFormat(cooked.settings.compression);
+	imageInfo.usageFlags = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc;
+	imageInfo.extent = vk::Extent3D{ cooked.mips.front().width, cooked.mips.front().height, 1 };
+	imageInfo.mipLevels = static_cast<uint32_t>(cooked.mips.size());
+	imageInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	// masks are read from the channel they had in the source texture
+	if (cooked.settings.compression == Plume::TextureCompression::eBC4)
+	{
+		imageInfo.components = vk::ComponentMapping{ vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eR,
+			vk::ComponentSwizzle::eR, vk::ComponentSwizzle::eOne };
+	}
+
+	return imageInfo;
+}
+
+
+bool RenderUtil::LoadImageFromFile(Render::System* renderSys, const std::string& fileName, Render::Image& outImage,
+	bool generateMipmaps/* = true */, vk::Format imageFormat/* = vk::Format::eR8G8B8A8Srgb */)
+{
+	ImageLoadInfo loadInfo;
+	loadInfo.fileName = fileName;
+	loadInfo.generateMipmaps = generateMipmaps;
+	loadInfo.imageFormat = imageFormat;
+
+	std::vector<Render::Image> loadedImages;
+	if (!LoadImagesFromFiles({ loadInfo }, loadedImages).front())
 	{
-		std::cout << "Failed to load texture file " << first << std::endl;
 		return false;
 	}
 
-	vk::DeviceSize subimageSize = static_cast<uint64_t>(texWidth) * texHeight * 4;
+	outImage = loadedImages.front();
+
+	return true;
+}
+
 
-	pCurPixel = pixels;
+std::vector<bool> RenderUtil::LoadImagesFromFiles(const std::vector<ImageLoadInfo>& loadInfos, std::vector<Render::Image>& outImages,
+	Render::MipGenerator* pMipGenerator /* = nullptr */)
+{
+	auto* backend = Render::Backend::AcquireInstance();
 
-	imageSize += subimageSize;
+	Plume::ThreadPool* pThreadPool = Plume::ThreadPool::AcquireInstance();
 
-	std::vector<uint8_t> images(subimageSize * 6);
+	// decoded images are held until they are staged, so only a few are decoded ahead instead of the whole scene
+	const size_t maxDecodesInFlight = std::max<size_t>(DECODES_IN_FLIGHT_PER_WORKER * pThreadPool->GetNumWorkers(), 1);
 
-	// copy first image into the vector
-	std::memcpy(images.data(), pCurPixel, subimageSize);
+	std::vector<std::future<DecodedImage>> decodes(loadInfos.size());
+	size_t numSubmittedDecodes = 0;
 
-	for (size_t i = 1; i < files.size(); ++i)
+	auto submitDecodes = [&](size_t endId) {
+		for (; numSubmittedDecodes < std::min(endId, loadInfos.size()); ++numSubmittedDecodes)
+		{
+			// every future is waited for below, so the load info outlives the task
+			decodes[numSubmittedDecodes] = pThreadPool->Submit([&loadInfo = loadInfos[numSubmittedDecodes]]() {
+				return DecodeImage(loadInfo);
+			});
+		}
+	};
+
+	outImages.assign(loadInfos.size(), Render::Image{});
+	std::vector<bool> isLoaded(loadInfos.size(), false);
+
+	Render::Buffer::CreateInfo stagingInfo = {};
+	stagingInfo.allocSize = TEXTURE_STAGING_SEGMENT_SIZE;
+	stagingInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+	stagingInfo.memUsage = VMA_MEMORY_USAGE_CPU_ONLY;
+	// images are written to the mapped memory directly
+	stagingInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	stagingInfo.isLifetimeManaged = false;
+
+	// every segment is uploaded with its own upload context, one is filled while the others are copied
+	struct StagingSegment
 	{
-		stbi_image_free(pixels);
+		Render::Buffer buffer;
 
-		pixels = stbi_load(files[i].data(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+		// staging buffer of an image larger than the segment, destroyed once the upload is done
+		Render::Buffer dedicatedBuffer;
+		bool hasDedicatedBuffer = false;
 
-		if (!pixels)
+		// the upload records the compute mips, which are released once it is done
+		bool hasComputeMips = false;
+	};
+
+	std::array<StagingSegment, Render::Backend::NUM_ASYNC_UPLOAD_CONTEXTS> segments;
+	for (StagingSegment& segment : segments)
+	{
+		segment.buffer = backend->CreateBuffer(stagingInfo);
+	}
+
+	uint32_t segmentId = 0;
+	vk::DeviceSize stagingOffset = 0;
+
+	struct PendingUpload
+	{
+		size_t imageId;
+		std::vector<vk::BufferImageCopy> copyRegions;
+		// cooked images come with their mips
+		bool generateMipmaps;
+		bool useComputeMips;
+	};
+
+	std::vector<PendingUpload> pendingUploads;
+
+	// waits for the last upload of the segment, so that it can be refilled
+	auto waitForSegment = [&](uint32_t id) {
+		StagingSegment& segment = segments[id];
+
+		backend->WaitForAsyncUpload(id);
+
+		if (segment.hasDedicatedBuffer)
+		{
+			segment.dedicatedBuffer.DestroyManually();
+			segment.hasDedicatedBuffer = false;
+		}
+
+		if (segment.hasComputeMips)
+		{
+			pMipGenerator->ReleaseRecorded();
+			segment.hasComputeMips = false;
+		}
+	};
+
+	auto flushUploads = [&](const Render::Buffer& srcBuffer) {
+		if (pendingUploads.empty())
+		{
+			return;
+		}
+
+		// no-op for host-coherent memory
+		vmaFlushAllocation(backend->_allocator, srcBuffer.GetAllocation(), 0, VK_WHOLE_SIZE);
+
+		const bool hasComputeMips = std::any_of(pendingUploads.begin(), pendingUploads.end(), [](const PendingUpload& upload) {
+			return upload.useComputeMips;
+		});
+
+		// the mip generator holds the images of one recording at a time
+		if (hasComputeMips)
+		{
+			for (uint32_t id = 0; id < segments.size(); ++id)
+			{
+				if (segments[id].hasComputeMips)
+				{
+					waitForSegment(id);
+				}
+			}
+		}
+
+		backend->SubmitCmdAsync([&](vk::CommandBuffer cmd) {
+			for (const auto& upload : pendingUploads)
+			{
+				RecordImageUpload(cmd, srcBuffer, upload.copyRegions, upload.generateMipmaps, upload.useComputeMips ? pMipGenerator : nullptr,
+					loadInfos[upload.imageId].isNormalMap, outImages[upload.imageId]);
+			}
+
+			if (hasComputeMips)
+			{
+				pMipGenerator->Record(cmd);
+			}
+		}, segmentId);
+
+		segments[segmentId].hasComputeMips = hasComputeMips;
+
+		pendingUploads.clear();
+		stagingOffset = 0;
+
+		segmentId = (segmentId + 1) % Render::Backend::NUM_ASYNC_UPLOAD_CONTEXTS;
+		waitForSegment(segmentId);
+	};
+
+	// images are staged in load order, while the pool keeps decoding the following ones
+	for (size_t i = 0; i < loadInfos.size(); ++i)
+	{
+		submitDecodes(i + maxDecodesInFlight);
+
+		DecodedImage decoded = decodes[i].get();
+
+		if (!decoded.isValid)
 		{
-			std::cout << "Failed to load texture file " << files[i] << std::endl;
-			return false;
+			std::cout << "Failed to load texture file " << loadInfos[i].fileName << std::endl;
+			continue;
 		}
 
-		pCurPixel = pixels;
+		const vk::DeviceSize imageSize = GetStagingSize(loadInfos[i], decoded);
+		const bool generateMipmaps = loadInfos[i].generateMipmaps && !decoded.isCooked;
+		const bool useComputeMips = generateMipmaps && loadInfos[i].useComputeMips && pMipGenerator &&
+			pMipGenerator->IsFormatSupported(loadInfos[i].imageFormat);
+
+		outImages[i] = CreateTextureImage(loadInfos[i], decoded, useComputeMips);
+
+		if (imageSize > TEXTURE_STAGING_SEGMENT_SIZE)
+		{
+			flushUploads(segments[segmentId].buffer);
+
+			StagingSegment& segment = segments[segmentId];
+
+			Render::Buffer::CreateInfo dedicatedStagingInfo = stagingInfo;
+			dedicatedStagingInfo.allocSize = imageSize;
+
+			segment.dedicatedBuffer = backend->CreateBuffer(dedicatedStagingInfo);
+			segment.hasDedicatedBuffer = true;
 
-		subimageSize = static_cast<uint64_t>(texWidth) * texHeight * 4;
-		
-		// fill the rest of the vector
-		std::memcpy(&images[imageSize], pCurPixel, subimageSize);
+			WriteStagingData(loadInfos[i], decoded, static_cast<uint8_t*>(segment.dedicatedBuffer.GetMappedData()));
 
-		imageSize += subimageSize;
+			pendingUploads.push_back({ i, GetCopyRegions(decoded, 0), generateMipmaps, useComputeMips });
+			flushUploads(segment.dedicatedBuffer);
+		}
+		else
+		{
+			vk::DeviceSize alignedOffset = AlignUp(stagingOffset, TEXTURE_STAGING_ALIGNMENT);
+			if (alignedOffset + imageSize > TEXTURE_STAGING_SEGMENT_SIZE)
+			{
+				flushUploads(segments[segmentId].buffer);
+				alignedOffset = 0;
+			}
+
+			uint8_t* pStagingData = static_cast<uint8_t*>(segments[segmentId].buffer.GetMappedData());
+			WriteStagingData(loadInfos[i], decoded, pStagingData + alignedOffset);
+			stagingOffset = alignedOffset + imageSize;
+
+			pendingUploads.push_back({ i, GetCopyRegions(decoded, alignedOffset), generateMipmaps, useComputeMips });
+		}
+
+		isLoaded[i] = true;
+
+		std::cout << "Texture from " << loadInfos[i].fileName << " loaded successfully" << std::endl;
+	}
+
+	flushUploads(segments[segmentId].buffer);
+
+	for (uint32_t id = 0; id < segments.size(); ++id)
+	{
+		waitForSegment(id);
+		segments[id].buffer.DestroyManually();
 	}
-	
-	// reset pointer to front of the vector
-	void* pPixel = images.data();
+
+	return isLoaded;
+}
+
+
+bool RenderUtil::LoadCubemapFromFiles(Render::System* renderSys, const std::vector<std::string>& files,
+	Render::Image& outImage)
+{
+	auto* backend = Render::Backend::AcquireInstance();
 
 	// matching format
 	vk::Format imageFormat = vk::Format::eR8G8B8A8Srgb;
 
-	auto* backend = Render::Backend::AcquireInstance();
+	int texWidth = 0;
+	int texHeight = 0;
+	vk::DeviceSize subimageSize = 0;
 
-	// hold texture data
-	Render::Buffer::CreateInfo stagingInfo = {};
-	stagingInfo.allocSize = imageSize;
-	stagingInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
-	stagingInfo.memUsage = VMA_MEMORY_USAGE_CPU_ONLY;
+	// the staging buffer is sized by the first face, every face is copied into it straight from the decoder
+	Render::Buffer stagingBuffer;
+	uint8_t* pStagingData = nullptr;
+
+	auto failLoad = [&](const std::string& message) {
+		std::cout << message << std::endl;
+
+		if (pStagingData)
+		{
+			stagingBuffer.DestroyManually();
+		}
+
+		return false;
+	};
 
-	Render::Buffer stagingBuffer = backend->CreateBuffer(stagingInfo);
+	for (size_t face = 0; face < files.size(); ++face)
+	{
+		int width, height, texChannels;
+		stbi_uc* pixels = stbi_load(files[face].data(), &width, &height, &texChannels, STBI_rgb_alpha);
+
+		if (!pixels)
+		{
+			return failLoad("Failed to load texture file " + files[face]);
+		}
+
+		if (face == 0)
+		{
+			texWidth = width;
+			texHeight = height;
+			subimageSize = static_cast<uint64_t>(texWidth) * texHeight * 4;
+
+			Render::Buffer::CreateInfo stagingInfo = {};
+			stagingInfo.allocSize = subimageSize * files.size();
+			stagingInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+			stagingInfo.memUsage = VMA_MEMORY_USAGE_CPU_ONLY;
+			stagingInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+			stagingInfo.isLifetimeManaged = false;
+
+			stagingBuffer = backend->CreateBuffer(stagingInfo);
+			pStagingData = static_cast<uint8_t*>(stagingBuffer.GetMappedData());
+		}
+		else if (width != texWidth || height != texHeight)
+		{
+			stbi_image_free(pixels);
+			return failLoad("Cubemap face " + files[face] + " differs in size from the first face");
+		}
 
-	backend->CopyDataToBuffer(pPixel, imageSize, stagingBuffer);
+		std::memcpy(pStagingData + face * subimageSize, pixels, subimageSize);
 
-	stbi_image_free(pixels);
+		stbi_image_free(pixels);
+	}
+
+	// no-op for host-coherent memory
+	vmaFlushAllocation(backend->_allocator, stagingBuffer.GetAllocation(), 0, VK_WHOLE_SIZE);
 
 	vk::Extent3D imageExtent;
 	imageExtent.width = static_cast<uint32_t>(texWidth);
@@ -209,7 +638,7 @@ bool RenderUtil::LoadCubemapFromFiles(Render::System* renderSys, const std::vect
 		std::vector<vk::BufferImageCopy> bufferCopyRegions;
 
 		uint32_t face = 0;
-		for (size_t offset = 0; offset < images.size(); offset += subimageSize)
+		for (size_t offset = 0; offset < subimageSize * files.size(); offset += subimageSize)
 		{
 			vk::BufferImageCopy copyRegion = {};
 			copyRegion.bufferOffset = offset;
@@ -240,6 +669,8 @@ bool RenderUtil::LoadCubemapFromFiles(Render::System* renderSys, const std::vect
 
 	}, backend->GetUploadContext()._commandBuffer);
 
+	stagingBuffer.DestroyManually();
+
 	std::cout << "Cubemap texture loaded successfully" << std::endl;
 
 	return true;
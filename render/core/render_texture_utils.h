@@ -1,12 +1,60 @@
 #pragma once
 
 #include "render_types.h"
-#include "render_system.h"
+#include "render_core.h"
+#include "render_mip_generator.h"
+
+#include "../engine/plm_texture_cooker.h"
+
+namespace Render
+{
+	class System;
+}
 
 namespace RenderUtil
 {
+	struct ImageLoadInfo
+	{
+		std::string fileName;
+		bool generateMipmaps = true;
+		vk::Format imageFormat = vk::Format::eR8G8B8A8Srgb;
+
+		// Generates the mips with the compute downsampler if one is passed to LoadImagesFromFiles() and supports the format,
+		// normal maps are filtered as unit vectors then
+		bool useComputeMips = false;
+		bool isNormalMap = false;
+
+		// Loads the block-compressed texture cooked from the file, imageFormat and generateMipmaps are ignored
+		bool cook = false;
+		Plume::TextureCookSettings cookSettings;
+
+		// Packs the channels of packedSources into one image, fileName is only used for logging then
+		bool isPacked = false;
+		Plume::PackedTextureSources packedSources;
+
+		// images that aren't lifetime managed are destroyed by their owner, see Render::Image::DestroyManually()
+		bool isLifetimeManaged = true;
+
+		// Cooked textures only: loaded by the texture streamer with just their mip tail, finer mips follow on demand
+		bool isStreamed = false;
+		// Streamed textures only: over the memory budget, textures of lower priority drop their finest mips first
+		uint32_t residencyPriority = 0;
+	};
+
+	vk::Format GetCookedFormat(Plume::TextureCompression compression);
+
+	// Sampled image with the full mip chain of the cooked texture
+	Render::Image::CreateInfo GetCookedImageInfo(const Plume::CookedTexture& cooked);
+
 	bool LoadImageFromFile(Render::System* renderSys, const std::string& fileName, Render::Image& outImage,
 		bool generateMipmaps = true, vk::Format imageFormat = vk::Format::eR8G8B8A8Srgb);
 
+	// Decodes or maps the cooked versions of all files on the engine thread pool, a few files ahead of the one being staged.
+	// Decoded images are packed into a ring of staging segments in load order, and every filled segment is uploaded
+	// without waiting while the next one is filled. Returns which images were loaded, outImages has an entry for every
+	// load info.
+	std::vector<bool> LoadImagesFromFiles(const std::vector<ImageLoadInfo>& loadInfos, std::vector<Render::Image>& outImages,
+		Render::MipGenerator* pMipGenerator = nullptr);
+
 	bool LoadCubemapFromFiles(Render::System* renderSys, const std::vector<std::string>& files, Render::Image& outImage);
 }
\ No newline at end of file
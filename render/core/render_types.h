@@ -13,6 +13,7 @@
 
 #include <deque>
 #include <functional>
+#include <vector>
 
 #include "../render/shaders/host_device_common.h"
 
@@ -31,7 +32,7 @@ struct AccelerationStructure
 struct AccelerationStructureBuild
 {
 	vk::AccelerationStructureBuildGeometryInfoKHR _geometryInfo;
-	vk::AccelerationStructureBuildRangeInfoKHR _rangeInfo;
+	std::vector<vk::AccelerationStructureBuildRangeInfoKHR> _rangeInfos;
 	vk::AccelerationStructureBuildSizesInfoKHR _sizesInfo;
 
 	AccelerationStructure _as;
@@ -1,11 +1,20 @@
 #include "render_path_tracing.h"
 
 
-void Render::PathTracing::Init(const Plume::Camera* pCamera)
+void Render::PathTracing::Init(const Plume::Camera* pCamera, Render::Pass::BuildMode buildMode /* = Render::Pass::BuildMode::eImmediate */)
 {
 	_pCamera = pCamera;
 
-	InitPass();
+	InitPass(buildMode);
+}
+
+
+void Render::PathTracing::FinishPendingBuild()
+{
+	if (pass.IsBuildPending())
+	{
+		pass.RequirePipeline();
+	}
 }
 
 
@@ -128,14 +137,14 @@ void Render::PathTracing::InitGBuffer()
 }
 
 
-void Render::PathTracing::InitPass()
+void Render::PathTracing::InitPass(Render::Pass::BuildMode buildMode)
 {
 	Render::Pass::RTInitInfo pathTracingPassInfo = {};
 
 	pathTracingPassInfo.usedDescSets = Render::DescriptorSetFlagBits::eRTXGeneral | Render::DescriptorSetFlagBits::eRTXPerFrame |
 		Render::DescriptorSetFlagBits::eGlobal | Render::DescriptorSetFlagBits::eObjects | Render::DescriptorSetFlagBits::eDiffuseTextures |
-		Render::DescriptorSetFlagBits::eMetallicTextures | Render::DescriptorSetFlagBits::eRoughnessTextures |
-		Render::DescriptorSetFlagBits::eNormalMapTextures | Render::DescriptorSetFlagBits::eSkyboxTextures;
+		Render::DescriptorSetFlagBits::eOrmTextures | Render::DescriptorSetFlagBits::eNormalMapTextures |
+		Render::DescriptorSetFlagBits::eSkyboxTextures;
 
 	std::vector<std::string> ptPassShaders = {
 		"path_tracing.rgen", "path_tracing.rmiss", "trace_shadow.rmiss", "path_tracing.rchit", "path_tracing.rahit"
@@ -149,6 +158,8 @@ void Render::PathTracing::InitPass()
 
 	pathTracingPassInfo.pcInitInfo = pcInitInfo;
 
+	pathTracingPassInfo.buildMode = buildMode;
+
 	pass.InitRT(pathTracingPassInfo);
 }
 
@@ -228,12 +239,17 @@ void Render::PathTracing::RenderPass()
 	_rayConstants.USE_MOTION_VECTORS = backend->_renderCfg.MOTION_VECTORS;
 	_rayConstants.USE_SHADER_EXECUTION_REORDERING = backend->_renderCfg.SHADER_EXECUTION_REORDERING;
 	_rayConstants.USE_TEMPORAL_ACCUMULATION = backend->_renderCfg.TEMPORAL_ACCUMULATION;
+	_rayConstants.USE_COARSE_SECONDARY_LODS = backend->_renderCfg.COARSE_SECONDARY_LODS;
+	_rayConstants.USE_ENVIRONMENT_SAMPLING = backend->_renderCfg.ENVIRONMENT_SAMPLING;
 
 	Render::Backend::PushConstantsInfo pcInfo = {};
 	pcInfo.pData = &_rayConstants;
 	pcInfo.size = sizeof(_rayConstants);
 	pcInfo.shaderStages = vk::ShaderStageFlagBits::eRaygenKHR;
 
+	Render::GpuZone gpuZone(backend->GetGpuProfiler(), backend->GetCurrentCommandBuffer(), "Path Tracing");
+
+	pass.RequirePipeline();
 	backend->TraceRays(pass, &pcInfo, true);
 }
 
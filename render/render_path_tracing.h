@@ -11,9 +11,13 @@ namespace Render
 class PathTracing
 {
 public:
-	void Init(const Plume::Camera* pCamera);
+	void Init(const Plume::Camera* pCamera, Render::Pass::BuildMode buildMode = Render::Pass::BuildMode::eImmediate);
 	void InitResources();
 
+	void RequirePipeline() { pass.RequirePipeline(); }
+	// Waits for an asynchronous pipeline build, lazy builds that haven't started are dropped
+	void FinishPendingBuild();
+
 	void RenderFrame();
 
 	void ResetFrame();
@@ -22,7 +26,7 @@ private:
 	void InitDescriptors() const;
 	void InitFrameContext();
 	void InitGBuffer();
-	void InitPass();
+	void InitPass(Render::Pass::BuildMode buildMode);
 
 	void SwitchFrameImageLayout();
 
@@ -6,8 +6,13 @@
 #include "render_lights.h"
 #include "core/render_rt_backend_utils.h"
 #include "core/render_shader.h"
+#include "../engine/plm_tracer.h"
 
 #include <unordered_map>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
 
 #include "imgui.h"
 #include "imgui_impl_sdl3.h"
@@ -22,7 +27,8 @@ void Render::System::InitBackendAndData(const Render::System::InitData& initData
 
 	Render::Backend* backend = Render::Backend::AcquireInstance();
 	
-	backend->_pWindow = initData.pWindow;
+	backend->_isHeadless = initData.isHeadless;
+	backend->_pWindow = initData.isHeadless ? nullptr : initData.pWindow;
 	backend->_windowExtent = initData.windowExtent;
 	
 	backend->_windowExtent3D.width = backend->_windowExtent.width;
@@ -35,12 +41,16 @@ void Render::System::InitBackendAndData(const Render::System::InitData& initData
 
 void Render::System::Init(const Render::System::InitData& initData)
 {
+	PLM_TRACE_ZONE("Render::System::Init");
+
 	InitBackendAndData(initData);
 
 	Render::Backend* backend = Render::Backend::AcquireInstance();
 
 	_pathTracingManager.InitResources();
 
+	_useCoarseRTLods = _renderMode == RenderMode::ePathTracing && backend->_renderCfg.COARSE_SECONDARY_LODS;
+
 	InitGBufferImages();
 
 	LoadImages();
@@ -49,16 +59,26 @@ void Render::System::Init(const Render::System::InitData& initData)
 
 	InitRenderScene();
 
+	InitClusterCulling();
+
 	InitBLAS();
 
 	InitTLAS();
 
 	backend->AllocateDescriptorSets();
 
+	// with a warm pipeline cache, the driver skips most of the shader compilation
+	const auto passesStart = std::chrono::steady_clock::now();
+
 	InitPasses();
 
 	backend->UpdateDescriptorSets();
 
+	RequireFramePipelines();
+
+	const std::chrono::duration<double, std::milli> passesTime = std::chrono::steady_clock::now() - passesStart;
+	std::cout << "Pipelines of the first frame built in " << passesTime.count() << " ms" << std::endl;
+
 	// everything went well
 	_isInitialized = true;
 }
@@ -118,7 +138,8 @@ void Render::System::SwitchSwapchainImageLayout(uint32_t swapchainImageIndex, bo
 	{
 		transitionInfo.srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite;
 		transitionInfo.oldLayout = vk::ImageLayout::eColorAttachmentOptimal;
-		transitionInfo.newLayout = vk::ImageLayout::ePresentSrcKHR;
+		// offscreen targets are left ready to be copied out, the present layout needs VK_KHR_swapchain
+		transitionInfo.newLayout = backend->_isHeadless ? vk::ImageLayout::eTransferSrcOptimal : vk::ImageLayout::ePresentSrcKHR;
 		transitionInfo.srcStageMask = vk::PipelineStageFlagBits::eColorAttachmentOutput;
 		transitionInfo.dstStageMask = vk::PipelineStageFlagBits::eBottomOfPipe;
 	}
@@ -173,7 +194,8 @@ void Render::System::InitDescriptors()
 {
 	auto* backend = Render::Backend::AcquireInstance();
 
-	const size_t camSceneParamBufferSize = FRAME_OVERLAP * backend->PadUniformBufferSize(sizeof(CameraDataGPU) + sizeof(LightingData));
+	const size_t camSceneParamBufferSize = FRAME_OVERLAP * backend->PadUniformBufferSize(sizeof(CameraDataGPU) + sizeof(LightingData) +
+		sizeof(TextureStreamingGPU) + sizeof(EnvironmentMapGPU));
 
 	Render::Buffer::CreateInfo camSceneParamsInfo;
 	camSceneParamsInfo.allocSize = camSceneParamBufferSize;
@@ -186,11 +208,17 @@ void Render::System::InitDescriptors()
 	camSceneBufferInfo.buffer = _frameCtx.camLightingBuffer.GetHandle();
 	camSceneBufferInfo.bufferType = vk::DescriptorType::eUniformBufferDynamic;
 	camSceneBufferInfo.offset = 0;
-	camSceneBufferInfo.range = sizeof(CameraDataGPU) + sizeof(LightingData);
+	camSceneBufferInfo.range = sizeof(CameraDataGPU) + sizeof(LightingData) + sizeof(TextureStreamingGPU) + sizeof(EnvironmentMapGPU);
 
-	backend->RegisterBuffer(Render::RegisteredDescriptorSet::eGlobal, vk::ShaderStageFlagBits::eVertex |
-		vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR,
-		{ camSceneBufferInfo }, 0);
+	// every stage sampling material textures reads the texture streaming data
+	vk::ShaderStageFlags camSceneStages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment |
+		vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eClosestHitKHR | vk::ShaderStageFlagBits::eAnyHitKHR;
+	if (backend->AreMeshShadersSupported())
+	{
+		camSceneStages |= vk::ShaderStageFlagBits::eMeshEXT;
+	}
+
+	backend->RegisterBuffer(Render::RegisteredDescriptorSet::eGlobal, camSceneStages, { camSceneBufferInfo }, 0);
 
 	std::vector<Render::DescriptorManager::BufferInfo> objectBufferInfos(FRAME_OVERLAP);
 
@@ -205,10 +233,10 @@ void Render::System::InitDescriptors()
 
 	for (int i = 0; i < FRAME_OVERLAP; ++i)
 	{
-		constexpr int MAX_OBJECTS = 10000;
 		Render::Buffer::CreateInfo objectBufferCreateInfo;
 		objectBufferCreateInfo.allocSize = sizeof(ObjectData) * MAX_OBJECTS;
-		objectBufferCreateInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+		// cluster culling reads objects through buffer references
+		objectBufferCreateInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress;
 		objectBufferCreateInfo.memUsage = VMA_MEMORY_USAGE_CPU_TO_GPU;
 
 		backend->_frames[i]._objectBuffer = backend->CreateBuffer(objectBufferCreateInfo);
@@ -262,8 +290,8 @@ void Render::System::InitGeometryPass()
 	Render::Pass::InitInfo geometryPassInfo = {};
 
 	geometryPassInfo.usedDescSets = Render::DescriptorSetFlagBits::eGlobal | Render::DescriptorSetFlagBits::eObjects |
-		Render::DescriptorSetFlagBits::eDiffuseTextures | Render::DescriptorSetFlagBits::eMetallicTextures |
-		Render::DescriptorSetFlagBits::eRoughnessTextures | Render::DescriptorSetFlagBits::eNormalMapTextures | Render::DescriptorSetFlagBits::eTLAS;
+		Render::DescriptorSetFlagBits::eDiffuseTextures | Render::DescriptorSetFlagBits::eOrmTextures |
+		Render::DescriptorSetFlagBits::eNormalMapTextures | Render::DescriptorSetFlagBits::eTLAS;
 	geometryPassInfo.cullMode = vk::CullModeFlagBits::eNone;
 
 	std::vector<Render::Pass::AttachmentStateInfo> gBufferAttachmentInfos(NUM_GBUFFER_ATTACHMENTS);
@@ -287,8 +315,58 @@ void Render::System::InitGeometryPass()
 
 	geometryPassInfo.useVertexAttributes = true;
 
+	geometryPassInfo.buildMode = GetHybridPassBuildMode();
+
 	auto geometryPassId = static_cast<size_t>(Render::Pass::Type::eGeometryPass);
 	_renderPasses[geometryPassId].Init(geometryPassInfo);
+
+	// cluster draws add to what the regular draws of the frame have written
+	for (auto& attachmentInfo : gBufferAttachmentInfos)
+	{
+		attachmentInfo.loadOp = vk::AttachmentLoadOp::eLoad;
+	}
+	depthAttachment.loadOp = vk::AttachmentLoadOp::eLoad;
+
+	auto clusterGeometryPassId = static_cast<size_t>(Render::Pass::Type::eClusterGeometryPass);
+	_renderPasses[clusterGeometryPassId].Init(geometryPassInfo);
+
+	auto* backend = Render::Backend::AcquireInstance();
+	if (!backend->AreMeshShadersSupported())
+	{
+		return;
+	}
+
+	std::vector<std::string> meshletGeometryPassShaders = {
+		"meshlet_geometry_pass.task", "meshlet_geometry_pass.mesh", "geometry_pass.frag"
+	};
+
+	geometryPassInfo.pShaderNames = &meshletGeometryPassShaders;
+
+	geometryPassInfo.useVertexAttributes = false;
+
+	Render::Pass::PushConstantsInitInfo pcInitInfo;
+	pcInitInfo.pcBufferSize = sizeof(ClusterCullPushConstants);
+	pcInitInfo.stageFlags = vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+
+	geometryPassInfo.pcInitInfo = pcInitInfo;
+
+	auto meshletGeometryPassId = static_cast<size_t>(Render::Pass::Type::eMeshletGeometryPass);
+	_renderPasses[meshletGeometryPassId].Init(geometryPassInfo);
+}
+
+
+void Render::System::InitClusterCullingPass()
+{
+	Render::Pass::ComputeInitInfo clusterCullingInfo = {};
+
+	clusterCullingInfo.shaderName = "cluster_culling.comp";
+	clusterCullingInfo.pcInitInfo.pcBufferSize = sizeof(ClusterCullPushConstants);
+	clusterCullingInfo.pcInitInfo.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+	clusterCullingInfo.buildMode = GetHybridPassBuildMode();
+
+	auto clusterCullingId = static_cast<size_t>(Render::Pass::Type::eClusterCulling);
+	_renderPasses[clusterCullingId].InitCompute(clusterCullingInfo);
 }
 
 
@@ -324,6 +402,8 @@ void Render::System::InitLightingPass()
 
 	lightingPassInfo.pShaderNames = &lightingPassShaders;
 
+	lightingPassInfo.buildMode = GetHybridPassBuildMode();
+
 	auto lightingPassId = static_cast<size_t>(Render::Pass::Type::eLightingPass);
 	_renderPasses[lightingPassId].Init(lightingPassInfo);
 }
@@ -373,6 +453,9 @@ void Render::System::InitPostprocessPass()
 
 	postprocessPassInfo.pcInitInfo = pcInitInfo;
 
+	// used by both render modes
+	postprocessPassInfo.buildMode = Render::Pass::BuildMode::eAsync;
+
 	auto postprocessPassId = static_cast<size_t>(Render::Pass::Type::ePostprocess);
 	_renderPasses[postprocessPassId].Init(postprocessPassInfo);
 }
@@ -411,6 +494,8 @@ void Render::System::InitSkyPass()
 
 	skyboxPassInfo.useVertexAttributes = true;
 
+	skyboxPassInfo.buildMode = GetHybridPassBuildMode();
+
 	auto skyboxPassId = static_cast<size_t>(Render::Pass::Type::eSky);
 	_renderPasses[skyboxPassId].Init(skyboxPassInfo);
 }
@@ -418,20 +503,57 @@ void Render::System::InitSkyPass()
 
 void Render::System::InitPasses()
 {
+	PLM_TRACE_ZONE("InitPasses");
+
 	InitGeometryPass();
 
+	InitClusterCullingPass();
+
 	InitLightingPass();
 
 	InitPostprocessPass();
 
 	InitSkyPass();
 
-	_pathTracingManager.Init(_pCamera);
+	_pathTracingManager.Init(_pCamera, (_renderMode == RenderMode::ePathTracing) ? Render::Pass::BuildMode::eAsync :
+		Render::Pass::BuildMode::eLazy);
+}
+
+
+Render::Pass::BuildMode Render::System::GetHybridPassBuildMode()
+{
+	return (_renderMode == RenderMode::eHybrid) ? Render::Pass::BuildMode::eAsync : Render::Pass::BuildMode::eLazy;
+}
+
+
+void Render::System::RequireFramePipelines()
+{
+	PLM_TRACE_ZONE("RequireFramePipelines");
+
+	std::vector<Render::Pass::Type> framePassTypes = { Render::Pass::Type::ePostprocess };
+
+	if (_renderMode == RenderMode::eHybrid)
+	{
+		framePassTypes.insert(framePassTypes.end(), { Render::Pass::Type::eGeometryPass, Render::Pass::Type::eLightingPass,
+			Render::Pass::Type::eSky });
+	}
+	else if (_renderMode == RenderMode::ePathTracing)
+	{
+		_pathTracingManager.RequirePipeline();
+	}
+
+	// the cluster passes depend on settings that change at runtime, they are waited for when first used
+	for (auto passType : framePassTypes)
+	{
+		_renderPasses[static_cast<size_t>(passType)].RequirePipeline();
+	}
 }
 
 
 void Render::System::InitBLAS()
 {
+	PLM_TRACE_ZONE("InitBLAS");
+
 	auto* backend = Render::Backend::AcquireInstance();
 
 	std::vector<Render::Backend::BLASInput> blasInputs;
@@ -439,9 +561,86 @@ void Render::System::InitBLAS()
 	vk::GeometryFlagBitsKHR blasGeometryFlags = (_renderMode == RenderMode::ePathTracing) ?
 		vk::GeometryFlagBitsKHR::eNoDuplicateAnyHitInvocation : vk::GeometryFlagBitsKHR::eOpaque;
 
+	struct BLASIds
+	{
+		uint32_t detailed = 0;
+		uint32_t coarse = 0;
+	};
+
+	// Either one BLAS per unique geometry or one per model. Placements of the same geometry (or model) only differ
+	// in their TLAS instances.
+	std::unordered_map<uint32_t, BLASIds> blasIdsByGeometry;
+	std::unordered_map<const Plume::Model*, BLASIds> blasIdsByModel;
+
+	auto addBlasInputs = [&]() {
+		BLASIds ids;
+		ids.detailed = static_cast<uint32_t>(blasInputs.size());
+		blasInputs.emplace_back();
+
+		if (_useCoarseRTLods)
+		{
+			ids.coarse = static_cast<uint32_t>(blasInputs.size());
+			blasInputs.emplace_back();
+		}
+
+		return ids;
+	};
+
+	auto addMeshToBlasInputs = [&](const Render::Object& object) {
+		backend->AddMeshToBlasInput(object.mesh, blasGeometryFlags, blasInputs[object.blasId]);
+
+		if (_useCoarseRTLods)
+		{
+			backend->AddMeshToBlasInput(object.mesh, blasGeometryFlags, blasInputs[object.coarseBlasId],
+				object.mesh.GetNumOfLods() - 1);
+		}
+	};
+
 	for (size_t i = 0; i < _renderables.size() - 1; ++i)
 	{
-		blasInputs.emplace_back(backend->ConvertMeshToBlasInput(_renderables[i].mesh, blasGeometryFlags));
+		Render::Object& object = _renderables[i];
+
+		if (_useModelBLAS)
+		{
+			auto blasIt = blasIdsByModel.find(object.model);
+			if (blasIt == blasIdsByModel.end())
+			{
+				blasIt = blasIdsByModel.emplace(object.model, addBlasInputs()).first;
+			}
+
+			object.blasId = blasIt->second.detailed;
+			object.coarseBlasId = blasIt->second.coarse;
+
+			// objects of a placement are contiguous and ordered like the model's meshes, the first placement fills the BLAS
+			const size_t numBlasGeometries = blasInputs[object.blasId]._geometries.size();
+			if (numBlasGeometries < object.model->meshes.size())
+			{
+				object.blasGeometryIndex = static_cast<uint32_t>(numBlasGeometries);
+				addMeshToBlasInputs(object);
+			}
+			else
+			{
+				object.blasGeometryIndex = static_cast<uint32_t>(_renderables[i - 1].model == object.model ?
+					(_renderables[i - 1].blasGeometryIndex + 1) % object.model->meshes.size() : 0);
+			}
+		}
+		else
+		{
+			auto blasIt = blasIdsByGeometry.find(object.mesh.geometryId);
+			const bool isNewGeometry = blasIt == blasIdsByGeometry.end();
+			if (isNewGeometry)
+			{
+				blasIt = blasIdsByGeometry.emplace(object.mesh.geometryId, addBlasInputs()).first;
+			}
+
+			object.blasId = blasIt->second.detailed;
+			object.coarseBlasId = blasIt->second.coarse;
+
+			if (isNewGeometry)
+			{
+				addMeshToBlasInputs(object);
+			}
+		}
 	}
 
 	RenderBackendRTUtils::BuildBLAS(this, blasInputs);
@@ -450,19 +649,42 @@ void Render::System::InitBLAS()
 
 void Render::System::InitTLAS()
 {
+	PLM_TRACE_ZONE("InitTLAS");
+
 	std::vector<vk::AccelerationStructureInstanceKHR> tlas;
-	tlas.reserve(_renderables.size() - 1);
+	tlas.reserve((_renderables.size() - 1) * (_useCoarseRTLods ? 2 : 1));
+
+	// without coarse instances, rays of both kinds have to hit the detailed ones
+	const uint32_t detailedMask = _useCoarseRTLods ? RT_MASK_DETAILED : (RT_MASK_DETAILED | RT_MASK_COARSE);
+
+	// ObjectData of coarse instances is stored after the one of all renderables
+	const auto numObjects = static_cast<uint32_t>(_renderables.size());
 
 	for (uint32_t i = 0; i < _renderables.size() - 1; ++i)
 	{
+		// the remaining geometries of a multi-geometry BLAS are covered by the instance of its first object
+		if (_renderables[i].blasGeometryIndex != 0)
+		{
+			continue;
+		}
+
 		vk::AccelerationStructureInstanceKHR accelInst;
 		accelInst.setTransform(RenderBackendRTUtils::ConvertToTransformKHR(_renderables[i].transformMatrix));
 		accelInst.setInstanceCustomIndex(i);
-		accelInst.setAccelerationStructureReference(RenderBackendRTUtils::GetBLASDeviceAddress(this, i));
+		accelInst.setAccelerationStructureReference(RenderBackendRTUtils::GetBLASDeviceAddress(this, _renderables[i].blasId));
 		accelInst.setFlags(vk::GeometryInstanceFlagBitsKHR::eTriangleFacingCullDisable);
-		accelInst.setMask(0xFF);
+		accelInst.setMask(detailedMask);
 
 		tlas.emplace_back(accelInst);
+
+		if (_useCoarseRTLods)
+		{
+			accelInst.setInstanceCustomIndex(numObjects + i);
+			accelInst.setAccelerationStructureReference(RenderBackendRTUtils::GetBLASDeviceAddress(this, _renderables[i].coarseBlasId));
+			accelInst.setMask(RT_MASK_COARSE);
+
+			tlas.emplace_back(accelInst);
+		}
 	}
 
 	RenderBackendRTUtils::BuildTLAS(this, tlas);
@@ -477,20 +699,6 @@ void Render::System::InitTLAS()
 }
 
 
-bool Render::System::LoadMaterialTexture(Render::Image& tex, const std::string& texName, const std::string& matName,
-	uint32_t texSlot, bool generateMipmaps/* = true */, vk::Format format/* = vk::Format::eR8G8B8A8Srgb */)
-{
-	if (texName.empty() || !RenderUtil::LoadImageFromFile(this, texName, tex, generateMipmaps, format))
-	{
-		return false;
-	}
-
-	_loadedTextures[matName][texSlot] = tex;
-
-	return true;
-}
-
-
 void Render::System::LoadSkybox(Render::Image& skybox, const std::string& directory)
 {
 	std::vector<std::string> files = {
@@ -510,135 +718,191 @@ void Render::System::LoadSkybox(Render::Image& skybox, const std::string& direct
 
 void Render::System::LoadImages()
 {
+	PLM_TRACE_ZONE("LoadImages");
+
 	auto* backend = Render::Backend::AcquireInstance();
 
 	vk::Sampler smoothSampler = backend->GetSampler(Render::SamplerType::eLinearRepeatAnisotropic);
 
-	Render::Image defaultTex = {};
-
-	RenderUtil::LoadImageFromFile(this, "../../../assets/null-texture.png", defaultTex);
-
-	Render::DescriptorManager::ImageInfo texInfo;
-	texInfo.imageType = vk::DescriptorType::eCombinedImageSampler;
-	texInfo.sampler = smoothSampler;
-	texInfo.layout = vk::ImageLayout::eShaderReadOnlyOptimal;
-
 	ASSERT(_pScene != nullptr, "Invalid scene");
 	const Plume::Scene& scene = *_pScene;
 
-	std::vector<Render::DescriptorManager::ImageInfo> diffuseInfos(scene.diffuseTexNames.size());
+	ASSERT(scene.metallicTexNames.size() == scene.roughnessTexNames.size(), "Metallic and roughness texture tables differ");
 
-	for (size_t i = 0; i < scene.diffuseTexNames.size(); ++i)
-	{
-		Render::Image diffuse = {};
+	// ORM textures come from the metallic and roughness textures, see getOrmLoadInfo
+	const std::array<const std::vector<std::string>*, NUM_MATERIAL_TEXTURE_TYPES> texNames = {
+		&scene.diffuseTexNames, &scene.metallicTexNames, &scene.normalMapNames
+	};
 
-		if (!scene.diffuseTexNames[i].empty())
+	auto getTexFormat = [](uint32_t texSlot) {
+		switch (texSlot)
 		{
-			bool loadRes = LoadMaterialTexture(diffuse, scene.diffuseTexNames[i], scene.matNames[i], DIFFUSE_TEX_SLOT);
+		case ORM_TEX_SLOT:
+			return vk::Format::eR8G8B8A8Unorm;
+		case NORMAL_MAP_SLOT:
+			return vk::Format::eR32G32B32A32Sfloat;
+		default:
+			return vk::Format::eR8G8B8A8Srgb;
+		}
+	};
 
-			if (!loadRes)
-			{
-				_loadedTextures[scene.matNames[i]][DIFFUSE_TEX_SLOT] = defaultTex;
-			}
+	auto getCookSettings = [](uint32_t texSlot) {
+		Plume::TextureCookSettings cookSettings;
+		switch (texSlot)
+		{
+		case DIFFUSE_TEX_SLOT:
+			cookSettings.compression = Plume::TextureCompression::eBC7;
+			break;
+		case ORM_TEX_SLOT:
+			cookSettings.compression = Plume::TextureCompression::eBC7Linear;
+			break;
+		case NORMAL_MAP_SLOT:
+			cookSettings.compression = Plume::TextureCompression::eBC5;
+			break;
 		}
-		else
+		return cookSettings;
+	};
+
+	// over the memory budget, ORM textures drop their finest mips first and diffuse textures last
+	auto getResidencyPriority = [](uint32_t texSlot) {
+		switch (texSlot)
 		{
-			_loadedTextures[scene.matNames[i]][DIFFUSE_TEX_SLOT] = defaultTex;
+		case DIFFUSE_TEX_SLOT:
+			return 2u;
+		case NORMAL_MAP_SLOT:
+			return 1u;
+		default:
+			return 0u;
 		}
-		
-		diffuseInfos[i] = texInfo;
-		diffuseInfos[i].imageView = _loadedTextures[scene.matNames[i]][DIFFUSE_TEX_SLOT].GetView();
-	}
+	};
 
-	backend->RegisterImage(Render::RegisteredDescriptorSet::eDiffuseTextures, vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eRaygenKHR |
-		vk::ShaderStageFlagBits::eAnyHitKHR, diffuseInfos, 0, static_cast<uint32_t>(scene.diffuseTexNames.size()),
-		true);
+	// Roughness and metallic are read from the green and blue channels. glTF metallicRoughness textures are laid out
+	// like that already and are referenced as both, separate masks are packed into one texture.
+	auto getOrmLoadInfo = [&scene](size_t matId, RenderUtil::ImageLoadInfo& outLoadInfo) {
+		const std::string& metallicName = scene.metallicTexNames[matId];
+		const std::string& roughnessName = scene.roughnessTexNames[matId];
+
+		if (metallicName == roughnessName)
+		{
+			outLoadInfo.fileName = metallicName;
+			return;
+		}
+
+		outLoadInfo.fileName = metallicName.empty() ? roughnessName : metallicName;
+		outLoadInfo.isPacked = true;
 
+		// no occlusion, missing masks match the black default texture
+		outLoadInfo.packedSources[0].fillValue = 255;
+		outLoadInfo.packedSources[1].fileName = roughnessName;
+		outLoadInfo.packedSources[2].fileName = metallicName;
+		outLoadInfo.packedSources[3].fillValue = 255;
+	};
 
-	std::vector<Render::DescriptorManager::ImageInfo> metallicInfos(scene.metallicTexNames.size());
-	for (size_t i = 0; i < scene.metallicTexNames.size(); ++i)
+	// one feedback entry per material texture slot
+	if (_useTextureStreaming)
 	{
-		Render::Image metallic = {};
+		const size_t numMaterials = std::max({ scene.diffuseTexNames.size(), scene.metallicTexNames.size(), scene.normalMapNames.size() });
+		_textureStreamer.Init(static_cast<uint32_t>(numMaterials * STREAMED_TEXTURE_SLOTS));
+	}
 
-		if (!scene.metallicTexNames[i].empty())
-		{
-			bool loadRes = LoadMaterialTexture(metallic, scene.metallicTexNames[i], scene.matNames[i], METALLIC_TEX_SLOT);
+	if (_useComputeMips)
+	{
+		_mipGenerator.Init();
+	}
 
-			if (!loadRes)
-			{
-				_loadedTextures[scene.matNames[i]][METALLIC_TEX_SLOT] = defaultTex;
-			}
-		}
-		else
-		{
-			_loadedTextures[scene.matNames[i]][METALLIC_TEX_SLOT] = defaultTex;
-		}
+	_textureRegistry.Init(_useTextureStreaming ? &_textureStreamer : nullptr, _useComputeMips ? &_mipGenerator : nullptr);
 
-		metallicInfos[i] = texInfo;
-		metallicInfos[i].imageView = _loadedTextures[scene.matNames[i]][METALLIC_TEX_SLOT].GetView();
-	}
+	RenderUtil::ImageLoadInfo defaultTexLoadInfo;
+	defaultTexLoadInfo.fileName = "../../../assets/null-texture.png";
+	defaultTexLoadInfo.useComputeMips = _useComputeMips;
 
-	backend->RegisterImage(Render::RegisteredDescriptorSet::eMetallicTextures, vk::ShaderStageFlagBits::eFragment |
-		vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eAnyHitKHR,
-		metallicInfos, 0, static_cast<uint32_t>(scene.metallicTexNames.size()), true);
+	RenderUtil::ImageLoadInfo defaultNormalLoadInfo;
+	defaultNormalLoadInfo.fileName = "../../../assets/null-normal.png";
+	defaultNormalLoadInfo.imageFormat = getTexFormat(NORMAL_MAP_SLOT);
+	defaultNormalLoadInfo.useComputeMips = _useComputeMips;
+	defaultNormalLoadInfo.isNormalMap = true;
 
+	const Render::TextureRegistry::TextureId defaultTexId = _textureRegistry.Acquire(defaultTexLoadInfo);
+	const Render::TextureRegistry::TextureId defaultNormalId = _textureRegistry.Acquire(defaultNormalLoadInfo);
 
-	std::vector<Render::DescriptorManager::ImageInfo> roughnessInfos(scene.roughnessTexNames.size());
-	for (size_t i = 0; i < scene.roughnessTexNames.size(); ++i)
+	// materials referencing the same file share its texture, all unique textures are loaded in one batch
+	for (uint32_t texSlot = 0; texSlot < NUM_MATERIAL_TEXTURE_TYPES; ++texSlot)
 	{
-		Render::Image roughness = {};
+		_materialTextures[texSlot].assign(texNames[texSlot]->size(), Render::TextureRegistry::INVALID_TEXTURE_ID);
 
-		if (!scene.roughnessTexNames[i].empty())
+		for (size_t i = 0; i < texNames[texSlot]->size(); ++i)
 		{
-			bool loadRes = LoadMaterialTexture(roughness, scene.roughnessTexNames[i], scene.matNames[i], ROUGHNESS_TEX_SLOT);
+			RenderUtil::ImageLoadInfo loadInfo;
+			if (texSlot == ORM_TEX_SLOT)
+			{
+				getOrmLoadInfo(i, loadInfo);
+			}
+			else
+			{
+				loadInfo.fileName = (*texNames[texSlot])[i];
+			}
 
-			if (!loadRes)
+			if (loadInfo.fileName.empty())
 			{
-				_loadedTextures[scene.matNames[i]][ROUGHNESS_TEX_SLOT] = defaultTex;
+				continue;
 			}
-		}
-		else
-		{
-			_loadedTextures[scene.matNames[i]][ROUGHNESS_TEX_SLOT] = defaultTex;
-		}
 
-		roughnessInfos[i] = texInfo;
-		roughnessInfos[i].imageView = _loadedTextures[scene.matNames[i]][ROUGHNESS_TEX_SLOT].GetView();
-	}
+			loadInfo.imageFormat = getTexFormat(texSlot);
+			loadInfo.useComputeMips = _useComputeMips;
+			loadInfo.isNormalMap = texSlot == NORMAL_MAP_SLOT;
+			loadInfo.cook = _useCompressedTextures;
+			loadInfo.cookSettings = getCookSettings(texSlot);
+			loadInfo.isStreamed = _useTextureStreaming;
+			loadInfo.residencyPriority = getResidencyPriority(texSlot);
 
-	backend->RegisterImage(Render::RegisteredDescriptorSet::eRoughnessTextures, vk::ShaderStageFlagBits::eFragment |
-		vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eAnyHitKHR, roughnessInfos, 0,
-		static_cast<uint32_t>(scene.roughnessTexNames.size()), true);
+			_materialTextures[texSlot][i] = _textureRegistry.Acquire(loadInfo);
+		}
+	}
 
+	_textureRegistry.LoadPending();
 
-	Render::Image defaultNormal = {};
+	ASSERT(_textureRegistry.IsLoaded(defaultTexId) && _textureRegistry.IsLoaded(defaultNormalId), "Failed to load default textures");
 
-	RenderUtil::LoadImageFromFile(this, "../../../assets/null-normal.png", defaultNormal, true,
-		vk::Format::eR32G32B32A32Sfloat);
+	Render::DescriptorManager::ImageInfo texInfo;
+	texInfo.imageType = vk::DescriptorType::eCombinedImageSampler;
+	texInfo.sampler = smoothSampler;
+	texInfo.layout = vk::ImageLayout::eShaderReadOnlyOptimal;
 
-	std::vector<Render::DescriptorManager::ImageInfo> normalMapInfos(scene.normalMapNames.size());
-	for (size_t i = 0; i < scene.normalMapNames.size(); ++i)
+	// missing and failed textures fall back to the defaults
+	std::array<std::vector<Render::DescriptorManager::ImageInfo>, NUM_MATERIAL_TEXTURE_TYPES> texInfos;
+	for (uint32_t texSlot = 0; texSlot < NUM_MATERIAL_TEXTURE_TYPES; ++texSlot)
 	{
-		Render::Image normalMap = {};
-
-		bool loadRes = LoadMaterialTexture(normalMap, scene.normalMapNames[i], scene.matNames[i], NORMAL_MAP_SLOT,
-			true, vk::Format::eR32G32B32A32Sfloat);
+		const Render::TextureRegistry::TextureId defaultId = texSlot == NORMAL_MAP_SLOT ? defaultNormalId : defaultTexId;
 
-		if (!loadRes)
-		{
-			_loadedTextures[scene.matNames[i]][NORMAL_MAP_SLOT] = defaultNormal;
-		}
-		else
+		texInfos[texSlot].resize(texNames[texSlot]->size(), texInfo);
+		for (size_t i = 0; i < texInfos[texSlot].size(); ++i)
 		{
-			_loadedTextures[scene.matNames[i]][NORMAL_MAP_SLOT] = normalMap;
-		}
+			Render::TextureRegistry::TextureId textureId = _materialTextures[texSlot][i];
+			if (textureId == Render::TextureRegistry::INVALID_TEXTURE_ID || !_textureRegistry.IsLoaded(textureId))
+			{
+				textureId = defaultId;
+			}
 
-		normalMapInfos[i] = texInfo;
-		normalMapInfos[i].imageView = _loadedTextures[scene.matNames[i]][NORMAL_MAP_SLOT].GetView();
+			texInfos[texSlot][i].imageView = _textureRegistry.GetImage(textureId).GetView();
+
+			const Render::TextureStreamer::TextureId streamedId = _textureRegistry.GetStreamedId(textureId);
+			if (streamedId != Render::TextureStreamer::INVALID_TEXTURE_ID)
+			{
+				_textureStreamer.SetEntryTexture(static_cast<uint32_t>(i * STREAMED_TEXTURE_SLOTS + texSlot), streamedId);
+			}
+		}
 	}
 
+	backend->RegisterImage(Render::RegisteredDescriptorSet::eDiffuseTextures, vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eRaygenKHR |
+		vk::ShaderStageFlagBits::eAnyHitKHR, texInfos[DIFFUSE_TEX_SLOT], 0, static_cast<uint32_t>(scene.diffuseTexNames.size()),
+		true);
+
+	backend->RegisterImage(Render::RegisteredDescriptorSet::eOrmTextures, vk::ShaderStageFlagBits::eFragment |
+		vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eAnyHitKHR,
+		texInfos[ORM_TEX_SLOT], 0, static_cast<uint32_t>(scene.metallicTexNames.size()), true);
+
 	backend->RegisterImage(Render::RegisteredDescriptorSet::eNormalMapTextures, vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eClosestHitKHR |
-		vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eAnyHitKHR, normalMapInfos,
+		vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eAnyHitKHR, texInfos[NORMAL_MAP_SLOT],
 		0, static_cast<uint32_t>(scene.normalMapNames.size()), true);
 
 
@@ -652,36 +916,179 @@ void Render::System::LoadImages()
 
 	backend->RegisterImage(Render::RegisteredDescriptorSet::eSkyboxTextures, vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eRaygenKHR |
 		vk::ShaderStageFlagBits::eMissKHR, { skyboxInfo }, 0);
+
+	// without an HDR file, the path tracer keeps its constant sky
+	_environmentMap.Init("../../../assets/skybox/environment.hdr", glm::vec3(253.0f / 255.0f, 251.0f / 255.0f, 211.0f / 255.0f) * 5.0f);
+
+	Render::DescriptorManager::ImageInfo environmentMapInfo;
+	environmentMapInfo.imageView = _environmentMap.GetImage().GetView();
+	environmentMapInfo.imageType = vk::DescriptorType::eCombinedImageSampler;
+	environmentMapInfo.layout = vk::ImageLayout::eShaderReadOnlyOptimal;
+	// repeating would blend the poles into each other
+	environmentMapInfo.sampler = backend->GetSampler(Render::SamplerType::eLinearClamp);
+
+	backend->RegisterImage(Render::RegisteredDescriptorSet::eSkyboxTextures, vk::ShaderStageFlagBits::eRaygenKHR | vk::ShaderStageFlagBits::eMissKHR,
+		{ environmentMapInfo }, 1);
 }
 
 
 void Render::System::InitRenderScene()
 {
+	PLM_TRACE_ZONE("InitRenderScene");
+
 	ASSERT(_pScene != nullptr, "Invalid scene");
 
 	auto* backend = Render::Backend::AcquireInstance();
 
 	const auto& models = _pScene->models;
 
+	std::vector<const Plume::Mesh*> engineMeshes;
 	for (const auto& [name, model] : models)
 	{
 		for (const Plume::Mesh& mesh : model.meshes)
 		{
-			Render::Object object = {};
-			object.model = &model;
-			object.transformMatrix = model.transformMatrix;
-			object.mesh = backend->UploadMesh(mesh);
+			engineMeshes.push_back(&mesh);
+		}
+	}
+
+	std::vector<Render::Mesh> gpuMeshes = backend->UploadMeshes(engineMeshes);
 
-			if (name != "skybox")
+	size_t firstMeshId = 0;
+	for (const auto& [name, model] : models)
+	{
+		if (name == "skybox")
+		{
+			if (!model.meshes.empty() && !model.instanceTransforms.empty())
 			{
-				_renderables.push_back(std::move(object));
+				_skyboxObject.model = &model;
+				_skyboxObject.transformMatrix = model.instanceTransforms.front();
+				_skyboxObject.mesh = gpuMeshes[firstMeshId];
 			}
-			else
+		}
+		else
+		{
+			// every placement gets its own objects (and ObjectData), while the geometry is shared
+			for (const glm::mat4& instanceTransform : model.instanceTransforms)
 			{
-				_skyboxObject = std::move(object);
+				for (size_t i = 0; i < model.meshes.size(); ++i)
+				{
+					Render::Object object = {};
+					object.model = &model;
+					object.transformMatrix = instanceTransform;
+					object.mesh = gpuMeshes[firstMeshId + i];
+
+					_renderables.push_back(std::move(object));
+				}
 			}
 		}
+
+		firstMeshId += model.meshes.size();
+	}
+}
+
+
+void Render::System::InitClusterCulling()
+{
+	PLM_TRACE_ZONE("InitClusterCulling");
+
+	auto* backend = Render::Backend::AcquireInstance();
+
+	std::vector<Render::Backend::IndirectDrawBatch> batches;
+	std::vector<std::vector<ClusterData>> batchClusters;
+
+	for (uint32_t objectId = 0; objectId < _renderables.size(); ++objectId)
+	{
+		const Render::Object& object = _renderables[objectId];
+		const Render::Mesh& mesh = object.mesh;
+
+		if (!object.model || !mesh.pEngineMesh || mesh.pEngineMesh->GetMeshlets().empty())
+		{
+			continue;
+		}
+
+		auto batchIt = std::find_if(batches.begin(), batches.end(), [&](const Render::Backend::IndirectDrawBatch& batch) {
+			return batch.vertexBuffer == mesh.vertexRange.buffer && batch.indexBuffer == mesh.indexRange.buffer &&
+				batch.indexType == mesh.indexType;
+		});
+
+		if (batchIt == batches.end())
+		{
+			Render::Backend::IndirectDrawBatch batch = {};
+			batch.vertexBuffer = mesh.vertexRange.buffer;
+			batch.indexBuffer = mesh.indexRange.buffer;
+			batch.indexType = mesh.indexType;
+
+			batches.push_back(batch);
+			batchClusters.emplace_back();
+			batchIt = std::prev(batches.end());
+		}
+
+		std::vector<ClusterData>& clusters = batchClusters[std::distance(batches.begin(), batchIt)];
+
+		// meshlet triangles follow the order of the mesh index buffer
+		for (const Plume::Meshlet& meshlet : mesh.pEngineMesh->GetMeshlets())
+		{
+			ClusterData cluster = {};
+			cluster.boundsCenter = meshlet.center;
+			cluster.boundsRadius = meshlet.radius;
+			cluster.coneAxis = meshlet.coneAxis;
+			cluster.coneCutoff = meshlet.coneCutoff;
+
+			cluster.objectId = objectId;
+			cluster.indexCount = meshlet.triangleCount * 3;
+			cluster.firstIndex = mesh.GetFirstIndex() + meshlet.triangleOffset * 3;
+			cluster.vertexOffset = mesh.GetVertexOffset();
+
+			cluster.vertexCount = meshlet.vertexCount;
+			cluster.triangleCount = meshlet.triangleCount;
+			cluster.meshletVerticesAddress = mesh.meshletVerticesRange.deviceAddress + meshlet.vertexOffset * sizeof(uint32_t);
+			cluster.meshletTrianglesAddress = mesh.meshletTrianglesRange.deviceAddress + meshlet.triangleOffset * sizeof(uint32_t);
+
+			clusters.push_back(cluster);
+		}
+	}
+
+	std::vector<ClusterData> allClusters;
+	for (size_t i = 0; i < batches.size(); ++i)
+	{
+		batches[i].firstCommand = static_cast<uint32_t>(allClusters.size());
+		batches[i].numCommands = static_cast<uint32_t>(batchClusters[i].size());
+
+		allClusters.insert(allClusters.end(), batchClusters[i].begin(), batchClusters[i].end());
+	}
+
+	_clusterDrawBatches = std::move(batches);
+	_numClusters = static_cast<uint32_t>(allClusters.size());
+
+	if (_numClusters == 0)
+	{
+		backend->_renderCfg.CLUSTER_CULLING = false;
+		return;
 	}
+
+	Render::Buffer::CreateInfo clusterBufferInfo = {};
+	clusterBufferInfo.allocSize = allClusters.size() * sizeof(ClusterData);
+	clusterBufferInfo.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress |
+		vk::BufferUsageFlagBits::eTransferDst;
+	clusterBufferInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	_clusterBuffer = backend->CreateBuffer(clusterBufferInfo);
+	backend->UploadBufferImmediately(_clusterBuffer, allClusters.data(), clusterBufferInfo.allocSize);
+
+	// written by compute culling every frame, hence one per frame in flight
+	Render::Buffer::CreateInfo drawCommandBufferInfo = {};
+	drawCommandBufferInfo.allocSize = allClusters.size() * sizeof(vk::DrawIndexedIndirectCommand);
+	drawCommandBufferInfo.usage = vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer |
+		vk::BufferUsageFlagBits::eShaderDeviceAddress;
+	drawCommandBufferInfo.memUsage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	for (auto& drawCommandBuffer : _clusterDrawCommandBuffers)
+	{
+		drawCommandBuffer = backend->CreateBuffer(drawCommandBufferInfo);
+	}
+
+	std::cout << "Cluster culling: " << _numClusters << " clusters in " << _clusterDrawBatches.size() << " batches, "
+		<< (backend->_renderCfg.MESH_SHADERS ? "mesh shading" : "compute culling with indirect draws") << std::endl;
 }
 
 
@@ -694,6 +1101,17 @@ void Render::System::Cleanup()
 
 	auto* backend = Render::Backend::AcquireInstance();
 
+	// builds still running would create pipelines on a destroyed device
+	for (auto& pass : _renderPasses)
+	{
+		if (pass.IsBuildPending())
+		{
+			pass.RequirePipeline();
+		}
+	}
+
+	_pathTracingManager.FinishPendingBuild();
+
 	backend->Terminate();
 
 	_isInitialized = false;
@@ -702,14 +1120,28 @@ void Render::System::Cleanup()
 
 void Render::System::RenderFrame()
 {
+	PLM_TRACE_ZONE("RenderFrame");
+
 	auto* backend = Render::Backend::AcquireInstance();
 
 	backend->BeginFrameRendering();
 
+	// mips requested by earlier frames are uploaded before any pass samples them
+	if (_useTextureStreaming)
+	{
+		_textureStreamer.Update(backend->GetCurrentCommandBuffer());
+	}
+
 	SwitchIntermediateImageLayout(true);
 	
 	// ========================================   RENDERING   ========================================
 
+	// LOD and cluster selection end up in the object data
+	if (_renderMode == RenderMode::eHybrid)
+	{
+		SelectLods();
+	}
+
 	UploadCamSceneData(_renderables.data(), _renderables.size());
 
 	if (_renderMode == RenderMode::eHybrid)
@@ -798,6 +1230,8 @@ void Render::System::CopyImage(vk::CommandBuffer cmd, vk::ImageAspectFlags aspec
 
 void Render::System::UploadCamSceneData(Render::Object* first, size_t count)
 {
+	PLM_TRACE_ZONE("UploadCamSceneData");
+
 	ASSERT(_pCamera != nullptr, "Invalid camera");
 	ASSERT(_pLightManager != nullptr, "Invalid light manager");
 
@@ -807,12 +1241,16 @@ void Render::System::UploadCamSceneData(Render::Object* first, size_t count)
 	{
 		CameraDataGPU camData;
 		LightingData lightingData;
+		TextureStreamingGPU textureStreaming;
+		EnvironmentMapGPU environmentMap;
 	} camLightingData = {};
 
 	const Plume::Camera& camera = *_pCamera;
 
 	camLightingData.camData = camera.MakeGPUCameraData(_prevCamera, { backend->_windowExtent.width, backend->_windowExtent.height });
 	camLightingData.lightingData = Render::LightManager::MakeLightingData(_pLightManager->GetLights());
+	camLightingData.textureStreaming = _textureStreamer.GetGPUData();
+	camLightingData.environmentMap = _environmentMap.GetGPUData();
 
 	size_t camLightingDataBufferSize = backend->PadUniformBufferSize(sizeof(CamLightingData));
 
@@ -821,8 +1259,12 @@ void Render::System::UploadCamSceneData(Render::Object* first, size_t count)
 	backend->CopyDataToBuffer(&camLightingData, camLightingDataBufferSize, _frameCtx.camLightingBuffer, camLightingDataBufferSize * frameIndex);
 
 
+	// coarse TLAS instances address a second copy of the objects, which points to their coarsest LODs
+	const size_t numObjectDataCopies = _useCoarseRTLods ? 2 : 1;
+	ASSERT(count * numObjectDataCopies <= MAX_OBJECTS, "Too many objects for the object buffer");
+
 	std::vector<ObjectData> objectSsboVector = {};
-	objectSsboVector.resize(count);
+	objectSsboVector.resize(count * numObjectDataCopies);
 
 	for (int32_t i = 0; i < count; ++i)
 	{
@@ -830,12 +1272,26 @@ void Render::System::UploadCamSceneData(Render::Object* first, size_t count)
 		objectSsboVector[i].model = object.transformMatrix;
 		if (object.mesh.pEngineMesh)
 		{
-			uint64_t indexAddress = object.mesh.indexBuffer.GetDeviceAddress();
-			uint64_t vertexAddress = object.mesh.vertexBuffer.GetDeviceAddress();
+			uint64_t indexAddress = object.mesh.indexRange.deviceAddress;
+			uint64_t vertexAddress = object.mesh.vertexRange.deviceAddress;
 			objectSsboVector[i].matIndex = object.mesh.pEngineMesh->matIndex;
+			objectSsboVector[i].flags = object.mesh.indexType == vk::IndexType::eUint16 ? OBJECT_FLAG_16BIT_INDICES : 0;
+			objectSsboVector[i].flags |= object.isDrawnAsClusters ? OBJECT_FLAG_CLUSTER_DRAW : 0;
 			objectSsboVector[i].indexBufferAddress = indexAddress;
 			objectSsboVector[i].vertexBufferAddress = vertexAddress;
 			objectSsboVector[i].emittance = object.mesh.pEngineMesh->emittance;
+			objectSsboVector[i].positionOffset = object.mesh.positionOffset;
+			objectSsboVector[i].positionScale = object.mesh.positionScale;
+		}
+
+		if (_useCoarseRTLods)
+		{
+			objectSsboVector[count + i] = objectSsboVector[i];
+			if (object.mesh.pEngineMesh)
+			{
+				const uint32_t coarsestLodId = object.mesh.GetNumOfLods() - 1;
+				objectSsboVector[count + i].indexBufferAddress = object.mesh.GetIndexRange(coarsestLodId).deviceAddress;
+			}
 		}
 	}
 
@@ -843,12 +1299,165 @@ void Render::System::UploadCamSceneData(Render::Object* first, size_t count)
 }
 
 
+void Render::System::SelectLods()
+{
+	PLM_TRACE_ZONE("SelectLods");
+
+	ASSERT(_pCamera != nullptr, "Invalid camera");
+
+	auto* backend = Render::Backend::AcquireInstance();
+
+	constexpr float NEAR_PLANE = 0.1f;
+
+	const float maxErrorPixels = backend->_renderCfg.LOD_ERROR_PIXELS;
+
+	// pixels covered by one world unit at distance 1
+	const float pixelsPerUnit = backend->_windowExtent.height / (2.0f * glm::tan(0.5f * glm::radians(_pCamera->_zoom)));
+
+	for (auto& object : _renderables)
+	{
+		object.lodId = 0;
+
+		const Render::Mesh& mesh = object.mesh;
+		if (!object.model || mesh.lods.empty() || maxErrorPixels <= 0.0f)
+		{
+			continue;
+		}
+
+		// conservative for non-uniform scales
+		const float worldScale = glm::max(glm::length(glm::vec3(object.transformMatrix[0])),
+			glm::max(glm::length(glm::vec3(object.transformMatrix[1])), glm::length(glm::vec3(object.transformMatrix[2]))));
+
+		const glm::vec3 worldCenter = glm::vec3(object.transformMatrix * glm::vec4(mesh.boundsCenter, 1.0f));
+		const float distance = glm::max(glm::length(worldCenter - _pCamera->_position) - mesh.boundsRadius * worldScale, NEAR_PLANE);
+
+		const float errorToPixels = worldScale * pixelsPerUnit / distance;
+
+		// LOD errors only grow, so the first one that is too coarse ends the search
+		for (uint32_t lodId = 1; lodId < mesh.GetNumOfLods(); ++lodId)
+		{
+			if (mesh.GetLodError(lodId) * errorToPixels > maxErrorPixels)
+			{
+				break;
+			}
+
+			object.lodId = lodId;
+		}
+	}
+
+	// meshlets only exist for LOD 0
+	const bool useClusters = backend->_renderCfg.CLUSTER_CULLING && _numClusters > 0;
+
+	for (auto& object : _renderables)
+	{
+		object.isDrawnAsClusters = useClusters && object.lodId == 0 && object.mesh.pEngineMesh &&
+			!object.mesh.pEngineMesh->GetMeshlets().empty();
+	}
+}
+
+
 void Render::System::GBufferGeometryPass()
 {
 	auto* backend = Render::Backend::AcquireInstance();
 
+	Render::GpuZone gpuZone(backend->GetGpuProfiler(), backend->GetCurrentCommandBuffer(), "G-Buffer Geometry");
+
 	auto geometryPassId = static_cast<int32_t>(Render::Pass::Type::eGeometryPass);
+
+	_renderPasses[geometryPassId].RequirePipeline();
+
+	if (!backend->_renderCfg.CLUSTER_CULLING || _numClusters == 0)
+	{
+		backend->DrawObjects(_renderables, _renderPasses[geometryPassId], nullptr, true);
+		return;
+	}
+
+	ASSERT(_pCamera != nullptr, "Invalid camera");
+
+	vk::CommandBuffer cmd = backend->GetCurrentCommandBuffer();
+	const Render::Buffer& drawCommandBuffer = _clusterDrawCommandBuffers[backend->_frameId % FRAME_OVERLAP];
+
+	const glm::mat4 viewProj = _pCamera->MakeGPUCameraData(_prevCamera,
+		{ backend->_windowExtent.width, backend->_windowExtent.height }).viewproj;
+
+	// rows of the view-projection matrix
+	const glm::mat4 viewProjRows = glm::transpose(viewProj);
+
+	ClusterCullPushConstants cullConstants = {};
+	cullConstants.frustumPlanes[0] = viewProjRows[3] + viewProjRows[0];
+	cullConstants.frustumPlanes[1] = viewProjRows[3] - viewProjRows[0];
+	cullConstants.frustumPlanes[2] = viewProjRows[3] + viewProjRows[1];
+	cullConstants.frustumPlanes[3] = viewProjRows[3] - viewProjRows[1];
+
+	for (auto& plane : cullConstants.frustumPlanes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	cullConstants.cameraPosition = _pCamera->_position;
+	cullConstants.clusterCount = _numClusters;
+	cullConstants.clustersAddress = _clusterBuffer.GetDeviceAddress();
+	cullConstants.objectsAddress = backend->GetCurrentFrameData()._objectBuffer.GetDeviceAddress();
+	cullConstants.drawCommandsAddress = drawCommandBuffer.GetDeviceAddress();
+	cullConstants.USE_CONE_CULLING = backend->_renderCfg.CLUSTER_CONE_CULLING;
+
+	Render::Backend::PushConstantsInfo pcInfo = {};
+	pcInfo.pData = &cullConstants;
+	pcInfo.size = sizeof(ClusterCullPushConstants);
+
+	const uint32_t numGroups = (_numClusters + CLUSTER_CULLING_GROUP_SIZE - 1) / CLUSTER_CULLING_GROUP_SIZE;
+
+	const bool useMeshShaders = backend->_renderCfg.MESH_SHADERS;
+
+	if (!useMeshShaders)
+	{
+		Render::GpuZone cullingGpuZone(backend->GetGpuProfiler(), cmd, "Cluster Culling");
+
+		pcInfo.shaderStages = vk::ShaderStageFlagBits::eCompute;
+
+		auto clusterCullingId = static_cast<int32_t>(Render::Pass::Type::eClusterCulling);
+		_renderPasses[clusterCullingId].RequirePipeline();
+		backend->Dispatch(_renderPasses[clusterCullingId], numGroups, &pcInfo);
+
+		Render::Buffer::MemoryBarrierInfo cullingBarrierInfo = {};
+		cullingBarrierInfo.srcAccess = vk::AccessFlagBits2::eShaderStorageWrite;
+		cullingBarrierInfo.dstAccess = vk::AccessFlagBits2::eIndirectCommandRead;
+		cullingBarrierInfo.srcStage = vk::PipelineStageFlagBits2::eComputeShader;
+		cullingBarrierInfo.dstStage = vk::PipelineStageFlagBits2::eDrawIndirect;
+
+		drawCommandBuffer.MemoryBarrier(cmd, cullingBarrierInfo);
+	}
+
+	// objects drawn without clusters clear the G-buffer
 	backend->DrawObjects(_renderables, _renderPasses[geometryPassId], nullptr, true);
+
+	vk::MemoryBarrier2 attachmentBarrier;
+	attachmentBarrier.srcStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eLateFragmentTests;
+	attachmentBarrier.srcAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+	attachmentBarrier.dstStageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput | vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+		vk::PipelineStageFlagBits2::eLateFragmentTests;
+	attachmentBarrier.dstAccessMask = vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite |
+		vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+
+	vk::DependencyInfo attachmentDepInfo;
+	attachmentDepInfo.setMemoryBarriers(attachmentBarrier);
+
+	cmd.pipelineBarrier2(attachmentDepInfo);
+
+	if (useMeshShaders)
+	{
+		pcInfo.shaderStages = vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+
+		auto meshletGeometryPassId = static_cast<int32_t>(Render::Pass::Type::eMeshletGeometryPass);
+		_renderPasses[meshletGeometryPassId].RequirePipeline();
+		backend->DrawMeshTasks(numGroups, _renderPasses[meshletGeometryPassId], &pcInfo, true);
+	}
+	else
+	{
+		auto clusterGeometryPassId = static_cast<int32_t>(Render::Pass::Type::eClusterGeometryPass);
+		_renderPasses[clusterGeometryPassId].RequirePipeline();
+		backend->DrawIndexedIndirect(_clusterDrawBatches, drawCommandBuffer, _renderPasses[clusterGeometryPassId], nullptr, true);
+	}
 }
 
 
@@ -856,7 +1465,10 @@ void Render::System::GBufferLightingPass()
 {
 	auto* backend = Render::Backend::AcquireInstance();
 
+	Render::GpuZone gpuZone(backend->GetGpuProfiler(), backend->GetCurrentCommandBuffer(), "G-Buffer Lighting");
+
 	auto lightingPassId = static_cast<int32_t>(Render::Pass::Type::eLightingPass);
+	_renderPasses[lightingPassId].RequirePipeline();
 	backend->DrawScreenQuad(_renderPasses[lightingPassId], nullptr, true);
 }
 
@@ -865,12 +1477,16 @@ void Render::System::SkyPass()
 {
 	auto* backend = Render::Backend::AcquireInstance();
 
+	Render::GpuZone gpuZone(backend->GetGpuProfiler(), backend->GetCurrentCommandBuffer(), "Sky");
+
 	std::vector<Render::Object> skyObj = {
 		_skyboxObject
 	};
 
 	MeshPushConstants constants = {};
 	constants.render_matrix = _skyboxObject.transformMatrix;
+	constants.positionOffset = glm::vec4(_skyboxObject.mesh.positionOffset, 0.0f);
+	constants.positionScale = glm::vec4(_skyboxObject.mesh.positionScale, 0.0f);
 
 	Render::Backend::PushConstantsInfo pcInfo = {};
 	pcInfo.pData = &constants;
@@ -878,6 +1494,7 @@ void Render::System::SkyPass()
 	pcInfo.shaderStages = vk::ShaderStageFlagBits::eVertex;
 
 	auto skyPassId = static_cast<int32_t>(Render::Pass::Type::eSky);
+	_renderPasses[skyPassId].RequirePipeline();
 	backend->DrawObjects(skyObj, _renderPasses[skyPassId], &pcInfo, true);
 }
 
@@ -886,6 +1503,8 @@ void Render::System::FXAAPass()
 {
 	auto* backend = Render::Backend::AcquireInstance();
 
+	Render::GpuZone gpuZone(backend->GetGpuProfiler(), backend->GetCurrentCommandBuffer(), "FXAA");
+
 	int32_t fxaaOn = backend->_renderCfg.FXAA;
 
 	Render::Backend::PushConstantsInfo pcInfo = {};
@@ -895,6 +1514,7 @@ void Render::System::FXAAPass()
 
 	auto postprocessPassId = static_cast<int32_t>(Render::Pass::Type::ePostprocess);
 
+	_renderPasses[postprocessPassId].RequirePipeline();
 	_renderPasses[postprocessPassId].SetSwapchainImage(backend->_swapchainImages[backend->_swapchainImageIndex]);
 
 	backend->DrawScreenQuad(_renderPasses[postprocessPassId], &pcInfo);
@@ -905,6 +1525,8 @@ void Render::System::DenoiserPass()
 {
 	auto* backend = Render::Backend::AcquireInstance();
 
+	Render::GpuZone gpuZone(backend->GetGpuProfiler(), backend->GetCurrentCommandBuffer(), "Denoiser");
+
 	int32_t denoisingOn = backend->_renderCfg.DENOISING;
 
 	Render::Backend::PushConstantsInfo pcInfo = {};
@@ -914,6 +1536,7 @@ void Render::System::DenoiserPass()
 
 	auto postprocessPassId = static_cast<int32_t>(Render::Pass::Type::ePostprocess);
 
+	_renderPasses[postprocessPassId].RequirePipeline();
 	_renderPasses[postprocessPassId].SetSwapchainImage(backend->_swapchainImages[backend->_swapchainImageIndex]);
 
 	backend->DrawScreenQuad(_renderPasses[postprocessPassId], &pcInfo);
@@ -940,6 +1563,54 @@ void Render::System::DebugUIPass(vk::CommandBuffer cmd, vk::ImageView targetImag
 }
 
 
+void Render::System::SetupGpuProfilerUI()
+{
+	const Render::GpuProfiler& profiler = Render::Backend::AcquireInstance()->GetGpuProfiler();
+
+	if (!profiler.IsEnabled())
+	{
+		ImGui::Text("Timestamps are not supported");
+		return;
+	}
+
+	const uint32_t numFrames = profiler.GetNumHistoryFrames();
+
+	for (const auto& zone : profiler.GetZoneHistories())
+	{
+		float sumMs = 0.0f;
+		for (float timeMs : zone.timesMs)
+		{
+			sumMs += timeMs;
+		}
+
+		char overlay[32];
+		snprintf(overlay, sizeof(overlay), "%.3f ms", numFrames > 0 ? sumMs / numFrames : 0.0f);
+
+		const float indent = GPU_PROFILER_UI_INDENT * zone.depth;
+		if (indent > 0.0f)
+		{
+			ImGui::Indent(indent);
+		}
+
+		// zone names repeat under different parents
+		ImGui::PushID(zone.path.c_str());
+		ImGui::PlotLines(zone.name.c_str(), zone.timesMs.data(), Render::GpuProfiler::HISTORY_SIZE, profiler.GetHistoryOffset(),
+			overlay, 0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+		ImGui::PopID();
+
+		if (indent > 0.0f)
+		{
+			ImGui::Unindent(indent);
+		}
+	}
+
+	if (ImGui::Button("Export CSV"))
+	{
+		profiler.ExportCsv(Render::GpuProfiler::CSV_PATH);
+	}
+}
+
+
 void Render::System::SetupDebugUIFrame()
 {
 	if (!_showDebugUi)
@@ -967,10 +1638,41 @@ void Render::System::SetupDebugUIFrame()
 			_pathTracingManager.ResetFrame();
 		}
 		ImGui::Checkbox("Use Shader Execution Reordering", &backend->_renderCfg.SHADER_EXECUTION_REORDERING);
+		if (_useCoarseRTLods)
+		{
+			bool prevCoarseLods = backend->_renderCfg.COARSE_SECONDARY_LODS;
+			ImGui::Checkbox("Use Coarse LODs for Bounces", &backend->_renderCfg.COARSE_SECONDARY_LODS);
+			if (backend->_renderCfg.COARSE_SECONDARY_LODS != prevCoarseLods)
+			{
+				_pathTracingManager.ResetFrame();
+			}
+		}
+		ImGui::Checkbox("Use Environment Sampling", &backend->_renderCfg.ENVIRONMENT_SAMPLING);
 	}
 	else if (_renderMode == RenderMode::eHybrid)
 	{
 		ImGui::Checkbox("Use FXAA", &backend->_renderCfg.FXAA);
+		ImGui::SliderFloat("LOD Error (pixels)", &backend->_renderCfg.LOD_ERROR_PIXELS, 0.0f, 8.0f);
+		if (_numClusters > 0)
+		{
+			ImGui::Checkbox("Use Cluster Culling", &backend->_renderCfg.CLUSTER_CULLING);
+			ImGui::Checkbox("Use Cone Culling", &backend->_renderCfg.CLUSTER_CONE_CULLING);
+			if (backend->AreMeshShadersSupported())
+			{
+				ImGui::Checkbox("Use Mesh Shaders", &backend->_renderCfg.MESH_SHADERS);
+			}
+		}
+	}
+	if (_useTextureStreaming)
+	{
+		ImGui::Text("Streamed textures: %.1f MB", static_cast<double>(_textureStreamer.GetResidentSize()) / (1024.0 * 1024.0));
+	}
+	const Render::Backend::MemoryBudget memBudget = backend->GetDeviceLocalMemoryBudget();
+	ImGui::Text("Device memory: %.0f / %.0f MB%s", static_cast<double>(memBudget.usage) / (1024.0 * 1024.0),
+		static_cast<double>(memBudget.budget) / (1024.0 * 1024.0), backend->IsMemoryBudgetSupported() ? "" : " (estimated)");
+	if (ImGui::CollapsingHeader("GPU Time"))
+	{
+		SetupGpuProfilerUI();
 	}
 	ImGui::End();
 
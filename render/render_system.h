@@ -14,6 +14,10 @@
 
 #include "core/render_core.h"
 #include "core/render_descriptors.h"
+#include "core/render_environment_map.h"
+#include "core/render_mip_generator.h"
+#include "core/render_texture_registry.h"
+#include "core/render_texture_streamer.h"
 
 #include "render_path_tracing.h"
 
@@ -47,6 +51,9 @@ enum class RenderMode
 struct MeshPushConstants
 {
 	glm::mat4 render_matrix;
+	// compact vertex position dequantization, see Render::Mesh
+	glm::vec4 positionOffset;
+	glm::vec4 positionScale;
 };
 
 
@@ -72,12 +79,36 @@ public:
 
 		SDL_Window* pWindow = nullptr;
 		vk::Extent2D windowExtent{ 0, 0 };
+
+		// render offscreen, pWindow is ignored
+		bool isHeadless = false;
 	};
 
 	bool _isInitialized = false;
 
 	constexpr static RenderMode _renderMode = RenderMode::ePathTracing;
 
+	// Build one multi-geometry BLAS per model instead of one BLAS per mesh. Results in far fewer TLAS instances
+	// for scenes made of many submeshes, such as Sponza.
+	constexpr static bool _useModelBLAS = true;
+
+	// Add a second set of TLAS instances built from the coarsest mesh LODs. Secondary path tracing bounces can trace
+	// against them (see ConfigurationVariables::COARSE_SECONDARY_LODS), their ObjectData follows the regular one.
+	// Only set on Init() if the path tracer starts with COARSE_SECONDARY_LODS, the instances are never traced otherwise.
+	bool _useCoarseRTLods = false;
+
+	// Load material textures block-compressed (BC7 color, BC5 normal maps, BC4 masks) with precomputed mips.
+	// Textures are cooked once and cached next to their source files.
+	constexpr static bool _useCompressedTextures = true;
+
+	// Start material textures with only their mip tail resident and stream finer mips in as shaders request them.
+	// Memory is bound per mip with sparse residency, otherwise textures are allocated with all of their mips.
+	constexpr static bool _useTextureStreaming = _useCompressedTextures;
+
+	// Generate the mips of uncompressed textures with compute shaders, all textures of a load batch at once, instead of
+	// blitting mip after mip per texture. Cooked textures come with their mips.
+	constexpr static bool _useComputeMips = true;
+
 	void InitBackendAndData(const InitData& initData);
 
 	// initializes everything in the rendering system
@@ -135,13 +166,32 @@ public:
 
 	std::array<Render::Pass, static_cast<size_t>(Render::Pass::Type::eMaxValue)> _renderPasses;
 
-	std::unordered_map<std::string, std::array<Render::Image, NUM_MATERIAL_TEXTURE_TYPES>> _loadedTextures;
+	Render::TextureRegistry _textureRegistry;
+	Render::TextureStreamer _textureStreamer;
+	Render::MipGenerator _mipGenerator;
+
+	// registry entries of every texture slot, indexed by material
+	std::array<std::vector<Render::TextureRegistry::TextureId>, NUM_MATERIAL_TEXTURE_TYPES> _materialTextures;
 
 	Render::Image _skybox;
 	Render::Object _skyboxObject;
 
+	// lights path traced scenes, the skybox is only drawn by the hybrid renderer
+	Render::EnvironmentMap _environmentMap;
+
 	void UploadCamSceneData(Render::Object* first, size_t count);
 
+	// picks the coarsest LOD of every renderable whose error stays below LOD_ERROR_PIXELS on screen. Full-detail
+	// renderables are drawn as clusters when cluster culling is on.
+	void SelectLods();
+
+	// Meshlets of all renderables, culled against the view before they are drawn, see ConfigurationVariables::CLUSTER_CULLING.
+	// Clusters sharing vertex and index buffers are contiguous, so that the indirect path issues one multi-draw per batch.
+	Render::Buffer _clusterBuffer;
+	std::array<Render::Buffer, FRAME_OVERLAP> _clusterDrawCommandBuffers;
+	std::vector<Render::Backend::IndirectDrawBatch> _clusterDrawBatches;
+	uint32_t _numClusters = 0;
+
 	void GBufferGeometryPass();
 	void GBufferLightingPass();
 	void SkyPass();
@@ -151,25 +201,33 @@ public:
 	void DebugUIPass(vk::CommandBuffer cmd, vk::ImageView targetImageView);
 
 private:
+	// Rolling graphs of the GPU zone times, child zones indented by GPU_PROFILER_UI_INDENT per level
+	void SetupGpuProfilerUI();
+	static constexpr float GPU_PROFILER_UI_INDENT = 10.0f;
+
 	void InitGBufferImages();
 
 	void InitDescriptors();
 
+	// Pipelines the active render mode uses are built asynchronously, all others on first use
 	void InitPasses();
+	static Render::Pass::BuildMode GetHybridPassBuildMode();
+	// Waits for the pipelines every frame of the render mode uses
+	void RequireFramePipelines();
 	void InitGeometryPass();
+	void InitClusterCullingPass();
 	void InitLightingPass();
 	void InitPostprocessPass();
 	void InitSkyPass();
 
 	void InitRenderScene();
 
+	void InitClusterCulling();
+
 	void InitBLAS();
 
 	void InitTLAS();
 
-	bool LoadMaterialTexture(Render::Image& tex, const std::string& texName, const std::string& matName,
-		uint32_t texSlot, bool generateMipmaps = true, vk::Format format = vk::Format::eR8G8B8A8Srgb);
-
 	void LoadSkybox(Render::Image& skybox, const std::string& directory);
 
 	void LoadImages();
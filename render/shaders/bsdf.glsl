@@ -83,6 +83,22 @@ vec3 SpecularBRDF(vec3 albedo, float metallic, float roughness, vec3 V, vec3 N,
 	return D * F * G;
 }
 
+// Both lobes for light sampled directions, pdf is the one of sampling L with the lobe chosen by diffuseProb
+vec3 CombinedBRDF(vec3 albedo, float metallic, float roughness, float diffuseProb, vec3 V, vec3 N, vec3 L, out float pdf)
+{
+	vec3 H = normalize(L + V);
+
+	float diffusePdf = 0.0;
+	float specularPdf = 0.0;
+
+	vec3 diffuse = DiffuseBRDF(albedo, metallic, V, N, L, H, diffusePdf);
+	vec3 specular = SpecularBRDF(albedo, metallic, roughness, V, N, L, H, specularPdf);
+
+	pdf = diffuseProb * diffusePdf + (1.0 - diffuseProb) * specularPdf;
+
+	return diffuse + specular;
+}
+
 vec3 BRDF(vec3 L, vec3 V, vec3 N, float metallic, float roughness, vec3 texColor)
 {
 	vec3 H = normalize(V + L);
@@ -0,0 +1,73 @@
+#if !defined(CLUSTER_CULLING_GLSL)
+#define CLUSTER_CULLING_GLSL
+
+// Shared by compute culling and the task shader. Expects host_device_common.h to be included, as well as
+// GL_EXT_buffer_reference2 and GL_EXT_scalar_block_layout to be enabled.
+
+
+layout (push_constant) uniform constants
+{
+	ClusterCullPushConstants cullConstants;
+};
+
+layout (buffer_reference, scalar) readonly buffer Clusters
+{
+	ClusterData CLUSTERS[];
+};
+
+layout (buffer_reference, scalar) readonly buffer Objects
+{
+	ObjectData OBJECTS[];
+};
+
+// visible clusters of a task shader workgroup, one mesh shader workgroup is launched per entry
+struct ClusterTaskPayload
+{
+	uint clusterIds[CLUSTER_CULLING_GROUP_SIZE];
+};
+
+
+bool IsClusterVisible(ClusterData cluster, ObjectData object)
+{
+	// LODs and objects without meshlets are drawn regularly this frame
+	if ((object.flags & OBJECT_FLAG_CLUSTER_DRAW) == 0)
+	{
+		return false;
+	}
+
+	mat4 modelMatrix = object.model;
+
+	float maxScale = max(length(modelMatrix[0].xyz), max(length(modelMatrix[1].xyz), length(modelMatrix[2].xyz)));
+
+	vec3 center = (modelMatrix * vec4(cluster.boundsCenter, 1.0)).xyz;
+	float radius = cluster.boundsRadius * maxScale;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		if (dot(cullConstants.frustumPlanes[i].xyz, center) + cullConstants.frustumPlanes[i].w < -radius)
+		{
+			return false;
+		}
+	}
+
+	// a cutoff of 1 marks cones too wide to ever be back-facing
+	if (!cullConstants.USE_CONE_CULLING || cluster.coneCutoff >= 1.0)
+	{
+		return true;
+	}
+
+	vec3 coneAxis = normalize(mat3(modelMatrix) * cluster.coneAxis);
+
+	// mirroring transforms flip the winding, and with it the facing of every triangle
+	if (determinant(mat3(modelMatrix)) < 0.0)
+	{
+		coneAxis = -coneAxis;
+	}
+
+	vec3 toCenter = center - cullConstants.cameraPosition;
+
+	// all triangles face away from every point of the bounding sphere
+	return dot(toCenter, coneAxis) < cluster.coneCutoff * length(toCenter) + radius;
+}
+
+#endif // CLUSTER_CULLING_GLSL
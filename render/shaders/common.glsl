@@ -4,5 +4,12 @@
 #define PI 3.1415926535897932384626433832795
 #define FLT_EPS 0.00000001
 
+// Tangent-space normal from a normal map texel. Z is reconstructed, so BC5 maps that store only x and y decode the
+// same as full RGB ones.
+vec3 DecodeNormalMapTexel(vec4 normalTex)
+{
+	const vec2 xy = normalTex.xy * 2.0 - vec2(1.0);
+	return vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+}
 
 #endif // COMMON_GLSL
@@ -0,0 +1,34 @@
+#if !defined(ENVIRONMENT_MAP_GLSL)
+#define ENVIRONMENT_MAP_GLSL
+
+#include "common.glsl"
+
+// Equirectangular environment map with +Y up, u follows the azimuth and v the polar angle from +Y.
+// Expects the shader to declare sampler2D envMap.
+
+vec2 DirectionToEquirectUv(vec3 direction)
+{
+	const float phi = atan(direction.z, direction.x);
+	const float theta = acos(clamp(direction.y, -1.0, 1.0));
+
+	return vec2((phi + PI) / (2.0 * PI), theta / PI);
+}
+
+
+vec3 EquirectUvToDirection(vec2 uv, out float sinTheta)
+{
+	const float phi = uv.x * 2.0 * PI - PI;
+	const float theta = uv.y * PI;
+
+	sinTheta = sin(theta);
+
+	return vec3(sinTheta * cos(phi), cos(theta), sinTheta * sin(phi));
+}
+
+
+vec3 GetEnvironmentRadiance(vec3 direction)
+{
+	return textureLod(envMap, DirectionToEquirectUv(direction), 0.0).rgb;
+}
+
+#endif // ENVIRONMENT_MAP_GLSL
@@ -0,0 +1,108 @@
+#if !defined(ENVIRONMENT_SAMPLING_GLSL)
+#define ENVIRONMENT_SAMPLING_GLSL
+
+#include "environment_map.glsl"
+
+// Importance sampling of the environment map by the distribution built in Render::EnvironmentMap. The pdf is constant
+// per texel. Expects host_device_common.h to be included, GL_EXT_buffer_reference2 and GL_EXT_scalar_block_layout to be
+// enabled, and the shader to declare EnvironmentMapGPU ENVIRONMENT_MAP next to sampler2D envMap.
+
+layout (buffer_reference, scalar) readonly buffer EnvironmentCdf
+{
+	float CDF[];
+};
+
+
+// First of the count entries from offset that is above value. The last entry of every CDF is 1, so there is one.
+uint FindCdfInterval(EnvironmentCdf cdf, uint offset, uint count, float value)
+{
+	uint low = 0;
+	uint high = count - 1;
+
+	while (low < high)
+	{
+		const uint mid = (low + high) / 2;
+
+		if (cdf.CDF[offset + mid] > value)
+		{
+			high = mid;
+		}
+		else
+		{
+			low = mid + 1;
+		}
+	}
+
+	return low;
+}
+
+
+// Probability of the interval, cdfBegin is where the interval starts
+float GetCdfIntervalProbability(EnvironmentCdf cdf, uint offset, uint index, out float cdfBegin)
+{
+	cdfBegin = index > 0 ? cdf.CDF[offset + index - 1] : 0.0;
+
+	return cdf.CDF[offset + index] - cdfBegin;
+}
+
+
+// Texel pdf over the uv square to solid angle pdf, the equirectangular mapping stretches texels by 2 pi^2 sin(theta)
+float UvPdfToSolidAngle(float uvPdf, float sinTheta)
+{
+	return sinTheta > 0.0 ? uvPdf / (2.0 * PI * PI * sinTheta) : 0.0;
+}
+
+
+// Returns the radiance from the sampled direction, pdf is per solid angle
+vec3 SampleEnvironment(vec2 rnd, out vec3 direction, out float pdf)
+{
+	const uint width = ENVIRONMENT_MAP.width;
+	const uint height = ENVIRONMENT_MAP.height;
+
+	const EnvironmentCdf marginalCdf = EnvironmentCdf(ENVIRONMENT_MAP.marginalCdfAddress);
+	const EnvironmentCdf conditionalCdf = EnvironmentCdf(ENVIRONMENT_MAP.conditionalCdfAddress);
+
+	const uint row = FindCdfInterval(marginalCdf, 0, height, rnd.y);
+	float rowCdfBegin;
+	const float rowProbability = GetCdfIntervalProbability(marginalCdf, 0, row, rowCdfBegin);
+
+	const uint rowOffset = row * width;
+	const uint column = FindCdfInterval(conditionalCdf, rowOffset, width, rnd.x);
+	float columnCdfBegin;
+	const float columnProbability = GetCdfIntervalProbability(conditionalCdf, rowOffset, column, columnCdfBegin);
+
+	// the random numbers are reused for the position within the texel
+	const float du = columnProbability > 0.0 ? clamp((rnd.x - columnCdfBegin) / columnProbability, 0.0, 1.0) : 0.5;
+	const float dv = rowProbability > 0.0 ? clamp((rnd.y - rowCdfBegin) / rowProbability, 0.0, 1.0) : 0.5;
+
+	const vec2 uv = vec2((float(column) + du) / float(width), (float(row) + dv) / float(height));
+
+	float sinTheta;
+	direction = EquirectUvToDirection(uv, sinTheta);
+
+	pdf = UvPdfToSolidAngle(rowProbability * float(height) * columnProbability * float(width), sinTheta);
+
+	return GetEnvironmentRadiance(direction);
+}
+
+
+// Solid angle pdf of SampleEnvironment() returning direction
+float GetEnvironmentPdf(vec3 direction)
+{
+	const uint width = ENVIRONMENT_MAP.width;
+	const uint height = ENVIRONMENT_MAP.height;
+
+	const vec2 uv = DirectionToEquirectUv(direction);
+
+	const uint row = min(uint(uv.y * float(height)), height - 1);
+	const uint column = min(uint(uv.x * float(width)), width - 1);
+
+	float cdfBegin;
+	const float rowProbability = GetCdfIntervalProbability(EnvironmentCdf(ENVIRONMENT_MAP.marginalCdfAddress), 0, row, cdfBegin);
+	const float columnProbability = GetCdfIntervalProbability(EnvironmentCdf(ENVIRONMENT_MAP.conditionalCdfAddress), row * width,
+		column, cdfBegin);
+
+	return UvPdfToSolidAngle(rowProbability * float(height) * columnProbability * float(width), sin(uv.y * PI));
+}
+
+#endif // ENVIRONMENT_SAMPLING_GLSL
@@ -1,12 +1,17 @@
 #version 460
 #extension GL_EXT_nonuniform_qualifier : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+#extension GL_EXT_scalar_block_layout : enable
+#extension GL_EXT_buffer_reference2 : require
+#extension GL_ARB_sparse_texture_clamp : enable
+
+#include "common.glsl"
+#include "host_device_common.h"
 
 #define DIFFUSE_TEX_SLOT 0U
-#define METALLIC_TEX_SLOT 1U
-#define ROUGHNESS_TEX_SLOT 2U
-#define NORMAL_MAP_SLOT 3U
+#define ORM_TEX_SLOT 1U
+#define NORMAL_MAP_SLOT 2U
 
-layout (location = 0) in vec3 inColor;
 layout (location = 1) in vec2 texCoord;
 layout (location = 2) flat in uint matID;
 layout (location = 3) in vec3 fragPosWorld;
@@ -19,20 +24,42 @@ layout (location = 2) out vec4 outAlbedo;
 layout (location = 3) out vec4 outMetallicRoughness;
 
 layout (set = DIFFUSE_TEX_SLOT, binding = 0) uniform sampler2D diffuseTex[];
-layout (set = METALLIC_TEX_SLOT, binding = 0) uniform sampler2D metallicTex[];
-layout (set = ROUGHNESS_TEX_SLOT, binding = 0) uniform sampler2D roughnessTex[];
+layout (set = ORM_TEX_SLOT, binding = 0) uniform sampler2D ormTex[];
 layout (set = NORMAL_MAP_SLOT, binding = 0) uniform sampler2D normalMap[];
 
+layout (set = 4, binding = 0) uniform CameraBuffer
+{
+	CameraDataGPU CAM_DATA;
+	LightingData LIGHTING_DATA;
+	TextureStreamingGPU TEXTURE_STREAMING;
+};
+
+#include "texture_streaming.glsl"
+
 void main()
 {
 	outPosition = vec4(fragPosWorld, 1.0);
 
 	vec3 resColor = vec3(0.0, 0.0, 0.0);
 
-	vec4 diffuseMaterial = texture(diffuseTex[matID], texCoord);
-	float metallicMaterial = texture(metallicTex[matID], texCoord).b;
-	float roughnessMaterial = texture(roughnessTex[matID], texCoord).g;
-	vec4 normalTex = texture(normalMap[matID], texCoord);
+	// implicit derivatives are only defined in uniform control flow, so the LODs are queried by the whole quad
+	const float diffuseLod = textureQueryLod(diffuseTex[matID], texCoord).y;
+	const float ormLod = textureQueryLod(ormTex[matID], texCoord).y;
+	const float normalMapLod = textureQueryLod(normalMap[matID], texCoord).y;
+
+	if (IsTextureFeedbackPixel(uvec2(gl_FragCoord.xy)))
+	{
+		RequestTextureLod(matID, STREAMED_DIFFUSE_TEX, diffuseLod);
+		RequestTextureLod(matID, STREAMED_ORM_TEX, ormLod);
+		RequestTextureLod(matID, STREAMED_NORMAL_MAP, normalMapLod);
+	}
+
+	// mips finer than the resident ones are not loaded yet
+	vec4 diffuseMaterial = textureClampARB(diffuseTex[matID], texCoord, GetTextureMinLod(matID, STREAMED_DIFFUSE_TEX));
+	vec3 ormMaterial = textureClampARB(ormTex[matID], texCoord, GetTextureMinLod(matID, STREAMED_ORM_TEX)).rgb;
+	float metallicMaterial = ormMaterial.b;
+	float roughnessMaterial = ormMaterial.g;
+	vec4 normalTex = textureClampARB(normalMap[matID], texCoord, GetTextureMinLod(matID, STREAMED_NORMAL_MAP));
 
 	vec3 T = normalize(fragTangent);
 	vec3 B = cross(fragNormalWorld, fragTangent);
@@ -41,7 +68,7 @@ void main()
 	mat3 TBN = mat3(T, B, N);
 
 	vec3 surfaceNormal = normalize(fragNormalWorld);
-	vec3 mappedNormal = TBN * normalize(normalTex.xyz * 2.0 - vec3(1.0));
+	vec3 mappedNormal = TBN * DecodeNormalMapTexel(normalTex);
 	
 	if (normalTex.w > 0.2)
 	{
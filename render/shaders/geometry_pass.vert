@@ -4,14 +4,20 @@
 
 #include "common.glsl"
 #include "host_device_common.h"
+#include "vertex_decoding.glsl"
 
+#if USE_COMPACT_VERTICES
+layout (location = 0) in vec4 vPosition; // relative to the mesh bounds
+layout (location = 1) in vec2 vNormal; // octahedral
+layout (location = 2) in vec2 vTexCoord;
+layout (location = 3) in vec2 vTangent; // octahedral
+#else
 layout (location = 0) in vec3 vPosition;
 layout (location = 1) in vec3 vNormal;
-layout (location = 2) in vec3 vColor;
-layout (location = 3) in vec2 vTexCoord;
-layout (location = 4) in vec3 vTangent;
+layout (location = 2) in vec2 vTexCoord;
+layout (location = 3) in vec3 vTangent;
+#endif
 
-layout (location = 0) out vec3 outColor;
 layout (location = 1) out vec2 texCoord;
 layout (location = 2) flat out uint matID;
 layout (location = 3) out vec3 fragPosWorld;
@@ -19,14 +25,14 @@ layout (location = 4) out vec3 fragNormalWorld;
 layout (location = 5) out vec3 fragTangent;
 
 
-layout (set = 5, binding = 0) uniform CameraBuffer
+layout (set = 4, binding = 0) uniform CameraBuffer
 {
 	CameraDataGPU camData;
 } camSceneData;
 
 
 // object data 
-layout (set = 4, binding = 0, scalar) readonly buffer ObjectBuffer
+layout (set = 3, binding = 0, scalar) readonly buffer ObjectBuffer
 {
 	ObjectData objects[];
 } objectBuffer;
@@ -34,18 +40,28 @@ layout (set = 4, binding = 0, scalar) readonly buffer ObjectBuffer
 
 void main()
 {
-	mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
+	ObjectData object = objectBuffer.objects[gl_BaseInstance];
+	mat4 modelMatrix = object.model;
+
+#if USE_COMPACT_VERTICES
+	vec3 position = DecodePosition(vPosition.xyz, object.positionOffset, object.positionScale);
+	vec3 normal = OctDecode(vNormal);
+	vec3 tangent = OctDecode(vTangent);
+#else
+	vec3 position = vPosition;
+	vec3 normal = vNormal;
+	vec3 tangent = vTangent;
+#endif
 
 	// normal transform, no non-uniform scaling
-	fragNormalWorld = normalize(modelMatrix * vec4(vNormal, 0.0)).xyz;
+	fragNormalWorld = normalize(modelMatrix * vec4(normal, 0.0)).xyz;
 
-	vec4 vPositionWorld = modelMatrix * vec4(vPosition, 1.0);
+	vec4 vPositionWorld = modelMatrix * vec4(position, 1.0);
 	fragPosWorld = vPositionWorld.xyz;
 
 	gl_Position = camSceneData.camData.viewproj * vPositionWorld;
 
-	outColor = vColor;
 	texCoord = vTexCoord;
-	matID = objectBuffer.objects[gl_BaseInstance].matIndex;
-	fragTangent = vTangent;
+	matID = object.matIndex;
+	fragTangent = tangent;
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #if !defined(HIT_PROPERTIES_GLSL)
 #define HIT_PROPERTIES_GLSL
 
+#include "common.glsl"
+#include "texture_streaming.glsl"
+#include "vertex_fetch.glsl"
+
 
 struct HitProperties
 {
@@ -11,6 +15,8 @@ struct HitProperties
 	vec3 bitangent;
 	vec3 normal;
 	vec3 emittance;
+	// uv units per world unit on the surface, turns ray cone widths into texture LODs
+	float uvDensity;
 };
 
 
@@ -26,14 +32,12 @@ HitProperties GetHitProperties(int instId, int primId, mat4x3 objectToWorld, mat
 	HitProperties hitProperties;
 
 	ObjectData currentObject = objectBuffer.objects[instId];
-	Indices curIndices = Indices(currentObject.indexBufferAddress);
-	Vertices curVertices = Vertices(currentObject.vertexBufferAddress);
 
-	uvec3 triangleInd = curIndices.INDICES[primId];
+	uvec3 triangleInd = FetchTriangleIndices(currentObject, primId);
 
-	Vertex v0 = curVertices.VERTICES[triangleInd.x];
-	Vertex v1 = curVertices.VERTICES[triangleInd.y];
-	Vertex v2 = curVertices.VERTICES[triangleInd.z];
+	DecodedVertex v0 = FetchVertex(currentObject, triangleInd.x);
+	DecodedVertex v1 = FetchVertex(currentObject, triangleInd.y);
+	DecodedVertex v2 = FetchVertex(currentObject, triangleInd.z);
 
 	const vec3 barycentrics = vec3(1.0 - hitUV.x - hitUV.y, hitUV.x, hitUV.y);
 
@@ -48,6 +52,16 @@ HitProperties GetHitProperties(int instId, int primId, mat4x3 objectToWorld, mat
 
 	hitProperties.worldPos = worldPos;
 
+	const vec3 worldEdge1 = objectToWorld * vec4(v1.position - v0.position, 0.0);
+	const vec3 worldEdge2 = objectToWorld * vec4(v2.position - v0.position, 0.0);
+	const vec2 uvEdge1 = v1.uv - v0.uv;
+	const vec2 uvEdge2 = v2.uv - v0.uv;
+
+	const float worldArea = length(cross(worldEdge1, worldEdge2));
+	const float uvArea = abs(uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x);
+
+	hitProperties.uvDensity = sqrt(uvArea / max(worldArea, FLT_EPS));
+
 	int matID = currentObject.matIndex;
 	hitProperties.matID = matID;
 
@@ -68,8 +82,8 @@ HitProperties GetHitProperties(int instId, int primId, mat4x3 objectToWorld, mat
 
 	mat3 TBN = mat3(T, B, N);
 
-	const vec4 normalTex = texture(normalMap[matID], texCoord);
-	vec3 mappedNormal = TBN * normalize(normalTex.xyz * 2.0 - vec3(1.0));
+	const vec4 normalTex = textureLod(normalMap[matID], texCoord, GetTextureMinLod(uint(matID), STREAMED_NORMAL_MAP));
+	vec3 mappedNormal = TBN * DecodeNormalMapTexel(normalTex);
 
 	if (normalTex.w > 0.2)
 	{
@@ -16,6 +16,10 @@
 
 const uint32_t MAX_POINT_LIGHTS_PER_FRAME = 3;
 
+// Store vertices in GPU buffers as CompactVertex instead of full-precision Vertex. Vertex is still used on the CPU
+// for import-time processing, meshes are packed on upload.
+#define USE_COMPACT_VERTICES 1
+
 struct WindowExtent
 {
 	uint32_t width;
@@ -53,24 +57,98 @@ struct LightingData
 	PointLightGPU pointLights[MAX_POINT_LIGHTS_PER_FRAME];
 };
 
+// Texture streaming: every material has one streamed texture entry per material texture slot (diffuse, ORM, normal map),
+// entry = matIndex * STREAMED_TEXTURE_SLOTS + slot
+const uint32_t STREAMED_TEXTURE_SLOTS = 3;
+// one pixel of every TEXTURE_FEEDBACK_PIXEL_STRIDE^2 block writes feedback per frame, the pixel rotates between frames
+const uint32_t TEXTURE_FEEDBACK_PIXEL_STRIDE = 8;
+
+struct TextureStreamingGPU
+{
+	// float per entry, finest resident mip
+	uint64_t minLodsAddress;
+	// uint per entry, finest mip requested by shaders this frame, reset to 0xFFFFFFFF
+	uint64_t feedbackAddress;
+	uint32_t frame;
+
+#ifdef __cplusplus
+	int32_t ENABLED;
+#else
+	bool ENABLED;
+#endif
+
+	// scalars, std140 would pad the elements of an array to 16 bytes and offset the members that follow in CameraBuffer
+	int32_t padding0;
+	int32_t padding1;
+};
+
+// Equirectangular environment map, sampled proportionally to luminance * sin(theta) through a marginal CDF over its
+// rows and a conditional CDF per row, see environment_sampling.glsl
+struct EnvironmentMapGPU
+{
+	// float per texel, the CDFs of all rows one after another
+	uint64_t conditionalCdfAddress;
+	// float per row
+	uint64_t marginalCdfAddress;
+	uint32_t width;
+	uint32_t height;
+};
+
+// ObjectData::flags
+const uint32_t OBJECT_FLAG_16BIT_INDICES = 1;
+// drawn through cluster culling in the current frame instead of a regular indexed draw
+const uint32_t OBJECT_FLAG_CLUSTER_DRAW = 2;
+
+// TLAS instance masks, coarse instances use the lowest-detail mesh LODs
+const uint32_t RT_MASK_DETAILED = 0x01;
+const uint32_t RT_MASK_COARSE = 0x02;
+
 struct ObjectData
 {
 	mat4 model;
 	int32_t matIndex;
+	uint32_t flags;
 	uint64_t vertexBufferAddress;
 	uint64_t indexBufferAddress;
 	vec3 emittance;
+	// compact vertex positions are stored relative to the mesh bounds: position = offset + snorm * scale
+	vec3 positionOffset;
+	vec3 positionScale;
 };
 
 struct Vertex
 {
 	vec3 position;
 	vec3 normal;
-	vec3 color;
 	vec2 uv;
 	vec3 tangent;
 };
 
+// 20 bytes, fields are packed into 32-bit words so that shaders can read them without 16-bit storage support.
+// Field order matches the vertex input attributes of the compact format.
+struct CompactVertex
+{
+	uint32_t positionXY; // snorm16 x2, relative to the mesh bounds
+	uint32_t positionZW; // snorm16 x2, w is unused
+	uint32_t normal;     // octahedral snorm16 x2
+	uint32_t uv;         // half x2
+	uint32_t tangent;    // octahedral snorm16 x2
+};
+
+#if USE_COMPACT_VERTICES
+	#ifdef __cplusplus
+		using GPUVertex = CompactVertex;
+	#else
+		#define GPUVertex CompactVertex
+	#endif
+#else
+	#ifdef __cplusplus
+		using GPUVertex = Vertex;
+	#else
+		#define GPUVertex Vertex
+	#endif
+#endif
+
 struct RayPushConstants
 {
 	int32_t frame;
@@ -86,7 +164,81 @@ struct RayPushConstants
 #endif
 	int32_t MAX_BOUNCES;
 
-	int32_t padding[3];
+#ifdef __cplusplus
+	int32_t USE_COARSE_SECONDARY_LODS;
+	int32_t USE_ENVIRONMENT_SAMPLING;
+#else
+	bool USE_COARSE_SECONDARY_LODS;
+	bool USE_ENVIRONMENT_SAMPLING;
+#endif
+
+	int32_t padding;
+};
+
+// Meshlet limits, also the maximum mesh shader output
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// clusters per compute culling and task shader workgroup
+const uint32_t CLUSTER_CULLING_GROUP_SIZE = 32;
+
+// A meshlet of a single object
+struct ClusterData
+{
+	// object space
+	vec3 boundsCenter;
+	float boundsRadius;
+	vec3 coneAxis;
+	float coneCutoff;
+
+	uint32_t objectId;
+	// triangles of the meshlet in the arena index buffer, used by the indexed indirect path
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+
+	// mesh vertex ids and packed local triangles of the meshlet, used by the mesh shading path
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	uint64_t meshletVerticesAddress;
+	uint64_t meshletTrianglesAddress;
+};
+
+struct ClusterCullPushConstants
+{
+	// world-space side planes of the view frustum, xyz points inside
+	vec4 frustumPlanes[4];
+	vec3 cameraPosition;
+	uint32_t clusterCount;
+
+	uint64_t clustersAddress;
+	uint64_t objectsAddress;
+	// one VkDrawIndexedIndirectCommand per cluster, written by compute culling
+	uint64_t drawCommandsAddress;
+
+#ifdef __cplusplus
+	int32_t USE_CONE_CULLING;
+#else
+	bool USE_CONE_CULLING;
+#endif
+
+	int32_t padding;
+};
+
+// texels per side of a compute mip generation workgroup, see mip_downsample.glsl
+const uint32_t MIP_DOWNSAMPLE_GROUP_SIZE = 8;
+
+struct MipDownsamplePushConstants
+{
+#ifdef __cplusplus
+	// texels are averaged as unit vectors and renormalized
+	int32_t IS_NORMAL_MAP;
+	// the destination is a UNORM view of an sRGB image
+	int32_t ENCODE_SRGB;
+#else
+	bool IS_NORMAL_MAP;
+	bool ENCODE_SRGB;
+#endif
 };
 
 #ifdef __cplusplus
@@ -96,14 +248,13 @@ enum class RTXSets
 const uint
 #endif
 	eDiffuseTex = 0,
-	eMetallicTex = 1,
-	eRoughnessTex = 2,
-	eNormalMap = 3,
-	eSkybox = 4,
-	eObjectData = 5,
-	ePerFrame = 6,
-	eGeneralRTX = 7,
-	eGlobal = 8
+	eOrmTex = 1,
+	eNormalMap = 2,
+	eSkybox = 3,
+	eObjectData = 4,
+	ePerFrame = 5,
+	eGeneralRTX = 6,
+	eGlobal = 7
 #ifdef __cplusplus
 }
 #endif
@@ -29,7 +29,7 @@ layout (set = 2 + TLAS_SLOT, binding = 0) uniform accelerationStructureEXT TLAS;
 bool ShadowRayQueryHit(vec3 origin, vec3 direction, float tMin, float tMax)
 {
 	rayQueryEXT shadowQuery;
-	rayQueryInitializeEXT(shadowQuery, TLAS, gl_RayFlagsTerminateOnFirstHitEXT, 0xFF, origin, tMin,
+	rayQueryInitializeEXT(shadowQuery, TLAS, gl_RayFlagsTerminateOnFirstHitEXT, RT_MASK_DETAILED, origin, tMin,
 		direction, tMax);
 
 	while (rayQueryProceedEXT(shadowQuery))
@@ -0,0 +1,105 @@
+#if !defined(MIP_DOWNSAMPLE_GLSL)
+#define MIP_DOWNSAMPLE_GLSL
+
+#include "common.glsl"
+
+// Box filter from one mip level into the next, one invocation per destination texel. The source is read through a
+// view of the image format, so sRGB texels arrive linear. Expects host_device_common.h to be included and
+// MIP_STORAGE_FORMAT to be defined as the format qualifier of the destination view.
+
+layout (local_size_x = MIP_DOWNSAMPLE_GROUP_SIZE, local_size_y = MIP_DOWNSAMPLE_GROUP_SIZE) in;
+
+layout (set = 0, binding = 0) uniform sampler2D srcMip;
+layout (set = 0, binding = 1, MIP_STORAGE_FORMAT) uniform writeonly image2D dstMip;
+
+layout (push_constant) uniform constants
+{
+	MipDownsamplePushConstants mipConstants;
+};
+
+
+vec3 LinearToSrgb(vec3 color)
+{
+	const vec3 low = color * 12.92;
+	const vec3 high = 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055;
+
+	return mix(high, low, lessThanEqual(color, vec3(0.0031308)));
+}
+
+
+// First source texel and the weights of the up to three source texels covering a destination texel along one axis.
+// Odd source sizes don't halve evenly, every destination texel then covers parts of three source texels.
+void GetFootprint(uint dstCoord, uint dstSize, uint srcSize, out int firstTexel, out vec3 weights)
+{
+	firstTexel = int(2u * dstCoord);
+
+	if (srcSize == 1u)
+	{
+		firstTexel = 0;
+		weights = vec3(1.0, 0.0, 0.0);
+	}
+	else if ((srcSize & 1u) == 0u)
+	{
+		weights = vec3(0.5, 0.5, 0.0);
+	}
+	else
+	{
+		weights = vec3(float(dstSize - dstCoord), float(dstSize), float(dstCoord + 1)) / float(srcSize);
+	}
+}
+
+
+void main()
+{
+	const uvec2 dstSize = uvec2(imageSize(dstMip));
+	const uvec2 dstTexel = gl_GlobalInvocationID.xy;
+
+	if (any(greaterThanEqual(dstTexel, dstSize)))
+	{
+		return;
+	}
+
+	const uvec2 srcSize = uvec2(textureSize(srcMip, 0));
+
+	int firstX, firstY;
+	vec3 weightsX, weightsY;
+	GetFootprint(dstTexel.x, dstSize.x, srcSize.x, firstX, weightsX);
+	GetFootprint(dstTexel.y, dstSize.y, srcSize.y, firstY, weightsY);
+
+	vec4 sum = vec4(0.0);
+
+	for (int y = 0; y < 3; ++y)
+	{
+		for (int x = 0; x < 3; ++x)
+		{
+			const float weight = weightsX[x] * weightsY[y];
+			if (weight == 0.0)
+			{
+				continue;
+			}
+
+			vec4 texel = texelFetch(srcMip, ivec2(firstX + x, firstY + y), 0);
+			if (mipConstants.IS_NORMAL_MAP)
+			{
+				texel.xyz = DecodeNormalMapTexel(texel);
+			}
+
+			sum += weight * texel;
+		}
+	}
+
+	if (mipConstants.IS_NORMAL_MAP)
+	{
+		// opposing normals may cancel out
+		const float len = length(sum.xyz);
+		sum.xyz = (len > FLT_EPS ? sum.xyz / len : vec3(0.0, 0.0, 1.0)) * 0.5 + vec3(0.5);
+	}
+	else if (mipConstants.ENCODE_SRGB)
+	{
+		sum.rgb = LinearToSrgb(sum.rgb);
+	}
+
+	imageStore(dstMip, ivec2(dstTexel), sum);
+}
+
+#endif // MIP_DOWNSAMPLE_GLSL
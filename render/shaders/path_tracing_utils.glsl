@@ -2,6 +2,7 @@
 #define PATH_TRACING_UTILS_GLSL
 
 #include "hit_properties.glsl"
+#include "environment_map.glsl"
 
 
 vec2 HiresToLowres(ivec2 ipos, vec2 jitterOffset)
@@ -19,11 +20,20 @@ float GetSampleWeight(vec2 delta, float scale)
 }
 
 
+// Primary rays always see full detail, later bounces may use the coarse LOD instances
+uint GetCullMask()
+{
+	return (rayConstants.USE_COARSE_SECONDARY_LODS && rayPayload.depth > 0) ? RT_MASK_COARSE : RT_MASK_DETAILED;
+}
+
+
 HitProperties TraceRay(vec3 origin, vec3 direction, float tMin, float tMax, uint rayFlags)
 {
 	HitProperties resHitProperties;
 	InitHitProperties(resHitProperties);
 
+	const uint cullMask = GetCullMask();
+
 	if (rayConstants.USE_SHADER_EXECUTION_REORDERING)
 	{
 		hitObjectNV hObj;
@@ -32,7 +42,7 @@ HitProperties TraceRay(vec3 origin, vec3 direction, float tMin, float tMax, uint
 		hitObjectTraceRayNV(hObj,
 			TLAS,	           // TLAS
 			rayFlags,		   // flags
-			0xFF,			   // cull mask
+			cullMask,		   // cull mask
 			0,				   // SBT record offset
 			0,				   // SBT record stride
 			0,				   // miss shader index
@@ -48,7 +58,7 @@ HitProperties TraceRay(vec3 origin, vec3 direction, float tMin, float tMax, uint
 
 		if (hitObjectIsHitNV(hObj))
 		{
-			int instId = hitObjectGetInstanceCustomIndexNV(hObj);
+			int instId = hitObjectGetInstanceCustomIndexNV(hObj) + hitObjectGetGeometryIndexNV(hObj);
 			int primId = hitObjectGetPrimitiveIndexNV(hObj);
 			mat4x3 objectToWorld = hitObjectGetObjectToWorldNV(hObj);
 			mat4x3 worldToObject = hitObjectGetWorldToObjectNV(hObj);
@@ -60,9 +70,7 @@ HitProperties TraceRay(vec3 origin, vec3 direction, float tMin, float tMax, uint
 		}
 		else
 		{
-			// vec3 rayMissDirection = normalize(hitObjectGetWorldRayDirectionNV(hObj));
-			// vec3 missValue = texture(skyboxSampler, rayMissDirection).rgb;
-			vec3 missValue = vec3(253.0f / 255.0f, 251.0f / 255.0f, 211.0f / 255.0f) * 5;
+			vec3 missValue = GetEnvironmentRadiance(normalize(hitObjectGetWorldRayDirectionNV(hObj)));
 			OnRayMiss(rayPayload, missValue);
 		}
 	}
@@ -70,7 +78,7 @@ HitProperties TraceRay(vec3 origin, vec3 direction, float tMin, float tMax, uint
 	{
 		traceRayEXT(TLAS,	   // TLAS
 			rayFlags,		   // flags
-			0xFF,			   // cull mask
+			cullMask,		   // cull mask
 			0,				   // SBT record offset
 			0,				   // SBT record stride
 			0,				   // miss shader index
@@ -104,6 +112,33 @@ bool ShadowRayHit(vec3 origin, vec3 direction, float distToLight)
 }
 
 
+// Only the shadow miss shader writes the payload, the closest hit shader is skipped
+bool IsVisible(vec3 origin, vec3 direction, float tMin, float tMax)
+{
+	rayPayload.hasMissed = false;
+
+	traceRayEXT(TLAS,	   // TLAS
+		gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsSkipClosestHitShaderEXT, // flags
+		GetCullMask(),	   // cull mask
+		0,				   // SBT record offset
+		0,				   // SBT record stride
+		1,				   // miss shader index
+		origin,	           // ray origin
+		tMin,			   // ray min range
+		direction,         // ray direction
+		tMax,			   // ray max range
+		0				   // ray payload location
+	);
+
+	const bool isVisible = rayPayload.hasMissed;
+
+	// the path goes on from the vertex the ray was traced from
+	rayPayload.hasMissed = false;
+
+	return isVisible;
+}
+
+
 float CalculateCurrentFrameWeightAndMotion(vec3 primaryHitPos, vec2 frameUV, vec2 subpixelJitter, out vec2 motion)
 {
 	vec3 worldSpacePositionCurr = primaryHitPos;
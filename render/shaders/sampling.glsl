@@ -79,4 +79,13 @@ vec3 sampleGGX(float roughness, inout uint seed, in vec3 x, in vec3 y, in vec3 z
 	return direction;
 }
 
+// MIS weight of a sample of the strategy with pdfA, for one sample per strategy
+float PowerHeuristic(float pdfA, float pdfB)
+{
+	const float weightA = pdfA * pdfA;
+	const float weightSum = weightA + pdfB * pdfB;
+
+	return weightSum > 0.0 ? weightA / weightSum : 0.0;
+}
+
 #endif // SAMPLING_GLSL
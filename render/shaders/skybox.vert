@@ -1,10 +1,14 @@
 #version 460
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
 
+#include "host_device_common.h"
+#include "vertex_decoding.glsl"
+
+#if USE_COMPACT_VERTICES
+layout (location = 0) in vec4 vPosition; // relative to the mesh bounds
+#else
 layout (location = 0) in vec3 vPosition;
-layout (location = 1) in vec3 vNormal;
-layout (location = 2) in vec3 vColor;
-layout (location = 3) in vec2 vTexCoord;
-layout (location = 4) in vec3 vTangent;
+#endif
 
 struct CameraData
 {
@@ -24,14 +28,22 @@ layout (location = 0) out vec3 outUVW;
 layout (push_constant) uniform constants
 {
 	mat4 renderMatrix;
+	vec4 positionOffset;
+	vec4 positionScale;
 } PushConstants;
 
 void main()
 {
+#if USE_COMPACT_VERTICES
+	vec3 position = DecodePosition(vPosition.xyz, PushConstants.positionOffset.xyz, PushConstants.positionScale.xyz);
+#else
+	vec3 position = vPosition;
+#endif
+
 	// normal transform, no non-uniform scaling
 
-	vec4 vPositionWorld = PushConstants.renderMatrix * vec4(vPosition, 1.0);
+	vec4 vPositionWorld = PushConstants.renderMatrix * vec4(position, 1.0);
 	gl_Position = camSceneData.camData.viewproj * vPositionWorld;
 	
-	outUVW = vPosition;
+	outUVW = position;
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#if !defined(TEXTURE_STREAMING_GLSL)
+#define TEXTURE_STREAMING_GLSL
+
+#include "common.glsl"
+
+// Streamed material textures. Sampling is clamped to the resident mips, and shaders report the finest mip they would
+// sample so that the texture streamer can load it. Expects host_device_common.h to be included, GL_EXT_buffer_reference2
+// and GL_EXT_scalar_block_layout to be enabled, and the shader to declare TextureStreamingGPU TEXTURE_STREAMING.
+
+// material texture slots, the same as their descriptor set indices
+const uint STREAMED_DIFFUSE_TEX = 0;
+const uint STREAMED_ORM_TEX = 1;
+const uint STREAMED_NORMAL_MAP = 2;
+
+layout (buffer_reference, scalar) readonly buffer TextureMinLods
+{
+	float MIN_LODS[];
+};
+
+layout (buffer_reference, scalar) buffer TextureFeedback
+{
+	uint REQUESTED_MIPS[];
+};
+
+
+// Finest mip that may be sampled, textures that aren't streamed are fully resident
+float GetTextureMinLod(uint matID, uint slot)
+{
+	if (!TEXTURE_STREAMING.ENABLED)
+	{
+		return 0.0;
+	}
+
+	return TextureMinLods(TEXTURE_STREAMING.minLodsAddress).MIN_LODS[matID * STREAMED_TEXTURE_SLOTS + slot];
+}
+
+
+// A single pixel of every block writes feedback, which keeps contention on the feedback entries low. The pixel moves
+// through the block from frame to frame, so that every pixel is covered over time.
+bool IsTextureFeedbackPixel(uvec2 pixel)
+{
+	if (!TEXTURE_STREAMING.ENABLED)
+	{
+		return false;
+	}
+
+	const uint blockPixel = TEXTURE_STREAMING.frame % (TEXTURE_FEEDBACK_PIXEL_STRIDE * TEXTURE_FEEDBACK_PIXEL_STRIDE);
+	const uvec2 feedbackPixel = uvec2(blockPixel % TEXTURE_FEEDBACK_PIXEL_STRIDE, blockPixel / TEXTURE_FEEDBACK_PIXEL_STRIDE);
+
+	return all(equal(pixel % TEXTURE_FEEDBACK_PIXEL_STRIDE, feedbackPixel));
+}
+
+
+void RequestTextureLod(uint matID, uint slot, float lod)
+{
+	const uint mip = uint(max(floor(lod), 0.0));
+
+	atomicMin(TextureFeedback(TEXTURE_STREAMING.feedbackAddress).REQUESTED_MIPS[matID * STREAMED_TEXTURE_SLOTS + slot], mip);
+}
+
+
+// LOD of a footprint in uv units, for stages without derivatives
+float GetFootprintLod(sampler2D tex, float uvFootprint)
+{
+	const ivec2 size = textureSize(tex, 0);
+
+	return log2(max(uvFootprint * float(max(size.x, size.y)), FLT_EPS));
+}
+
+#endif // TEXTURE_STREAMING_GLSL
@@ -0,0 +1,30 @@
+#if !defined(VERTEX_DECODING_GLSL)
+#define VERTEX_DECODING_GLSL
+
+// Shared by the vertex input path (attributes already converted from snorm/half by the hardware)
+// and the buffer_reference path in ray tracing shaders, so both decode to the exact same values
+
+
+vec2 SignNotZero(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+
+vec3 OctDecode(vec2 encoded)
+{
+	vec3 v = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	if (v.z < 0.0)
+	{
+		v.xy = (1.0 - abs(v.yx)) * SignNotZero(v.xy);
+	}
+	return normalize(v);
+}
+
+
+vec3 DecodePosition(vec3 snormPosition, vec3 positionOffset, vec3 positionScale)
+{
+	return positionOffset + snormPosition * positionScale;
+}
+
+#endif // VERTEX_DECODING_GLSL
@@ -0,0 +1,79 @@
+#if !defined(VERTEX_FETCH_GLSL)
+#define VERTEX_FETCH_GLSL
+
+#include "vertex_decoding.glsl"
+
+
+layout (buffer_reference, scalar) buffer Vertices
+{
+	GPUVertex VERTICES[];
+};
+
+layout (buffer_reference, scalar) buffer Indices
+{
+	uvec3 INDICES[];
+};
+
+// 16-bit index buffers are read as pairs of indices packed into 32-bit words, so no 16-bit storage support is needed
+layout (buffer_reference, scalar) buffer Indices16
+{
+	uint INDEX_PAIRS[];
+};
+
+
+struct DecodedVertex
+{
+	vec3 position;
+	vec3 normal;
+	vec2 uv;
+	vec3 tangent;
+};
+
+
+DecodedVertex FetchVertex(ObjectData object, uint vertexId)
+{
+	Vertices vertices = Vertices(object.vertexBufferAddress);
+	GPUVertex v = vertices.VERTICES[vertexId];
+
+	DecodedVertex decoded;
+
+#if USE_COMPACT_VERTICES
+	vec3 snormPosition = vec3(unpackSnorm2x16(v.positionXY), unpackSnorm2x16(v.positionZW).x);
+
+	decoded.position = DecodePosition(snormPosition, object.positionOffset, object.positionScale);
+	decoded.normal = OctDecode(unpackSnorm2x16(v.normal));
+	decoded.uv = unpackHalf2x16(v.uv);
+	decoded.tangent = OctDecode(unpackSnorm2x16(v.tangent));
+#else
+	decoded.position = v.position;
+	decoded.normal = v.normal;
+	decoded.uv = v.uv;
+	decoded.tangent = v.tangent;
+#endif
+
+	return decoded;
+}
+
+
+uvec3 FetchTriangleIndices(ObjectData object, int primId)
+{
+	if ((object.flags & OBJECT_FLAG_16BIT_INDICES) != 0)
+	{
+		Indices16 indices = Indices16(object.indexBufferAddress);
+
+		uvec3 triangleInd;
+		for (uint i = 0; i < 3; ++i)
+		{
+			uint indexId = uint(primId) * 3 + i;
+			uint indexPair = indices.INDEX_PAIRS[indexId >> 1];
+			triangleInd[i] = (indexId & 1) == 0 ? (indexPair & 0xFFFF) : (indexPair >> 16);
+		}
+
+		return triangleInd;
+	}
+
+	Indices indices = Indices(object.indexBufferAddress);
+	return indices.INDICES[primId];
+}
+
+#endif // VERTEX_FETCH_GLSL